@@ -0,0 +1,93 @@
+#!/usr/bin/python
+
+# Compare a benchmark result file written by one of the bench_*
+# programs against a stored baseline, and report regressions.
+#
+# Records are matched on all of their fields except the measured
+# values listed in METRICS. A metric regresses if it is worse than the
+# baseline by more than the tolerance. Exits with status 1 if anything
+# regressed, so it can be used in CI.
+#
+# Usage: compare_bench.py baseline.json current.json [--tolerance 0.1]
+
+import sys
+import json
+import argparse
+
+# measured values, and whether a larger value is better
+METRICS = {
+    "steps_per_sec": True,
+    "batches_per_second": True,
+    "ns_per_edge": False,
+    "best_ns_per_edge": False,
+    "peak_rss_kib": False,
+    "us_per_batch": False,
+    "best_us_per_batch": False,
+    "us_per_job_submit": False,
+    "us_per_job_total": False,
+    "us_per_barrier": False,
+    "llrt_ns_per_item": False,
+    "hand_ns_per_item": False,
+    "ratio": False,
+    "seconds_per_step": False,
+    "speedup": True,
+    "efficiency": True,
+}
+
+# fields that are neither metrics nor part of a record's identity
+IGNORED = {"reps", "steps", "batches", "barriers", "pass", "max_abs_diff",
+           "kernel_us", "single_us", "multi_us", "multi_faster", "crossover",
+           "kernel_s", "barrier_s", "sched_s", "barriers_per_step"}
+
+def key(record):
+    return tuple(sorted((k, json.dumps(v)) for k, v in record.items()
+                        if k not in METRICS and k not in IGNORED))
+
+def load(filename):
+    with open(filename, 'r') as f:
+        data = json.load(f)
+    return data["benchmark"], {key(r): r for r in data["results"]}
+
+def describe(k):
+    return ", ".join("{}={}".format(name, value) for name, value in k)
+
+def main(args):
+    baseName, baseline = load(args.baseline)
+    curName, current = load(args.current)
+    if baseName != curName:
+        print("warning: comparing results of {} against {}".format(curName, baseName))
+
+    regressions = 0
+    for k, cur in current.items():
+        if k not in baseline:
+            print("new:       " + describe(k))
+            continue
+        base = baseline[k]
+        for metric, higherIsBetter in METRICS.items():
+            if metric not in cur or metric not in base or base[metric] == 0:
+                continue
+            change = (cur[metric] - base[metric]) / abs(base[metric])
+            if higherIsBetter:
+                change = -change
+            # change > 0 means worse
+            if change > args.tolerance:
+                regressions += 1
+                print("REGRESSED: {}: {} {} -> {} ({:+.1f}%)".format(
+                    describe(k), metric, base[metric], cur[metric], 100*change))
+            elif args.verbose:
+                print("ok:        {}: {} {} -> {} ({:+.1f}%)".format(
+                    describe(k), metric, base[metric], cur[metric], 100*change))
+    for k in baseline:
+        if k not in current:
+            print("missing:   " + describe(k))
+
+    print("{} regression(s) beyond {:.0f}%".format(regressions, 100*args.tolerance))
+    return 1 if regressions > 0 else 0
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Compare benchmark results against a baseline.')
+    parser.add_argument('baseline', type=str, help="baseline JSON file")
+    parser.add_argument('current', type=str, help="JSON file to compare against the baseline")
+    parser.add_argument('--tolerance', type=float, default=0.1, help="allowed relative slowdown before reporting a regression (default 0.1)")
+    parser.add_argument('-v', '--verbose', action='store_true', help="also show metrics that did not regress")
+    sys.exit(main(parser.parse_args()))
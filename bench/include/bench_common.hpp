@@ -0,0 +1,246 @@
+#ifndef BENCH_COMMON_HPP_
+#define BENCH_COMMON_HPP_
+
+// Helpers shared by the benchmark programs in bench/src: command line
+// options, timing loops, and a small JSON writer so that results can
+// be compared between runs by scripts.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cstring>
+#include <limits>
+
+namespace llrt{
+
+    /**
+       Options common to all benchmark programs.
+
+       --quick          smaller problem sizes and shorter timing loops
+       --out=FILE       write the JSON results to FILE instead of stdout
+       --workers=0,1,4  worker counts to run with. 0 means no Scheduler.
+       --min-time=SEC   minimum time to spend timing each configuration
+    */
+    struct BenchOptions{
+        bool quick = false;
+        std::string outFile = "";
+        std::vector<size_t> workers;
+        bool workersGiven = false; ///< true if --workers was on the command line
+        double minTime = 0.25;
+        std::vector<std::string> extra; ///< arguments not recognized here, left for the program
+
+        BenchOptions(int argc, char **argv){
+            size_t hw = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+            workers = {0, 1, 2, hw};
+            for(int i=1; i < argc; i++){
+                std::string a = argv[i];
+                if (a == "--quick"){
+                    quick = true;
+                    minTime = 0.05;
+                }
+                else if (a.rfind("--out=", 0) == 0)
+                    outFile = a.substr(6);
+                else if (a.rfind("--min-time=", 0) == 0)
+                    minTime = std::stod(a.substr(11));
+                else if (a.rfind("--workers=", 0) == 0){
+                    workers = parseList(a.substr(10));
+                    workersGiven = true;
+                }
+                else
+                    extra.push_back(a);
+            }
+            std::sort(workers.begin(), workers.end());
+            workers.erase(std::unique(workers.begin(), workers.end()), workers.end());
+        }
+
+        static std::vector<size_t> parseList(const std::string &s){
+            std::vector<size_t> v;
+            std::stringstream st(s);
+            std::string item;
+            while(std::getline(st, item, ','))
+                if (!item.empty())
+                    v.push_back(std::stoul(item));
+            return v;
+        }
+
+        /**
+           @return the value of an extra option --name=value, or def if it
+           was not given
+        */
+        std::string get(const std::string &name, const std::string &def) const{
+            std::string prefix = "--" + name + "=";
+            for(const std::string &a : extra)
+                if (a.rfind(prefix, 0) == 0)
+                    return a.substr(prefix.size());
+            return def;
+        }
+
+        bool has(const std::string &name) const{
+            return std::find(extra.begin(), extra.end(), "--" + name) != extra.end();
+        }
+    };
+
+    /**
+       The result of timing a repeated operation.
+     */
+    struct BenchTiming{
+        size_t reps = 0;
+        double seconds = 0; ///< total time for all reps
+        double best = 0; ///< fastest single rep, in seconds
+
+        double perRep() const{
+            return reps == 0 ? 0 : seconds / reps;
+        }
+    };
+
+    /**
+       Run f once to warm up, then repeatedly until at least minTime
+       seconds and minReps repetitions have elapsed.
+     */
+    template<typename F>
+    BenchTiming benchTime(F &&f, double minTime, size_t minReps = 3){
+        using clock = std::chrono::steady_clock;
+        f();
+        BenchTiming t;
+        t.best = std::numeric_limits<double>::max();
+        while(t.reps < minReps || t.seconds < minTime){
+            auto start = clock::now();
+            f();
+            double s = std::chrono::duration<double>(clock::now() - start).count();
+            t.seconds += s;
+            t.best = std::min(t.best, s);
+            t.reps++;
+        }
+        return t;
+    }
+
+    /**
+       One line of results: an ordered list of named values.
+     */
+    struct BenchRecord{
+        std::vector<std::pair<std::string, std::string> > fields;
+
+        BenchRecord & add(const std::string &name, const std::string &value){
+            fields.emplace_back(name, quote(value));
+            return *this;
+        }
+
+        BenchRecord & add(const std::string &name, const char *value){
+            return add(name, std::string(value));
+        }
+
+        BenchRecord & add(const std::string &name, double value){
+            std::stringstream st;
+            st << std::setprecision(6) << value;
+            fields.emplace_back(name, st.str());
+            return *this;
+        }
+
+        BenchRecord & add(const std::string &name, size_t value){
+            fields.emplace_back(name, std::to_string(value));
+            return *this;
+        }
+
+        BenchRecord & add(const std::string &name, int value){
+            fields.emplace_back(name, std::to_string(value));
+            return *this;
+        }
+
+        BenchRecord & add(const std::string &name, bool value){
+            fields.emplace_back(name, value ? "true" : "false");
+            return *this;
+        }
+
+        BenchRecord & add(const std::string &name, const std::vector<size_t> &values){
+            std::string s = "[";
+            for(size_t i=0; i < values.size(); i++){
+                if (i > 0)
+                    s += ", ";
+                s += std::to_string(values[i]);
+            }
+            fields.emplace_back(name, s + "]");
+            return *this;
+        }
+
+        static std::string quote(const std::string &s){
+            std::string q = "\"";
+            for(char c : s){
+                if (c == '"' || c == '\\')
+                    q += '\\';
+                q += c;
+            }
+            return q + "\"";
+        }
+
+        void write(std::ostream &out) const{
+            out << "{";
+            for(size_t i=0; i < fields.size(); i++){
+                if (i > 0)
+                    out << ", ";
+                out << quote(fields[i].first) << ": " << fields[i].second;
+            }
+            out << "}";
+        }
+    };
+
+    /**
+       A set of results from one benchmark program, written as
+       {"benchmark": name, "results": [record, record, ...]}
+     */
+    struct BenchReport{
+        std::string name;
+        std::vector<BenchRecord> records;
+        bool echo = true; ///< print a short line to stderr for each record
+
+        BenchReport(const std::string &name) : name(name){}
+
+        BenchRecord & add(){
+            records.emplace_back();
+            return records.back();
+        }
+
+        /**
+           Print the most recently added record to stderr, so that
+           long runs show progress.
+         */
+        void progress(){
+            if (!echo || records.empty())
+                return;
+            records.back().write(std::cerr);
+            std::cerr << std::endl;
+        }
+
+        void write(std::ostream &out) const{
+            out << "{\"benchmark\": " << BenchRecord::quote(name) << ", \"results\": [" << std::endl;
+            for(size_t i=0; i < records.size(); i++){
+                out << "  ";
+                records[i].write(out);
+                if (i + 1 < records.size())
+                    out << ",";
+                out << std::endl;
+            }
+            out << "]}" << std::endl;
+        }
+
+        void write(const BenchOptions &opts) const{
+            if (opts.outFile == ""){
+                write(std::cout);
+                return;
+            }
+            std::ofstream f(opts.outFile);
+            if (!f)
+                throw std::runtime_error("Couldn't open " + opts.outFile + " for writing");
+            write(f);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef BENCH_MODELS_HPP_
+#define BENCH_MODELS_HPP_
+
+// Whole-network reference workloads. Each model lives in its own
+// source file in bench/src/models, and adds itself to the registry
+// returned by benchModels() when the program starts, so that a
+// program can run whichever models were compiled into it.
+//
+// This header is also passed to genProcessLink.py as a source, since
+// it uses LLRT operations itself.
+
+#include "process_link.hpp"
+#include <cmath>
+#include <memory>
+#include <random>
+#include <sys/resource.h>
+
+namespace llrt{
+
+    /**
+       One instance of a reference model, built at a given size and
+       worker count.
+     */
+    struct BenchModel{
+        virtual ~BenchModel(){}
+
+        /**
+           Advance the network by one time step, and wait until it has
+           finished.
+         */
+        virtual void step() = 0;
+
+        /// number of edges processed by one step
+        virtual size_t edges() = 0;
+
+        /// number of nodes in the network
+        virtual size_t nodes() = 0;
+
+        /// the Scheduler running the network, or nullptr if there is none
+        virtual Scheduler * scheduler() = 0;
+    };
+
+    /**
+       Base for models made of a single Network<TL>
+     */
+    template<typename TL>
+    struct NetworkBenchModel : public BenchModel{
+        Network<TL> net;
+        size_t t = 0; ///< the number of steps taken so far
+
+        NetworkBenchModel(size_t nWorkers) : net(nWorkers){
+            net.seed(1);
+        }
+
+        /**
+           @return the total number of edges over all links, excluding
+           the links between each component and itself
+         */
+        size_t edges() override{
+            size_t n = 0;
+            for(auto &c : net.components)
+                for(auto &l : c->links[0])
+                    n += l->getMaxProgress(0);
+            return n;
+        }
+
+        size_t nodes() override{
+            size_t n = 0;
+            for(auto &c : net.components)
+                n += c->dataSize();
+            return n;
+        }
+
+        Scheduler * scheduler() override{
+            return net.sched ? &*net.sched : nullptr;
+        }
+    };
+
+    /**
+       A registered model. make(size, nWorkers) builds the model with
+       roughly size edges, running on nWorkers worker threads (0 for
+       no Scheduler).
+     */
+    struct BenchModelInfo{
+        std::string name;
+        std::string description;
+        std::function<std::unique_ptr<BenchModel>(size_t size, size_t nWorkers)> make;
+    };
+
+    inline std::vector<BenchModelInfo> & benchModels(){
+        static std::vector<BenchModelInfo> models;
+        return models;
+    }
+
+    /**
+       Declare a RegisterBenchModel at namespace scope in a model's
+       source file to add it to benchModels().
+     */
+    struct RegisterBenchModel{
+        RegisterBenchModel(const BenchModelInfo &info){
+            benchModels().push_back(info);
+        }
+    };
+
+    /**
+       @return the number of edges for the named scale: small, medium or large
+     */
+    inline size_t benchScaleSize(const std::string &scale){
+        if (scale == "small")
+            return 100000;
+        if (scale == "medium")
+            return 1000000;
+        if (scale == "large")
+            return 10000000;
+        throw std::runtime_error("Unknown scale " + scale + ", expected small, medium or large");
+    }
+
+    /**
+       @return the peak resident set size of this process so far, in KiB
+     */
+    inline size_t peakRSSKiB(){
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+        return usage.ru_maxrss; // KiB on Linux
+    }
+
+    // The neuron model shared by most of the reference models: the
+    // leaky integrate and fire model of examples/ex1.cpp.
+
+    struct LIFNeuron{
+        float v[2]={0,0};
+        float x[2]={0,0};
+    };
+
+    struct LIFDendrite{
+        float w=0;
+    };
+
+    const float lifMu = 0.99;
+    const float lifK = 0.01;
+
+    template<typename TL>
+    void lifInitialize(Network<TL> &net){
+        ProcessNetLinks_Er(net, [](LIFDendrite &E, ThreadsafeRNG &r){
+            E.w = std::normal_distribution<float>(0,1.0)(r);
+        }, Dendrites | Parallel);
+    }
+
+    /**
+       One time step of the leaky integrate and fire model over the
+       whole network, with external input to the nodes of inputCmp.
+     */
+    template<typename TL>
+    void lifStep(Network<TL> &net, size_t timestep, Component<TL> &inputCmp, std::vector<float> &inputs){
+        size_t _0 = timestep % 2;
+        size_t _1 = 1 - _0;
+        ProcessNetCmps_N(net, [=](LIFNeuron &N){
+            if (N.x[_0] == 0)
+                N.v[_1] = lifMu * N.v[_0];
+            else
+                N.v[_1] = 0;
+        }, Parallel);
+        ProcessCmp_NNi(inputCmp, [=, &inputs](LIFNeuron &N, const size_t Ni){
+            N.v[_1] += inputs[Ni];
+        }, Parallel);
+        ProcessNetLinks_NEn(net, [_1, _0](LIFNeuron &N, const LIFDendrite &E, const LIFNeuron &n){
+            N.v[_1] += E.w * n.x[_0];
+        }, Dendrites | Parallel);
+        ProcessNetCmps_Nr(net, [=](LIFNeuron &N, ThreadsafeRNG &r){
+            float activateProb = 1 / (1 + std::exp(-lifK*N.v[_1]));
+            if(std::uniform_real_distribution<float>(0,1.0)(r) < activateProb)
+                N.x[_1] = 1;
+            else
+                N.x[_1] = 0;
+        }, Parallel);
+    }
+
+    /**
+       Random external input, regenerated every step
+     */
+    struct BenchInputs{
+        std::vector<float> values;
+        std::mt19937_64 rng{136};
+
+        BenchInputs(size_t n) : values(n){}
+
+        std::vector<float> & next(){
+            for(float &x : values)
+                x = std::normal_distribution<float>(0,1.0)(rng);
+            return values;
+        }
+    };
+}
+
+#endif
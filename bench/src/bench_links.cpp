@@ -0,0 +1,184 @@
+// Link-type microbenchmarks
+//
+// Measures the time per edge of the link iterators, for each core
+// LinkType, over a range of component sizes, sparsities, depths and
+// strides, from both ends, with a few representative kernels. Each
+// configuration is run without a Scheduler and with each requested
+// number of worker threads. Results are written as JSON.
+//
+// Usage: bench_links [--quick] [--out=FILE] [--workers=0,1,4] [--min-time=SEC] [--only=Dense]
+
+#include "process_link.hpp"
+#include "bench_common.hpp"
+#include <random>
+
+using namespace llrt;
+
+struct BNode{
+    float v[2]={0,0};
+    float x[2]={0,0};
+};
+
+using BEdge = float;
+
+using TTypes = std::tuple<BNode, BEdge>;
+using LTypes = std::tuple<DenseLink, AdjListLink, GeneralLocal2DLink, Local2DLink<3> >;
+using TL = std::pair<TTypes, LTypes>;
+
+/**
+   A link configuration to benchmark. build() creates the components
+   and the link on a fresh Network, and returns the link.
+ */
+struct LinkCase{
+    std::string link;
+    std::string config;
+    std::function<Link<TL> &(Network<TL> &)> build;
+};
+
+Link<TL> & buildDense(Network<TL> &net, index_t n0, index_t n1){
+    Component<TL> &a = net.component<BNode>({n0});
+    a.connect<DenseLink, BEdge, BEdge, BNode>({n1});
+    return *a.links[0].back();
+}
+
+Link<TL> & buildSame(Network<TL> &net, index_t n){
+    Component<TL> &a = net.component<BNode>({n});
+    a.connect<SameLink, BEdge, BEdge, BNode>({n});
+    return *a.links[0].back();
+}
+
+Link<TL> & buildAdjList(Network<TL> &net, index_t n0, index_t n1, size_t degree){
+    Component<TL> &a = net.component<BNode>({n0});
+    a.connect<AdjListLink, BEdge, BEdge, BNode>({n1});
+    AdjListLink &adj = net.prevLinkType<AdjListLink>();
+    std::mt19937_64 g(1234);
+    std::uniform_int_distribution<size_t> pick(0, n1-1);
+    std::vector<std::pair<size_t, size_t> > edges;
+    edges.reserve(n0 * degree);
+    for(size_t i=0; i < n0; i++)
+        for(size_t j=0; j < degree; j++)
+            edges.emplace_back(i, pick(g));
+    adj.insertEdges(edges);
+    return *a.links[0].back();
+}
+
+Link<TL> & buildLocal2D(Network<TL> &net, index_t rows, index_t cols, index_t depth, size_t filter, size_t stride){
+    Component<TL> &a = net.component<BNode>({rows, cols, depth});
+    index_t rows1 = (rows-1)/stride+1, cols1 = (cols-1)/stride+1;
+    a.connect<GeneralLocal2DLink, BEdge, BEdge, BNode>({rows1, cols1, depth});
+    int start = -static_cast<int>(filter/2);
+    net.prevLinkType<GeneralLocal2DLink>().setParams(start, start, filter, filter, stride, stride, 1, 1);
+    return *a.links[0].back();
+}
+
+Link<TL> & buildFixedLocal2D(Network<TL> &net, index_t rows, index_t cols){
+    Component<TL> &a = net.component<BNode>({rows, cols});
+    a.connect<Local2DLink<3>, BEdge, BEdge, BNode>();
+    return *a.links[0].back();
+}
+
+std::vector<LinkCase> linkCases(const BenchOptions &opts){
+    std::vector<LinkCase> cases;
+    using Sz = std::pair<index_t, index_t>;
+    std::vector<Sz> denseSizes = opts.quick ?
+        std::vector<Sz>{{100, 100}, {500, 500}} :
+        std::vector<Sz>{{100, 100}, {1000, 1000}, {4000, 1000}};
+    for(auto [n0, n1] : denseSizes)
+        cases.push_back({"Dense", std::to_string(n0) + "x" + std::to_string(n1),
+                [=](Network<TL> &net) -> Link<TL> &{return buildDense(net, n0, n1);}});
+
+    std::vector<index_t> sameSizes = opts.quick ?
+        std::vector<index_t>{10000, 100000} :
+        std::vector<index_t>{10000, 1000000};
+    for(index_t n : sameSizes)
+        cases.push_back({"Same", std::to_string(n),
+                [=](Network<TL> &net) -> Link<TL> &{return buildSame(net, n);}});
+
+    std::vector<index_t> adjSizes = opts.quick ?
+        std::vector<index_t>{10000} :
+        std::vector<index_t>{10000, 100000};
+    for(index_t n : adjSizes)
+        for(size_t degree : {4, 32})
+            cases.push_back({"AdjList", std::to_string(n) + " degree " + std::to_string(degree),
+                    [=](Network<TL> &net) -> Link<TL> &{return buildAdjList(net, n, n, degree);}});
+
+    std::vector<index_t> localSizes = opts.quick ?
+        std::vector<index_t>{64} :
+        std::vector<index_t>{64, 256};
+    for(index_t side : localSizes)
+        for(index_t depth : {1, 4})
+            for(size_t stride : {1, 2})
+                cases.push_back({"GeneralLocal2D", std::to_string(side) + "x" + std::to_string(side) + "x" + std::to_string(depth) + " filter 3 stride " + std::to_string(stride),
+                        [=](Network<TL> &net) -> Link<TL> &{return buildLocal2D(net, side, side, depth, 3, stride);}});
+
+    index_t side = opts.quick ? 64 : 256;
+    cases.push_back({"Local2D", std::to_string(side) + "x" + std::to_string(side) + " filter 3",
+            [=](Network<TL> &net) -> Link<TL> &{return buildFixedLocal2D(net, side, side);}});
+    return cases;
+}
+
+/**
+   Time one kernel on one end of a link, and add a record for it.
+ */
+template<typename RunOp>
+void benchKernel(BenchReport &report, const BenchOptions &opts, const LinkCase &lc, Link<TL> &l, int whichEnd, size_t workers, const std::string &kernel, RunOp runOp){
+    size_t edges = l.getMaxProgress(whichEnd);
+    BenchTiming t = benchTime(runOp, opts.minTime);
+    report.add()
+        .add("link", lc.link)
+        .add("config", lc.config)
+        .add("dims0", l.ends[0].c.getDimensions())
+        .add("dims1", l.ends[1].c.getDimensions())
+        .add("whichEnd", whichEnd)
+        .add("kernel", kernel)
+        .add("workers", workers)
+        .add("edges", edges)
+        .add("reps", t.reps)
+        .add("ns_per_edge", edges == 0 ? 0.0 : t.perRep() * 1e9 / edges)
+        .add("best_ns_per_edge", edges == 0 ? 0.0 : t.best * 1e9 / edges);
+    report.progress();
+}
+
+void benchCase(BenchReport &report, const BenchOptions &opts, const LinkCase &lc, size_t workers){
+    Network<TL> net(workers);
+    net.seed(42);
+    Link<TL> &l = lc.build(net);
+
+    ProcessNetLinks_Er(net, [](BEdge &E, ThreadsafeRNG &r){
+        E = std::uniform_real_distribution<float>(-1, 1)(r);
+    }, Parallel);
+    ProcessNetCmps_Nr(net, [](BNode &N, ThreadsafeRNG &r){
+        N.x[0] = std::uniform_real_distribution<float>(0, 1)(r) < 0.5 ? 1 : 0;
+    }, Parallel);
+
+    for(int whichEnd : {0, 1}){
+        benchKernel(report, opts, lc, l, whichEnd, workers, "N", [&](){
+            ProcessLink_N(l, whichEnd, [](BNode &N){
+                N.v[1] += 1.0f;
+            }, Parallel | KernelName("N"));
+        });
+        benchKernel(report, opts, lc, l, whichEnd, workers, "NEn", [&](){
+            ProcessLink_NEn(l, whichEnd, [](BNode &N, const BEdge &E, const BNode &n){
+                N.v[1] += E * n.x[0];
+            }, Parallel | KernelName("NEn"));
+        });
+        benchKernel(report, opts, lc, l, whichEnd, workers, "NEen", [&](){
+            ProcessLink_NEen(l, whichEnd, [](BNode &N, const BEdge &E, const BEdge &e, const BNode &n){
+                N.v[1] += E * e * n.x[0];
+            }, Parallel | KernelName("NEen"));
+        });
+    }
+}
+
+int main(int argc, char **argv){
+    BenchOptions opts(argc, argv);
+    std::string only = opts.get("only", "");
+    BenchReport report("bench_links");
+    for(const LinkCase &lc : linkCases(opts)){
+        if (only != "" && lc.link != only)
+            continue;
+        for(size_t workers : opts.workers)
+            benchCase(report, opts, lc, workers);
+    }
+    report.write(opts);
+}
@@ -0,0 +1,66 @@
+// End-to-end reference model benchmarks
+//
+// Runs each model compiled into this program (see
+// bench/include/bench_models.hpp and bench/src/models) at the requested
+// scales and worker counts, and reports steps per second, time per
+// edge and peak memory as JSON. Compare a result file with a stored
+// baseline using bench/compare_bench.py.
+//
+// peak_rss_kib is the peak memory use of the whole process so far.
+// Scales run in increasing order, so it is normally set by the
+// current scale; for exact figures, run one scale at a time.
+//
+// With --trace=FILE, the jobs given to the Scheduler during the first
+// timed run with a Scheduler are recorded to FILE, for replay with
+// sched_sim.
+//
+// Usage: bench_<model> [--quick] [--out=FILE] [--workers=0,4] [--min-time=SEC] [--scale=small,medium,large] [--trace=FILE]
+
+#include "bench_models.hpp"
+#include "bench_common.hpp"
+
+using namespace llrt;
+
+int main(int argc, char **argv){
+    BenchOptions opts(argc, argv);
+    if (!opts.workersGiven)
+        opts.workers = {std::max<size_t>(std::thread::hardware_concurrency(), 1)};
+    std::vector<std::string> scales;
+    std::stringstream st(opts.get("scale", opts.quick ? "small" : "small,medium,large"));
+    std::string scale;
+    while(std::getline(st, scale, ','))
+        scales.push_back(scale);
+
+    std::string traceFile = opts.get("trace", "");
+
+    BenchReport report("bench_model");
+    for(const std::string &scale : scales){
+        size_t size = benchScaleSize(scale);
+        for(const BenchModelInfo &info : benchModels())
+            for(size_t workers : opts.workers){
+                std::unique_ptr<BenchModel> model = info.make(size, workers);
+                size_t edges = model->edges();
+                Scheduler *sched = model->scheduler();
+                bool tracing = traceFile != "" && sched != nullptr;
+                if (tracing)
+                    sched->startTrace();
+                BenchTiming t = benchTime([&](){model->step();}, opts.minTime);
+                if (tracing){
+                    sched->stopTrace().save(traceFile);
+                    traceFile = "";
+                }
+                report.add()
+                    .add("model", info.name)
+                    .add("scale", scale)
+                    .add("workers", workers)
+                    .add("nodes", model->nodes())
+                    .add("edges", edges)
+                    .add("steps", t.reps)
+                    .add("steps_per_sec", 1 / t.perRep())
+                    .add("ns_per_edge", edges == 0 ? 0.0 : t.perRep() * 1e9 / edges)
+                    .add("peak_rss_kib", peakRSSKiB());
+                report.progress();
+            }
+    }
+    report.write(opts);
+}
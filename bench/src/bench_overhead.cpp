@@ -0,0 +1,286 @@
+// Zero-overhead validation benchmarks
+//
+// README.md claims an LLRT operation is as fast as an inlined nested
+// loop over the synapses written by hand. This program checks that
+// claim: it runs the accumulate and activate kernels of
+// examples/ex1.cpp through ProcessNetLinks_NEn and ProcessNetCmps_Nr,
+// and also as hand-written loops over plain arrays holding the same
+// data, for each link type. It reports the ratio of the two times
+// and exits with status 1 if any ratio exceeds --max-ratio.
+//
+// Usage: bench_overhead [--quick] [--out=FILE] [--workers=0] [--min-time=SEC] [--max-ratio=1.5]
+
+#include "process_link.hpp"
+#include "bench_common.hpp"
+#include <cmath>
+#include <random>
+
+using namespace llrt;
+
+struct IFNeuron{
+    float v[2]={0,0};
+    float x[2]={0,0};
+};
+
+struct IFDendrite{
+    float w=0;
+};
+
+template <typename T>
+T sigmoid(const T x){
+    return (1 / (1 + std::exp(-x)));
+}
+
+const float k = 0.01;
+
+using TTypes = std::tuple<IFNeuron, IFDendrite>;
+using LTypes = std::tuple<DenseLink, AdjListLink, Local2DLink<3> >;
+using TL = std::pair<TTypes, LTypes>;
+
+/**
+   The data of a two-component network, copied out of a Network into
+   plain arrays, plus a hand-written loop doing the accumulate step
+   over them.
+ */
+struct HandNet{
+    std::vector<IFNeuron> near, far;
+    std::vector<IFDendrite> w;
+    std::function<void(HandNet &)> accumulate;
+};
+
+/**
+   Copy the components and the dendrite end of the link into a
+   HandNet. The near component is end 1 of the link.
+ */
+HandNet copyOut(Link<TL> &l){
+    HandNet h;
+    h.near = l.compData<IFNeuron>(1);
+    h.far = l.compData<IFNeuron>(0);
+    h.w = l.linkData<IFDendrite>(1);
+    return h;
+}
+
+void accumulateDense(HandNet &h){
+    const size_t nF = h.far.size();
+    for(size_t i=0; i < h.near.size(); i++){
+        const IFDendrite *w = &h.w[i*nF];
+        float v = h.near[i].v[1];
+        for(size_t j=0; j < nF; j++)
+            v += w[j].w * h.far[j].x[0];
+        h.near[i].v[1] = v;
+    }
+}
+
+void accumulateSame(HandNet &h){
+    for(size_t i=0; i < h.near.size(); i++)
+        h.near[i].v[1] += h.w[i].w * h.far[i].x[0];
+}
+
+/**
+   Compressed sparse rows: the edges of near node i are
+   edges[rowStart[i]] ... edges[rowStart[i+1]-1]
+ */
+struct CSR{
+    std::vector<size_t> rowStart;
+    std::vector<std::pair<size_t, size_t> > edges; ///< (edge index, far node)
+};
+
+void accumulateCSR(HandNet &h, const CSR &csr){
+    for(size_t i=0; i < h.near.size(); i++){
+        float v = h.near[i].v[1];
+        for(size_t e=csr.rowStart[i]; e < csr.rowStart[i+1]; e++)
+            v += h.w[csr.edges[e].first].w * h.far[csr.edges[e].second].x[0];
+        h.near[i].v[1] = v;
+    }
+}
+
+/**
+   A 3x3 "same" convolution pattern with stride 1, with the edge
+   layout used by GeneralLocal2DLink: (row, filter row, column, filter column)
+ */
+void accumulateLocal2D(HandNet &h, size_t rows, size_t cols){
+    const size_t F = 3;
+    size_t edgeIx = 0;
+    for(size_t r=0; r < rows; r++)
+        for(size_t fr=0; fr < F; fr++){
+            int64_t r0 = static_cast<int64_t>(r + fr) - 1;
+            if (r0 < 0 || r0 >= static_cast<int64_t>(rows)){
+                edgeIx += cols * F;
+                continue;
+            }
+            const IFNeuron *farRow = &h.far[r0*cols];
+            for(size_t c=0; c < cols; c++){
+                float v = h.near[r*cols + c].v[1];
+                for(size_t fc=0; fc < F; fc++, edgeIx++){
+                    int64_t c0 = static_cast<int64_t>(c + fc) - 1;
+                    if (c0 < 0 || c0 >= static_cast<int64_t>(cols))
+                        continue;
+                    v += h.w[edgeIx].w * farRow[c0].x[0];
+                }
+                h.near[r*cols + c].v[1] = v;
+            }
+        }
+}
+
+void activateHand(std::vector<IFNeuron> &ns, std::mt19937_64 &g){
+    for(IFNeuron &N : ns){
+        float activateProb = sigmoid(k*N.v[1]);
+        if(std::uniform_real_distribution<float>(0,1.0)(g) < activateProb)
+            N.x[1] = 1;
+        else
+            N.x[1] = 0;
+    }
+}
+
+struct OverheadCase{
+    std::string link;
+    std::string config;
+    /// creates the link on a fresh Network, and sets up the hand-written loop
+    std::function<Link<TL> &(Network<TL> &, std::function<void(HandNet &)> &)> build;
+};
+
+std::vector<OverheadCase> overheadCases(const BenchOptions &opts){
+    index_t dense = opts.quick ? 300 : 1000;
+    index_t same = opts.quick ? 100000 : 1000000;
+    index_t adjNodes = opts.quick ? 10000 : 100000;
+    index_t side = opts.quick ? 128 : 512;
+    std::vector<OverheadCase> cases;
+    cases.push_back({"Dense", std::to_string(dense) + "x" + std::to_string(dense),
+            [=](Network<TL> &net, std::function<void(HandNet &)> &acc) -> Link<TL> &{
+                Component<TL> &a = net.component<IFNeuron>({dense});
+                a.connect<DenseLink, NoData, IFDendrite, IFNeuron>({dense});
+                acc = accumulateDense;
+                return *a.links[0].back();
+            }});
+    cases.push_back({"Same", std::to_string(same),
+            [=](Network<TL> &net, std::function<void(HandNet &)> &acc) -> Link<TL> &{
+                Component<TL> &a = net.component<IFNeuron>({same});
+                a.connect<SameLink, NoData, IFDendrite, IFNeuron>({same});
+                acc = accumulateSame;
+                return *a.links[0].back();
+            }});
+    cases.push_back({"AdjList", std::to_string(adjNodes) + " degree 16",
+            [=](Network<TL> &net, std::function<void(HandNet &)> &acc) -> Link<TL> &{
+                Component<TL> &a = net.component<IFNeuron>({adjNodes});
+                a.connect<AdjListLink, NoData, IFDendrite, IFNeuron>({adjNodes});
+                AdjListLink &adj = net.prevLinkType<AdjListLink>();
+                std::mt19937_64 g(99);
+                std::uniform_int_distribution<size_t> pick(0, adjNodes-1);
+                std::vector<std::pair<size_t, size_t> > edges;
+                for(size_t i=0; i < adjNodes * 16; i++)
+                    edges.emplace_back(pick(g), pick(g));
+                adj.insertEdges(edges);
+                // the hand-written version gets its own CSR copy of the adjacency lists of end 1
+                auto csr = std::make_shared<CSR>();
+                csr->rowStart.push_back(0);
+                for(auto &neighbors : adj.end1Adjacency){
+                    for(auto &ixs : neighbors)
+                        csr->edges.emplace_back(ixs.edgeIx, ixs.farNode);
+                    csr->rowStart.push_back(csr->edges.size());
+                }
+                acc = [csr](HandNet &h){accumulateCSR(h, *csr);};
+                return *a.links[0].back();
+            }});
+    cases.push_back({"Local2D", std::to_string(side) + "x" + std::to_string(side) + " filter 3",
+            [=](Network<TL> &net, std::function<void(HandNet &)> &acc) -> Link<TL> &{
+                Component<TL> &a = net.component<IFNeuron>({side, side});
+                a.connect<Local2DLink<3>, NoData, IFDendrite, IFNeuron>();
+                acc = [=](HandNet &h){accumulateLocal2D(h, side, side);};
+                return *a.links[0].back();
+            }});
+    return cases;
+}
+
+int main(int argc, char **argv){
+    BenchOptions opts(argc, argv);
+    if (!opts.workersGiven)
+        opts.workers = {0}; // the claim is about code without a Scheduler
+    double maxRatio = std::stod(opts.get("max-ratio", "1.5"));
+    BenchReport report("bench_overhead");
+    bool pass = true;
+
+    for(const OverheadCase &oc : overheadCases(opts)){
+        for(size_t workers : opts.workers){
+            Network<TL> net(workers);
+            net.seed(7);
+            std::function<void(HandNet &)> accumulate;
+            Link<TL> &l = oc.build(net, accumulate);
+            ProcessNetLinks_Er(net, [](IFDendrite &E, ThreadsafeRNG &r){
+                E.w = std::normal_distribution<float>(0,1.0)(r);
+            }, Dendrites | Parallel);
+            ProcessNetCmps_Nr(net, [](IFNeuron &N, ThreadsafeRNG &r){
+                N.x[0] = std::uniform_real_distribution<float>(0,1.0)(r) < 0.3 ? 1 : 0;
+            }, Parallel);
+
+            HandNet h = copyOut(l);
+            h.accumulate = accumulate;
+
+            // check that both versions compute the same thing before timing them
+            ProcessNetLinks_NEn(net, [](IFNeuron &N, const IFDendrite &E, const IFNeuron &n){
+                N.v[1] += E.w * n.x[0];
+            }, Dendrites | Parallel);
+            h.accumulate(h);
+            std::vector<IFNeuron> &llrtNear = l.compData<IFNeuron>(1);
+            double maxDiff = 0;
+            for(size_t i=0; i < h.near.size(); i++)
+                maxDiff = std::max<double>(maxDiff, std::abs(h.near[i].v[1] - llrtNear[i].v[1]));
+
+            size_t edges = l.getMaxProgress(1);
+            BenchTiming tLLRT = benchTime([&](){
+                ProcessNetLinks_NEn(net, [](IFNeuron &N, const IFDendrite &E, const IFNeuron &n){
+                    N.v[1] += E.w * n.x[0];
+                }, Dendrites | Parallel);
+            }, opts.minTime);
+            BenchTiming tHand = benchTime([&](){
+                h.accumulate(h);
+            }, opts.minTime);
+
+            // activate, over both components
+            size_t nodes = h.near.size() + h.far.size();
+            BenchTiming tLLRTAct = benchTime([&](){
+                ProcessNetCmps_Nr(net, [](IFNeuron &N, ThreadsafeRNG &r){
+                    float activateProb = sigmoid(k*N.v[1]);
+                    if(std::uniform_real_distribution<float>(0,1.0)(r) < activateProb)
+                        N.x[1] = 1;
+                    else
+                        N.x[1] = 0;
+                }, Parallel);
+            }, opts.minTime);
+            std::mt19937_64 g(7);
+            BenchTiming tHandAct = benchTime([&](){
+                activateHand(h.near, g);
+                activateHand(h.far, g);
+            }, opts.minTime);
+
+            for(int step=0; step < 2; step++){
+                const char *kernel = step == 0 ? "accumulate" : "activate";
+                BenchTiming &tl = step == 0 ? tLLRT : tLLRTAct;
+                BenchTiming &th = step == 0 ? tHand : tHandAct;
+                size_t count = step == 0 ? edges : nodes;
+                double ratio = tl.best / th.best;
+                bool ok = ratio <= maxRatio;
+                pass = pass && ok;
+                BenchRecord &rec = report.add()
+                    .add("link", oc.link)
+                    .add("config", oc.config)
+                    .add("kernel", kernel)
+                    .add("workers", workers)
+                    .add("count", count)
+                    .add("llrt_ns_per_item", tl.best * 1e9 / count)
+                    .add("hand_ns_per_item", th.best * 1e9 / count)
+                    .add("ratio", ratio)
+                    .add("max_ratio", maxRatio)
+                    .add("pass", ok);
+                if (step == 0)
+                    rec.add("max_abs_diff", maxDiff);
+                report.progress();
+            }
+        }
+    }
+    report.write(opts);
+    if (!pass){
+        std::cerr << "bench_overhead: overhead ratio exceeded " << maxRatio << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Strong- and weak-scaling harness
+//
+// Runs registered reference models (see bench/include/bench_models.hpp)
+// over a sweep of worker counts:
+//
+//  strong  fixed problem size; speedup and parallel efficiency
+//          relative to the smallest worker count
+//  weak    problem size proportional to the number of workers
+//
+// In both cases speedup is edges per second relative to the smallest
+// worker count, and efficiency is speedup divided by the relative
+// number of workers.
+//
+// Each result also splits the time per step, using Scheduler::getStats(),
+// into
+//
+//  kernel_s    time in job chunks, averaged over the workers
+//  barrier_s   time lost waiting for the busiest worker in each barrier
+//              (load imbalance, and barriers run on a single worker)
+//  sched_s     the rest: planning, submitting jobs, and notifying workers
+//
+// Usage: bench_scaling [--quick] [--out=FILE] [--workers=1,2,4,8]
+//            [--min-time=SEC] [--models=lif_dense,multipop] [--scale=medium]
+//            [--mode=strong,weak]
+
+#include "bench_models.hpp"
+#include "bench_common.hpp"
+
+using namespace llrt;
+
+/**
+   Time per step of a model, and how that time divides up
+ */
+struct ScalingPoint{
+    size_t edges = 0;
+    size_t steps = 0;
+    double seconds = 0; ///< per step
+    double kernel = 0; ///< per step
+    double barrier = 0; ///< per step
+    double sched = 0; ///< per step
+    size_t barriers = 0; ///< per step
+};
+
+double seconds(dur_t d){
+    return std::chrono::duration<double>(d).count();
+}
+
+ScalingPoint measure(const BenchModelInfo &info, size_t size, size_t workers, double minTime){
+    std::unique_ptr<BenchModel> model = info.make(size, workers);
+    ScalingPoint p;
+    p.edges = model->edges();
+    // warm up, so that the Scheduler's estimates have settled
+    benchTime([&](){model->step();}, minTime / 4);
+
+    Scheduler *sched = model->scheduler();
+    if (sched != nullptr)
+        sched->resetStats();
+    BenchTiming t = benchTime([&](){model->step();}, minTime, 3);
+    // benchTime runs one extra step to warm up
+    p.steps = t.reps + 1;
+    p.seconds = t.perRep();
+    if (sched == nullptr){
+        p.kernel = p.seconds;
+        return p;
+    }
+    Scheduler::Stats stats = sched->getStats();
+    dur_t busy = dur_t::zero();
+    for(dur_t b : stats.busyByWorker)
+        busy += b;
+    double stepTotal = t.seconds + p.seconds;
+    p.kernel = seconds(busy) / workers / p.steps;
+    p.barrier = seconds(stats.criticalPath) / p.steps - p.kernel;
+    p.sched = stepTotal / p.steps - seconds(stats.criticalPath) / p.steps;
+    p.barriers = stats.barriers / p.steps;
+    return p;
+}
+
+std::vector<std::string> splitList(const std::string &s){
+    std::vector<std::string> v;
+    std::stringstream st(s);
+    std::string item;
+    while(std::getline(st, item, ','))
+        if (!item.empty())
+            v.push_back(item);
+    return v;
+}
+
+int main(int argc, char **argv){
+    BenchOptions opts(argc, argv);
+    if (!opts.workersGiven){
+        size_t hw = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        opts.workers.clear();
+        for(size_t w=1; w < hw; w *= 2)
+            opts.workers.push_back(w);
+        opts.workers.push_back(hw);
+    }
+    opts.workers.erase(std::remove(opts.workers.begin(), opts.workers.end(), 0), opts.workers.end());
+    if (opts.workers.empty())
+        throw std::runtime_error("bench_scaling needs at least one nonzero worker count");
+
+    std::string scale = opts.get("scale", opts.quick ? "small" : "medium");
+    size_t size = benchScaleSize(scale);
+    std::vector<std::string> modes = splitList(opts.get("mode", "strong,weak"));
+    std::vector<std::string> only = splitList(opts.get("models", ""));
+
+    std::vector<BenchModelInfo> models = benchModels();
+    std::sort(models.begin(), models.end(), [](const BenchModelInfo &a, const BenchModelInfo &b){
+        return a.name < b.name;
+    });
+
+    BenchReport report("bench_scaling");
+    size_t w0 = opts.workers.front();
+    for(const BenchModelInfo &info : models){
+        if (!only.empty() && std::find(only.begin(), only.end(), info.name) == only.end())
+            continue;
+        for(const std::string &mode : modes){
+            if (mode != "strong" && mode != "weak")
+                throw std::runtime_error("Unknown mode " + mode + ", expected strong or weak");
+            bool weak = mode == "weak";
+            double baseRate = 0;
+            for(size_t workers : opts.workers){
+                size_t modelSize = weak ? size * workers / w0 : size;
+                ScalingPoint p = measure(info, modelSize, workers, opts.minTime);
+                // compare edges per second rather than time per step,
+                // since the models only approximate the requested size
+                double rate = p.edges / p.seconds;
+                if (workers == w0)
+                    baseRate = rate;
+                double speedup = rate / baseRate;
+                double efficiency = speedup * w0 / workers;
+                report.add()
+                    .add("mode", mode)
+                    .add("model", info.name)
+                    .add("scale", scale)
+                    .add("workers", workers)
+                    .add("edges", p.edges)
+                    .add("steps", p.steps)
+                    .add("seconds_per_step", p.seconds)
+                    .add("speedup", speedup)
+                    .add("efficiency", efficiency)
+                    .add("kernel_s", p.kernel)
+                    .add("barrier_s", p.barrier)
+                    .add("sched_s", p.sched)
+                    .add("barriers_per_step", p.barriers);
+                report.progress();
+            }
+        }
+    }
+    report.write(opts);
+}
@@ -0,0 +1,187 @@
+// Scheduler overhead microbenchmarks
+//
+// Measures the fixed cost of the parallel machinery, separately from
+// kernel cost, by submitting empty or trivial kernels over tiny
+// SameLink components:
+//
+//  roundtrip      latency of one Parallel operation, submitted and waited for
+//  pipelined      time per batch when ParallelNonBlocking batches are queued back to back
+//  batch_assembly cost per ParallelPart operation when assembling a large batch
+//  barrier        cost of a synchronization barrier across all workers, versus nWorkers
+//  crossover      single-threaded versus multithreaded barrier time, versus component size,
+//                 giving the size at which a singleThreadThreshold should switch over
+//
+// Usage: bench_scheduler [--quick] [--out=FILE] [--workers=1,2,4] [--min-time=SEC]
+
+#include "process_link.hpp"
+#include "bench_common.hpp"
+
+using namespace llrt;
+
+struct BNode{
+    float v=0;
+};
+
+using TTypes = std::tuple<BNode>;
+using LTypes = std::tuple<>;
+using TL = std::pair<TTypes, LTypes>;
+
+const dur_t defaultThreshold = dur_t(-1); // leave singleThreadThreshold as it is
+const dur_t alwaysSingleThreaded = std::chrono::hours(1);
+const dur_t neverSingleThreaded = dur_t::zero();
+
+std::string thresholdName(dur_t threshold){
+    if (threshold == alwaysSingleThreaded)
+        return "single";
+    if (threshold == neverSingleThreaded)
+        return "multi";
+    return "default";
+}
+
+void setThreshold(Network<TL> &net, dur_t threshold){
+    if (threshold != defaultThreshold)
+        net.sched->singleThreadThreshold = threshold;
+}
+
+void benchRoundTrip(BenchReport &report, const BenchOptions &opts, size_t workers, dur_t threshold){
+    Network<TL> net(workers);
+    Component<TL> &c = net.component<BNode>({16});
+    setThreshold(net, threshold);
+    BenchTiming t = benchTime([&](){
+        ProcessCmp_N(c, [](BNode &N){}, Parallel);
+    }, opts.minTime);
+    report.add()
+        .add("measurement", "roundtrip")
+        .add("workers", workers)
+        .add("mode", thresholdName(threshold))
+        .add("reps", t.reps)
+        .add("us_per_batch", t.perRep() * 1e6)
+        .add("best_us_per_batch", t.best * 1e6);
+    report.progress();
+}
+
+void benchPipelined(BenchReport &report, const BenchOptions &opts, size_t workers, dur_t threshold){
+    Network<TL> net(workers);
+    Component<TL> &c = net.component<BNode>({16});
+    setThreshold(net, threshold);
+    const size_t batches = 1000;
+    BenchTiming t = benchTime([&](){
+        for(size_t i=0; i < batches; i++)
+            ProcessCmp_N(c, [](BNode &N){}, ParallelNonBlocking);
+        net.finishBatches();
+    }, opts.minTime);
+    report.add()
+        .add("measurement", "pipelined")
+        .add("workers", workers)
+        .add("mode", thresholdName(threshold))
+        .add("batches", batches * t.reps)
+        .add("us_per_batch", t.perRep() * 1e6 / batches)
+        .add("batches_per_second", batches / t.perRep());
+    report.progress();
+}
+
+void benchBatchAssembly(BenchReport &report, const BenchOptions &opts, size_t workers){
+    for(size_t nParts : {10, 100, 1000}){
+        if (opts.quick && nParts > 100)
+            continue;
+        Network<TL> net(workers);
+        std::vector<Component<TL> *> cmps;
+        for(size_t i=0; i < nParts; i++)
+            cmps.push_back(&net.component<BNode>({16}));
+        double submitSeconds = 0;
+        BenchTiming t = benchTime([&](){
+            auto start = std::chrono::steady_clock::now();
+            for(size_t i=0; i + 1 < nParts; i++)
+                ProcessCmp_N(*cmps[i], [](BNode &N){}, ParallelPart);
+            ProcessCmp_N(*cmps.back(), [](BNode &N){}, ParallelNonBlocking);
+            submitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            net.finishBatches();
+        }, opts.minTime);
+        // benchTime runs once to warm up before it starts counting
+        submitSeconds *= static_cast<double>(t.reps) / (t.reps + 1);
+        report.add()
+            .add("measurement", "batch_assembly")
+            .add("workers", workers)
+            .add("jobs_per_batch", nParts)
+            .add("reps", t.reps)
+            .add("us_per_job_submit", submitSeconds * 1e6 / (t.reps * nParts))
+            .add("us_per_job_total", t.perRep() * 1e6 / nParts)
+            .add("us_per_batch", t.perRep() * 1e6);
+        report.progress();
+    }
+}
+
+void benchBarrier(BenchReport &report, const BenchOptions &opts, size_t workers){
+    // One component per worker, so every worker gets a job and
+    // must take part in the barrier.
+    Network<TL> net(workers);
+    std::vector<Component<TL> *> cmps;
+    for(size_t i=0; i < workers; i++)
+        cmps.push_back(&net.component<BNode>({16}));
+    net.sched->singleThreadThreshold = neverSingleThreaded;
+    const size_t batches = 200;
+    BenchTiming t = benchTime([&](){
+        for(size_t i=0; i < batches; i++)
+            ProcessNetCmps_N(net, [](BNode &N){}, ParallelNonBlocking);
+        net.finishBatches();
+    }, opts.minTime);
+    report.add()
+        .add("measurement", "barrier")
+        .add("workers", workers)
+        .add("barriers", batches * t.reps)
+        .add("us_per_barrier", t.perRep() * 1e6 / batches);
+    report.progress();
+}
+
+void benchCrossover(BenchReport &report, const BenchOptions &opts, size_t workers){
+    index_t maxSize = opts.quick ? 1 << 16 : 1 << 20;
+    bool found = false;
+    for(index_t n = 16; n <= maxSize; n *= 4){
+        double perMode[2];
+        int m = 0;
+        for(dur_t threshold : {alwaysSingleThreaded, neverSingleThreaded}){
+            Network<TL> net(workers);
+            Component<TL> &c = net.component<BNode>({n});
+            setThreshold(net, threshold);
+            BenchTiming t = benchTime([&](){
+                ProcessCmp_N(c, [](BNode &N){N.v += 1;}, Parallel);
+            }, opts.minTime);
+            perMode[m++] = t.perRep();
+        }
+        // the kernel time alone, without a Scheduler
+        Network<TL> net0(0);
+        Component<TL> &c0 = net0.component<BNode>({n});
+        BenchTiming t0 = benchTime([&](){
+            ProcessCmp_N(c0, [](BNode &N){N.v += 1;});
+        }, opts.minTime);
+        bool multiFaster = perMode[1] < perMode[0];
+        report.add()
+            .add("measurement", "crossover")
+            .add("workers", workers)
+            .add("nodes", n)
+            .add("kernel_us", t0.perRep() * 1e6)
+            .add("single_us", perMode[0] * 1e6)
+            .add("multi_us", perMode[1] * 1e6)
+            .add("multi_faster", multiFaster)
+            .add("crossover", multiFaster && !found);
+        report.progress();
+        found = found || multiFaster;
+    }
+}
+
+int main(int argc, char **argv){
+    BenchOptions opts(argc, argv);
+    BenchReport report("bench_scheduler");
+    for(size_t workers : opts.workers){
+        if (workers == 0)
+            continue; // nothing to measure without a Scheduler
+        for(dur_t threshold : {defaultThreshold, alwaysSingleThreaded, neverSingleThreaded}){
+            benchRoundTrip(report, opts, workers, threshold);
+            benchPipelined(report, opts, workers, threshold);
+        }
+        benchBatchAssembly(report, opts, workers);
+        benchBarrier(report, opts, workers);
+        benchCrossover(report, opts, workers);
+    }
+    report.write(opts);
+}
@@ -0,0 +1,46 @@
+// A stack of 5 layers of LIF neurons, each connected to the next by a
+// 3x3 Local2DLink with 4 channels per layer.
+
+#include "bench_models.hpp"
+
+using namespace llrt;
+
+namespace{
+    using TTypes = std::tuple<LIFNeuron, LIFDendrite>;
+    using LTypes = std::tuple<Local2DLink<3> >;
+    using TL = std::pair<TTypes, LTypes>;
+
+    const size_t layers = 5;
+    const index_t channels = 4;
+
+    /// side length of each layer for roughly size edges in total
+    index_t convSide(size_t size){
+        double edgesPerNode = 9.0 * channels * channels * (layers - 1);
+        return std::max<index_t>(std::sqrt(size / edgesPerNode), 3);
+    }
+
+    struct ConvStackModel : public NetworkBenchModel<TL>{
+        Component<TL> *input;
+        BenchInputs inputs;
+
+        ConvStackModel(size_t size, size_t nWorkers) :
+            NetworkBenchModel<TL>(nWorkers),
+            inputs(convSide(size) * convSide(size) * channels){
+            index_t side = convSide(size);
+            input = &net.component<LIFNeuron>({side, side, channels});
+            Component<TL> *c = input;
+            for(size_t i=1; i < layers; i++)
+                c = &c->connect<Local2DLink<3>, NoData, LIFDendrite, LIFNeuron>({side, side, channels});
+            lifInitialize(net);
+        }
+
+        void step() override{
+            lifStep(net, t++, *input, inputs.next());
+        }
+    };
+
+    RegisterBenchModel reg({"conv_stack", "5 LIF layers with 4 channels, 3x3 Local2D links between consecutive layers",
+            [](size_t size, size_t nWorkers) -> std::unique_ptr<BenchModel>{
+                return std::make_unique<ConvStackModel>(size, nWorkers);
+            }});
+}
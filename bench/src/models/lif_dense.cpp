@@ -0,0 +1,36 @@
+// ex1-style leaky integrate and fire network: two populations of
+// equal size, densely connected to each other in both directions.
+
+#include "bench_models.hpp"
+
+using namespace llrt;
+
+namespace{
+    using TTypes = std::tuple<LIFNeuron, LIFDendrite>;
+    using LTypes = std::tuple<DenseLink>;
+    using TL = std::pair<TTypes, LTypes>;
+
+    struct LIFDenseModel : public NetworkBenchModel<TL>{
+        Component<TL> *input;
+        BenchInputs inputs;
+
+        LIFDenseModel(size_t size, size_t nWorkers) :
+            NetworkBenchModel<TL>(nWorkers),
+            inputs(std::max<size_t>(std::sqrt(size / 2.0), 1)){
+            index_t n = inputs.values.size();
+            input = &net.component<LIFNeuron>({n});
+            Component<TL> &c2 = input->connect<DenseLink, NoData, LIFDendrite, LIFNeuron>({n});
+            c2.connect<DenseLink, NoData, LIFDendrite>(*input);
+            lifInitialize(net);
+        }
+
+        void step() override{
+            lifStep(net, t++, *input, inputs.next());
+        }
+    };
+
+    RegisterBenchModel reg({"lif_dense", "two LIF populations, Dense links in both directions",
+            [](size_t size, size_t nWorkers) -> std::unique_ptr<BenchModel>{
+                return std::make_unique<LIFDenseModel>(size, nWorkers);
+            }});
+}
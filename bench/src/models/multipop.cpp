@@ -0,0 +1,75 @@
+// ex5-style multi-population model: two LIF populations densely
+// connected in both directions, plus a population of constant
+// neurons feeding the second one, run with ParallelPart and
+// ParallelNonBlocking operations.
+
+#include "bench_models.hpp"
+
+using namespace llrt;
+
+namespace{
+    struct ConstNeuron{
+        float x=0;
+    };
+
+    using TTypes = std::tuple<LIFNeuron, LIFDendrite, ConstNeuron>;
+    using LTypes = std::tuple<DenseLink>;
+    using TL = std::pair<TTypes, LTypes>;
+
+    struct MultiPopModel : public NetworkBenchModel<TL>{
+        Component<TL> *input;
+        BenchInputs inputs;
+
+        MultiPopModel(size_t size, size_t nWorkers) :
+            NetworkBenchModel<TL>(nWorkers),
+            inputs(std::max<size_t>(std::sqrt(size / 3.0), 1)){
+            index_t n = inputs.values.size();
+            input = &net.component<LIFNeuron>({n});
+            Component<TL> &c2 = input->connect<DenseLink, NoData, LIFDendrite, LIFNeuron>({n});
+            c2.connect<DenseLink, NoData, LIFDendrite>(*input);
+            c2.connect<DenseLink, LIFDendrite, NoData, ConstNeuron>({n}, false, true);
+
+            ProcessNetLinks_Er(net, [](LIFDendrite &E, ThreadsafeRNG &r){
+                E.w = std::normal_distribution<float>(0,1.0)(r);
+            }, Dendrites | ParallelPart);
+            ProcessNetCmps_Nr(net, [](ConstNeuron &N, ThreadsafeRNG &r){
+                N.x = std::uniform_int_distribution<int>(0, 1)(r);
+            }, Parallel);
+        }
+
+        void step() override{
+            size_t _0 = t % 2;
+            size_t _1 = 1 - _0;
+            t++;
+            std::vector<float> &in = inputs.next();
+            ProcessNetCmps_N(net, [=](LIFNeuron &N){
+                if (N.x[_0] == 0)
+                    N.v[_1] = lifMu * N.v[_0];
+                else
+                    N.v[_1] = 0;
+            }, ParallelNonBlocking | KernelName("SelfPotential"));
+            ProcessCmp_NNi(*input, [=, &in](LIFNeuron &N, const size_t Ni){
+                N.v[_1] += in[Ni];
+            }, ParallelNonBlocking | KernelName("Input"));
+            ProcessNetLinks_NEn(net, [_1, _0](LIFNeuron &N, const LIFDendrite &E, const LIFNeuron &n){
+                N.v[_1] += E.w * n.x[_0];
+            }, Dendrites | KernelName("EdgeSum") | ParallelPart);
+            ProcessNetLinks_NEn(net, [_1](LIFNeuron &N, const LIFDendrite &E, const ConstNeuron &n){
+                N.v[_1] += E.w * n.x;
+            }, Dendrites | KernelName("ConstEdgeSum") | ParallelNonBlocking);
+            ProcessNetCmps_Nr(net, [=](LIFNeuron &N, ThreadsafeRNG &r){
+                float activateProb = 1 / (1 + std::exp(-lifK*N.v[_1]));
+                if(std::uniform_real_distribution<float>(0,1.0)(r) < activateProb)
+                    N.x[_1] = 1;
+                else
+                    N.x[_1] = 0;
+            }, ParallelNonBlocking | KernelName("Activate"));
+            net.finishBatches();
+        }
+    };
+
+    RegisterBenchModel reg({"multipop", "ex5-style: two Dense-linked LIF populations plus a constant population, nonblocking batches",
+            [](size_t size, size_t nWorkers) -> std::unique_ptr<BenchModel>{
+                return std::make_unique<MultiPopModel>(size, nWorkers);
+            }});
+}
@@ -0,0 +1,62 @@
+// A sparse random recurrent LIF network: excitatory and inhibitory
+// populations (4:1), connected to themselves and each other by
+// AdjListLinks with random edges, 100 incoming edges per node.
+
+#include "bench_models.hpp"
+
+using namespace llrt;
+
+namespace{
+    using TTypes = std::tuple<LIFNeuron, LIFDendrite>;
+    using LTypes = std::tuple<AdjListLink>;
+    using TL = std::pair<TTypes, LTypes>;
+
+    const size_t inDegree = 100;
+
+    struct SparseRecurrentModel : public NetworkBenchModel<TL>{
+        Component<TL> *input;
+        BenchInputs inputs;
+        std::mt19937_64 g{4321};
+
+        /**
+           Add random edges to the last created link, so that each
+           node of the dendrite end gets degree incoming edges.
+         */
+        void randomEdges(index_t nAxon, index_t nDendrite, size_t degree){
+            std::uniform_int_distribution<size_t> pick(0, nAxon-1);
+            std::vector<std::pair<size_t, size_t> > edges;
+            edges.reserve(nDendrite * degree);
+            for(size_t i=0; i < nDendrite; i++)
+                for(size_t j=0; j < degree; j++)
+                    edges.emplace_back(pick(g), i);
+            net.prevLinkType<AdjListLink>().insertEdges(edges);
+        }
+
+        SparseRecurrentModel(size_t size, size_t nWorkers) :
+            NetworkBenchModel<TL>(nWorkers),
+            inputs(std::max<size_t>(size / inDegree * 4 / 5, 5)){
+            index_t nE = inputs.values.size();
+            index_t nI = nE / 4;
+            size_t degE = inDegree * 4 / 5, degI = inDegree - degE;
+            input = &net.component<LIFNeuron>({nE});
+            Component<TL> &inh = input->connect<AdjListLink, NoData, LIFDendrite, LIFNeuron>({nI});
+            randomEdges(nE, nI, degE);
+            inh.connect<AdjListLink, NoData, LIFDendrite>(*input);
+            randomEdges(nI, nE, degI);
+            input->connect<AdjListLink, NoData, LIFDendrite>(*input);
+            randomEdges(nE, nE, degE);
+            inh.connect<AdjListLink, NoData, LIFDendrite>(inh);
+            randomEdges(nI, nI, degI);
+            lifInitialize(net);
+        }
+
+        void step() override{
+            lifStep(net, t++, *input, inputs.next());
+        }
+    };
+
+    RegisterBenchModel reg({"sparse_recurrent", "random recurrent excitatory/inhibitory LIF populations on AdjList links, in-degree 100",
+            [](size_t size, size_t nWorkers) -> std::unique_ptr<BenchModel>{
+                return std::make_unique<SparseRecurrentModel>(size, nWorkers);
+            }});
+}
@@ -0,0 +1,65 @@
+// Offline scheduler simulator
+//
+// Replays a SchedulerTrace, recorded with Scheduler::startTrace() and
+// stopTrace() (for example by running a bench_<model> program with
+// --trace=FILE), through the Scheduler's planning code with a virtual
+// clock, for each requested number of workers, and reports the
+// predicted makespan and idle time as JSON.
+//
+// Usage: sched_sim TRACE [--out=FILE] [--workers=1,2,4,8] [--threshold-us=30]
+//            [--chunk-overhead-us=0.5] [--barrier-overhead-us=5] [--cold]
+
+#include "scheduler_simulator.hpp"
+#include "bench_common.hpp"
+
+using namespace llrt;
+
+dur_t microseconds(const std::string &s){
+    return std::chrono::duration_cast<dur_t>(std::chrono::duration<double, std::micro>(std::stod(s)));
+}
+
+double toUs(dur_t d){
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+
+int main(int argc, char **argv){
+    BenchOptions opts(argc, argv);
+    std::string traceFile;
+    for(const std::string &a : opts.extra)
+        if (a.rfind("--", 0) != 0)
+            traceFile = a;
+    if (traceFile == ""){
+        std::cerr << "Usage: sched_sim TRACE [--out=FILE] [--workers=1,2,4,8] [--threshold-us=30] [--chunk-overhead-us=0.5] [--barrier-overhead-us=5] [--cold]" << std::endl;
+        return 2;
+    }
+    if (!opts.workersGiven)
+        opts.workers = {1, 2, 4, 8};
+
+    SchedulerTrace trace = SchedulerTrace::load(traceFile);
+    SchedulerSimulator::Options simOpts;
+    simOpts.singleThreadThreshold = microseconds(opts.get("threshold-us", "30"));
+    simOpts.chunkOverhead = microseconds(opts.get("chunk-overhead-us", "0.5"));
+    simOpts.barrierOverhead = microseconds(opts.get("barrier-overhead-us", "5"));
+    simOpts.warmEstimates = !opts.has("cold");
+
+    BenchReport report("sched_sim");
+    report.echo = false;
+    for(size_t workers : opts.workers){
+        if (workers == 0)
+            continue;
+        simOpts.nWorkers = workers;
+        SchedulerSimulator::Result r = SchedulerSimulator(trace, simOpts).run();
+        report.add()
+            .add("trace", traceFile)
+            .add("batches", trace.batches.size())
+            .add("workers", workers)
+            .add("makespan_us", toUs(r.makespan))
+            .add("busy_us", toUs(r.busy))
+            .add("idle_us", toUs(r.idle))
+            .add("utilization", r.utilization())
+            .add("barriers", r.barriers)
+            .add("single_threaded_barriers", r.singleThreadedBarriers)
+            .add("chunks", r.chunks);
+    }
+    report.write(opts);
+}
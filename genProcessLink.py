@@ -29,7 +29,10 @@ def vec(n,specifier):
     return s + "std::vector<arg{0}> & v{1};".format(str(n), specifier)
 
 def call(specifiers):
-    s = "                k("
+    s = ""
+    if 'r' in specifiers:
+        s += "                restartRNG(r, near, near_link);\n"
+    s += "                k("
     for n,specifier in enumerate(specifiers):
         if specifier == "Ni":
             s += "near"
@@ -60,7 +63,7 @@ def pkParam(n, specifier):
     if specifier == "Ni" or specifier == "Ei" or specifier == "f" or specifier == "ni" or specifier == "ei":
         return None
     if specifier == "r":
-        return "link.ends[0].c.net.rng" 
+        return "rng"
     s = "link.template "
     if specifier[0] == "N" or specifier[0] == "n":
         s += "comp"
@@ -96,6 +99,13 @@ def filterParam(n, specifier):
             return 0;""".format(str(n), filterVariant(specifier))
     return None
 
+def markWritten(n, specifier):
+    variant = filterVariant(specifier)
+    if variant is None:
+        return None
+    return """        if constexpr(kernelWrites<typename Traits::template argument<{0}>::type>)
+            {1}written = true;""".format(str(n), variant[:-len("values")])
+
 def processLink(specifiers):
     argtypes = '\n'.join([argtype(n,specifiers[n]) for n in range(len(specifiers)) if argtype(n,specifiers[n])])
     filtertypes = '\n'.join([filterParam(n, specifiers[n]) for n in range(len(specifiers)) if filterParam(n, specifiers[n])])
@@ -104,9 +114,13 @@ def processLink(specifiers):
     vecspec = [s for s in specifiers if s != 'r']
     vecs = '\n'.join([vec(n,vecspec[n]) for n in range(len(vecspec)) if vec(n,vecspec[n])])
     if 'r' in specifiers:
-        vecs += "\n            ThreadsafeRNG r;"
+        vecs += "\n            arg{0} r;".format(specifiers.index('r'))
     vecs += "\n            _" + "".join(specifiers) + "Kernel k;"
 
+    rng = ""
+    if 'r' in specifiers:
+        rng = "        auto &&rng = kernelRNG<arg{0}>(link, whichEnd);".format(specifiers.index('r'))
+    written = '\n'.join([markWritten(n, specifiers[n]) for n in range(len(specifiers)) if markWritten(n, specifiers[n])])
     pkParams = '\n'.join(["            " + pkParam(n,specifiers[n]) + "," for n in range(len(specifiers)) if pkParam(n,specifiers[n])])
     vecs_ref = vecs.replace("Kernel k", "Kernel &k")
     s="""
@@ -122,6 +136,7 @@ def processLink(specifiers):
 {3}
             }}
         }};
+{7}
         PureKernel pk{{
 {4}
             k
@@ -136,8 +151,9 @@ def processLink(specifiers):
 {4}
             k
         }};
-        auto li = [=,&link](PureKernel &pk, size_t start, size_t end){{
-            ProcessLink(link, whichEnd, pk, start, end
+{6}
+        auto li = [=,&link](PureKernel &pk, size_t start, size_t end, IsaLevel level){{
+            ProcessLink(link, whichEnd, pk, start, end, level
 #ifdef DEBUG_OP_LEVEL
                 ,opts.kernelName
 #endif
@@ -146,7 +162,7 @@ def processLink(specifiers):
         return QueueProcessLink(link, whichEnd, k, pk, pk_ref, li, opts);
     }}
 
-""".format("".join(specifiers), argtypes + '\n' + filtertypes, vecs, call(specifiers), pkParams, vecs_ref)
+""".format("".join(specifiers), argtypes + '\n' + filtertypes, vecs, call(specifiers), pkParams, vecs_ref, written, rng)
     return s
 
 def processCmp(specifiers):
@@ -272,7 +288,7 @@ def genHeader(filename, generable, verbose):
 // e = far link end
 // ei = index at far link end
 // f = edgeInfo
-// r = ThreadsafeRNG
+// r = ThreadsafeRNG or CounterRNG
 
 namespace llrt{
 """)
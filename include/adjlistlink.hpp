@@ -289,6 +289,77 @@ namespace llrt{
             return {0}; // user can increase this by adding edges
         }
 
+        // The state is: edgeIxBound, the number of nodes on each end,
+        // the number of neighbors of each node on end 0 and then on end
+        // 1, the NeighborIndices of end 0 and then of end 1, and one
+        // byte of destructedStatus per edge.
+        virtual void saveState(std::string &out){
+            auto put = [&](const void *p, size_t bytes){
+                out.append(static_cast<const char *>(p), bytes);
+            };
+            size_t header[3] = {edgeIxBound, end0Adjacency.size(), end1Adjacency.size()};
+            put(header, sizeof(header));
+            for(auto *adj : {&end0Adjacency, &end1Adjacency})
+                for(auto &a : *adj){
+                    size_t n = a.size();
+                    put(&n, sizeof(n));
+                }
+            for(auto *adj : {&end0Adjacency, &end1Adjacency})
+                for(auto &a : *adj)
+                    put(a.data(), a.size() * sizeof(NeighborIndices));
+            for(bool d : destructedStatus)
+                out.push_back(d ? 1 : 0);
+        }
+
+        virtual void loadState(const char *data, size_t size){
+            const char *end = data + size;
+            auto get = [&](void *p, size_t bytes){
+                if (static_cast<size_t>(end - data) < bytes)
+                    throw std::runtime_error("AdjList link state is truncated");
+                std::memcpy(p, data, bytes);
+                data += bytes;
+            };
+            size_t header[3];
+            get(header, sizeof(header));
+            if (header[1] != end0Adjacency.size() || header[2] != end1Adjacency.size())
+                throw std::runtime_error("AdjList link state has the wrong number of nodes");
+            for(auto *adj : {&end0Adjacency, &end1Adjacency})
+                for(auto &a : *adj){
+                    size_t n;
+                    get(&n, sizeof(n));
+                    a.resize(n);
+                }
+            for(auto *adj : {&end0Adjacency, &end1Adjacency})
+                for(auto &a : *adj)
+                    get(a.data(), a.size() * sizeof(NeighborIndices));
+            edgeIxBound = header[0];
+            for(int e=0; e < 2; e++){
+                auto &adj = e == 0 ? end0Adjacency : end1Adjacency;
+                size_t farSize = e == 0 ? end1Adjacency.size() : end0Adjacency.size();
+                for(auto &a : adj)
+                    for(NeighborIndices &ixs : a)
+                        if (ixs.edgeIx >= edgeIxBound || ixs.farNode >= farSize)
+                            throw std::runtime_error("AdjList link state has an edge out of range");
+            }
+            destructedStatus.resize(edgeIxBound);
+            for(size_t i=0; i < edgeIxBound; i++){
+                char d;
+                get(&d, 1);
+                destructedStatus[i] = d != 0;
+            }
+            end0LinkData->apply(&edgeIxBound, [](void * edgeIxBound, AnyVector &v){
+                v.resize(*static_cast<size_t *>(edgeIxBound));
+            });
+            end1LinkData->apply(&edgeIxBound, [](void * edgeIxBound, AnyVector &v){
+                v.resize(*static_cast<size_t *>(edgeIxBound));
+            });
+            dirty = true;
+        }
+
+        virtual std::optional<std::string> topologyParams(){
+            return std::nullopt; // edges are inserted by code
+        }
+
         virtual size_t maxProgress(int whichEnd){
             resetCumulativeEdgeCounts();
             if (end0CumulativeEdgeCounts.empty())
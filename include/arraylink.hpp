@@ -0,0 +1,253 @@
+// this file is included at the end of network.hpp and may therefore
+// refer to definitions from there.
+
+#ifndef ARRAYLINK_HPP_
+#define ARRAYLINK_HPP_
+
+namespace llrt{
+
+    /**
+       The values of one end of an ArrayLink, seen by its inner link
+       type as the values of a single member. The members' values are
+       stored one member after another, so resizing them, or moving
+       or refreshing a value, does the same to every member.
+     */
+    struct ArrayMemberVector : public AnyVector{
+        AnyVector &v;
+        size_t members;
+
+        ArrayMemberVector(AnyVector &v, size_t members) : v(v), members(members){}
+
+        virtual size_t size(){
+            return v.size() / members;
+        }
+
+        virtual void resize(size_t n){
+            size_t s = size();
+            if (n > s){
+                v.resize(n * members);
+                // from the back, so each value moves before its place is taken
+                for(size_t m=members; m-- > 1;)
+                    for(size_t i=s; i-- > 0;)
+                        v.move(m * s + i, m * n + i);
+                for(size_t m=0; m < members; m++)
+                    for(size_t i=s; i < n; i++)
+                        v.refreshIndex(m * n + i);
+            }
+            else if (n < s){
+                for(size_t m=1; m < members; m++)
+                    for(size_t i=0; i < n; i++)
+                        v.move(m * s + i, m * n + i);
+                v.resize(n * members);
+            }
+        }
+
+        virtual void move(size_t fromIndex, size_t toIndex){
+            size_t s = size();
+            for(size_t m=0; m < members; m++)
+                v.move(m * s + fromIndex, m * s + toIndex);
+        }
+
+        virtual void refreshIndex(size_t index){
+            size_t s = size();
+            for(size_t m=0; m < members; m++)
+                v.refreshIndex(m * s + index);
+        }
+    };
+
+    /**
+       The values of one end of an ArrayLink, given to its inner link
+       type by setLinkData. Keeps track of how many values each member
+       has, as the inner link type resizes them.
+     */
+    struct ArrayMemberVectors : public VariantVectorWrapper{
+        VariantVectorWrapper *outer = nullptr;
+        size_t members = 1;
+        size_t memberValues = 0;
+
+        virtual void apply(void *capture, void (*f)(void *, AnyVector &)){
+            if (outer == nullptr)
+                return;
+            struct Capture{
+                ArrayMemberVectors *self;
+                void *capture;
+                void (*f)(void *, AnyVector &);
+            } c{this, capture, f};
+            outer->apply(&c, [](void *cp, AnyVector &v){
+                Capture &c = *static_cast<Capture *>(cp);
+                ArrayMemberVector member(v, c.self->members);
+                c.f(c.capture, member);
+                c.self->memberValues = member.size();
+            });
+        }
+    };
+
+    /**
+       The kernel of an ArrayLink's inner link type, which moves the
+       indices of one member to their place in the whole array.
+     */
+    template<typename Kernel>
+    struct ArrayMemberKernel{
+        Kernel &k;
+        size_t nearNode, nearEdge, farNode, farEdge;
+
+        inline void operator()(const size_t Ni, const size_t Ei, const size_t ni, const size_t ei, const size_t edgeInfo){
+            k(Ni + nearNode, Ei + nearEdge, ni + farNode, ei + farEdge, edgeInfo);
+        }
+    };
+
+    /**
+       A link between two component arrays: components whose first
+       dimension counts members of the same shape, such as thousands
+       of small populations (see Network::componentArray). Member m of
+       one end is connected to member m of the other by the Inner link
+       type, the same way for every member, and the values of each
+       end of the link are stored one member after another.
+
+       An operation on the link is a single job for the scheduler,
+       whose progress runs through the members in turn, so it costs
+       no more to schedule than an operation on one big component. It
+       is divided between workers at the progress points of the
+       members' inner links.
+
+       Component<TL> &cols = net.template componentArray<Neuron>(1000, {100});
+       Component<TL> &inhib = cols.template connect<ArrayLink<DenseLink>, NoData, float, Neuron>({1000, 25});
+
+       The inner link type is reached as inner, such as to insert the
+       edges of an ArrayLink<AdjListLink>, which every member then has.
+     */
+    template<typename Inner>
+    struct ArrayLink : public BaseLinkType{
+        Inner inner;
+        /// the number of members
+        size_t members = 0;
+        /// the nodes of a member at each end
+        size_t memberNodes[2] = {0, 0};
+        ArrayMemberVectors vectors[2];
+
+        ArrayLink(){}
+
+        ArrayLink(const ArrayLink &other) : BaseLinkType(other){
+            *this = other;
+        }
+
+        ArrayLink &operator=(const ArrayLink &other){
+            inner = other.inner;
+            members = other.members;
+            for(int e=0; e < 2; e++){
+                memberNodes[e] = other.memberNodes[e];
+                vectors[e] = other.vectors[e];
+            }
+            // the inner link type must see this link's vectors, not other's
+            if (vectors[0].outer != nullptr)
+                inner.setLinkData(vectors[0], vectors[1]);
+            return *this;
+        }
+
+        static std::vector<index_t> memberDimensions(const std::vector<index_t> &dims){
+            return std::vector<index_t>(dims.begin() + 1, dims.end());
+        }
+
+        virtual std::string identifier(){
+            return "Array" + inner.identifier();
+        }
+
+        virtual bool canConnectDimensions(const std::vector<index_t> &dim0, const std::vector<index_t> &dim1){
+            if (dim0.size() < 2 || dim1.size() < 2 || dim0[0] != dim1[0] || dim0[0] == 0)
+                return false;
+            return inner.canConnectDimensions(memberDimensions(dim0), memberDimensions(dim1));
+        }
+
+        virtual bool deduceComponentDimensions(const std::vector<index_t> &dimF, std::vector<index_t> &result, int whichEnd){
+            if (dimF.size() < 2)
+                return false;
+            std::vector<index_t> member;
+            if (!inner.deduceComponentDimensions(memberDimensions(dimF), member, whichEnd))
+                return false;
+            result = {dimF[0]};
+            result.insert(result.end(), member.begin(), member.end());
+            return true;
+        }
+
+        virtual void setDimensions(const std::vector<index_t> &dim0, const std::vector<index_t> &dim1){
+            members = dim0.at(0);
+            std::vector<index_t> member0 = memberDimensions(dim0), member1 = memberDimensions(dim1);
+            memberNodes[0] = std::accumulate(member0.begin(), member0.end(), 1, std::multiplies<>());
+            memberNodes[1] = std::accumulate(member1.begin(), member1.end(), 1, std::multiplies<>());
+            for(int e=0; e < 2; e++)
+                vectors[e].members = members;
+            inner.setDimensions(member0, member1);
+            for(int e=0; e < 2; e++){
+                std::vector<index_t> size = e == 0 ? inner.linkEndSize(member0, member1, 0) : inner.linkEndSize(member1, member0, 1);
+                vectors[e].memberValues = std::accumulate(size.begin(), size.end(), 1, std::multiplies<>());
+            }
+        }
+
+        virtual std::vector<index_t> linkEndSize(const std::vector<index_t> &dimN, const std::vector<index_t> &dimF, int whichEnd){
+            std::vector<index_t> member = inner.linkEndSize(memberDimensions(dimN), memberDimensions(dimF), whichEnd);
+            std::vector<index_t> v{dimN.at(0)};
+            v.insert(v.end(), member.begin(), member.end());
+            return v;
+        }
+
+        virtual size_t maxProgress(int whichEnd){
+            return members * inner.maxProgress(whichEnd);
+        }
+
+        virtual void setLinkData(VariantVectorWrapper &valuesEnd0, VariantVectorWrapper &valuesEnd1){
+            vectors[0].outer = &valuesEnd0;
+            vectors[1].outer = &valuesEnd1;
+            inner.setLinkData(vectors[0], vectors[1]);
+        }
+
+        virtual size_t requestPartialProgress(int whichEnd, size_t requestedProgress){
+            size_t memberProgress = inner.maxProgress(whichEnd);
+            if (memberProgress == 0 || requestedProgress == 0)
+                return std::min(maxProgress(whichEnd), inner.requestPartialProgress(whichEnd, requestedProgress));
+            size_t m = requestedProgress / memberProgress, p = requestedProgress % memberProgress;
+            if (p == 0 || m >= members)
+                return std::min(requestedProgress, maxProgress(whichEnd));
+            return m * memberProgress + std::min(memberProgress, inner.requestPartialProgress(whichEnd, p));
+        }
+
+        virtual void saveState(std::string &out){
+            inner.saveState(out);
+        }
+
+        virtual void loadState(const char *data, size_t size){
+            inner.loadState(data, size);
+        }
+
+        virtual std::optional<std::string> topologyParams(){
+            return inner.topologyParams();
+        }
+
+        virtual void saveTopology(std::string &out){
+            inner.saveTopology(out);
+        }
+
+        virtual void loadTopology(const char *data, size_t size){
+            inner.loadTopology(data, size);
+        }
+
+        template<typename Kernel>
+        void operator()(int whichEnd,
+                        Kernel &k,
+                        size_t start,
+                        size_t end
+            ){
+            size_t memberProgress = inner.maxProgress(whichEnd);
+            if (memberProgress == 0)
+                return;
+            int near = whichEnd, far = 1 - whichEnd;
+            for(size_t m = start / memberProgress; m < members && m * memberProgress < end; m++){
+                size_t first = m * memberProgress;
+                ArrayMemberKernel<Kernel> mk{k,
+                    m * memberNodes[near], m * vectors[near].memberValues,
+                    m * memberNodes[far], m * vectors[far].memberValues};
+                inner(whichEnd, mk, std::max(start, first) - first, std::min(end, first + memberProgress) - first);
+            }
+        }
+    };
+}
+#endif
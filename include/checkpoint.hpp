@@ -0,0 +1,514 @@
+#ifndef CHECKPOINT_HPP_
+#define CHECKPOINT_HPP_
+
+/**
+   Saving and restoring the data of a Network.
+
+   A checkpoint holds the values of every Component's Tensor and of
+   both ends of every Link, plus whatever state the link types need
+   to restore their connectivity (for AdjListLink, the adjacency
+   lists; see BaseLinkType::saveState), plus the state of the
+   Network's random number generator.
+
+   It does not hold the structure of the Network, which is made of
+   types and kernels that only exist in code. To restore a
+   checkpoint, build the same Network again, with the same
+   components, connections and link parameters in the same order,
+   then call loadCheckpoint. The structure recorded in the
+   checkpoint is compared with the Network, and any mismatch throws
+   std::runtime_error before anything is changed.
+
+   The file format (version 1, native byte order) is:
+
+     "LLRTCKPT", u32 version, u32 alignment, u64 header bytes, u64 payload start
+     header: see CheckpointHeader
+     payloads, each starting at a multiple of alignment (4096 bytes)
+
+   The raw values of each Tensor are stored as one payload, so that
+   restoring them is a single copy from the mapped file. Only
+   trivially copyable value types (and bool) can be saved.
+
+   A delta, written by an IncrementalCheckpointer (see
+   incremental_checkpoint.hpp), has the same layout with the magic
+   "LLRTDLTA" and a CheckpointDelta after the header. Each Tensor's
+   payload then holds only the chunks of its values that changed.
+ */
+
+#include "network.hpp"
+#include "mapped_file.hpp"
+#include <deque>
+#include <sstream>
+
+namespace llrt{
+
+    const uint32_t checkpointVersion = 1;
+    const size_t checkpointAlignment = 4096;
+
+    /// where a Tensor's values are in a checkpoint
+    struct CheckpointTensor{
+        /// index of the value type in the Network's TTypes, or -1 for NoData
+        int64_t typeTag = -1;
+        std::vector<index_t> dimensions;
+        /// number of values stored, which for AdjListLink ends differs
+        /// from the product of the dimensions
+        uint64_t count = 0;
+        /// payload, relative to the start of the payloads. In a full
+        /// checkpoint, no bytes for some values means they were never
+        /// allocated (see Tensor::materialize), and are all T().
+        uint64_t offset = 0, bytes = 0;
+    };
+
+    struct CheckpointComponent{
+        std::string name;
+        int64_t id;
+        CheckpointTensor data;
+    };
+
+    struct CheckpointLink{
+        uint64_t id;
+        std::string identifier;
+        /// indices into CheckpointHeader::components of the components at end 0 and end 1
+        uint64_t cmp[2];
+        bool end0IsAxon;
+        CheckpointTensor ends[2];
+        /// payload written by BaseLinkType::saveState
+        uint64_t stateOffset = 0, stateBytes = 0;
+    };
+
+    /**
+       Everything in a checkpoint except the payloads. Components are
+       in the order of Network::components, and links in the order
+       they appear in the links[0] of those components. Self-links
+       have no data and are not included.
+     */
+    struct CheckpointHeader{
+        struct ValueType{
+            std::string name; ///< from typeid
+            uint64_t size;
+        };
+        std::vector<ValueType> valueTypes;
+        std::string rngState;
+        std::vector<CheckpointComponent> components;
+        std::vector<CheckpointLink> links;
+
+        /**
+           @return the record of a Tensor, given its index in
+           checkpoint order (see checkpointTensors)
+         */
+        CheckpointTensor &tensor(size_t index);
+
+        std::string encode() const;
+
+        /**
+           Throws std::runtime_error if the bytes are not a valid header
+         */
+        static CheckpointHeader decode(const char *data, size_t size);
+    };
+
+    /**
+       The part of a delta's header that says which parts of the
+       previous checkpoint in the chain it replaces.
+     */
+    struct CheckpointDelta{
+        uint64_t sequence = 0;
+        uint64_t previousSequence = 0;
+        /// the values of each Tensor are divided into chunks of this many bytes
+        uint64_t chunkBytes = 0;
+        /// for each Tensor, in checkpoint order (see
+        /// checkpointTensors), the indices of the chunks stored in
+        /// its payload, in increasing order
+        std::vector<std::vector<uint64_t> > chunks;
+        /// for each link, true if the payload holds its state, and
+        /// false if the state is unchanged
+        std::vector<bool> linkStateChanged;
+    };
+
+    /// a run of bytes to be written as one payload of a checkpoint
+    struct CheckpointPayload{
+        const char *data;
+        size_t bytes;
+    };
+
+    /**
+       Write a checkpoint file. The payloads must be given in the
+       order of their offsets, which must have been assigned by
+       checkpointPayloadOffset.
+     */
+    void writeCheckpointFile(const std::string &filename, const CheckpointHeader &header, const std::vector<CheckpointPayload> &payloads, const CheckpointDelta *delta=nullptr);
+
+    /// the offset of the payload after one at offset with the given size
+    inline uint64_t checkpointPayloadOffset(uint64_t offset, uint64_t bytes){
+        uint64_t end = offset + bytes;
+        return (end + checkpointAlignment - 1) / checkpointAlignment * checkpointAlignment;
+    }
+
+    /**
+       A checkpoint or delta file mapped into memory, with its header
+       decoded. Throws std::runtime_error if the file is neither.
+     */
+    struct MappedCheckpoint{
+        MappedFile file;
+        CheckpointHeader header;
+        std::optional<CheckpointDelta> delta;
+        uint64_t payloadStart;
+
+        MappedCheckpoint(const std::string &filename);
+
+        /// the payload at the given offset, checked to be inside the file
+        const char *payload(uint64_t offset, uint64_t bytes) const;
+    };
+
+    /**
+       @return the number of payload bytes taken by the given chunks
+       of a Tensor whose values take totalBytes. Throws
+       std::runtime_error if a chunk is out of range or out of order.
+     */
+    uint64_t checkpointChunksBytes(const std::vector<uint64_t> &chunks, uint64_t chunkBytes, uint64_t totalBytes);
+
+    /**
+       Copy the chunks packed one after another in src over the
+       corresponding chunks of the bytesSize bytes in dst
+     */
+    void patchCheckpointChunks(char *dst, uint64_t bytesSize, const std::vector<uint64_t> &chunks, uint64_t chunkBytes, const char *src);
+
+    /**
+       Write the values of all the Tensors in the Network, and the
+       state of its links and random number generator, to a file.
+       Waits for any scheduled operations to finish first.
+
+       Throws std::runtime_error if the file can't be written, or if
+       a Tensor holds values of a type that isn't trivially copyable.
+     */
+    template<typename TL>
+    void saveCheckpoint(Network<TL> &net, const std::string &filename);
+
+    /**
+       Restore the values written by saveCheckpoint into a Network
+       with the same structure. Waits for any scheduled operations to
+       finish first. The file is mapped into memory, and each
+       Tensor's values are copied out of the mapping once, into the
+       Tensor's own std::vector; the Tensors don't keep using the
+       mapped pages, so restoring copies the whole file.
+
+       Throws std::runtime_error, leaving the Network unchanged, if
+       the file is not a checkpoint or the Network's structure
+       doesn't match it.
+     */
+    template<typename TL>
+    void loadCheckpoint(Network<TL> &net, const std::string &filename);
+
+    template<typename TType>
+    struct CheckpointTypes;
+
+    template<typename ...Ts>
+    struct CheckpointTypes<std::tuple<Ts...> >{
+        static std::vector<CheckpointHeader::ValueType> valueTypes(){
+            return {CheckpointHeader::ValueType{typeid(Ts).name(), sizeof(Ts)}...};
+        }
+    };
+
+    /**
+       @return the raw bytes of the values of tensor t. Throws
+       std::runtime_error if they are not of a trivially copyable
+       type.
+
+       @param buffers holds a copy of the values if they aren't stored
+       contiguously (std::vector<bool>)
+     */
+    template<typename TType>
+    CheckpointPayload checkpointTensorBytes(Tensor<TType> &t, std::deque<std::string> &buffers){
+        if (t.noData || t.unallocated())
+            return {nullptr, 0};
+        return std::visit([&](auto &vec){
+            using T = std::decay_t<decltype(vec)>::value_type;
+            if constexpr(std::is_same_v<T, bool>){
+                buffers.emplace_back(vec.begin(), vec.end());
+                return CheckpointPayload{buffers.back().data(), buffers.back().size()};
+            }
+            else if constexpr(std::is_trivially_copyable_v<T>)
+                return CheckpointPayload{reinterpret_cast<const char *>(vec.data()), vec.size() * sizeof(T)};
+            else{
+                throw std::runtime_error(std::string() + "Can't checkpoint values of type " + typeid(T).name() + ", which is not trivially copyable");
+                return CheckpointPayload{nullptr, 0};
+            }
+        }, t.values);
+    }
+
+    /// fill in the type, dimensions and count of tensor t in rec
+    template<typename TType>
+    void describeCheckpointTensor(Tensor<TType> &t, CheckpointTensor &rec){
+        rec.dimensions = t.dimensions;
+        if (t.noData)
+            return;
+        rec.typeTag = t.values.index();
+        rec.count = t.unallocated() ? t.num_values : std::visit([](auto &vec){return vec.size();}, t.values);
+    }
+
+    /**
+       Throw std::runtime_error unless tensor t can hold the values
+       recorded in rec, whose payload is in ckpt.
+
+       @param chunks if ckpt is a delta, the chunks of the values that
+       the payload holds
+       @param countIsSize if true, the number of values recorded must
+       also match the dimensions of t
+       @param what names the tensor in error messages
+     */
+    template<typename TType>
+    void checkCheckpointTensor(Tensor<TType> &t, const CheckpointTensor &rec, const MappedCheckpoint &ckpt, const std::vector<uint64_t> *chunks, bool countIsSize, const std::string &what){
+        int64_t tag = t.noData ? -1 : static_cast<int64_t>(t.values.index());
+        if (tag != rec.typeTag)
+            throw std::runtime_error("Checkpoint doesn't match the network: " + what + " holds " + t.valueTypeName() + ", but the checkpoint has " + (rec.typeTag < 0 ? std::string("NoData") : ckpt.header.valueTypes.at(rec.typeTag).name));
+        if (rec.dimensions != t.dimensions)
+            throw std::runtime_error("Checkpoint doesn't match the network: " + what + " has dimensions " + listDimensions(t.dimensions) + ", but the checkpoint has " + listDimensions(rec.dimensions));
+        if (countIsSize && rec.typeTag >= 0 && rec.count != t.num_values)
+            throw std::runtime_error("Checkpoint doesn't match the network: " + what + " has " + std::to_string(t.num_values) + " values, but the checkpoint has " + std::to_string(rec.count));
+        if (rec.typeTag >= 0){
+            uint64_t total = rec.count * ckpt.header.valueTypes.at(rec.typeTag).size;
+            if (chunks != nullptr)
+                total = checkpointChunksBytes(*chunks, ckpt.delta->chunkBytes, total);
+            // values that were never allocated are all T(), with no payload
+            if (rec.bytes != total && !(chunks == nullptr && rec.bytes == 0))
+                throw std::runtime_error("Checkpoint is corrupt: " + what + " has the wrong payload size");
+            ckpt.payload(rec.offset, rec.bytes);
+        }
+    }
+
+    /**
+       Copy the values recorded in rec into tensor t.
+
+       @param chunks if ckpt is a delta, the chunks of the values that
+       the payload holds, which replace those chunks of t's values
+     */
+    template<typename TType>
+    void restoreCheckpointTensor(Tensor<TType> &t, const CheckpointTensor &rec, const MappedCheckpoint &ckpt, const std::vector<uint64_t> *chunks){
+        if (rec.typeTag < 0)
+            return;
+        bool allDefault = chunks == nullptr ? rec.bytes == 0 : chunks->empty();
+        if (allDefault && t.unallocated())
+            return;
+        t.materialize();
+        if (chunks == nullptr && rec.bytes == 0){
+            std::visit([&](auto &vec){
+                using T = std::decay_t<decltype(vec)>::value_type;
+                vec.assign(rec.count, T());
+            }, t.values);
+            return;
+        }
+        const char *src = ckpt.payload(rec.offset, rec.bytes);
+        std::visit([&](auto &vec){
+            using T = std::decay_t<decltype(vec)>::value_type;
+            if constexpr(std::is_same_v<T, bool>){
+                if (chunks == nullptr){
+                    vec.assign(src, src + rec.count);
+                    return;
+                }
+                std::string bytes(vec.begin(), vec.end());
+                bytes.resize(rec.count);
+                patchCheckpointChunks(bytes.data(), rec.count, *chunks, ckpt.delta->chunkBytes, src);
+                vec.assign(bytes.begin(), bytes.end());
+            }
+            else if constexpr(std::is_trivially_copyable_v<T>){
+                if (chunks == nullptr){
+                    // the payload is page-aligned, so it is aligned for T
+                    const T *values = reinterpret_cast<const T *>(src);
+                    vec.assign(values, values + rec.count);
+                    return;
+                }
+                vec.resize(rec.count);
+                patchCheckpointChunks(reinterpret_cast<char *>(vec.data()), rec.count * sizeof(T), *chunks, ckpt.delta->chunkBytes, src);
+            }
+            else
+                throw std::runtime_error(std::string() + "Can't restore values of type " + typeid(T).name() + ", which is not trivially copyable");
+        }, t.values);
+    }
+
+    /// the links of the Network in checkpoint order
+    template<typename TL>
+    std::vector<Link<TL> *> checkpointLinks(Network<TL> &net){
+        std::vector<Link<TL> *> links;
+        for(auto &c : net.components)
+            for(auto &l : c->links[0])
+                links.push_back(l.get());
+        return links;
+    }
+
+    /// the CounterRNG step counters of the Network's links, including self links, in checkpoint order
+    template<typename TL>
+    std::vector<uint64_t *> rngSteps(Network<TL> &net){
+        std::vector<uint64_t *> steps;
+        for(auto &c : net.components)
+            steps.push_back(&c->selfLink->rngSteps[0]);
+        for(Link<TL> *l : checkpointLinks(net))
+            for(int e=0; e < 2; e++)
+                steps.push_back(&l->rngSteps[e]);
+        return steps;
+    }
+
+    /// the Tensors of the Network in checkpoint order: the components, then both ends of each link
+    template<typename TL>
+    std::vector<Tensor<typename TLTypes<TL>::TType> *> checkpointTensors(Network<TL> &net){
+        std::vector<Tensor<typename TLTypes<TL>::TType> *> tensors;
+        for(auto &c : net.components)
+            tensors.push_back(&c->data);
+        for(Link<TL> *l : checkpointLinks(net))
+            for(int e=0; e < 2; e++)
+                tensors.push_back(&l->ends[e].data);
+        return tensors;
+    }
+
+    /**
+       @return the header of a checkpoint of the Network, with no
+       payloads assigned yet
+     */
+    template<typename TL>
+    CheckpointHeader checkpointHeader(Network<TL> &net){
+        using TType = TLTypes<TL>::TType;
+        CheckpointHeader header;
+        header.valueTypes = CheckpointTypes<TType>::valueTypes();
+        std::ostringstream rng;
+        rng << *net.rng.baseRNG << " " << net.counterSeed;
+        for(uint64_t *steps : rngSteps(net))
+            rng << " " << *steps;
+        header.rngState = rng.str();
+
+        std::map<Component<TL> *, uint64_t> cmpIndex;
+        for(auto &c : net.components){
+            cmpIndex[c.get()] = header.components.size();
+            header.components.emplace_back();
+            CheckpointComponent &rec = header.components.back();
+            rec.name = c->name;
+            rec.id = c->id;
+            describeCheckpointTensor(c->data, rec.data);
+        }
+        for(Link<TL> *l : checkpointLinks(net)){
+            header.links.emplace_back();
+            CheckpointLink &rec = header.links.back();
+            rec.id = l->id;
+            rec.identifier = l->identifier();
+            rec.end0IsAxon = l->ends[0].isAxon();
+            for(int e=0; e < 2; e++){
+                rec.cmp[e] = cmpIndex.at(&l->ends[e].c);
+                describeCheckpointTensor(l->ends[e].data, rec.ends[e]);
+            }
+        }
+        return header;
+    }
+
+    template<typename TL>
+    void saveCheckpoint(Network<TL> &net, const std::string &filename){
+        net.finishBatches();
+        CheckpointHeader header = checkpointHeader(net);
+
+        std::vector<CheckpointPayload> payloads;
+        std::deque<std::string> buffers;
+        uint64_t offset = 0;
+        auto tensors = checkpointTensors(net);
+        for(size_t i=0; i < tensors.size(); i++){
+            CheckpointTensor &rec = header.tensor(i);
+            if (rec.typeTag < 0)
+                continue;
+            payloads.push_back(checkpointTensorBytes(*tensors[i], buffers));
+            rec.offset = offset;
+            rec.bytes = payloads.back().bytes;
+            offset = checkpointPayloadOffset(offset, rec.bytes);
+        }
+        std::vector<Link<TL> *> links = checkpointLinks(net);
+        for(size_t i=0; i < links.size(); i++){
+            buffers.emplace_back();
+            std::visit([&](auto &t){t.saveState(buffers.back());}, links[i]->type);
+            if (buffers.back().empty())
+                continue;
+            CheckpointLink &rec = header.links[i];
+            rec.stateOffset = offset;
+            rec.stateBytes = buffers.back().size();
+            payloads.push_back({buffers.back().data(), buffers.back().size()});
+            offset = checkpointPayloadOffset(offset, rec.stateBytes);
+        }
+        writeCheckpointFile(filename, header, payloads);
+    }
+
+    /**
+       Copy the contents of a checkpoint or delta into a Network,
+       after checking that the Network has the structure recorded in
+       it. Throws std::runtime_error, leaving the Network unchanged,
+       if it doesn't.
+     */
+    template<typename TL>
+    void restoreCheckpoint(Network<TL> &net, const MappedCheckpoint &ckpt){
+        using TType = TLTypes<TL>::TType;
+        const CheckpointHeader &header = ckpt.header;
+        const CheckpointDelta *delta = ckpt.delta ? &*ckpt.delta : nullptr;
+
+        // check everything before changing anything
+        std::vector<CheckpointHeader::ValueType> valueTypes = CheckpointTypes<TType>::valueTypes();
+        if (header.valueTypes.size() != valueTypes.size())
+            throw std::runtime_error("Checkpoint doesn't match the network: it has " + std::to_string(header.valueTypes.size()) + " value types, but the network has " + std::to_string(valueTypes.size()));
+        for(size_t i=0; i < valueTypes.size(); i++)
+            if (header.valueTypes[i].name != valueTypes[i].name || header.valueTypes[i].size != valueTypes[i].size)
+                throw std::runtime_error("Checkpoint doesn't match the network: value type " + std::to_string(i) + " is " + header.valueTypes[i].name + " in the checkpoint, but " + valueTypes[i].name + " in the network");
+
+        if (header.components.size() != net.components.size())
+            throw std::runtime_error("Checkpoint doesn't match the network: it has " + std::to_string(header.components.size()) + " components, but the network has " + std::to_string(net.components.size()));
+        std::vector<Link<TL> *> links = checkpointLinks(net);
+        if (header.links.size() != links.size())
+            throw std::runtime_error("Checkpoint doesn't match the network: it has " + std::to_string(header.links.size()) + " links, but the network has " + std::to_string(links.size()));
+        size_t nTensors = net.components.size() + 2 * links.size();
+        if (delta && (delta->chunks.size() != nTensors || delta->linkStateChanged.size() != links.size()))
+            throw std::runtime_error("Checkpoint is corrupt: the delta doesn't cover every tensor and link");
+        auto chunks = [&](size_t tensorIndex){
+            return delta ? &delta->chunks[tensorIndex] : nullptr;
+        };
+
+        std::map<Component<TL> *, uint64_t> cmpIndex;
+        for(size_t i=0; i < net.components.size(); i++){
+            Component<TL> &c = *net.components[i];
+            cmpIndex[&c] = i;
+            checkCheckpointTensor(c.data, header.components[i].data, ckpt, chunks(i), true, "component " + c.name);
+        }
+        for(size_t i=0; i < links.size(); i++){
+            Link<TL> &l = *links[i];
+            const CheckpointLink &rec = header.links[i];
+            if (rec.identifier != l.identifier() || rec.cmp[0] != cmpIndex.at(&l.ends[0].c) || rec.cmp[1] != cmpIndex.at(&l.ends[1].c))
+                throw std::runtime_error("Checkpoint doesn't match the network: link " + l.name + " is a " + l.identifier() + " link between components " + std::to_string(cmpIndex.at(&l.ends[0].c)) + " and " + std::to_string(cmpIndex.at(&l.ends[1].c)) + ", but the checkpoint has a " + rec.identifier + " link between components " + std::to_string(rec.cmp[0]) + " and " + std::to_string(rec.cmp[1]));
+            // link types with state decide the size of their ends
+            for(int e=0; e < 2; e++)
+                checkCheckpointTensor(l.ends[e].data, rec.ends[e], ckpt, chunks(net.components.size() + 2*i + e), !delta && rec.stateBytes == 0, l.endName(e));
+            ckpt.payload(rec.stateOffset, rec.stateBytes);
+        }
+
+        ckpt.file.willNeed(ckpt.payloadStart, ckpt.file.size() - ckpt.payloadStart);
+        for(size_t i=0; i < net.components.size(); i++)
+            restoreCheckpointTensor(net.components[i]->data, header.components[i].data, ckpt, chunks(i));
+        for(size_t i=0; i < links.size(); i++){
+            Link<TL> &l = *links[i];
+            const CheckpointLink &rec = header.links[i];
+            if (!delta || delta->linkStateChanged[i])
+                std::visit([&](auto &t){
+                    t.loadState(ckpt.payload(rec.stateOffset, rec.stateBytes), rec.stateBytes);
+                }, l.type);
+            for(int e=0; e < 2; e++)
+                restoreCheckpointTensor(l.ends[e].data, rec.ends[e], ckpt, chunks(net.components.size() + 2*i + e));
+        }
+        std::istringstream rng(header.rngState);
+        rng >> *net.rng.baseRNG;
+        // checkpoints from before CounterRNG end here
+        uint64_t seed;
+        if (rng >> seed){
+            net.counterSeed = seed;
+            for(uint64_t *steps : rngSteps(net))
+                rng >> *steps;
+        }
+    }
+
+    template<typename TL>
+    void loadCheckpoint(Network<TL> &net, const std::string &filename){
+        net.finishBatches();
+        MappedCheckpoint ckpt(filename);
+        if (ckpt.delta)
+            throw std::runtime_error(filename + " is a delta, which must be loaded with loadCheckpointChain");
+        restoreCheckpoint(net, ckpt);
+    }
+}
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef COUNTER_RNG_HPP_
+#define COUNTER_RNG_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <algorithm>
+
+namespace llrt{
+
+    /**
+       A counter-based random number generator (Philox4x32-10, from
+       Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"):
+       each block of 4 numbers is a function of a 64-bit key and a
+       128-bit counter, so any stream can be started anywhere without
+       state to carry over, allocate or share.
+
+       Declare a kernel's "r" parameter as CounterRNG & instead of
+       ThreadsafeRNG & to get one. Its key comes from the Network's
+       seed (Network::seed), the link and end the operation runs on,
+       and how many such operations have run there before; the
+       counter starts from the near node and near link end indices at
+       each call of the kernel. So the numbers each node (or edge)
+       draws don't depend on how the operation is split into chunks,
+       on the number of workers, or on adaptive scheduling:
+
+       ProcessNetCmps_Nr(net, [](Neuron &N, CounterRNG &r){
+           N.v += std::normal_distribution<float>(0, 1)(r);
+       });
+
+       It is trivially copyable, and satisfies
+       UniformRandomBitGenerator, so it works with the std::
+       distributions. generate() and uniform() fill arrays in bulk.
+     */
+    class CounterRNG{
+    public:
+        using result_type = uint32_t;
+
+        CounterRNG(){}
+
+        /// a stream with the given key, starting at counter 0
+        explicit CounterRNG(uint64_t key){
+            setKey(key);
+        }
+
+        /// the key of the stream of the given operation
+        static uint64_t streamKey(uint64_t seed, uint64_t op, uint64_t step){
+            return mix(mix(seed ^ mix(op)) ^ step);
+        }
+
+        void setKey(uint64_t key){
+            k[0] = uint32_t(key);
+            k[1] = uint32_t(key >> 32);
+            restart(0, 0);
+        }
+
+        /**
+           Start the numbers of a node and link end, from the
+           beginning. Every pair of indices below 2^48 (far more than
+           fit in memory) gets a stream of its own: the low 32 bits of
+           each have a counter word, and their next 16 bits share one.
+           The last word counts blocks.
+         */
+        void restart(uint64_t node, uint64_t linkEnd){
+            c[0] = uint32_t(linkEnd);
+            c[1] = uint32_t((linkEnd >> 32) & 0xFFFF) | uint32_t((node >> 32) & 0xFFFF) << 16;
+            c[2] = uint32_t(node);
+            c[3] = 0;
+            used = 4;
+        }
+
+        result_type operator()(){
+            if (used == 4){
+                philox(c, k, buf);
+                c[3]++;
+                used = 0;
+            }
+            return buf[used++];
+        }
+
+        static constexpr result_type min(){
+            return 0;
+        }
+
+        static constexpr result_type max(){
+            return std::numeric_limits<result_type>::max();
+        }
+
+        /// a float in [0, 1), from the top 24 bits of a number
+        float uniform(){
+            return ((*this)() >> 8) * (1.0f / 16777216.0f);
+        }
+
+        /// n numbers, the same as n calls of operator()
+        void generate(result_type *out, size_t n){
+            size_t i = 0;
+            while(i < n && used < 4)
+                out[i++] = buf[used++];
+            // whole blocks, independent of each other, so the loop vectorizes
+            size_t blocks = (n - i) / 4;
+            for(size_t b=0; b < blocks; b++){
+                uint32_t ctr[4] = {c[0], c[1], c[2], c[3] + uint32_t(b)};
+                philox(ctr, k, out + i + 4*b);
+            }
+            c[3] += blocks;
+            i += 4*blocks;
+            while(i < n)
+                out[i++] = (*this)();
+        }
+
+        /// n floats in [0, 1), the same as n calls of uniform()
+        void uniform(float *out, size_t n){
+            result_type bits[256];
+            for(size_t start=0; start < n; start += 256){
+                size_t m = std::min<size_t>(n - start, 256);
+                generate(bits, m);
+                for(size_t i=0; i < m; i++)
+                    out[start + i] = (bits[i] >> 8) * (1.0f / 16777216.0f);
+            }
+        }
+
+        /// the Philox4x32-10 block of a counter and key
+        static void philox(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]){
+            uint32_t x0 = ctr[0], x1 = ctr[1], x2 = ctr[2], x3 = ctr[3];
+            uint32_t k0 = key[0], k1 = key[1];
+            for(int round=0; round < 10; round++){
+                uint64_t p0 = uint64_t(0xD2511F53u) * x0, p1 = uint64_t(0xCD9E8D57u) * x2;
+                uint32_t y0 = uint32_t(p1 >> 32) ^ x1 ^ k0, y2 = uint32_t(p0 >> 32) ^ x3 ^ k1;
+                x1 = uint32_t(p1);
+                x3 = uint32_t(p0);
+                x0 = y0;
+                x2 = y2;
+                k0 += 0x9E3779B9u;
+                k1 += 0xBB67AE85u;
+            }
+            out[0] = x0;
+            out[1] = x1;
+            out[2] = x2;
+            out[3] = x3;
+        }
+
+    private:
+        uint32_t k[2] = {0, 0};
+        uint32_t c[4] = {0, 0, 0, 0};
+        uint32_t buf[4] = {0, 0, 0, 0};
+        uint32_t used = 4;
+
+        /// the splitmix64 finalizer
+        static uint64_t mix(uint64_t x){
+            x ^= x >> 30;
+            x *= 0xBF58476D1CE4E5B9ull;
+            x ^= x >> 27;
+            x *= 0x94D049BB133111EBull;
+            return x ^ (x >> 31);
+        }
+    };
+
+    static_assert(std::is_trivially_copyable_v<CounterRNG>);
+}
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef DISTRIBUTED_PARTITION_HPP_
+#define DISTRIBUTED_PARTITION_HPP_
+
+#include "halo.hpp"
+#include "halo_transport.hpp"
+
+namespace llrt{
+
+    /**
+       Append the indices of the true values of spikes to out, as a
+       varint count followed by varint gaps between the indices.
+     */
+    void encodeSpikeIndices(const std::vector<bool> &spikes, std::string &out);
+
+    /**
+       Set spikes from the indices written by encodeSpikeIndices at p,
+       and clear the others. Throws std::runtime_error if the data is
+       malformed.
+
+       @return the end of the indices
+     */
+    const char *decodeSpikeIndices(const char *p, const char *end, std::vector<bool> &spikes);
+
+    /**
+       Runs one Network across several processes, on one machine or
+       many, like ShmPartition but exchanging the halo through a
+       HaloTransport, such as a TcpTransport, instead of shared
+       memory.
+
+       Every rank builds the same Network and creates a
+       DistributedPartition with the rank that owns each component
+       (see ShmPartition). Operations on other ranks' components are
+       skipped, and exchange() sends each rank the halo data it reads
+       from this one: the data of components and link ends next to a
+       link between ranks. Tensors of bools, such as spikes, are sent
+       as the indices of their true values, so the traffic grows with
+       activity rather than with size.
+
+       To overlap the communication with computation, split exchange()
+       into beginExchange(), which sends this rank's halo data in the
+       background, and endExchange(), which waits for the other ranks'
+       data. In between, submit nonblocking operations that don't read
+       the halo, such as updates of components that only have links
+       within this rank:
+
+       part.exchange([&]{
+           return ProcessCmp_N(interior, ..., ParallelNonBlocking);
+       });
+       ProcessNetLinks_NEn(net, ...); // may read the halo
+
+       @tparam TL the Network's types
+     */
+    template<typename TL>
+    class DistributedPartition{
+    public:
+        struct Options{
+            /// send tensors of bools as the indices of their true values
+            bool spikeIndices = true;
+        };
+
+        /**
+           @param transport connected to the other ranks;
+           transport.rank() is this rank
+           @param owners the rank that owns each component, in the
+           order of Network::components
+         */
+        DistributedPartition(Network<TL> &net, HaloTransport &transport, const std::vector<size_t> &owners);
+        DistributedPartition(Network<TL> &net, HaloTransport &transport, const std::vector<size_t> &owners, const Options &opts);
+
+        /// makes every component local again
+        ~DistributedPartition();
+
+        DistributedPartition(const DistributedPartition &) = delete;
+        DistributedPartition &operator=(const DistributedPartition &) = delete;
+
+        /**
+           Finish the operations submitted so far, and send this
+           rank's halo data to the ranks that read it. Returns once
+           the data has been copied for sending.
+         */
+        void beginExchange();
+
+        /**
+           Wait for the halo data of the other ranks, and copy it into
+           the network. Throws std::runtime_error if a rank sends
+           data for a different exchange or of the wrong size.
+         */
+        void endExchange();
+
+        /// beginExchange() then endExchange()
+        void exchange(){
+            beginExchange();
+            endExchange();
+        }
+
+        /**
+           beginExchange(), then submit operations to run while the
+           data is in flight, then endExchange().
+
+           @param interior submits operations that don't read the
+           halo, and returns the batch number of the last
+           @return that batch number
+         */
+        template<typename Interior>
+        size_t exchange(Interior &&interior){
+            beginExchange();
+            size_t batch = interior();
+            endExchange();
+            return batch;
+        }
+
+        size_t getRank() const{
+            return rank;
+        }
+
+        size_t getNumRanks() const{
+            return numRanks;
+        }
+
+        /// bytes of halo data this rank has sent
+        size_t bytesSent() const{
+            return sent;
+        }
+
+    private:
+        using TType = TLTypes<TL>::TType;
+
+        Network<TL> &net;
+        HaloTransport &transport;
+        Options opts;
+        size_t rank, numRanks;
+        /// the tensors sent to, and received from, each rank
+        std::vector<std::vector<Tensor<TType> *> > sendTo, receiveFrom;
+        uint64_t exchanges = 0;
+        bool exchanging = false;
+        size_t sent = 0;
+
+        void encode(Tensor<TType> &t, std::string &out);
+        const char *decode(Tensor<TType> &t, const char *p, const char *end);
+    };
+
+    template<typename TL>
+    DistributedPartition<TL>::DistributedPartition(Network<TL> &net, HaloTransport &transport, const std::vector<size_t> &owners) :
+        DistributedPartition(net, transport, owners, Options()){}
+
+    template<typename TL>
+    DistributedPartition<TL>::DistributedPartition(Network<TL> &net, HaloTransport &transport, const std::vector<size_t> &owners, const Options &opts) :
+        net(net), transport(transport), opts(opts), rank(transport.rank()), numRanks(transport.numRanks()){
+        if (numRanksOf(owners) > numRanks)
+            throw std::runtime_error("DistributedPartition: components are owned by " + std::to_string(numRanksOf(owners)) + " ranks, but the transport connects only " + std::to_string(numRanks));
+        net.finishBatches();
+        sendTo.resize(numRanks);
+        receiveFrom.resize(numRanks);
+        for(auto &h : haloTensors(net, owners)){
+            haloTensorBytes(*h.t); // throws if it can't be sent
+            for(size_t reader : h.readers){
+                if (h.owner == rank)
+                    sendTo[reader].push_back(h.t);
+                else if (reader == rank)
+                    receiveFrom[h.owner].push_back(h.t);
+            }
+        }
+        for(size_t i=0; i < owners.size(); i++)
+            net.components[i]->local = owners[i] == rank;
+    }
+
+    template<typename TL>
+    DistributedPartition<TL>::~DistributedPartition(){
+        for(auto &c : net.components)
+            c->local = true;
+    }
+
+    template<typename TL>
+    void DistributedPartition<TL>::beginExchange(){
+        if (exchanging)
+            throw std::runtime_error("DistributedPartition: beginExchange() called twice without endExchange()");
+        net.finishBatches();
+        for(size_t r=0; r < numRanks; r++){
+            if (sendTo[r].empty())
+                continue;
+            std::string msg(reinterpret_cast<const char *>(&exchanges), sizeof(exchanges));
+            for(Tensor<TType> *t : sendTo[r])
+                encode(*t, msg);
+            sent += msg.size();
+            transport.send(r, std::move(msg));
+        }
+        exchanging = true;
+    }
+
+    template<typename TL>
+    void DistributedPartition<TL>::endExchange(){
+        if (!exchanging)
+            throw std::runtime_error("DistributedPartition: endExchange() called without beginExchange()");
+        exchanging = false;
+        for(size_t r=0; r < numRanks; r++){
+            if (receiveFrom[r].empty())
+                continue;
+            std::string msg = transport.receive(r);
+            uint64_t number;
+            if (msg.size() < sizeof(number))
+                throw std::runtime_error("DistributedPartition: malformed halo data from rank " + std::to_string(r));
+            std::memcpy(&number, msg.data(), sizeof(number));
+            if (number != exchanges)
+                throw std::runtime_error("DistributedPartition: rank " + std::to_string(r) + " sent the halo of exchange " + std::to_string(number) + " during exchange " + std::to_string(exchanges));
+            const char *p = msg.data() + sizeof(number), *end = msg.data() + msg.size();
+            for(Tensor<TType> *t : receiveFrom[r])
+                p = decode(*t, p, end);
+            if (p != end)
+                throw std::runtime_error("DistributedPartition: rank " + std::to_string(r) + " sent more halo data than expected");
+        }
+        exchanges++;
+    }
+
+    template<typename TL>
+    void DistributedPartition<TL>::encode(Tensor<TType> &t, std::string &out){
+        bool encoded = std::visit([&](auto &vec){
+            if constexpr(std::is_same_v<typename std::decay_t<decltype(vec)>::value_type, bool>){
+                if (opts.spikeIndices){
+                    encodeSpikeIndices(vec, out);
+                    return true;
+                }
+            }
+            return false;
+        }, t.values);
+        if (encoded)
+            return;
+        size_t start = out.size();
+        out.resize(start + haloTensorBytes(t));
+        writeHaloTensor(t, out.data() + start);
+    }
+
+    template<typename TL>
+    const char *DistributedPartition<TL>::decode(Tensor<TType> &t, const char *p, const char *end){
+        const char *decoded = std::visit([&](auto &vec) -> const char *{
+            if constexpr(std::is_same_v<typename std::decay_t<decltype(vec)>::value_type, bool>){
+                if (opts.spikeIndices){
+                    t.materialize(); // the indices set and clear values in place
+                    return decodeSpikeIndices(p, end, vec);
+                }
+            }
+            return nullptr;
+        }, t.values);
+        if (decoded != nullptr)
+            return decoded;
+        size_t bytes = haloTensorBytes(t);
+        if (static_cast<size_t>(end - p) < bytes)
+            throw std::runtime_error("DistributedPartition: received less halo data than expected");
+        readHaloTensor(t, p);
+        return p + bytes;
+    }
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <set>
 #include <tuple>
@@ -140,7 +141,7 @@ namespace llrt{
             atrousCols = atrousCols_;
 
             dirty = true;
-            initialize();
+            resize();
         }
 
         virtual void setDimensions(const std::vector<index_t> &dim0, const std::vector<index_t> &dim1){
@@ -158,7 +159,7 @@ namespace llrt{
             else
                 end1depth = 1;
             dirty = true;
-            initialize();
+            resize();
         }
 
         virtual std::vector<index_t> linkEndSize(const std::vector<index_t> &dimN, const std::vector<index_t> &dimF, int whichEnd){
@@ -177,6 +178,8 @@ namespace llrt{
         }
 
         void resize(){
+            if (end1rows == 0 || filterRows == 0) // incomplete params
+                return;
             std::vector<index_t> dimN{end1rows, end1cols, end1depth};
             std::vector<index_t> dimF{end0rows, end0cols, end0depth};
             size_t size = linkEndSize(dimN, dimF, 1).at(0);
@@ -308,6 +311,16 @@ namespace llrt{
 
         std::vector<size_t> cumulativeEnd0RowSizes, cumulativeEnd1RowSizes;
 
+        /**
+           Compute the cumulative row sizes, if the parameters changed
+           since they were last computed. Called from maxProgress,
+           which QueueProcessLink calls on the client thread before an
+           operation is queued, so that a network that only loads them
+           from a TopologyCache never computes them. The scheduler
+           thread calls requestPartialProgress while the operation is
+           queued, and only reads them: the parameters, and so the
+           tables, can't change until the operation has finished.
+         */
         void initialize(){
             if (!dirty)
                 return;
@@ -348,15 +361,51 @@ namespace llrt{
                 cumulativeEnd0RowSizes[end0row] += cumulative;
                 cumulative += tmp;
             }
-            resize();
+            dirty = false;
+        }
+
+        virtual std::optional<std::string> topologyParams(){
+            return showParams();
+        }
+
+        // The topology is the number of rows on each end, then
+        // cumulativeEnd0RowSizes and cumulativeEnd1RowSizes.
+        virtual void saveTopology(std::string &out){
+            initialize();
+            size_t header[2] = {cumulativeEnd0RowSizes.size(), cumulativeEnd1RowSizes.size()};
+            out.append(reinterpret_cast<const char *>(header), sizeof(header));
+            out.append(reinterpret_cast<const char *>(cumulativeEnd0RowSizes.data()), cumulativeEnd0RowSizes.size() * sizeof(size_t));
+            out.append(reinterpret_cast<const char *>(cumulativeEnd1RowSizes.data()), cumulativeEnd1RowSizes.size() * sizeof(size_t));
+        }
+
+        virtual void loadTopology(const char *data, size_t size){
+            size_t header[2];
+            if (size < sizeof(header))
+                throw std::runtime_error("GeneralLocal2D topology is truncated");
+            std::memcpy(header, data, sizeof(header));
+            if (header[0] != end0rows || header[1] != end1rows)
+                throw std::runtime_error("GeneralLocal2D topology has the wrong number of rows");
+            if (size != sizeof(header) + (end0rows + end1rows) * sizeof(size_t))
+                throw std::runtime_error("GeneralLocal2D topology has the wrong size");
+            const size_t *rows = reinterpret_cast<const size_t *>(data + sizeof(header));
+            std::vector<size_t> rows0(end0rows), rows1(end1rows);
+            std::memcpy(rows0.data(), rows, end0rows * sizeof(size_t));
+            std::memcpy(rows1.data(), rows + end0rows, end1rows * sizeof(size_t));
+            if (!std::is_sorted(rows0.begin(), rows0.end()) || !std::is_sorted(rows1.begin(), rows1.end()) ||
+                rows0.empty() || rows1.empty() || rows0.back() != rows1.back())
+                throw std::runtime_error("GeneralLocal2D topology is inconsistent");
+            cumulativeEnd0RowSizes = std::move(rows0);
+            cumulativeEnd1RowSizes = std::move(rows1);
             dirty = false;
         }
 
         virtual size_t maxProgress(int){
+            initialize();
             return cumulativeEnd0RowSizes.at(cumulativeEnd0RowSizes.size()-1);
         }
 
         virtual size_t requestPartialProgress(int whichEnd, size_t requestedProgress){
+            assert(!dirty); // computed by maxProgress on the client thread
             std::vector<size_t> &arr = whichEnd == 0 ? cumulativeEnd0RowSizes : cumulativeEnd1RowSizes;
             if (arr.empty())
                 return 0;
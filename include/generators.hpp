@@ -0,0 +1,175 @@
+#ifndef GENERATORS_HPP_
+#define GENERATORS_HPP_
+
+#include "network.hpp"
+#include <cmath>
+
+namespace llrt{
+
+    /**
+       A parameter of a generator operation: one value for every node,
+       or a value for each node. A vector of values is read while the
+       operation runs, so it must outlive a nonblocking operation.
+     */
+    struct GeneratorParam{
+        float value = 0;
+        const std::vector<float> *perNode = nullptr;
+
+        GeneratorParam(float value) : value(value){}
+        GeneratorParam(double value) : value(value){}
+        GeneratorParam(const std::vector<float> &perNode) : perNode(&perNode){}
+
+        float operator[](size_t node) const{
+            return perNode == nullptr ? value : (*perNode)[node];
+        }
+    };
+
+    namespace generators{
+        /// nodes whose random numbers are generated together
+        const size_t blockNodes = 64;
+
+        /**
+           The kernel of a generator operation. It fills a block of
+           values at a time, with numbers that depend only on the
+           block, so that they don't depend on how the operation is
+           divided into job chunks, and writes them to the nodes one
+           by one as ProcessLink visits them.
+
+           @tparam Fill void(CounterRNG &r, size_t first, size_t count, Value *out)
+           @tparam Write void(Node &, Value)
+         */
+        template<typename Node, typename Value, typename Fill, typename Write>
+        struct BlockKernel{
+            std::vector<Node> &v;
+            CounterRNG r;
+            Fill fill;
+            Write write;
+            Value block[blockNodes];
+            size_t first = 0;
+            bool filled = false;
+
+            inline void operator()(const size_t near, const size_t, const size_t, const size_t, const size_t){
+                if (!filled || near < first || near >= first + blockNodes){
+                    first = near / blockNodes * blockNodes;
+                    r.restart(0, first / blockNodes);
+                    fill(r, first, std::min(blockNodes, v.size() - first), block);
+                    filled = true;
+                }
+                write(v[near], block[near - first]);
+            }
+        };
+
+        template<typename TL, typename Node, typename Value, typename Fill, typename Write, typename C>
+        size_t queue(Component<TL> &c, Fill fill, Write write, JobOptions<C> opts){
+            if (!std::holds_alternative<std::vector<Node> >(c.data.values))
+                return 0;
+            c.data.written = true;
+            // workers must not share the words std::vector<bool> packs
+            // bits into, which blocks of nodes are whole multiples of
+            static_assert(blockNodes % 64 == 0);
+            if constexpr(std::is_same_v<Node, bool>)
+                opts.progressAlign = std::max(opts.progressAlign, blockNodes);
+            Link<TL> &link = *c.selfLink;
+            using Kernel = BlockKernel<Node, Value, Fill, Write>;
+            Kernel pk{std::get<std::vector<Node> >(c.data.values), kernelRNG<CounterRNG>(link, 0), fill, write};
+            auto li = [&link](Kernel &pk, size_t start, size_t end, IsaLevel level){
+                ProcessLink(link, 0, pk, start, end, level
+#ifdef DEBUG_OP_LEVEL
+                            , "generator"
+#endif
+                    );
+            };
+            return QueueProcessLink(link, 0, pk, pk, pk, li, opts);
+        }
+
+        /// spikes with probability p[node]: a number below p * 2^32
+        struct PoissonFill{
+            GeneratorParam p;
+            void operator()(CounterRNG &r, size_t first, size_t count, uint8_t *out){
+                uint32_t bits[blockNodes];
+                r.generate(bits, count);
+                for(size_t i=0; i < count; i++){
+                    double threshold = std::min(1.0, std::max(0.0, double(p[first + i]))) * 4294967296.0;
+                    out[i] = bits[i] < threshold;
+                }
+            }
+        };
+
+        /// normal numbers by the Box-Muller transform, two from each pair of uniform numbers
+        struct NoiseFill{
+            GeneratorParam mean, stddev;
+            void operator()(CounterRNG &r, size_t first, size_t count, float *out){
+                uint32_t bits[blockNodes];
+                r.generate(bits, blockNodes);
+                float z[blockNodes];
+                for(size_t i=0; i < blockNodes; i += 2){
+                    float u1 = ((bits[i] >> 8) + 1) * (1.0f / 16777216.0f); // (0, 1], so the log is finite
+                    float u2 = (bits[i + 1] >> 8) * (1.0f / 16777216.0f);
+                    float radius = std::sqrt(-2.0f * std::log(u1)), angle = 6.2831853f * u2;
+                    z[i] = radius * std::cos(angle);
+                    z[i + 1] = radius * std::sin(angle);
+                }
+                for(size_t i=0; i < count; i++)
+                    out[i] = mean[first + i] + stddev[first + i] * z[i];
+            }
+        };
+    }
+
+    /**
+       Set each node of a component of bools to true with probability
+       p, such as a firing rate times the time step, and to false
+       otherwise: a step of Poisson spike trains. The random numbers
+       come from a CounterRNG, in blocks of nodes, so they are the
+       same however the operation is scheduled (see Network::seed).
+       Runs like any other operation on the component, with the same
+       JobOptions. Does nothing if the component's values are not
+       bools.
+
+       GeneratePoisson(input, rates, ParallelNonBlocking);
+
+       @param p the probability of a spike, for all nodes or for each
+     */
+    template<typename TL, typename C=NOpT3>
+    size_t GeneratePoisson(Component<TL> &c, GeneratorParam p, JobOptions<C> opts=NullJobOptions){
+        return generators::queue<TL, bool, uint8_t>(c, generators::PoissonFill{p}, [](auto &&N, uint8_t spike){
+            N = spike;
+        }, opts);
+    }
+
+    /**
+       Like GeneratePoisson, for a bool field of the nodes:
+
+       GeneratePoisson(input, &InputNeuron::spike, 0.02);
+     */
+    template<typename TL, typename Node, typename C=NOpT3>
+    size_t GeneratePoisson(Component<TL> &c, bool Node::*field, GeneratorParam p, JobOptions<C> opts=NullJobOptions){
+        return generators::queue<TL, Node, uint8_t>(c, generators::PoissonFill{p}, [field](Node &N, uint8_t spike){
+            N.*field = spike;
+        }, opts);
+    }
+
+    /**
+       Set each node of a component of floats to a normally
+       distributed number, such as a noise current. Scheduled and
+       seeded like GeneratePoisson.
+
+       @param mean the mean, for all nodes or for each
+       @param stddev the standard deviation, for all nodes or for each
+     */
+    template<typename TL, typename C=NOpT3>
+    size_t GenerateNoise(Component<TL> &c, GeneratorParam mean, GeneratorParam stddev, JobOptions<C> opts=NullJobOptions){
+        return generators::queue<TL, float, float>(c, generators::NoiseFill{mean, stddev}, [](float &N, float x){
+            N = x;
+        }, opts);
+    }
+
+    /// like GenerateNoise, for a float field of the nodes
+    template<typename TL, typename Node, typename C=NOpT3>
+    size_t GenerateNoise(Component<TL> &c, float Node::*field, GeneratorParam mean, GeneratorParam stddev, JobOptions<C> opts=NullJobOptions){
+        return generators::queue<TL, Node, float>(c, generators::NoiseFill{mean, stddev}, [field](Node &N, float x){
+            N.*field = x;
+        }, opts);
+    }
+}
+
+#endif
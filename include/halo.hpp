@@ -0,0 +1,163 @@
+#ifndef HALO_HPP_
+#define HALO_HPP_
+
+#include "checkpoint.hpp"
+#include <map>
+#include <algorithm>
+#include <cstring>
+
+namespace llrt{
+
+    /**
+       A tensor that links read across a partition boundary, when
+       each component of a Network is owned by one rank (process): the
+       data of a component, or one end of a link, where the link joins
+       components of different ranks. The owner writes it, and the
+       readers need a copy (a halo copy) of it.
+     */
+    template<typename TType>
+    struct HaloTensor{
+        Tensor<TType> *t;
+        size_t owner;
+        /// the other ranks that read it, in increasing order
+        std::vector<size_t> readers;
+    };
+
+    /// the number of ranks that own the components, given the owner of each
+    inline size_t numRanksOf(const std::vector<size_t> &owners){
+        size_t n = 0;
+        for(size_t o : owners)
+            n = std::max(n, o + 1);
+        return n;
+    }
+
+    /**
+       The halo of a Network partitioned between ranks, in the same
+       order for every rank that builds the same Network. Throws
+       std::runtime_error if owners doesn't have one entry per
+       component.
+
+       @param owners the rank that owns each component, in the order
+       of Network::components
+     */
+    template<typename TL>
+    std::vector<HaloTensor<typename TLTypes<TL>::TType> > haloTensors(Network<TL> &net, const std::vector<size_t> &owners){
+        using TType = TLTypes<TL>::TType;
+        if (owners.size() != net.components.size())
+            throw std::runtime_error("Partition of " + std::to_string(net.components.size()) + " components has " + std::to_string(owners.size()) + " owners");
+        std::map<Component<TL> *, size_t> owner;
+        for(size_t i=0; i < owners.size(); i++)
+            owner[net.components[i].get()] = owners[i];
+
+        std::vector<HaloTensor<TType> > halo;
+        std::map<Tensor<TType> *, size_t> index;
+        auto add = [&](Tensor<TType> &t, size_t ownerRank, size_t reader){
+            if (t.noData)
+                return;
+            auto it = index.find(&t);
+            if (it == index.end()){
+                it = index.emplace(&t, halo.size()).first;
+                halo.push_back({&t, ownerRank, {}});
+            }
+            std::vector<size_t> &r = halo[it->second].readers;
+            auto pos = std::lower_bound(r.begin(), r.end(), reader);
+            if (pos == r.end() || *pos != reader)
+                r.insert(pos, reader);
+        };
+        // each end of a link between ranks, and its component, are
+        // read by the rank of the other end
+        for(Link<TL> *l : checkpointLinks(net)){
+            size_t o0 = owner.at(&l->ends[0].c), o1 = owner.at(&l->ends[1].c);
+            if (o0 == o1)
+                continue;
+            add(l->ends[0].c.data, o0, o1);
+            add(l->ends[0].data, o0, o1);
+            add(l->ends[1].c.data, o1, o0);
+            add(l->ends[1].data, o1, o0);
+        }
+        return halo;
+    }
+
+    /// bytes of a tensor's values; throws std::runtime_error if they are not trivially copyable
+    template<typename TType>
+    size_t haloTensorBytes(Tensor<TType> &t){
+        size_t n = t.numValues();
+        return std::visit([n](auto &vec){
+            using T = std::decay_t<decltype(vec)>::value_type;
+            if constexpr(std::is_same_v<T, bool>)
+                return n;
+            else if constexpr(std::is_trivially_copyable_v<T>)
+                return n * sizeof(T);
+            else{
+                throw std::runtime_error(std::string() + "Can't exchange values of type " + typeid(T).name() + ", which is not trivially copyable");
+                return size_t(0);
+            }
+        }, t.values);
+    }
+
+    /**
+       copy a tensor's values to haloTensorBytes(t) bytes at dst;
+       bools take a byte each. Values that were never allocated are
+       written as T(), without allocating them.
+     */
+    template<typename TType>
+    void writeHaloTensor(Tensor<TType> &t, char *dst){
+        bool unallocated = t.unallocated();
+        size_t n = t.numValues();
+        std::visit([dst, unallocated, n](auto &vec){
+            using T = std::decay_t<decltype(vec)>::value_type;
+            if constexpr(std::is_same_v<T, bool>){
+                if (unallocated)
+                    std::fill(dst, dst + n, 0);
+                else
+                    std::copy(vec.begin(), vec.end(), dst);
+            }
+            else if constexpr(std::is_trivially_copyable_v<T>){
+                if (unallocated){
+                    const T value = T();
+                    for(size_t i=0; i < n; i++)
+                        std::memcpy(dst + i * sizeof(T), &value, sizeof(T));
+                }
+                else
+                    std::memcpy(dst, vec.data(), vec.size() * sizeof(T));
+            }
+        }, t.values);
+    }
+
+    /**
+       the reverse of writeHaloTensor. A tensor whose values were
+       never allocated is only allocated if some value isn't T().
+     */
+    template<typename TType>
+    void readHaloTensor(Tensor<TType> &t, const char *src){
+        if (t.unallocated()){
+            size_t n = t.numValues();
+            bool allDefault = std::visit([src, n](auto &vec){
+                using T = std::decay_t<decltype(vec)>::value_type;
+                if constexpr(std::is_same_v<T, bool>)
+                    return std::all_of(src, src + n, [](char b){return b == 0;});
+                else if constexpr(std::is_trivially_copyable_v<T>){
+                    const T value = T();
+                    for(size_t i=0; i < n; i++)
+                        if (std::memcmp(src + i * sizeof(T), &value, sizeof(T)) != 0)
+                            return false;
+                    return true;
+                }
+                else
+                    return false;
+            }, t.values);
+            if (allDefault)
+                return;
+            t.materialize();
+        }
+        std::visit([src](auto &vec){
+            using T = std::decay_t<decltype(vec)>::value_type;
+            if constexpr(std::is_same_v<T, bool>)
+                std::copy(src, src + vec.size(), vec.begin());
+            else if constexpr(std::is_trivially_copyable_v<T>)
+                std::memcpy(vec.data(), src, vec.size() * sizeof(T));
+        }, t.values);
+    }
+}
+
+#endif
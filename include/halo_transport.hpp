@@ -0,0 +1,145 @@
+#ifndef HALO_TRANSPORT_HPP_
+#define HALO_TRANSPORT_HPP_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <cstdint>
+
+namespace llrt{
+
+    /**
+       Carries messages between the ranks (processes) of a
+       DistributedPartition. Implement it to use another network
+       stack; TcpTransport is the default.
+     */
+    struct HaloTransport{
+        virtual ~HaloTransport(){}
+
+        virtual size_t rank() const = 0;
+
+        virtual size_t numRanks() const = 0;
+
+        /**
+           Send a message to another rank. May return before the
+           message is delivered, but messages to the same rank arrive
+           in order. Must not wait for that rank to receive.
+         */
+        virtual void send(size_t to, std::string msg) = 0;
+
+        /**
+           Wait for the next message from another rank. Throws
+           std::runtime_error if the connection is lost, or if no
+           message arrives in time.
+         */
+        virtual std::string receive(size_t from) = 0;
+    };
+
+    /**
+       A HaloTransport over TCP, with a connection between each pair of
+       ranks, and a thread for each connection's sends and one for its
+       receives, so that sending never waits for the receiver to ask
+       for the message.
+
+       Each rank first creates its TcpTransport, which starts
+       listening, then calls connect() with the addresses of all the
+       ranks:
+
+       TcpTransport transport(rank, 4, "0.0.0.0:7000");
+       transport.connect({"host0:7000", "host1:7000", "host2:7000", "host3:7000"});
+
+       Messages are a u64 length in native byte order followed by the
+       bytes, so all ranks must have the same byte order.
+     */
+    class TcpTransport : public HaloTransport{
+    public:
+        struct Options{
+            /// how long receive() waits for a message; zero waits for ever
+            std::chrono::milliseconds receiveTimeout{60000};
+            /// the longest message accepted; a longer length prefix is
+            /// taken as a broken connection, rather than allocated
+            uint64_t maxMessageBytes = uint64_t(1) << 30;
+        };
+
+        /**
+           Start listening for the ranks after this one. Throws
+           std::runtime_error if the address can't be bound.
+
+           @param listenAddress "host:port"; port 0 picks a free port,
+           which port() returns
+         */
+        TcpTransport(size_t rank, size_t numRanks, const std::string &listenAddress);
+        TcpTransport(size_t rank, size_t numRanks, const std::string &listenAddress, const Options &opts);
+
+        /// closes the connections, after sending the messages already given to send()
+        ~TcpTransport();
+
+        TcpTransport(const TcpTransport &) = delete;
+        TcpTransport &operator=(const TcpTransport &) = delete;
+
+        /// the port this rank listens on
+        int port() const{
+            return listenPort;
+        }
+
+        /**
+           Connect to every other rank: accept connections from the
+           ranks after this one, and connect to the ones before it,
+           retrying until they listen. Throws std::runtime_error after
+           the timeout.
+
+           @param addresses "host:port" of each rank, in rank order
+         */
+        void connect(const std::vector<std::string> &addresses, std::chrono::milliseconds timeout = std::chrono::milliseconds(60000));
+
+        virtual size_t rank() const{
+            return myRank;
+        }
+
+        virtual size_t numRanks() const{
+            return n;
+        }
+
+        virtual void send(size_t to, std::string msg);
+
+        virtual std::string receive(size_t from);
+
+        /// bytes of messages sent so far, not counting the length prefixes
+        size_t bytesSent() const;
+
+    private:
+        struct Peer{
+            int fd = -1;
+            std::thread sender, receiver;
+            std::mutex mtx;
+            std::condition_variable cv;
+            std::deque<std::string> outgoing, incoming;
+            bool closing = false;
+            /// the other rank has closed the connection
+            bool eof = false;
+            bool stopReceiving = false;
+            std::exception_ptr error;
+        };
+
+        size_t myRank, n;
+        Options opts;
+        int listenFd = -1;
+        int listenPort = 0;
+        std::vector<std::unique_ptr<Peer> > peers;
+        mutable std::mutex statsMtx;
+        size_t sent = 0;
+
+        Peer &peer(size_t r);
+        void startPeer(size_t r, int fd);
+        void sendLoop(Peer &p);
+        void receiveLoop(Peer &p);
+    };
+}
+
+#endif
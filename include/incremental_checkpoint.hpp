@@ -0,0 +1,344 @@
+#ifndef INCREMENTAL_CHECKPOINT_HPP_
+#define INCREMENTAL_CHECKPOINT_HPP_
+
+#include "checkpoint.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <cstdio>
+
+namespace llrt{
+
+    /**
+       The files of a chain of checkpoints: a full checkpoint (the
+       base), followed by deltas that each apply to the one before.
+       Stored as a small text file in the same directory as the
+       checkpoints:
+
+         llrt-checkpoint-chain 1
+         base <sequence> <filename>
+         delta <sequence> <filename>
+         ...
+     */
+    struct CheckpointChain{
+        struct Entry{
+            uint64_t sequence;
+            /// relative to the directory of the chain file
+            std::string filename;
+        };
+        /// the base, then the deltas in order
+        std::vector<Entry> entries;
+
+        /**
+           Write the chain file, replacing the old one only once the
+           new one is complete, so that a crash leaves one or the
+           other.
+         */
+        void save(const std::string &filename) const;
+
+        /**
+           Throws std::runtime_error if the file can't be read or is
+           not a chain file
+         */
+        static CheckpointChain load(const std::string &filename);
+    };
+
+    /**
+       Runs one write at a time on a background thread, so that
+       writing a checkpoint overlaps with computation.
+     */
+    class CheckpointWriterThread{
+    public:
+        CheckpointWriterThread();
+        /// waits for the current write to finish
+        ~CheckpointWriterThread();
+
+        /**
+           Wait for the previous write to finish, then start this one.
+           If the previous write threw, rethrow its exception instead.
+         */
+        void submit(std::function<void()> write);
+
+        /**
+           Wait for the current write to finish. If it threw, rethrow
+           its exception.
+         */
+        void wait();
+
+    private:
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::function<void()> pending;
+        bool busy = false;
+        bool stop = false;
+        std::exception_ptr error;
+        std::thread thread;
+
+        void run();
+        void waitIdle(std::unique_lock<std::mutex> &lock);
+    };
+
+    /// a hash of a chunk of a Tensor, to tell whether it changed between checkpoints
+    uint64_t checkpointChunkHash(const char *data, size_t bytes);
+
+    /**
+       Writes a chain of checkpoints of a Network: every so often a
+       full checkpoint, and in between, deltas holding only the chunks
+       of each Tensor that changed since the previous checkpoint.
+
+       Each call to checkpoint() copies the changed chunks aside while
+       the Network is idle, then returns, and the file is written on a
+       background thread while the Network carries on. A Tensor is
+       only examined if an operation's kernel took its values by
+       non-const reference or a link type moved or resized them (see
+       Tensor::written), or its size in bytes changed, unless
+       Options::checkAll is set. Within those Tensors, a chunk
+       is saved if its hash differs from the hash at the previous
+       checkpoint.
+
+       The files are named <prefix>.<sequence>.ckpt for full
+       checkpoints and <prefix>.<sequence>.delta for deltas, and
+       <prefix>.chain lists the current chain, for loadCheckpointChain.
+       The chain file is only updated once a checkpoint has been
+       completely written.
+     */
+    template<typename TL>
+    class IncrementalCheckpointer{
+    public:
+        struct Options{
+            /// the granularity of change tracking
+            size_t chunkBytes = 1 << 20;
+            /// every fullEvery checkpoints, write a full one instead of a delta
+            size_t fullEvery = 16;
+            /// examine every Tensor, rather than only those written by operations
+            bool checkAll = false;
+            /// don't delete the files of a chain when a new full checkpoint replaces it
+            bool keepOldChains = false;
+        };
+
+        IncrementalCheckpointer(Network<TL> &net, const std::string &prefix);
+        IncrementalCheckpointer(Network<TL> &net, const std::string &prefix, const Options &opts);
+
+        /**
+           Start writing a checkpoint of the Network, after waiting for
+           any scheduled operations and for the previous checkpoint to
+           finish. Throws std::runtime_error if the previous checkpoint
+           failed to be written (in which case this one is not started,
+           and the next will be a full checkpoint).
+
+           @return the name of the file being written
+         */
+        std::string checkpoint();
+
+        /**
+           Wait for the current checkpoint to be written. Throws
+           std::runtime_error if it failed.
+         */
+        void wait();
+
+        const std::string &chainFilename() const{
+            return chainFile;
+        }
+
+    private:
+        Network<TL> &net;
+        std::string prefix;
+        std::string chainFile;
+        Options opts;
+
+        uint64_t nextSequence = 0;
+        size_t sinceFull = 0;
+        /// for each Tensor in checkpoint order, the hash of each chunk
+        /// at the last checkpoint; empty until the first full checkpoint
+        std::vector<std::vector<uint64_t> > hashes;
+        /// for each Tensor, its bytes at the last checkpoint
+        std::vector<uint64_t> tensorBytes;
+        std::vector<uint64_t> linkStateHashes;
+
+        /// only used by the writer thread after construction
+        CheckpointChain chain;
+
+        CheckpointWriterThread writer;
+    };
+
+    /**
+       Restore a Network from the chain of checkpoints listed in a
+       chain file written by an IncrementalCheckpointer. The Network
+       must have the structure it had when the checkpoints were
+       written, as for loadCheckpoint. Throws std::runtime_error if
+       any file is missing, doesn't match the Network, or is out of
+       sequence; the Network may then be partly restored.
+     */
+    template<typename TL>
+    void loadCheckpointChain(Network<TL> &net, const std::string &chainFilename);
+
+    /// the path of a file in a chain, given the chain's file name
+    std::string checkpointChainPath(const std::string &chainFilename, const std::string &filename);
+
+    template<typename TL>
+    IncrementalCheckpointer<TL>::IncrementalCheckpointer(Network<TL> &net, const std::string &prefix) :
+        IncrementalCheckpointer(net, prefix, Options()){}
+
+    template<typename TL>
+    IncrementalCheckpointer<TL>::IncrementalCheckpointer(Network<TL> &net, const std::string &prefix, const Options &opts) :
+        net(net), prefix(prefix), chainFile(prefix + ".chain"), opts(opts){
+        if (opts.chunkBytes == 0)
+            throw std::runtime_error("IncrementalCheckpointer needs a chunk size of at least 1 byte");
+        // carry on the numbering of an existing chain, so as not to
+        // overwrite its files before the new one is complete
+        try{
+            chain = CheckpointChain::load(chainFile);
+            if (!chain.entries.empty())
+                nextSequence = chain.entries.back().sequence + 1;
+        }
+        catch(std::runtime_error &){
+            chain = CheckpointChain();
+        }
+    }
+
+    template<typename TL>
+    void IncrementalCheckpointer<TL>::wait(){
+        try{
+            writer.wait();
+        }
+        catch(...){
+            hashes.clear(); // the chain is broken, so start a new one
+            throw;
+        }
+    }
+
+    template<typename TL>
+    std::string IncrementalCheckpointer<TL>::checkpoint(){
+        net.finishBatches();
+        wait();
+
+        auto tensors = checkpointTensors(net);
+        std::vector<Link<TL> *> links = checkpointLinks(net);
+        bool full = hashes.empty() || sinceFull + 1 >= opts.fullEvery;
+        if (!full && (hashes.size() != tensors.size() || linkStateHashes.size() != links.size()))
+            throw std::runtime_error("IncrementalCheckpointer: the network's structure changed since the last checkpoint");
+        if (full){
+            hashes.assign(tensors.size(), {});
+            tensorBytes.assign(tensors.size(), 0);
+            linkStateHashes.assign(links.size(), 0);
+        }
+
+        struct Write{
+            CheckpointHeader header;
+            std::optional<CheckpointDelta> delta;
+            std::vector<std::string> buffers;
+        };
+        auto w = std::make_shared<Write>();
+        w->header = checkpointHeader(net);
+        uint64_t sequence = nextSequence;
+        if (!full){
+            w->delta = CheckpointDelta();
+            w->delta->sequence = sequence;
+            w->delta->previousSequence = sequence - 1;
+            w->delta->chunkBytes = opts.chunkBytes;
+            w->delta->chunks.resize(tensors.size());
+            w->delta->linkStateChanged.resize(links.size());
+        }
+
+        // copy aside the chunks to be written
+        uint64_t offset = 0;
+        std::deque<std::string> scratch;
+        for(size_t i=0; i < tensors.size(); i++){
+            CheckpointTensor &rec = w->header.tensor(i);
+            if (rec.typeTag < 0)
+                continue;
+            CheckpointPayload raw = checkpointTensorBytes(*tensors[i], scratch);
+            std::vector<uint64_t> &h = hashes[i];
+            size_t nChunks = (raw.bytes + opts.chunkBytes - 1) / opts.chunkBytes;
+            std::string buf;
+            if (full || opts.checkAll || tensors[i]->written || raw.bytes != tensorBytes[i]){
+                tensorBytes[i] = raw.bytes;
+                if (full)
+                    buf.assign(raw.data, raw.bytes);
+                size_t oldChunks = h.size();
+                h.resize(nChunks);
+                for(size_t c=0; c < nChunks; c++){
+                    size_t start = c * opts.chunkBytes;
+                    size_t bytes = std::min(opts.chunkBytes, raw.bytes - start);
+                    uint64_t hash = checkpointChunkHash(raw.data + start, bytes);
+                    if (!full && (c >= oldChunks || hash != h[c])){
+                        buf.append(raw.data + start, bytes);
+                        w->delta->chunks[i].push_back(c);
+                    }
+                    h[c] = hash;
+                }
+            }
+            scratch.clear();
+            rec.offset = offset;
+            rec.bytes = buf.size();
+            offset = checkpointPayloadOffset(offset, rec.bytes);
+            w->buffers.push_back(std::move(buf));
+        }
+        for(size_t i=0; i < links.size(); i++){
+            std::string state;
+            std::visit([&](auto &t){t.saveState(state);}, links[i]->type);
+            uint64_t hash = checkpointChunkHash(state.data(), state.size());
+            if (!full){
+                if (hash == linkStateHashes[i])
+                    continue;
+                w->delta->linkStateChanged[i] = true;
+            }
+            linkStateHashes[i] = hash;
+            if (state.empty())
+                continue;
+            CheckpointLink &rec = w->header.links[i];
+            rec.stateOffset = offset;
+            rec.stateBytes = state.size();
+            offset = checkpointPayloadOffset(offset, rec.stateBytes);
+            w->buffers.push_back(std::move(state));
+        }
+        for(auto *t : tensors)
+            t->written = false;
+
+        std::string filename = prefix + "." + std::to_string(sequence) + (full ? ".ckpt" : ".delta");
+        nextSequence++;
+        sinceFull = full ? 0 : sinceFull + 1;
+
+        writer.submit([this, w, filename, sequence, full](){
+            std::vector<CheckpointPayload> payloads;
+            for(const std::string &b : w->buffers)
+                payloads.push_back({b.data(), b.size()});
+            writeCheckpointFile(filename, w->header, payloads, w->delta ? &*w->delta : nullptr);
+
+            CheckpointChain old = chain;
+            if (full)
+                chain.entries.clear();
+            chain.entries.push_back({sequence, std::filesystem::path(filename).filename().string()});
+            chain.save(chainFile);
+            if (full && !opts.keepOldChains)
+                for(const CheckpointChain::Entry &e : old.entries)
+                    std::remove(checkpointChainPath(chainFile, e.filename).c_str());
+        });
+        return filename;
+    }
+
+    template<typename TL>
+    void loadCheckpointChain(Network<TL> &net, const std::string &chainFilename){
+        net.finishBatches();
+        CheckpointChain chain = CheckpointChain::load(chainFilename);
+        if (chain.entries.empty())
+            throw std::runtime_error(chainFilename + " lists no checkpoints");
+        for(size_t i=0; i < chain.entries.size(); i++){
+            std::string filename = checkpointChainPath(chainFilename, chain.entries[i].filename);
+            MappedCheckpoint ckpt(filename);
+            if (i == 0 && ckpt.delta)
+                throw std::runtime_error(filename + " should be a full checkpoint, but is a delta");
+            if (i > 0){
+                if (!ckpt.delta)
+                    throw std::runtime_error(filename + " should be a delta, but is a full checkpoint");
+                if (ckpt.delta->sequence != chain.entries[i].sequence || ckpt.delta->previousSequence != chain.entries[i-1].sequence)
+                    throw std::runtime_error(filename + " is out of sequence in " + chainFilename);
+            }
+            restoreCheckpoint(net, ckpt);
+        }
+    }
+}
+
+#endif
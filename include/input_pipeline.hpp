@@ -0,0 +1,276 @@
+#ifndef INPUT_PIPELINE_HPP_
+#define INPUT_PIPELINE_HPP_
+
+#include "network.hpp"
+#include "mapped_file.hpp"
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <cstring>
+
+namespace llrt{
+
+    /**
+       A dataset of equally sized frames of input values, such as
+       images, read as floats.
+     */
+    struct InputSource{
+        virtual ~InputSource(){}
+
+        /// number of values in each frame
+        virtual size_t frameSize() const = 0;
+
+        virtual size_t numFrames() const = 0;
+
+        /**
+           Convert frame number i to floats in dst, which has room for
+           frameSize() values. Called from a background thread.
+         */
+        virtual void read(size_t i, float *dst) = 0;
+    };
+
+    /**
+       A memory-mapped file of raw values of a numeric type, in native
+       byte order, with no header.
+
+       @tparam T the type of the values in the file
+     */
+    template<typename T>
+    class RawInputSource : public InputSource{
+    public:
+        /**
+           @param frameSize the number of values in each frame
+         */
+        RawInputSource(const std::string &filename, size_t frameSize) : file(filename), size(frameSize){
+            if (frameSize == 0)
+                throw std::runtime_error("RawInputSource needs a frame size of at least 1");
+        }
+
+        virtual size_t frameSize() const{
+            return size;
+        }
+
+        virtual size_t numFrames() const{
+            return file.size() / (size * sizeof(T));
+        }
+
+        virtual void read(size_t i, float *dst){
+            const char *src = file.data() + i * size * sizeof(T);
+            // start reading the next frame while this one is converted
+            file.willNeed((i + 1) * size * sizeof(T), size * sizeof(T));
+            for(size_t j=0; j < size; j++){
+                T v;
+                std::memcpy(&v, src + j * sizeof(T), sizeof(T));
+                dst[j] = static_cast<float>(v);
+            }
+        }
+
+    private:
+        MappedFile file;
+        size_t size;
+    };
+
+    /**
+       A memory-mapped file in the IDX format of the MNIST dataset: a
+       big-endian header giving the value type and dimensions, then
+       the values. The first dimension counts the frames.
+     */
+    class IdxInputSource : public InputSource{
+    public:
+        IdxInputSource(const std::string &filename);
+
+        virtual size_t frameSize() const{
+            return size;
+        }
+
+        virtual size_t numFrames() const{
+            return frames;
+        }
+
+        virtual void read(size_t i, float *dst);
+
+        /// dimensions of one frame
+        const std::vector<size_t> &frameDimensions() const{
+            return dims;
+        }
+
+    private:
+        MappedFile file;
+        unsigned char typeCode;
+        size_t valueBytes;
+        size_t headerBytes;
+        size_t frames = 0, size = 1;
+        std::vector<size_t> dims;
+    };
+
+    /**
+       A memory-mapped NumPy .npy file holding a C-ordered array of
+       integers or floats. The first dimension counts the frames.
+     */
+    class NpyInputSource : public InputSource{
+    public:
+        NpyInputSource(const std::string &filename);
+
+        virtual size_t frameSize() const{
+            return size;
+        }
+
+        virtual size_t numFrames() const{
+            return frames;
+        }
+
+        virtual void read(size_t i, float *dst);
+
+        /// dimensions of one frame
+        const std::vector<size_t> &frameDimensions() const{
+            return dims;
+        }
+
+    private:
+        MappedFile file;
+        char kind; ///< 'f', 'i' or 'u', as in the dtype
+        size_t valueBytes;
+        size_t dataOffset;
+        size_t frames = 0, size = 1;
+        std::vector<size_t> dims;
+    };
+
+    /**
+       Reads frames from an InputSource on a background thread,
+       normalizes them, and keeps them in a ring of preallocated
+       buffers, so that loading and preprocessing the input overlaps
+       with the simulation.
+
+       Each call to step() waits for the next frame (normally already
+       there), passes it to a function that submits an operation
+       copying it into the network, and records the batch number of
+       that operation. The frame's buffer is reused once that batch
+       has finished. For example, in place of the input loop of
+       examples/ex3_nonblocking.cpp:
+
+       InputPipeline inputs(std::make_unique<NpyInputSource>("train.npy"));
+       ...
+       inputs.step(net, [&](const float *frame){
+           return ProcessCmp_NNi(inputCmp, [=](IFNeuron &N, const size_t Ni){
+               N.v[_1] += frame[Ni];
+           }, ParallelNonBlocking | KernelName("Input"));
+       });
+     */
+    class InputPipeline{
+    public:
+        struct Options{
+            /// number of frame buffers, including the ones in use by the network
+            size_t ringSize = 4;
+            /// start over from the first frame after the last
+            bool loop = true;
+            /// the first frame to read
+            size_t start = 0;
+            /// each value x becomes x * scale + offset
+            float scale = 1;
+            float offset = 0;
+            /**
+               if set, called on each frame after scaling, on the
+               background thread, with the frame, its size, and the
+               frame number in the source
+             */
+            std::function<void(float *, size_t, size_t)> preprocess;
+        };
+
+        InputPipeline(std::unique_ptr<InputSource> source);
+        InputPipeline(std::unique_ptr<InputSource> source, const Options &opts);
+        ~InputPipeline();
+
+        InputPipeline(const InputPipeline &) = delete;
+        InputPipeline &operator=(const InputPipeline &) = delete;
+
+        size_t frameSize() const{
+            return source->frameSize();
+        }
+
+        InputSource &getSource(){
+            return *source;
+        }
+
+        /**
+           Submit the next frame to the network.
+
+           @param submit is called with the frame, and must submit an
+           operation that reads it, and return that operation's batch
+           number (the return value of the Process* function).
+           The frame stays valid until that batch has finished.
+
+           @return the batch number returned by submit, or 0 without
+           calling submit if the source has run out of frames
+           (Options::loop is false), after which exhausted() is true.
+
+           Throws the exception thrown by the source or the
+           preprocessing function, if any.
+         */
+        template<typename TL, typename Submit>
+        size_t step(Network<TL> &net, Submit &&submit){
+            // let the loader reuse the buffers of finished operations
+            // before we maybe wait for it
+            freeFinished([&net](size_t batch){return net.batchFinished(batch);});
+            if (slotInUse(next))
+                net.finishBatch(slotBatch(next));
+            freeFinished([&net](size_t batch){return net.batchFinished(batch);});
+            const float *frame = takeFrame();
+            if (frame == nullptr)
+                return 0;
+            size_t batch = submit(frame);
+            setBatch(batch);
+            return batch;
+        }
+
+        /// true once step() has returned every frame, if Options::loop is false
+        bool exhausted();
+
+        /// the number of the frame most recently returned by step(), in the source
+        size_t frameNumber();
+
+    private:
+        enum SlotState{Free, Loading, Ready, InUse};
+        struct Slot{
+            std::vector<float> values;
+            SlotState state = Free;
+            size_t frameNumber = 0;
+            size_t batch = 0;
+        };
+
+        std::unique_ptr<InputSource> source;
+        Options opts;
+        std::vector<Slot> slots;
+        /// slot that step() will take next
+        size_t next = 0;
+        /// slot that the loader will fill next
+        size_t loadSlot = 0;
+        size_t lastFrameNumber = 0;
+        bool sourceDone = false;
+        bool done = false;
+        bool stop = false;
+        std::exception_ptr error;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::thread loader;
+
+        void load();
+        void freeFinished(std::function<bool(size_t)> finished);
+        bool slotInUse(size_t i);
+        size_t slotBatch(size_t i);
+        /**
+           wait for the next slot to be loaded, and mark it in use;
+           nullptr if there are no more frames
+         */
+        const float *takeFrame();
+        /// record the batch reading the slot last taken
+        void setBatch(size_t batch);
+    };
+}
+
+#endif
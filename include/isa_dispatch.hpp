@@ -0,0 +1,97 @@
+#ifndef ISA_DISPATCH_HPP_
+#define ISA_DISPATCH_HPP_
+
+#include <cstddef>
+#include <string>
+
+// Link iterators are built for several x86-64 instruction set levels,
+// unless LLRT_NO_MULTIVERSION is defined (cmake -DNOMULTIVERSION=1)
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(LLRT_NO_MULTIVERSION)
+#define LLRT_MULTIVERSION
+#endif
+
+namespace llrt{
+
+    /**
+       The instruction set levels that link operations are built
+       for. FMA is left out of the AVX2 level, and the AVX-512 level
+       (which implies FMA) is compiled with fp-contract=off, so that a
+       multiply and an add are never contracted into one instruction
+       with a different rounding: every level gives the same bits.
+     */
+    enum class IsaLevel{
+        Baseline = 0, ///< what the library was compiled for
+        AVX2 = 1,     ///< AVX2, BMI1/2 and POPCNT (Haswell and later)
+        AVX512 = 2    ///< AVX2 plus AVX-512 F, VL, BW, DQ and CD (Skylake-SP and later)
+    };
+
+    std::string isaLevelName(IsaLevel level);
+
+    /// the highest level this CPU and OS support, detected once
+    IsaLevel supportedIsaLevel();
+
+    /**
+       The level link operations run at: supportedIsaLevel(), or the
+       level named by the environment variable LLRT_ISA ("baseline",
+       "avx2" or "avx512") when the process started, if that is lower.
+     */
+    IsaLevel isaLevel();
+
+    /**
+       Run link operations at the given level from now on, such as to
+       compare levels. Throws std::runtime_error if the CPU doesn't
+       support it.
+     */
+    void setIsaLevel(IsaLevel level);
+
+#ifdef LLRT_MULTIVERSION
+// g++ contracts when it compiles the flattened iteration, so only
+// those need the option; clang contracts as it parses the kernel, so
+// it needs -ffp-contract=off on every file that runs operations
+#if defined(__clang__)
+#define LLRT_NO_CONTRACT
+#else
+#define LLRT_NO_CONTRACT optimize("fp-contract=off"),
+#endif
+
+    /**
+       Iterations of a link, compiled for each level. "flatten"
+       inlines the link type's loop and the kernel into them, so the
+       whole loop is compiled for the level's instructions.
+     */
+    template<typename LinkType, typename Kernel>
+    __attribute__((target("avx2,bmi,bmi2,popcnt"), flatten))
+    void iterateLinkAVX2(LinkType &l, int whichEnd, Kernel &k, size_t start, size_t end){
+        l(whichEnd, k, start, end);
+    }
+
+    template<typename LinkType, typename Kernel>
+    __attribute__((target("avx512f,avx512vl,avx512bw,avx512dq,avx512cd,avx2,bmi,bmi2,popcnt"), LLRT_NO_CONTRACT flatten))
+    void iterateLinkAVX512(LinkType &l, int whichEnd, Kernel &k, size_t start, size_t end){
+        l(whichEnd, k, start, end);
+    }
+#endif
+
+    /**
+       Run link type l's iteration of kernel k from progress point
+       start to end, compiled for the given level.
+     */
+    template<typename LinkType, typename Kernel>
+    inline void iterateLink(IsaLevel level, LinkType &l, int whichEnd, Kernel &k, size_t start, size_t end){
+#ifdef LLRT_MULTIVERSION
+        switch(level){
+        case IsaLevel::AVX512:
+            iterateLinkAVX512(l, whichEnd, k, start, end);
+            return;
+        case IsaLevel::AVX2:
+            iterateLinkAVX2(l, whichEnd, k, start, end);
+            return;
+        default:
+            break;
+        }
+#endif
+        l(whichEnd, k, start, end);
+    }
+}
+
+#endif
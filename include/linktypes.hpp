@@ -1,6 +1,9 @@
 #ifndef LINKTYPES_HPP_
 #define LINKTYPES_HPP_
 #include "common.hpp"
+#include <string>
+#include <optional>
+#include <stdexcept>
 
 // core LinkTypes
 
@@ -81,6 +84,59 @@ namespace llrt{
             return maxProgress(whichEnd); // by default, the iterator can't split the job up
         }
 
+        /**
+           Append to out whatever the link needs, beyond the
+           dimensions and parameters given to it in code, to restore
+           its connectivity from a checkpoint (see checkpoint.hpp).
+           Most link types are fully described by those, and save
+           nothing.
+         */
+        virtual void saveState(std::string &out){
+
+        }
+
+        /**
+           Restore the state written by saveState. Throws
+           std::runtime_error if the state is malformed.
+
+           @param data the bytes appended by saveState
+           @param size the number of bytes
+         */
+        virtual void loadState(const char *data, size_t size){
+            if (size != 0)
+                throw std::runtime_error("Link type " + identifier() + " has no state to load");
+        }
+
+        /**
+           The parameters that, with identifier() and the dimensions
+           of the link's ends, determine its index structures, for a
+           TopologyCache (see topology_cache.hpp). Link types whose
+           structure is also built by code, such as AdjListLink,
+           return std::nullopt, and are cached by their position in
+           the network instead.
+         */
+        virtual std::optional<std::string> topologyParams(){
+            return std::string();
+        }
+
+        /**
+           Append to out the index structures the link derives from
+           its parameters and dimensions, or builds in code, so that
+           loadTopology can restore them without recomputing them.
+           By default, the same as saveState.
+         */
+        virtual void saveTopology(std::string &out){
+            saveState(out);
+        }
+
+        /**
+           Restore the index structures written by saveTopology.
+           Throws std::runtime_error if they are malformed.
+         */
+        virtual void loadTopology(const char *data, size_t size){
+            loadState(data, size);
+        }
+
         // All LinkTypes must also implement operator() with the following signature:
         //
         // template<typename Kernel>
@@ -0,0 +1,44 @@
+#ifndef MAPPED_FILE_HPP_
+#define MAPPED_FILE_HPP_
+
+#include <string>
+#include <cstddef>
+
+namespace llrt{
+
+    /**
+       A whole file mapped into memory, read-only from the file's
+       point of view: the mapping is private, so pages are read from
+       the file as they are touched, and nothing is ever written back.
+
+       Throws std::runtime_error if the file can't be opened or mapped.
+     */
+    class MappedFile{
+    public:
+        MappedFile(const std::string &filename);
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const char *data() const{
+            return static_cast<const char *>(addr);
+        }
+
+        size_t size() const{
+            return len;
+        }
+
+        /**
+           Tell the operating system that the given range of the file
+           will be read soon, so it can start reading it in.
+         */
+        void willNeed(size_t offset, size_t bytes) const;
+
+    private:
+        void *addr = nullptr;
+        size_t len = 0;
+    };
+}
+
+#endif
@@ -130,7 +130,10 @@
 #include <cstring>
 #include <stdexcept>
 #include <fstream>
+#include <optional>
 #include "common.hpp"
+#include "counter_rng.hpp"
+#include "isa_dispatch.hpp"
 #include "linktypes.hpp"
 #include "function_traits.hpp"
 #include "scheduler.hpp"
@@ -178,12 +181,24 @@ namespace llrt{
         bool initialized = false;
         bool noData = true;
 
+        /// false while the values of a Tensor initialized lazily are
+        /// not allocated yet (see materialize)
+        bool materialized = true;
+
+        /// set when an operation's kernel takes these values by
+        /// non-const reference, or a link type moves or resizes them
+        /// (through TensorWrapper), so that an IncrementalCheckpointer
+        /// knows which Tensors may have changed since its last
+        /// checkpoint. Code that changes the values directly should
+        /// set it too.
+        bool written = true;
+
         size_t num_values;
 
         void resize(const std::vector<index_t> &dims){
             dimensions = dims;
             num_values = std::accumulate(dimensions.begin(), dimensions.end(), 1, std::multiplies<>());
-            if (!noData)
+            if (!noData && materialized)
                 std::visit([&](auto && vec){vec.resize(num_values);},values);
         }
 
@@ -204,16 +219,65 @@ namespace llrt{
             }, values);
         }
 
+        /**
+           Give the Tensor values of type T, all T().
+
+           @param lazy if true, don't allocate them until
+           materialize() is called
+         */
         template <typename T>
-        void initialize(){
+        void initialize(bool lazy = false){
             assert(!initialized);
             if constexpr(!std::is_same_v<T, NoData>){
-                values = std::vector<T>(num_values, T());
+                values = lazy ? std::vector<T>() : std::vector<T>(num_values, T());
                 noData = false;
+                materialized = !lazy;
             }
             initialized = true;
         }
 
+        /**
+           Allocate the values of a Tensor initialized lazily, as T().
+           Everything that hands out or changes the values calls this
+           first: the operations of process_link.hpp (through
+           Link::linkData), link types that resize them, and loading
+           checkpoints, .npy files, halos and replica averages. Until
+           then the values count as all T(), which is how checkpoints,
+           halo exchanges and replica averages read them. Code that
+           reads values directly from a link end should call it too,
+           or use Link::linkData. Not threadsafe; call it before the
+           values are shared. The values are allocated and zeroed on
+           the calling thread, as by std::vector::resize, so the
+           memory is first touched there rather than by the workers
+           that use it.
+         */
+        void materialize(){
+            if (materialized)
+                return;
+            std::visit([this](auto &vec){
+                // values assigned directly are kept
+                if (vec.size() < num_values)
+                    vec.resize(num_values);
+            }, values);
+            materialized = true;
+        }
+
+        /**
+           true if the values were initialized lazily and aren't
+           allocated yet, so they are all T(). Values assigned
+           directly to a lazy Tensor count as allocated.
+         */
+        bool unallocated() const{
+            return !materialized && std::visit([](auto &vec){return vec.empty();}, values);
+        }
+
+        /// the number of values, whether or not they are allocated yet
+        size_t numValues() const{
+            if (!materialized)
+                return num_values;
+            return std::visit([](auto &vec){return vec.size();}, values);
+        }
+
         /**
            Given a multi-dimensional index, flatten it into an index
            into the values vector For efficiency, it's not recommended
@@ -266,6 +330,9 @@ namespace llrt{
             virtual void apply(void *capture, void (*f)(void *, AnyVector &)){
                 if (t.noData)
                     return;
+                t.materialize();
+                // link types move and resize values through here
+                t.written = true;
                 std::visit([&f, capture](auto &&arg){
                     using VecT = std::decay_t<decltype(arg)>;
                     using T = VecTGetter<VecT>::ItemType;
@@ -283,6 +350,13 @@ namespace llrt{
         }
     };
 
+    /**
+       true if a kernel parameter of type Arg can change the value
+       passed to it
+     */
+    template<typename Arg>
+    constexpr bool kernelWrites = std::is_lvalue_reference_v<Arg> && !std::is_const_v<std::remove_reference_t<Arg> >;
+
     template<typename TL>
     struct Network;
 
@@ -329,6 +403,8 @@ namespace llrt{
         
         std::string name;
         size_t id;
+        /// operations with a CounterRNG issued on each end so far, run here or not
+        uint64_t rngSteps[2] = {0, 0};
         template<typename LinkType>
         Link(Component<TL> &c1, LinkType h, Component<TL> &c2, bool swapAxon, size_t numericId) :
             ends{LinkEnd<TL>(h.linkEndSize(c1.data.dimensions, c2.data.dimensions, 0),c1,*this,0),
@@ -367,6 +443,7 @@ namespace llrt{
 
         template<typename T>
         std::vector<T> & linkData(int whichEnd){
+            ends[whichEnd].data.materialize();
             return std::get<std::vector<T> >(ends[whichEnd].data.values);
         }
 
@@ -417,6 +494,30 @@ namespace llrt{
         }
     };
 
+    /**
+       The generator for the "r" parameter of an operation's kernel,
+       of whichever type the kernel declares: the Network's
+       ThreadsafeRNG itself, for the kernel copies to draw their seeds
+       from, or a CounterRNG keyed by the link end and the number of
+       such operations issued on it before. That count advances on
+       every process, whether or not it runs the operation (see
+       Component::local), so the partitions of a network stay in step.
+     */
+    template<typename RNG, typename TL>
+    decltype(auto) kernelRNG(Link<TL> &link, int whichEnd){
+        if constexpr(std::is_same_v<RNG, CounterRNG>)
+            return CounterRNG(CounterRNG::streamKey(link.ends[0].c.net.counterSeed, 2 * link.id + whichEnd, link.rngSteps[whichEnd]++));
+        else
+            return (link.ends[0].c.net.rng);
+    }
+
+    /// start the numbers of a kernel's call on a node and link end
+    inline void restartRNG(ThreadsafeRNG &, size_t, size_t){}
+
+    inline void restartRNG(CounterRNG &r, size_t near, size_t nearLink){
+        r.restart(near, nearLink);
+    }
+
 
     /**
        A collection of Components and Links, plus the Scheduler necessary
@@ -429,6 +530,19 @@ namespace llrt{
 
         ThreadsafeRNG rng;
 
+        /// the seed of the CounterRNGs of kernels
+        uint64_t counterSeed = 0;
+
+        /**
+           if true, the values of the ends of links connected from now
+           on aren't allocated until they are first used (see
+           Tensor::materialize), so ends that no operation uses never
+           take any memory. Off by default, since code that reads
+           ends[e].data.values directly must then materialize them
+           first.
+         */
+        bool lazyLinkData = false;
+
         std::optional<Scheduler> sched;
 
         NetworkPerfLogger npl;
@@ -451,6 +565,13 @@ namespace llrt{
            with the given batchNumber.
          */
         void finishBatch(size_t batchNumber);
+
+        /**
+           @return true if the batch with the given batchNumber has
+           finished, without waiting for it. Always true if there is
+           no scheduler.
+         */
+        bool batchFinished(size_t batchNumber);
         void displayChain(Link<TL> &l, int i, std::set<Link<TL> *> &ls);
 
         /**
@@ -465,7 +586,7 @@ namespace llrt{
         void setDeterminism();
         
         /**
-           Seed the ThreadsafeRNG
+           Seed the ThreadsafeRNG, and the CounterRNGs of kernels
          */
         void seed(size_t rngSeed);
 
@@ -492,6 +613,24 @@ namespace llrt{
         template <typename NodeType>
         Component<TL> & component(const std::vector<index_t> &dims);
 
+        /**
+           Create a component array: a Component<TL> of members
+           members, each with dimensions memberDims, stored one member
+           after another. Members are connected to the members of
+           another component array by an ArrayLink, so many small
+           populations of the same shape are stepped by single jobs.
+
+           @tparam NodeType as for component
+           @param members the number of members
+           @param memberDims the dimensions of each member
+         */
+        template <typename NodeType>
+        Component<TL> & componentArray(index_t members, const std::vector<index_t> &memberDims){
+            std::vector<index_t> dims{members};
+            dims.insert(dims.end(), memberDims.begin(), memberDims.end());
+            return component<NodeType>(dims);
+        }
+
         // last created link type
         using LType = TLTypes<TL>::LType;
         UnpackLType<LType>::varType * _thatLink;
@@ -525,6 +664,12 @@ namespace llrt{
 
         int id;
 
+        /**
+           false if another process runs the operations on this
+           component (see shm_partition.hpp); they are skipped here
+         */
+        bool local = true;
+
         const std::vector<index_t> & getDimensions() const {
             return data.dimensions;
         }
@@ -640,7 +785,7 @@ namespace llrt{
     };
 
     template<typename TL, typename Kernel>
-    void ProcessLink(Link<TL> & link, int whichEnd, Kernel && k, index_t start, index_t end
+    void ProcessLink(Link<TL> & link, int whichEnd, Kernel && k, index_t start, index_t end, IsaLevel level
 #ifdef DEBUG_OP_LEVEL                     
                      , std::string kernelName
 #endif
@@ -666,6 +811,10 @@ namespace llrt{
         K1 combiner;
         K2 cmpNearFilter;
         K3 cmpFarFilter;
+        /// see DeterministicCombine
+        size_t combineBlock = 0;
+        /// see AlignProgress
+        size_t progressAlign = 0;
     };
 
     // NullOptionType defined in common.hpp
@@ -725,6 +874,33 @@ namespace llrt{
         return JobOptions<std::tuple<C, NullOptionType, NullOptionType> >{false, true, true, "", false, false, combiner};
     }
 
+    /**
+       Make the result of a Combiner the same, bit for bit, however
+       the operation is divided into job chunks: with any number of
+       workers, with adaptive scheduling, and single-threaded. Each
+       block of about blockProgress units of progress (nodes, or
+       edges, depending on the link) runs on its own copy of the
+       kernel, and the copies are combined in a fixed tree order.
+
+       ProcessNetCmps_N(net, sum, Parallel | Combiner(add) | DeterministicCombine());
+
+       Smaller blocks make more copies of the kernel to combine;
+       larger blocks limit how finely the scheduler can divide the
+       operation.
+     */
+    const JobOptions<NOpT3> DeterministicCombine(size_t blockProgress = 4096);
+
+    /**
+       Only divide the operation between workers at multiples of
+       this many units of progress (or the link's progress points
+       after them). For a component of bools, whose values
+       std::vector<bool> packs into shared words, a multiple of 64
+       keeps workers from writing the same word:
+
+       ProcessCmp_N(spikes, reset, Parallel | AlignProgress(64));
+     */
+    const JobOptions<NOpT3> AlignProgress(size_t multiple);
+
     /**
        Only run the operation on near components matching the filter.
 
@@ -814,7 +990,9 @@ namespace llrt{
             op1.onlyDendrites || op2.onlyDendrites,
             unifyKernels(op1.combiner, op2.combiner),
             unifyKernels(op1.cmpNearFilter, op2.cmpNearFilter),
-            unifyKernels(op1.cmpFarFilter, op2.cmpFarFilter)};
+            unifyKernels(op1.cmpFarFilter, op2.cmpFarFilter),
+            std::max(op1.combineBlock, op2.combineBlock),
+            std::max(op1.progressAlign, op2.progressAlign)};
     }
 
 ////////////////////////////////////////////////////
@@ -850,9 +1028,10 @@ namespace llrt{
        @param pk_ref like pk, but it wraps a reference to the kernel
        rather than a copy of it
        @param li a function with signature:
-       void(PureKernel &pk, size_t start, size_t end)
+       void(PureKernel &pk, size_t start, size_t end, IsaLevel level)
        The job of li is to execute the operation between progress points
-       start and end.
+       start and end, at the instruction set level the operation was
+       queued at.
        @param opts the options for the operation
        
        @return the client batch number, or 0 if single-threaded.
@@ -860,6 +1039,16 @@ namespace llrt{
     template<typename TL, typename Kernel, typename PureKernel, typename PureKernel_Ref, typename LI, typename Ks>
     size_t QueueProcessLink(Link<TL> & link, int whichEnd, Kernel &k, PureKernel &pk, PureKernel_Ref &pk_ref, LI li, JobOptions<Ks> opts){
         Component<TL> &c = link.ends[whichEnd].c;
+        if(!c.local){
+            // still submit the batch this operation would have ended
+            if(opts.parallel && c.net.sched.has_value()){
+                if(opts.endOfBatch || opts.blocking)
+                    c.net.sched->endOfBatch();
+                if(opts.blocking)
+                    c.net.sched->finishBatches();
+            }
+            return 0;
+        }
         NETPERFREC(c.net.npl, QueueProcessLink, 0);
         size_t maxProgress = link.getMaxProgress(whichEnd);
         std::string linkName = link.endName(whichEnd);
@@ -867,6 +1056,29 @@ namespace llrt{
         if(kernelName == ""){
             kernelName = getKernelName<Kernel>();
         }
+        struct NextProgressPoint{
+            int whichEnd;
+            Link<TL> &link;
+            size_t align;
+            NextProgressPoint(int whichEnd, Link<TL> &link, size_t align) : whichEnd(whichEnd), link(link), align(align){}
+            size_t operator()(index_t requested){
+                if (align > 1)
+                    requested = (requested + align - 1) / align * align;
+                return std::visit(
+                    [this, requested](auto &&arg){
+                        return arg.requestPartialProgress(
+                            this->whichEnd, requested);
+                    }, link.type);
+            }
+        }npp(whichEnd, link, opts.progressAlign);
+        constexpr bool hasCombiner = !std::is_same<decltype(opts.combiner), NullOptionType>::value;
+        // read once, so every chunk runs at the same level even if
+        // setIsaLevel is called while the operation is queued
+        IsaLevel level = isaLevel();
+        auto chunkLi = [li, level](PureKernel &pk, size_t start, size_t end){
+            li(pk, start, end, level);
+        };
+
         if(!(link.ends[0].c.net.sched.has_value() && opts.parallel)){
             // single threaded
             // track performance
@@ -875,29 +1087,37 @@ namespace llrt{
             size_t chunkId = c.net.npl.logChunkStart(opId, maxProgress, 0);
 #endif
             c.net.npl.logKernels(maxProgress);
-            ProcessLink(link, whichEnd, pk_ref, 0, maxProgress
+            bool combined = false;
+            if constexpr (hasCombiner){
+                if(opts.combineBlock > 0){
+                    // the same blocks and order as the scheduler uses
+                    CombineBlockProgressPoint<NextProgressPoint> blockNpp{npp, opts.combineBlock};
+                    std::vector<PureKernel> copies;
+                    std::vector<size_t> starts;
+                    forEachCombineBlock(0, maxProgress, blockNpp, [&](size_t start, size_t end){
+                        starts.push_back(start);
+                        copies.push_back(pk);
+                        chunkLi(copies.back(), start, end);
+                    });
+                    std::vector<std::pair<size_t, PureKernel *> > blocks;
+                    for(size_t i=0; i < copies.size(); i++)
+                        blocks.emplace_back(starts[i], &copies[i]);
+                    combineBlocks(k, blocks, opts.combiner);
+                    combined = true;
+                }
+            }
+            if(!combined)
+                ProcessLink(link, whichEnd, pk_ref, 0, maxProgress, level
 #ifdef DEBUG_OP_LEVEL
-                        , opts.kernelName
+                            , opts.kernelName
 #endif
-                );
+                    );
 #ifdef PROFILER
             c.net.npl.logChunkEnd(opId, chunkId);
 #endif
             return 0;
         }
 
-        struct NextProgressPoint{
-            int whichEnd;
-            Link<TL> &link;
-            NextProgressPoint(int whichEnd, Link<TL> &link) : whichEnd(whichEnd), link(link){}
-            size_t operator()(index_t requested){
-                return std::visit(
-                    [this, requested](auto &&arg){
-                        return arg.requestPartialProgress(
-                            this->whichEnd, requested);
-                    }, link.type);
-            }
-        }npp(whichEnd, link);
         // size_t processOp(Kernel &k, std::string linkName, std::string kernelName, size_t opTypeIndex, int cmpId, size_t maxProgress, bool indivisible, Combiner combiner, NextProgressPoint nextProgressPoint, LinkIterator LI, bool endOfBatch, bool blocking)
         
         //std::type_index opTypeIndex(typeid(li));
@@ -914,9 +1134,10 @@ namespace llrt{
             !opts.parallel,
             opts.combiner,
             npp,
-            li,
+            chunkLi,
             opts.endOfBatch,
-            opts.blocking);
+            opts.blocking,
+            opts.combineBlock);
     }
 
     /**
@@ -933,10 +1154,11 @@ namespace llrt{
        to the far LinkEnd. edgeInfo is explained in README.md
        @param start the progress point at which we should begin execution
        @param end the progress point before which we should finish execution
+       @param level the instruction set level to run the iteration at
        @param kernelName can be used for debugging output, if that is enabled.
     */
     template<typename TL, typename PureKernel>
-    void ProcessLink(Link<TL> & link, int whichEnd, PureKernel && pk, index_t start, index_t end
+    void ProcessLink(Link<TL> & link, int whichEnd, PureKernel && pk, index_t start, index_t end, IsaLevel level
 #ifdef DEBUG_OP_LEVEL
                      , std::string kernelName
 #endif
@@ -944,8 +1166,8 @@ namespace llrt{
 #ifdef DEBUG_OP_LEVEL
         std::cout << "ProcessLink for " << kernelName << " (" << start << "-" << end << ")" << std::endl;
 #endif
-        std::visit([whichEnd, &pk, start, end](auto&& arg){
-            arg(whichEnd, pk, start, end);
+        std::visit([level, whichEnd, &pk, start, end](auto&& arg){
+            iterateLink(level, arg, whichEnd, pk, start, end);
         }, link.type);
     }
 
@@ -954,6 +1176,7 @@ namespace llrt{
 #include "adjlistlink.hpp"
 #include "generallocal2dlink.hpp"
 #include "local2dlink.hpp"
+#include "arraylink.hpp"
 #include "network_impl.hpp"
 
 #endif /* NETWORK_HPP_ */
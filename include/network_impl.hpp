@@ -74,16 +74,16 @@ namespace llrt{
             net._thatLink = &(l->type);
             links[1].push_back(l);
             otherComponent.links[0].push_back(l);
-            l->ends[0].data.template initialize<EdgeType0>();
-            l->ends[1].data.template initialize<EdgeType1>();
+            l->ends[0].data.template initialize<EdgeType0>(net.lazyLinkData);
+            l->ends[1].data.template initialize<EdgeType1>(net.lazyLinkData);
         }
         else{
             std::shared_ptr<Link<TL>> l = std::make_shared<Link<TL>>(*this, LinkType(), otherComponent, swapAxon, ++net.linkId);
             net._thatLink = &(l->type);
             links[0].push_back(l);
             otherComponent.links[1].push_back(l);
-            l->ends[0].data.template initialize<EdgeType0>();
-            l->ends[1].data.template initialize<EdgeType1>();
+            l->ends[0].data.template initialize<EdgeType0>(net.lazyLinkData);
+            l->ends[1].data.template initialize<EdgeType1>(net.lazyLinkData);
         }
         return otherComponent;
     }
@@ -110,6 +110,11 @@ namespace llrt{
         if(sched.has_value())
             sched->finishBatch(batchNumber);
     }
+
+    template <typename TL>
+    bool Network<TL>::batchFinished(size_t batchNumber){
+        return !sched.has_value() || sched->batchFinished(batchNumber);
+    }
     
     template <typename TL>
     void Network<TL>::displayChain(Link<TL> &l, int i, std::set<Link<TL> *> &ls){
@@ -168,6 +173,7 @@ namespace llrt{
     template <typename TL>
     void Network<TL>::seed(size_t rngSeed){
         rng.seed(rngSeed);
+        counterSeed = rngSeed;
     }
 
 
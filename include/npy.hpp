@@ -0,0 +1,306 @@
+#ifndef NPY_HPP_
+#define NPY_HPP_
+
+/**
+   Reading and writing Tensors as NumPy .npy files, so that the state
+   of a Network can be analyzed in Python with numpy.load, and arrays
+   prepared in Python can be loaded into a Network.
+
+   Arithmetic and bool values map to the matching numpy dtype. Values
+   of a struct type are written with a structured dtype if NpyFields
+   is specialized for the struct, listing its fields:
+
+   template<>
+   struct llrt::NpyFields<IFNeuron>{
+       static std::vector<NpyField> fields(){
+           return {npyField("v", &IFNeuron::v), npyField("spikes", &IFNeuron::spikes)};
+       }
+   };
+
+   and otherwise as opaque records ('|V<size>'), which numpy can still
+   reinterpret with .view().
+ */
+
+#include "network.hpp"
+#include "mapped_file.hpp"
+#include <fstream>
+
+namespace llrt{
+
+    /// the parsed header of an .npy file
+    struct NpyHeader{
+        /// the descr entry, as the Python literal in the file (e.g. "'<f4'")
+        std::string descr;
+        bool fortranOrder = false;
+        std::vector<size_t> shape;
+        /// where the values start in the file
+        size_t dataOffset = 0;
+
+        /// the number of values, the product of the shape
+        size_t count() const;
+
+        /// the dtype string of a plain (not structured) dtype, e.g. "<f4"; empty for structured dtypes
+        std::string scalarDescr() const;
+    };
+
+    /**
+       Parse the header of an .npy file whose first size bytes are at
+       data. Throws std::runtime_error (naming the file) if it is not
+       an .npy file.
+     */
+    NpyHeader parseNpyHeader(const char *data, size_t size, const std::string &filename);
+
+    /**
+       Read the header of an .npy file from the start of f, leaving f
+       at the start of the values.
+     */
+    NpyHeader readNpyHeader(std::istream &f, const std::string &filename);
+
+    /**
+       The magic, version and header of an .npy file, padded so that
+       the values start at a multiple of 64 bytes.
+
+       @param descr the Python literal for the dtype
+     */
+    std::string encodeNpyHeader(const std::string &descr, const std::vector<size_t> &shape);
+
+    /// '<' on little-endian machines, '>' on big-endian ones
+    char npyByteOrder();
+
+    /// one field of a struct, for NpyFields
+    struct NpyField{
+        std::string name;
+        /// the Python literal for the field's dtype
+        std::string descr;
+        size_t offset;
+        size_t size;
+    };
+
+    /// specialize with a static fields() returning a std::vector<NpyField>
+    template<typename T>
+    struct NpyFields;
+
+    template<typename T, typename = void>
+    struct HasNpyFields : std::false_type{};
+
+    template<typename T>
+    struct HasNpyFields<T, std::void_t<decltype(NpyFields<T>::fields())> > : std::true_type{};
+
+    /// the Python literal for the numpy dtype of values of type T
+    template<typename T>
+    std::string npyDescr();
+
+    std::string npyStructDescr(std::vector<NpyField> fields, size_t itemSize);
+
+    /**
+       describe a member of struct T, for NpyFields; members that are
+       one-dimensional arrays become subarray fields
+     */
+    template<typename T, typename M>
+    NpyField npyField(const std::string &name, M T::*member){
+        alignas(T) char buf[sizeof(T)];
+        const T *p = reinterpret_cast<const T *>(buf);
+        size_t offset = reinterpret_cast<const char *>(&(p->*member)) - buf;
+        if constexpr(std::is_array_v<M>)
+            return {name, npyDescr<std::remove_extent_t<M> >() + ", (" + std::to_string(std::extent_v<M>) + ",)", offset, sizeof(M)};
+        else
+            return {name, npyDescr<M>(), offset, sizeof(M)};
+    }
+
+    template<typename T>
+    std::string npyDescr(){
+        std::string order(1, sizeof(T) == 1 ? '|' : npyByteOrder());
+        if constexpr(std::is_same_v<T, bool>)
+            return "'|b1'";
+        else if constexpr(std::is_integral_v<T>)
+            return "'" + order + (std::is_signed_v<T> ? "i" : "u") + std::to_string(sizeof(T)) + "'";
+        else if constexpr(std::is_floating_point_v<T>)
+            return "'" + order + "f" + std::to_string(sizeof(T)) + "'";
+        else if constexpr(HasNpyFields<T>::value)
+            return npyStructDescr(NpyFields<T>::fields(), sizeof(T));
+        else
+            return "'|V" + std::to_string(sizeof(T)) + "'";
+    }
+
+    /**
+       Write the values of tensor t to an .npy file, with the shape of
+       its dimensions (or, if it holds a different number of values,
+       such as the edge values of an AdjListLink, a one-dimensional
+       array). The values are written straight from the Tensor,
+       except for bool values, which std::vector stores as bits.
+
+       Throws std::runtime_error if the tensor has no data, its
+       values aren't trivially copyable, or the file can't be written.
+     */
+    template<typename TType>
+    void saveNpy(Tensor<TType> &t, const std::string &filename);
+
+    /**
+       Read an .npy file into tensor t, replacing its values. The file
+       must hold as many values as the tensor, with the tensor's
+       dimensions or one dimension, of the tensor's value type: for
+       arithmetic and bool values, the same dtype; for structs, any
+       dtype of the same size, which is only checked against the
+       struct's layout if it is exactly the one saveNpy writes. The
+       tensor is marked written (see Tensor::written), so that the
+       next incremental checkpoint saves the loaded values.
+
+       @param map if true, map the file into memory and copy from
+       there, rather than reading it into the tensor
+
+       Throws std::runtime_error if the file can't be read or doesn't
+       match, leaving the tensor unchanged.
+     */
+    template<typename TType>
+    void loadNpy(Tensor<TType> &t, const std::string &filename, bool map=false);
+
+    /**
+       A memory-mapped .npy file, for reading large arrays in place.
+
+       NpyArray a("weights.npy");
+       const float *w = a.values<float>();
+     */
+    class NpyArray{
+    public:
+        NpyArray(const std::string &filename);
+
+        const NpyHeader &header() const{
+            return hdr;
+        }
+
+        const std::vector<size_t> &shape() const{
+            return hdr.shape;
+        }
+
+        /**
+           The values, in place in the mapping. Throws
+           std::runtime_error if they aren't of type T (as for
+           loadNpy), or aren't aligned for T.
+         */
+        template<typename T>
+        const T *values() const{
+            checkType(npyDescr<T>(), sizeof(T), alignof(T));
+            return reinterpret_cast<const T *>(file.data() + hdr.dataOffset);
+        }
+
+        /// the bytes of the values
+        const char *data() const{
+            return file.data() + hdr.dataOffset;
+        }
+
+        size_t bytes() const{
+            return file.size() - hdr.dataOffset;
+        }
+
+    private:
+        MappedFile file;
+        std::string filename;
+        NpyHeader hdr;
+
+        void checkType(const std::string &descr, size_t size, size_t align) const;
+    };
+
+    /**
+       Throw std::runtime_error unless an .npy file with header h and
+       dataBytes bytes of values holds count values of the type with
+       the given descr and size.
+     */
+    void checkNpyType(const NpyHeader &h, size_t dataBytes, const std::string &descr, size_t size, size_t count, const std::string &filename);
+
+    template<typename TType>
+    void saveNpy(Tensor<TType> &t, const std::string &filename){
+        if (t.noData)
+            throw std::runtime_error("Can't save " + filename + ": the tensor has no data");
+        bool unallocated = t.unallocated();
+        std::visit([&](auto &vec){
+            using T = std::decay_t<decltype(vec)>::value_type;
+            if constexpr(!std::is_same_v<T, bool> && !std::is_trivially_copyable_v<T>)
+                throw std::runtime_error(std::string() + "Can't save values of type " + typeid(T).name() + ", which is not trivially copyable, to " + filename);
+            else{
+                size_t n = t.numValues();
+                std::vector<size_t> shape(t.dimensions.begin(), t.dimensions.end());
+                if (n != t.num_values)
+                    shape = {n};
+                std::ofstream f(filename, std::ios::binary | std::ios::trunc);
+                if (!f)
+                    throw std::runtime_error("Couldn't open " + filename + " for writing");
+                std::string header = encodeNpyHeader(npyDescr<T>(), shape);
+                f.write(header.data(), header.size());
+                if (unallocated){
+                    // all T(), written without allocating the tensor
+                    using Stored = std::conditional_t<std::is_same_v<T, bool>, char, T>;
+                    const std::vector<Stored> block(std::min<size_t>(n, 4096), Stored(T()));
+                    for(size_t done=0; done < n; done += block.size())
+                        f.write(reinterpret_cast<const char *>(block.data()), std::min(block.size(), n - done) * sizeof(Stored));
+                }
+                else if constexpr(std::is_same_v<T, bool>){
+                    std::string bytes(vec.begin(), vec.end());
+                    f.write(bytes.data(), bytes.size());
+                }
+                else
+                    f.write(reinterpret_cast<const char *>(vec.data()), vec.size() * sizeof(T));
+                f.close();
+                if (!f)
+                    throw std::runtime_error("Couldn't write " + filename);
+            }
+        }, t.values);
+    }
+
+    template<typename TType>
+    void loadNpy(Tensor<TType> &t, const std::string &filename, bool map){
+        if (t.noData)
+            throw std::runtime_error("Can't load " + filename + ": the tensor has no data");
+        t.materialize();
+        std::visit([&](auto &vec){
+            using T = std::decay_t<decltype(vec)>::value_type;
+            if constexpr(!std::is_same_v<T, bool> && !std::is_trivially_copyable_v<T>)
+                throw std::runtime_error(std::string() + "Can't load values of type " + typeid(T).name() + ", which is not trivially copyable, from " + filename);
+            else{
+                auto check = [&](const NpyHeader &h, size_t dataBytes){
+                    std::vector<size_t> dims(t.dimensions.begin(), t.dimensions.end());
+                    if (h.shape != dims && h.shape.size() != 1)
+                        throw std::runtime_error(filename + " has shape " + listDimensions(h.shape) + ", but the tensor has dimensions " + listDimensions(t.dimensions));
+                    checkNpyType(h, dataBytes, npyDescr<T>(), sizeof(T), vec.size(), filename);
+                };
+                if (map){
+                    MappedFile file(filename);
+                    NpyHeader h = parseNpyHeader(file.data(), file.size(), filename);
+                    check(h, file.size() - h.dataOffset);
+                    const char *src = file.data() + h.dataOffset;
+                    if constexpr(std::is_same_v<T, bool>)
+                        vec.assign(src, src + vec.size());
+                    else{
+                        size_t n = vec.size();
+                        std::memcpy(vec.data(), src, n * sizeof(T));
+                    }
+                    t.written = true;
+                    return;
+                }
+                std::ifstream f(filename, std::ios::binary | std::ios::ate);
+                if (!f)
+                    throw std::runtime_error("Couldn't open " + filename + " for reading");
+                size_t fileBytes = f.tellg();
+                f.seekg(0);
+                NpyHeader h = readNpyHeader(f, filename);
+                check(h, fileBytes - h.dataOffset);
+                if constexpr(std::is_same_v<T, bool>){
+                    std::string bytes(vec.size(), '\0');
+                    f.read(bytes.data(), bytes.size());
+                    if (!f)
+                        throw std::runtime_error("Couldn't read " + filename);
+                    vec.assign(bytes.begin(), bytes.end());
+                }
+                else{
+                    // read straight into the tensor
+                    t.written = true;
+                    f.read(reinterpret_cast<char *>(vec.data()), vec.size() * sizeof(T));
+                    if (!f)
+                        throw std::runtime_error("Couldn't read " + filename + "; the tensor may be partly overwritten");
+                }
+                t.written = true;
+            }
+        }, t.values);
+    }
+}
+
+#endif
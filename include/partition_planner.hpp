@@ -0,0 +1,153 @@
+#ifndef PARTITION_PLANNER_HPP_
+#define PARTITION_PLANNER_HPP_
+
+#include "halo.hpp"
+#include <map>
+
+namespace llrt{
+
+    /**
+       What a PartitionPlan minimizes and balances, as estimates:
+       the work of a component is nodeWork per node, plus edgeWork per
+       unit of maxProgress of each link end on it (the edges a link
+       operation on that end visits, such as the edges inserted into
+       an AdjListLink), and the traffic is the bytes of halo data
+       exchanged each step.
+     */
+    struct PartitionOptions{
+        double nodeWork = 1;
+        double edgeWork = 1;
+        /**
+           bytes sent per bool value: 1 for ShmPartition; with the
+           spike indices of DistributedPartition, about twice the
+           fraction of values that are true
+         */
+        double bytesPerBool = 1;
+        /// how much more work than the average a rank may get
+        double imbalance = 0.05;
+        /// the most refinement passes over the components
+        size_t passes = 20;
+    };
+
+    /**
+       A Network reduced to what matters for placing its components
+       on ranks: the work of each component, the links between them,
+       and the halo data that would cross a partition boundary.
+     */
+    struct PartitionGraph{
+        std::vector<std::string> names;
+        std::vector<double> work;
+        /// the components at the ends of each link
+        std::vector<std::pair<size_t, size_t> > links;
+        /// a tensor owned by one component and read by others
+        struct HaloData{
+            size_t owner;
+            std::vector<size_t> readers;
+            double bytes;
+        };
+        std::vector<HaloData> data;
+    };
+
+    /**
+       A placement of components on ranks, with the work and traffic
+       it is predicted to give.
+     */
+    struct PartitionPlan{
+        /// the rank of each component, to give to ShmPartition or DistributedPartition
+        std::vector<size_t> owners;
+        /// the work of each rank
+        std::vector<double> load;
+        /// bytes[from][to] sent at each exchange
+        std::vector<std::vector<double> > bytes;
+        double totalBytes = 0;
+        size_t cutLinks = 0;
+        std::vector<std::string> names;
+
+        /// the largest load divided by the average
+        double imbalance() const;
+
+        /// a table of the ranks' components, loads and traffic
+        std::string report() const;
+    };
+
+    /**
+       Place the components of graph on numRanks ranks, balancing their
+       work within opts.imbalance when whole components allow it, and
+       then making the traffic between ranks as small as possible. Every
+       rank gets at least one component. Deterministic, so each process
+       can plan for itself.
+
+       Grows each rank's part from its heaviest unplaced component,
+       adding the components that exchange the most data with it, then
+       refines by moving single components between ranks while that
+       reduces the overload or the traffic. Throws std::runtime_error if
+       there are fewer components than ranks.
+     */
+    PartitionPlan planPartition(const PartitionGraph &graph, size_t numRanks, const PartitionOptions &opts = PartitionOptions());
+
+    /// the load and traffic of a given placement, such as one made by hand
+    PartitionPlan evaluatePartition(const PartitionGraph &graph, const std::vector<size_t> &owners);
+
+    /**
+       The PartitionGraph of a Network. The halo data are those of
+       haloTensors(): the data of each component read across its links,
+       and the data of each link end, read by the other end.
+     */
+    template<typename TL>
+    PartitionGraph partitionGraph(Network<TL> &net, const PartitionOptions &opts = PartitionOptions()){
+        using TType = TLTypes<TL>::TType;
+        PartitionGraph g;
+        std::map<Component<TL> *, size_t> index;
+        for(size_t i=0; i < net.components.size(); i++){
+            index[net.components[i].get()] = i;
+            g.names.push_back(net.components[i]->name);
+            g.work.push_back(opts.nodeWork * net.components[i]->dataSize());
+        }
+        auto bytes = [&opts](Tensor<TType> &t){
+            return std::visit([&opts, &t](auto &vec){
+                using T = std::decay_t<decltype(vec)>::value_type;
+                if constexpr(std::is_same_v<T, bool>)
+                    return t.numValues() * opts.bytesPerBool;
+                else
+                    return double(t.numValues() * sizeof(T));
+            }, t.values);
+        };
+        std::vector<std::vector<size_t> > readers(net.components.size());
+        for(Link<TL> *l : checkpointLinks(net)){
+            size_t c[2] = {index.at(&l->ends[0].c), index.at(&l->ends[1].c)};
+            g.links.push_back({c[0], c[1]});
+            for(int e=0; e < 2; e++){
+                g.work[c[e]] += opts.edgeWork * l->getMaxProgress(e);
+                if (c[0] == c[1])
+                    continue;
+                readers[c[e]].push_back(c[1 - e]);
+                if (!l->ends[e].data.noData)
+                    g.data.push_back({c[e], {c[1 - e]}, bytes(l->ends[e].data)});
+            }
+        }
+        for(size_t i=0; i < net.components.size(); i++){
+            Tensor<TType> &t = net.components[i]->data;
+            if (t.noData || readers[i].empty())
+                continue;
+            std::sort(readers[i].begin(), readers[i].end());
+            readers[i].erase(std::unique(readers[i].begin(), readers[i].end()), readers[i].end());
+            g.data.push_back({i, readers[i], bytes(t)});
+        }
+        return g;
+    }
+
+    /**
+       Plan the placement of a Network's components on numRanks ranks
+       (see planPartition):
+
+       PartitionPlan plan = planPartition(net, 4);
+       std::cout << plan.report();
+       ShmPartition part(net, "/mynet", rank, plan.owners);
+     */
+    template<typename TL>
+    PartitionPlan planPartition(Network<TL> &net, size_t numRanks, const PartitionOptions &opts = PartitionOptions()){
+        return planPartition(partitionGraph(net, opts), numRanks, opts);
+    }
+}
+
+#endif
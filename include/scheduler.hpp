@@ -23,6 +23,7 @@
 #include <cassert>
 #include "common.hpp"
 #include "network_perf_logger.hpp"
+#include "scheduler_trace.hpp"
 
 
 namespace llrt{
@@ -73,11 +74,13 @@ namespace llrt{
 */
     class Scheduler{
 
+        friend class SchedulerSimulator;
+
     private:
 
         size_t sequence=0; ///< an ID number for each synchronization barrier. increments with each barrier. This number is equal to the highest scheduled barrier. Accessed only by the scheduler thread.
 
-        size_t clientBatchNumber=1; ///< ID numbers for batches submitted by clients. One client batch may correspond to multiple synchronization barriers. Need to lock schedChan.mtx to access.
+        size_t clientBatchNumber=0; ///< ID numbers for batches submitted by clients, from 1; batch 0 counts as finished from the start. One client batch may correspond to multiple synchronization barriers. Need to lock schedChan.mtx to access.
 
 
         /// maps from barrier sequence numbers to client batch numbers.
@@ -128,6 +131,22 @@ namespace llrt{
             time_t startTime;
             time_t endTime;
             Job *job;
+
+            /// A whole job run after job, in the same chunk
+            struct PackedJob{
+                Job *job;
+                std::function<void(int64_t, int64_t)> task;
+            };
+
+            /// tiny jobs packed into this chunk (see packJobThreshold),
+            /// run back to back after job, and timed together with it
+            std::vector<PackedJob> packed;
+
+            void run(){
+                task(start, end);
+                for(PackedJob &p : packed)
+                    p.task(0, p.job->maxProgress);
+            }
         };
 
         /// Possibly several pieces of a Job given to a worker,
@@ -238,6 +257,16 @@ namespace llrt{
          */
         void collectStats(JobChunkBatch &batch, size_t worker);
 
+        /**
+           Call f(job, progress, startTime, endTime) for each job in a
+           chunk. The time of a chunk with packed jobs is shared
+           between them in proportion to their estimated times, which
+           is only good enough for the profiler's picture, not for the
+           estimates themselves (see collectStats).
+         */
+        template<typename F>
+        void forEachChunkJob(JobChunk &chunk, F f);
+
         /**
            Clean up information relating to a barrier after it has completed.
          */
@@ -357,6 +386,28 @@ namespace llrt{
 
         std::map<type_index_t, PerfTracker> timeByKernel;
 
+    public:
+        /**
+           Running totals of the time spent in job chunks, for telling
+           kernel time apart from scheduling and synchronization
+           overhead. See getStats().
+         */
+        struct Stats{
+            size_t barriers = 0; ///< number of barriers finished
+            size_t singleThreadedBarriers = 0; ///< how many of those ran on a single worker
+            size_t chunks = 0; ///< number of job chunks run
+            size_t packedJobs = 0; ///< jobs run inside another job's chunk (see packJobThreshold)
+            std::vector<dur_t> busyByWorker; ///< total time each worker spent running job chunks
+            /// sum over barriers of the busiest worker's time in that
+            /// barrier. The wall time of the barriers if scheduling and
+            /// synchronization were free.
+            dur_t criticalPath = dur_t::zero();
+        };
+
+    private:
+        Stats stats;
+        std::mutex statsMtx;
+
         inline double microseconds(dur_t dur){
             return std::chrono::duration_cast<std::chrono::duration<double, std::micro> >(dur).count();
         }
@@ -433,7 +484,36 @@ namespace llrt{
          */
         void schedLoop();
 
-        std::thread *schedThread;
+        std::thread *schedThread = nullptr;
+
+        /// true while recording a SchedulerTrace
+        bool tracing = false;
+        size_t traceMaxBatches = 0;
+        SchedulerTrace trace;
+        std::mutex traceMtx;
+
+        /**
+           Add the jobs of a ClientBatch to the trace, if we are
+           recording one. Called by the scheduler thread before the
+           jobs are planned.
+         */
+        void traceBatch(std::list<Job *> &jobs);
+
+        struct NoThreads{};
+
+        /**
+           Make a Scheduler that doesn't start any threads, so that a
+           SchedulerSimulator can call the planning functions
+           directly.
+        */
+        Scheduler(int nWorkers, NoThreads) : startTime(time_t()), workChans(nWorkers), nWorkers(nWorkers){
+            workerLogs.resize(nWorkers);
+            stats.busyByWorker.resize(nWorkers, dur_t::zero());
+            firstBarrier = new Barrier(nWorkers, sequence);
+            firstBarrier->doneWorkers = nWorkers;
+            lastBarrier = firstBarrier;
+            schedBarrier = firstBarrier;
+        }
 
     public:
         /**
@@ -451,6 +531,16 @@ namespace llrt{
          */
         dur_t singleThreadThreshold = std::chrono::microseconds(30);
 
+        /**
+           Whole jobs estimated to take less than this are packed
+           together into one job chunk per worker, when a barrier is
+           divided between workers, so that a batch of many tiny jobs
+           (small components, small AdjListLinks) doesn't pay for a
+           chunk each. Each job still gets its own kernel copy. Zero
+           turns packing off.
+         */
+        dur_t packJobThreshold = std::chrono::microseconds(2);
+
         size_t nWorkers; ///< number of worker threads
 
         NetworkPerfLogger npl_op; ///< performance logger for job chunk start and end times
@@ -462,6 +552,7 @@ namespace llrt{
         */
         Scheduler(int nWorkers = std::thread::hardware_concurrency()) : startTime(std::chrono::steady_clock::now()), workChans(nWorkers), nWorkers(nWorkers){
             workerLogs.resize(nWorkers);
+            stats.busyByWorker.resize(nWorkers, dur_t::zero());
             // acquire a lock so that the scheduler thread doesn't start doing stuff until the Scheduler is fully constructed
             std::unique_lock<std::mutex> schedLck(schedChan.mtx);
             schedThread = new std::thread(&Scheduler::schedLoop, std::ref(*this));
@@ -474,6 +565,10 @@ namespace llrt{
            terminate the Scheduler thread, which will shut down the workers too
         */
         ~Scheduler(){
+            if (schedThread == nullptr){
+                finalCleanup();
+                return;
+            }
             std::unique_lock<std::mutex> lck(schedChan.mtx);
             schedChan.shutdown = true;
             lck.unlock();
@@ -549,12 +644,18 @@ namespace llrt{
          
            @param blocking is true if this call should not return until the
            entire job is done. Must have endOfBatch = true.
+
+           @param combineBlock if nonzero, and there is a combiner,
+           combine deterministically (see DeterministicCombine): each
+           block of about combineBlock units of progress gets its own
+           copy of pk, and the copies are combined in a fixed tree
+           order, so the result doesn't depend on the chunks.
          
            @return the client batch number, which can be passed to
            finishBatch to wait for the batch to finish.
          */
     template<typename Kernel, typename PureKernel, typename Combiner, typename NextProgressPoint, typename LinkIterator>
-    size_t processOp(Kernel &k, PureKernel &pk, std::string linkName, std::string kernelName, type_index_t opTypeIndex, int cmpId, size_t maxProgress, bool indivisible, Combiner combiner, NextProgressPoint nextProgressPoint, LinkIterator LI, bool endOfBatch, bool blocking);
+    size_t processOp(Kernel &k, PureKernel &pk, std::string linkName, std::string kernelName, type_index_t opTypeIndex, int cmpId, size_t maxProgress, bool indivisible, Combiner combiner, NextProgressPoint nextProgressPoint, LinkIterator LI, bool endOfBatch, bool blocking, size_t combineBlock = 0);
         
         /**
            The client may call this to wait for all batches to finish.
@@ -567,6 +668,12 @@ namespace llrt{
          */
         void finishBatch(size_t batchNumber);
 
+        /**
+           @return true if the batch with the given number has
+           finished, without waiting for it
+         */
+        bool batchFinished(size_t batchNumber);
+
         /**
            The client may call this after submitting several jobs, to
            indicate the batch is ready to be scheduled. (As an
@@ -586,11 +693,94 @@ namespace llrt{
            will be copied.
          */
         void mergeLoggers(NetworkPerfLogger &npl_client);
+
+        /**
+           @return the timing totals since the Scheduler started, or
+           since the last resetStats(). Barriers are counted once the
+           scheduler has recorded them, which happens before the
+           client is told their batch is finished.
+         */
+        Stats getStats();
+
+        /**
+           Set all timing totals back to zero.
+         */
+        void resetStats();
+
+        /**
+           Start recording the job sets given to the Scheduler, for
+           replay by a SchedulerSimulator. Any trace already being
+           recorded is discarded.
+
+           @param maxBatches stop recording after this many ClientBatches
+         */
+        void startTrace(size_t maxBatches = std::numeric_limits<size_t>::max());
+
+        /**
+           Wait for all batches to finish, and stop recording.
+
+           @return the recorded trace, including the measured cost per
+           unit of progress for each type of operation
+         */
+        SchedulerTrace stopTrace();
     };
 
 
+    /**
+       The progress points of a deterministic combine: the link's
+       progress point at or after the next multiple of block. They
+       depend only on the link, so the blocks between them are the
+       same however the operation is divided into chunks.
+     */
+    template<typename NextProgressPoint>
+    struct CombineBlockProgressPoint{
+        NextProgressPoint nextProgressPoint;
+        size_t block;
+
+        size_t operator()(size_t requested){
+            return nextProgressPoint((requested + block - 1) / block * block);
+        }
+    };
+
+    /**
+       Call f(blockStart, blockEnd) for each block of a deterministic
+       combine from progress point start to end, which are block
+       boundaries, or the end of the operation.
+     */
+    template<typename NextProgressPoint, typename F>
+    void forEachCombineBlock(size_t start, size_t end, CombineBlockProgressPoint<NextProgressPoint> &npp, F &&f){
+        while(start < end){
+            size_t next = std::min<size_t>(end, npp(start + 1));
+            f(start, next);
+            start = next;
+        }
+    }
+
+    /**
+       Combine the kernel copies of the blocks of a deterministic
+       combine into k: sort them by the start of their block, combine
+       neighbours pairwise, then pairs of pairs and so on, and combine
+       the first into k. The order depends only on the number of
+       blocks.
+
+       @param blocks the start of each block, and the copy of the pure
+       kernel that ran on it
+     */
+    template<typename Kernel, typename PureKernel, typename Combiner>
+    void combineBlocks(Kernel &k, std::vector<std::pair<size_t, PureKernel *> > &blocks, Combiner &combiner){
+        if (blocks.empty())
+            return;
+        std::sort(blocks.begin(), blocks.end(), [](auto &a, auto &b){
+            return a.first < b.first;
+        });
+        for(size_t stride=1; stride < blocks.size(); stride *= 2)
+            for(size_t i=0; i + stride < blocks.size(); i += 2*stride)
+                combiner(blocks[i].second->k, blocks[i + stride].second->k);
+        combiner(k, blocks[0].second->k);
+    }
+
     template<typename Kernel, typename PureKernel, typename Combiner, typename NextProgressPoint, typename LinkIterator>
-    size_t Scheduler::processOp(Kernel &k, PureKernel &pk, std::string linkName, std::string kernelName, type_index_t opTypeIndex, int cmpId, size_t maxProgress, bool indivisible, Combiner combiner, NextProgressPoint nextProgressPoint, LinkIterator LI, bool endOfBatch, bool blocking){
+    size_t Scheduler::processOp(Kernel &k, PureKernel &pk, std::string linkName, std::string kernelName, type_index_t opTypeIndex, int cmpId, size_t maxProgress, bool indivisible, Combiner combiner, NextProgressPoint nextProgressPoint, LinkIterator LI, bool endOfBatch, bool blocking, size_t combineBlock){
         std::unique_lock<std::mutex> schedLck(schedChan.mtx);
         constexpr bool hasCombiner = !std::is_same<Combiner, NullOptionType>::value;
         using _PureKernel = std::remove_reference<PureKernel>::type;
@@ -613,34 +803,63 @@ namespace llrt{
         batch = &schedChan.batches.back();
         size_t batchNum = batch->clientBatchNumber;
 
+        std::function<std::function<void(size_t, size_t)>(Job &)> copier(
+            [LI](Job &job){
+                job.kernelCopies.emplace_front(job.firstCopy);
+                _PureKernel *pk_ = std::any_cast<_PureKernel>(& job.kernelCopies.front());
+                return std::function<void(size_t, size_t)>(
+                    [LI, pk_](size_t start, size_t end){
+                        LI(*pk_, start, end);
+                    });
+            });
+        std::function<size_t(size_t)> npp(nextProgressPoint);
+        std::function<void(Job &)> combineAll(
+            [](Job &job){
+                if constexpr (hasCombiner){
+                    _Kernel *kptr = std::any_cast<_Kernel *>(job.originalKernelPtr);
+                    std::for_each(job.kernelCopies.begin(), job.kernelCopies.end(),
+                                  [kptr,&job](std::any &a){
+                                      _PureKernel *pk_ = std::any_cast<_PureKernel>(&a);
+                                      std::any_cast<Combiner>(job.combiner)(*kptr, pk_->k);
+                                  });
+                }
+            });
+        if constexpr (hasCombiner){
+            if (combineBlock > 0){
+                // a copy of the kernel for each block, keyed by the block's start
+                using BlockCopies = std::vector<std::pair<size_t, _PureKernel> >;
+                CombineBlockProgressPoint<NextProgressPoint> blockNpp{nextProgressPoint, combineBlock};
+                npp = blockNpp;
+                copier = [LI, blockNpp](Job &job){
+                    job.kernelCopies.emplace_front(BlockCopies());
+                    BlockCopies *copies = std::any_cast<BlockCopies>(& job.kernelCopies.front());
+                    const _PureKernel *first = std::any_cast<_PureKernel>(& job.firstCopy);
+                    return std::function<void(size_t, size_t)>(
+                        [LI, blockNpp, copies, first](size_t start, size_t end) mutable{
+                            forEachCombineBlock(start, end, blockNpp, [&](size_t blockStart, size_t blockEnd){
+                                copies->emplace_back(blockStart, *first);
+                                LI(copies->back().second, blockStart, blockEnd);
+                            });
+                        });
+                };
+                combineAll = [](Job &job){
+                    std::vector<std::pair<size_t, _PureKernel *> > blocks;
+                    for(std::any &a : job.kernelCopies)
+                        for(auto &copy : *std::any_cast<BlockCopies>(&a))
+                            blocks.emplace_back(copy.first, &copy.second);
+                    combineBlocks(*std::any_cast<_Kernel *>(job.originalKernelPtr), blocks, *std::any_cast<Combiner>(&job.combiner));
+                };
+            }
+        }
+
         batch->jobs.emplace_back(Job{
                 std::forward_list<std::any>(), // kernelCopies
                     hasCombiner ? &k : static_cast<_Kernel *>(nullptr), // originalKernelPtr
                     pk, // firstCopy
-                    // copier
-                    std::function<std::function<void(size_t, size_t)>(Job &)>(
-                        [LI](Job &job){
-                            job.kernelCopies.emplace_front(job.firstCopy);
-                            _PureKernel *pk_ = std::any_cast<_PureKernel>(& job.kernelCopies.front());
-                            return std::function<void(size_t, size_t)>(
-                                [LI, pk_](size_t start, size_t end){
-                                    LI(*pk_, start, end);
-                                });
-                        }),
-                    // nextProgressPoint
-                    std::function<size_t(size_t)>(nextProgressPoint),
+                    copier,
+                    npp, // nextProgressPoint
                     combiner, // combiner
-                    std::function<void(Job &)>( // combineAll
-                        [](Job &job){
-                            if constexpr (hasCombiner){
-                                _Kernel *kptr = std::any_cast<_Kernel *>(job.originalKernelPtr);
-                                std::for_each(job.kernelCopies.begin(), job.kernelCopies.end(),
-                                              [kptr,&job](std::any &a){
-                                                  _PureKernel *pk_ = std::any_cast<_PureKernel>(&a);
-                                                  std::any_cast<Combiner>(job.combiner)(*kptr, pk_->k);
-                                              });
-                            }
-                        }),
+                    combineAll,
                     kernelName,
                     opTypeIndex,
                     opIx,
@@ -0,0 +1,75 @@
+#ifndef SCHEDULER_SIMULATOR_HPP_
+#define SCHEDULER_SIMULATOR_HPP_
+
+#include "scheduler.hpp"
+
+namespace llrt{
+
+    /**
+       Replays a SchedulerTrace through the Scheduler's own planning
+       code (planAllStages, selectWater, pourWater,
+       singleThreadedSchedule, and the adaptive cost estimates) with a
+       virtual clock instead of worker threads, to predict how long the
+       recorded job sets would take under a given scheduling policy
+       and number of workers. The result depends only on the trace and
+       the options, so it can be compared between policies in CI.
+
+       The simulated time of a job chunk is the trace's measured cost
+       per unit of progress times the chunk's progress, plus
+       chunkOverhead, which a chunk of packed jobs pays only once. Each multithreaded barrier ends when its busiest
+       worker finishes, plus barrierOverhead. The simulated times are
+       fed back to the Scheduler's statistics just as measured times
+       would be.
+     */
+    class SchedulerSimulator{
+    public:
+        struct Options{
+            size_t nWorkers = 4;
+            /// passed on to Scheduler::singleThreadThreshold
+            dur_t singleThreadThreshold = std::chrono::microseconds(30);
+            /// passed on to Scheduler::packJobThreshold
+            dur_t packJobThreshold = std::chrono::microseconds(2);
+            /// time to start and finish each job chunk
+            dur_t chunkOverhead = std::chrono::nanoseconds(500);
+            /// time for the workers to synchronize at the end of a multithreaded barrier
+            dur_t barrierOverhead = std::chrono::microseconds(5);
+            /// time to hand a single-threaded barrier to a worker and report back
+            dur_t singleThreadedOverhead = std::chrono::microseconds(2);
+            /// if true, the Scheduler starts out knowing the cost of
+            /// each operation, instead of having to learn it from the
+            /// first few batches
+            bool warmEstimates = true;
+        };
+
+        struct Result{
+            dur_t makespan = dur_t::zero(); ///< total simulated time for all batches
+            dur_t busy = dur_t::zero(); ///< total time in job chunks, summed over workers
+            dur_t idle = dur_t::zero(); ///< nWorkers * makespan - busy
+            size_t barriers = 0;
+            size_t singleThreadedBarriers = 0;
+            size_t chunks = 0;
+
+            /// fraction of the workers' time spent in job chunks
+            double utilization() const{
+                dur_t total = busy + idle;
+                return total == dur_t::zero() ? 0 : static_cast<double>(busy.count()) / total.count();
+            }
+        };
+
+        SchedulerSimulator(const SchedulerTrace &trace, const Options &opts) : trace(trace), opts(opts){}
+
+        /**
+           Simulate all the batches of the trace, in order.
+         */
+        Result run();
+
+    private:
+        const SchedulerTrace &trace;
+        Options opts;
+
+        /// simulated time of a job chunk
+        dur_t chunkTime(const SchedulerTrace::TraceJob &job, size_t progress) const;
+    };
+}
+
+#endif
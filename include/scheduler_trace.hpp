@@ -0,0 +1,72 @@
+#ifndef SCHEDULER_TRACE_HPP_
+#define SCHEDULER_TRACE_HPP_
+
+#include <vector>
+#include <map>
+#include <string>
+#include <iostream>
+#include <chrono>
+
+namespace llrt{
+    /**
+       A record of the job sets a Scheduler was given, with the
+       measured cost of each type of operation, so that the planning
+       can be replayed offline by a SchedulerSimulator.
+
+       Recorded by Scheduler::startTrace() and Scheduler::stopTrace().
+     */
+    struct SchedulerTrace{
+        using type_index_t = size_t;
+
+        /// one type of operation, identified by its opTypeIndex
+        struct OpType{
+            std::string kernelName;
+            double usPerOp = 1; ///< measured microseconds per unit of progress
+        };
+
+        /// a Job, as submitted to the Scheduler
+        struct TraceJob{
+            type_index_t opTypeIndex;
+            int cmpId;
+            size_t maxProgress;
+            bool indivisible = false;
+        };
+
+        /// the jobs of one ClientBatch
+        struct TraceBatch{
+            std::vector<TraceJob> jobs;
+        };
+
+        std::map<type_index_t, OpType> opTypes;
+
+        /**
+           The points at which chunks of a job may end, as given by its
+           nextProgressPoint, for each (opTypeIndex, maxProgress). An
+           empty vector means a chunk may end anywhere.
+         */
+        std::map<std::pair<type_index_t, size_t>, std::vector<size_t> > progressPoints;
+
+        std::vector<TraceBatch> batches;
+
+        /**
+           @return nextProgressPoint(p) for a job of the trace: the
+           smallest recorded progress point at least as large as p
+         */
+        size_t nextProgressPoint(const TraceJob &job, size_t p) const;
+
+        /**
+           Write the trace in a line-based text format
+         */
+        void save(std::ostream &out) const;
+        void save(const std::string &filename) const;
+
+        /**
+           Read a trace written by save(). Throws std::runtime_error
+           if the input is not a valid trace.
+         */
+        static SchedulerTrace load(std::istream &in);
+        static SchedulerTrace load(const std::string &filename);
+    };
+}
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef SHM_INPUT_HPP_
+#define SHM_INPUT_HPP_
+
+#include "network.hpp"
+#include "shm_region.hpp"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <cstdint>
+
+namespace llrt{
+
+    /**
+       Layout of a shared-memory ring of input frames, shared by
+       ShmFrameProducer and ShmInputChannel:
+
+       header: "LLRTSHMI", u32 version, u32 number of slots, u64 frame
+       size (in floats), u64 bytes per slot, then the atomic u64
+       latest = sequence number << 16 | slot of the newest frame (0
+       before the first frame).
+
+       Each slot, 64-byte aligned after the header: an atomic u64
+       state = sequence number << 2 | flag, where the flag is
+       ShmSlotReady, ShmSlotWriting or ShmSlotReading, then the frame
+       at offset 64.
+
+       The producer only writes a slot that it has moved from Ready to
+       Writing, and never the latest one; the consumer only reads a
+       slot that it has moved from Ready to Reading, so neither sees a
+       partly written frame. Sequence numbers start at 1.
+     */
+    struct ShmFrameRingHeader{
+        char magic[8];
+        uint32_t version;
+        uint32_t slots;
+        uint64_t frameSize;
+        uint64_t slotBytes;
+        std::atomic<uint64_t> latest;
+    };
+
+    enum ShmSlotFlag : uint64_t{ShmSlotReady = 0, ShmSlotWriting = 1, ShmSlotReading = 2};
+
+    /**
+       Writes frames into a shared-memory ring for a ShmInputChannel,
+       normally in another process. Creates the ring, and removes its
+       name when destroyed.
+     */
+    class ShmFrameProducer{
+    public:
+        /**
+           @param name a shared-memory name of the form "/something"
+           @param frameSize number of floats in each frame
+           @param slots number of frames in the ring; the consumer
+           holds at most slots - 2 of them, so at least 3
+         */
+        ShmFrameProducer(const std::string &name, size_t frameSize, size_t slots = 4);
+
+        /**
+           Copy a frame of frameSize() values into the ring, as the
+           newest frame.
+
+           @return the frame's sequence number, or 0 if every slot was
+           in use by the consumer and the frame was dropped
+         */
+        uint64_t publish(const float *frame);
+
+        size_t frameSize() const{
+            return header()->frameSize;
+        }
+
+    private:
+        ShmRegion region;
+        uint64_t nextSeq = 1;
+        size_t nextSlot = 0;
+
+        ShmFrameRingHeader *header() const{
+            return reinterpret_cast<ShmFrameRingHeader *>(region.data());
+        }
+    };
+
+    /**
+       Input from a shared-memory ring written by a ShmFrameProducer in
+       an external process, such as a sensory front end.
+
+       Each call to step() takes the newest frame in the ring and
+       passes a pointer to it, in shared memory, to a function that
+       submits an operation reading it into the network, so the frame
+       isn't copied on the way. The slot stays reserved until that
+       operation's batch has finished. Frames published in between are
+       skipped. For example:
+
+       ShmInputChannel inputs("/sensors");
+       ...
+       inputs.step(net, [&](const float *frame){
+           return ProcessCmp_NNi(inputCmp, [=](IFNeuron &N, const size_t Ni){
+               N.v[_1] += frame[Ni];
+           }, ParallelNonBlocking | KernelName("Input"));
+       });
+
+       Only one ShmInputChannel may read a ring at a time.
+     */
+    class ShmInputChannel{
+    public:
+        struct Options{
+            /**
+               make step() wait for a frame newer than the last one it
+               returned; otherwise it returns the newest frame again
+               if there's no newer one
+             */
+            bool waitForNew = true;
+            /// how often to check for a new frame while waiting
+            std::chrono::microseconds pollInterval{50};
+            /// throw std::runtime_error if waiting for a frame takes longer
+            std::chrono::milliseconds timeout{10000};
+        };
+
+        /**
+           Attach to the ring created by a ShmFrameProducer. Throws
+           std::runtime_error if it doesn't exist or isn't a frame
+           ring.
+         */
+        ShmInputChannel(const std::string &name);
+        ShmInputChannel(const std::string &name, const Options &opts);
+
+        /**
+           Releases the slots still held. Finish the batches submitted
+           by step() first.
+         */
+        ~ShmInputChannel();
+
+        ShmInputChannel(const ShmInputChannel &) = delete;
+        ShmInputChannel &operator=(const ShmInputChannel &) = delete;
+
+        size_t frameSize() const{
+            return header()->frameSize;
+        }
+
+        /// sequence number of the frame most recently returned by step(), or 0
+        uint64_t sequence() const{
+            return lastSeq;
+        }
+
+        /**
+           Submit the newest frame to the network.
+
+           @param submit is called with the frame, and must submit an
+           operation that reads it, and return that operation's batch
+           number (the return value of the Process* function). The
+           frame stays valid until that batch has finished.
+
+           @return the batch number returned by submit
+         */
+        template<typename TL, typename Submit>
+        size_t step(Network<TL> &net, Submit &&submit){
+            releaseFinished([&net](size_t batch){return net.batchFinished(batch);});
+            if (held.size() >= maxHeld){
+                net.finishBatch(held.front().batch);
+                releaseFinished([&net](size_t batch){return net.batchFinished(batch);});
+            }
+            Held h = acquire();
+            h.batch = submit(frame(h.slot));
+            held.push_back(h);
+            return h.batch;
+        }
+
+    private:
+        struct Held{
+            size_t slot;
+            uint64_t seq;
+            size_t batch;
+        };
+
+        ShmRegion region;
+        Options opts;
+        std::deque<Held> held;
+        size_t maxHeld;
+        uint64_t lastSeq = 0;
+
+        ShmFrameRingHeader *header() const{
+            return reinterpret_cast<ShmFrameRingHeader *>(region.data());
+        }
+
+        const float *frame(size_t slot) const;
+
+        /// wait for and reserve the newest frame
+        Held acquire();
+
+        /// move slots held for finished batches back to Ready
+        template<typename Finished>
+        void releaseFinished(Finished &&finished){
+            while(!held.empty() && finished(held.front().batch)){
+                release(held.front());
+                held.pop_front();
+            }
+        }
+
+        void release(const Held &h);
+    };
+}
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef SHM_MIRROR_HPP_
+#define SHM_MIRROR_HPP_
+
+#include "network.hpp"
+#include "shm_region.hpp"
+#include <atomic>
+#include <cstdint>
+
+namespace llrt{
+
+    enum ShmFieldType : uint32_t{
+        /// one float per node, such as a voltage
+        ShmFloat = 0,
+        /// one bit per node, such as whether it spiked, packed into u64 words
+        ShmBits = 1
+    };
+
+    /// a field of a ShmStateMirror
+    struct ShmMirrorField{
+        /// at most 39 characters
+        std::string name;
+        ShmFieldType type;
+        /// number of nodes
+        size_t count;
+    };
+
+    /**
+       Layout of a ShmStateMirror's region:
+
+       header (64 bytes): "LLRTSHMM", u32 version, u32 number of
+       fields, u64 bytes per buffer, atomic u64 latest = frame number
+       << 1 | buffer of the newest complete frame (0 before the
+       first), then for each of the 2 buffers an atomic u64 sequence
+       = number of the frame in it << 1, | 1 while it is being
+       written.
+
+       field table, 64 bytes per field: the name (40 bytes, NUL
+       padded), u32 type, u32 unused, u64 number of nodes, then the
+       u64 offset of the field in a buffer (64-byte aligned).
+
+       the 2 buffers, each holding every field.
+     */
+    struct ShmMirrorHeader{
+        char magic[8];
+        uint32_t version;
+        uint32_t numFields;
+        uint64_t bufferBytes;
+        std::atomic<uint64_t> latest;
+        std::atomic<uint64_t> seq[2];
+    };
+
+    struct ShmMirrorFieldEntry{
+        char name[40];
+        uint32_t type;
+        uint32_t unused;
+        uint64_t count;
+        uint64_t offset;
+    };
+
+    /**
+       Publishes fields of a network's state, such as spikes or
+       voltages, to a double-buffered shared-memory region, for
+       external viewers (ShmStateViewer) to read while the simulation
+       runs.
+
+       The kernels of an ordinary operation write each node's values
+       straight into the back buffer, so the values are written by the
+       workers that own the nodes, and the network doesn't have to
+       stop to copy them out. Once that operation has finished, the
+       back buffer becomes the newest frame. For example:
+
+       ShmStateMirror mirror("/activity", {{"v", ShmFloat, n}, {"spikes", ShmBits, n}});
+       ...
+       mirror.capture(net, [&]{
+           float *v = mirror.floats(0);
+           return ProcessCmp_NNi(neurons, [&, v](IFNeuron &N, const size_t Ni){
+               ...
+               v[Ni] = N.v;
+               if (spiked)
+                   mirror.setBit(1, Ni);
+           }, ParallelNonBlocking);
+       });
+
+       Viewers use a sequence count per buffer instead of a lock, so
+       the simulation never waits for them: a viewer that reads a
+       buffer while it is being written notices and reads again.
+     */
+    class ShmStateMirror{
+    public:
+        /**
+           Create the region, replacing any existing one with the same
+           name, and remove its name when destroyed.
+
+           @param name a shared-memory name of the form "/something"
+         */
+        ShmStateMirror(const std::string &name, const std::vector<ShmMirrorField> &fields);
+
+        ShmStateMirror(const ShmStateMirror &) = delete;
+        ShmStateMirror &operator=(const ShmStateMirror &) = delete;
+
+        /**
+           Start writing the back buffer: clears its ShmBits fields.
+           Called by capture().
+         */
+        void beginFrame();
+
+        /**
+           Make the back buffer the newest frame, once every operation
+           writing it has finished. Called by capture().
+         */
+        void publish();
+
+        /**
+           Run beginFrame(), submit an operation writing the back
+           buffer, and publish() it once that operation's batch has
+           finished: right away if it has, otherwise at the next
+           capture() or finish(), so that nonblocking operations can
+           keep running.
+
+           @param submit must submit the operation and return its
+           batch number (the return value of the Process* function)
+
+           @return that batch number
+         */
+        template<typename TL, typename Submit>
+        size_t capture(Network<TL> &net, Submit &&submit){
+            finish(net);
+            beginFrame();
+            pendingBatch = submit();
+            pending = true;
+            if (net.batchFinished(pendingBatch)){
+                pending = false;
+                publish();
+            }
+            return pendingBatch;
+        }
+
+        /// wait for the operation submitted by capture(), and publish its frame
+        template<typename TL>
+        void finish(Network<TL> &net){
+            if (pending){
+                net.finishBatch(pendingBatch);
+                pending = false;
+                publish();
+            }
+        }
+
+        /// the back buffer's values of a ShmFloat field
+        float *floats(size_t field);
+
+        /// set a node's bit of a ShmBits field in the back buffer; thread-safe
+        void setBit(size_t field, size_t node){
+            uint64_t *words = reinterpret_cast<uint64_t *>(back() + fieldOffsets[field]);
+            std::atomic_ref<uint64_t>(words[node / 64]).fetch_or(uint64_t(1) << (node % 64), std::memory_order_relaxed);
+        }
+
+        /// number of the newest published frame, starting at 1
+        uint64_t frame() const{
+            return published;
+        }
+
+    private:
+        ShmRegion region;
+        std::vector<ShmMirrorField> fields;
+        std::vector<size_t> fieldOffsets;
+        uint64_t published = 0;
+        size_t backBuffer = 0;
+        bool pending = false;
+        size_t pendingBatch = 0;
+
+        ShmMirrorHeader *header() const{
+            return reinterpret_cast<ShmMirrorHeader *>(region.data());
+        }
+
+        char *back() const;
+    };
+
+    /**
+       Reads the frames published by a ShmStateMirror, normally in
+       another process.
+     */
+    class ShmStateViewer{
+    public:
+        /**
+           Attach to the region of a ShmStateMirror. Throws
+           std::runtime_error if it doesn't exist or isn't a state
+           mirror.
+         */
+        ShmStateViewer(const std::string &name);
+
+        const std::vector<ShmMirrorField> &getFields() const{
+            return fields;
+        }
+
+        /// index of the field with the given name; throws std::runtime_error if there's none
+        size_t fieldIndex(const std::string &name) const;
+
+        /**
+           Copy the newest frame, if newer than the last one read.
+
+           @return its frame number, or 0 if no frame has been
+           published yet
+         */
+        uint64_t read();
+
+        /// the values of a ShmFloat field in the frame last read
+        const float *floats(size_t field) const;
+
+        /// a node's bit of a ShmBits field in the frame last read
+        bool bit(size_t field, size_t node) const{
+            const uint64_t *words = reinterpret_cast<const uint64_t *>(reinterpret_cast<const char *>(snapshot.data()) + fieldOffsets[field]);
+            return (words[node / 64] >> (node % 64)) & 1;
+        }
+
+    private:
+        ShmRegion region;
+        std::vector<ShmMirrorField> fields;
+        std::vector<size_t> fieldOffsets;
+        std::vector<uint64_t> snapshot;
+        uint64_t lastFrame = 0;
+
+        const ShmMirrorHeader *header() const{
+            return reinterpret_cast<const ShmMirrorHeader *>(region.data());
+        }
+    };
+}
+
+#endif
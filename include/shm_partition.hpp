@@ -0,0 +1,232 @@
+#ifndef SHM_PARTITION_HPP_
+#define SHM_PARTITION_HPP_
+
+#include "halo.hpp"
+#include "shm_region.hpp"
+#include <chrono>
+#include <memory>
+#include <atomic>
+
+namespace llrt{
+
+    /**
+       Pin the calling thread, and the threads it creates afterwards,
+       to the CPUs of a NUMA node, as listed in
+       /sys/devices/system/node. Call it before creating the Network,
+       so that its worker threads, and the memory they first touch,
+       stay on that node.
+
+       @return false if the node's CPUs couldn't be found or used
+     */
+    bool pinToNumaNode(int node);
+
+    /**
+       Layout of the region shared by the processes of a ShmPartition:
+
+       header (64 bytes): "LLRTSHMP", u32 version, u32 number of
+       processes, u64 bytes per buffer, u64 hash of the layout of the
+       buffers, atomic u64 count of processes at the barrier, atomic
+       u64 barrier generation.
+
+       2 buffers, used on alternate exchanges, each holding a 64-byte
+       aligned slot for every tensor in the halo.
+     */
+    struct ShmPartitionHeader{
+        char magic[8];
+        uint32_t version;
+        uint32_t numRanks;
+        uint64_t bufferBytes;
+        uint64_t layoutHash;
+        std::atomic<uint64_t> arrived;
+        std::atomic<uint64_t> generation;
+    };
+
+    /**
+       The shared-memory region and barrier of a ShmPartition, which
+       don't depend on the Network's types.
+     */
+    class ShmHaloRegion{
+    public:
+        /**
+           Rank 0 creates the region, replacing any existing one with
+           the same name; the other ranks wait for it to appear, and
+           check that it has the same layout. Then all of them wait
+           for each other. Throws std::runtime_error on a mismatch, or
+           if that takes longer than the timeout.
+         */
+        ShmHaloRegion(const std::string &name, size_t rank, size_t numRanks, size_t bufferBytes, uint64_t layoutHash, std::chrono::milliseconds timeout);
+
+        /// buffer 0 or 1
+        char *buffer(size_t i) const;
+
+        /**
+           Wait until every rank has called barrier() as many times.
+           Throws std::runtime_error after the timeout, such as when
+           another process has died.
+         */
+        void barrier();
+
+    private:
+        std::unique_ptr<ShmRegion> region;
+        size_t rank, numRanks;
+        std::chrono::milliseconds timeout;
+
+        ShmPartitionHeader *header() const{
+            return reinterpret_cast<ShmPartitionHeader *>(region->data());
+        }
+    };
+
+    /**
+       Runs one Network across several processes on the same host,
+       each with its own worker pool and memory, for example one per
+       NUMA node (see pinToNumaNode).
+
+       Every process builds the same Network, then creates a
+       ShmPartition with its rank and the rank that owns each
+       component. Operations on the components owned by other ranks
+       are skipped (Component::local is false), so the same kernels
+       and Process* calls work unchanged, each process running them on
+       its own components. The halo, that is the data of components
+       and link ends that is read across a link from another rank's
+       component, goes through a shared-memory region: at each
+       exchange(), each rank writes the halo data it owns, waits for
+       the others at a barrier, and copies in the halo data it reads.
+       For example, with 2 processes:
+
+       Network<TL> net(threads);
+       ... build the network ...
+       ShmPartition part(net, "/mynet", rank, {0, 0, 1, 1});
+       ... initialize the network ...
+       part.exchange(); // share the initial values
+       for(size_t t=0; t < steps; t++){
+           ProcessNetLinks_NEn(net, ...);
+           ProcessNetCmps_N(net, ...);
+           part.exchange();
+       }
+
+       Kernels must follow the near-node guarantee, writing only to
+       the near node and near link end, and values must be trivially
+       copyable. Components are owned whole: link operations are split
+       into progress ranges rather than node ranges, so a component
+       can't be divided between processes.
+
+       @tparam TL the Network's types
+     */
+    template<typename TL>
+    class ShmPartition{
+    public:
+        struct Options{
+            /// how long to wait for the other processes at a barrier
+            std::chrono::milliseconds timeout{60000};
+        };
+
+        /**
+           @param name a shared-memory name of the form "/something",
+           unique to the run, the same in every process
+           @param rank this process, from 0
+           @param owners the rank that owns each component, in the
+           order of Network::components
+         */
+        ShmPartition(Network<TL> &net, const std::string &name, size_t rank, const std::vector<size_t> &owners);
+        ShmPartition(Network<TL> &net, const std::string &name, size_t rank, const std::vector<size_t> &owners, const Options &opts);
+
+        /// makes every component local again
+        ~ShmPartition();
+
+        ShmPartition(const ShmPartition &) = delete;
+        ShmPartition &operator=(const ShmPartition &) = delete;
+
+        /**
+           Finish the operations submitted so far, and exchange the
+           halo with the other ranks, so that their components' values
+           are visible here. Every rank must call it at the same
+           points.
+         */
+        void exchange();
+
+        size_t getRank() const{
+            return rank;
+        }
+
+        size_t getNumRanks() const{
+            return numRanks;
+        }
+
+        /// number of tensors this rank writes at each exchange
+        size_t outgoingTensors() const{
+            return outgoing.size();
+        }
+
+        /// number of tensors this rank reads at each exchange
+        size_t incomingTensors() const{
+            return incoming.size();
+        }
+
+    private:
+        using TType = TLTypes<TL>::TType;
+        struct Slot{
+            Tensor<TType> *t;
+            size_t offset;
+            size_t bytes;
+        };
+
+        Network<TL> &net;
+        size_t rank, numRanks;
+        std::vector<Slot> outgoing, incoming;
+        std::unique_ptr<ShmHaloRegion> region;
+        size_t exchanges = 0;
+    };
+
+    template<typename TL>
+    ShmPartition<TL>::ShmPartition(Network<TL> &net, const std::string &name, size_t rank, const std::vector<size_t> &owners) :
+        ShmPartition(net, name, rank, owners, Options()){}
+
+    template<typename TL>
+    ShmPartition<TL>::ShmPartition(Network<TL> &net, const std::string &name, size_t rank, const std::vector<size_t> &owners, const Options &opts) :
+        net(net), rank(rank){
+        if (owners.size() != net.components.size())
+            throw std::runtime_error("ShmPartition: " + std::to_string(owners.size()) + " owners given for " + std::to_string(net.components.size()) + " components");
+        numRanks = numRanksOf(owners);
+        if (rank >= numRanks)
+            throw std::runtime_error("ShmPartition: rank " + std::to_string(rank) + " owns no components");
+        net.finishBatches();
+        auto halo = haloTensors(net, owners);
+
+        // the same layout in every rank, since they build the same network
+        size_t offset = 0;
+        uint64_t hash = 14695981039346656037ull;
+        for(auto &h : halo){
+            size_t bytes = haloTensorBytes(*h.t);
+            if (h.owner == rank)
+                outgoing.push_back({h.t, offset, bytes});
+            else if (std::binary_search(h.readers.begin(), h.readers.end(), rank))
+                incoming.push_back({h.t, offset, bytes});
+            for(uint64_t v : {uint64_t(bytes), uint64_t(h.owner)})
+                hash = (hash ^ v) * 1099511628211ull;
+            offset += (bytes + 63) / 64 * 64;
+        }
+        region = std::make_unique<ShmHaloRegion>(name, rank, numRanks, offset, hash, opts.timeout);
+        for(size_t i=0; i < owners.size(); i++)
+            net.components[i]->local = owners[i] == rank;
+    }
+
+    template<typename TL>
+    ShmPartition<TL>::~ShmPartition(){
+        for(auto &c : net.components)
+            c->local = true;
+    }
+
+    template<typename TL>
+    void ShmPartition<TL>::exchange(){
+        net.finishBatches();
+        char *buffer = region->buffer(exchanges % 2);
+        for(Slot &s : outgoing)
+            writeHaloTensor(*s.t, buffer + s.offset);
+        region->barrier();
+        for(Slot &s : incoming)
+            readHaloTensor(*s.t, buffer + s.offset);
+        exchanges++;
+    }
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef SHM_REGION_HPP_
+#define SHM_REGION_HPP_
+
+#include <string>
+#include <cstddef>
+
+namespace llrt{
+
+    /**
+       A POSIX shared-memory object mapped into memory, for exchanging
+       data with other processes. The process that creates it removes
+       its name when the ShmRegion is destroyed; processes that have
+       it mapped keep their mapping.
+
+       Throws std::runtime_error if the object can't be created,
+       opened or mapped.
+     */
+    class ShmRegion{
+    public:
+        /**
+           Create a zero-filled region of the given size, replacing
+           any existing one with the same name.
+
+           @param name a name of the form "/something"
+         */
+        ShmRegion(const std::string &name, size_t bytes);
+
+        /// attach to an existing region created by another ShmRegion
+        ShmRegion(const std::string &name);
+
+        ~ShmRegion();
+
+        ShmRegion(const ShmRegion &) = delete;
+        ShmRegion &operator=(const ShmRegion &) = delete;
+
+        char *data() const{
+            return static_cast<char *>(addr);
+        }
+
+        size_t size() const{
+            return len;
+        }
+
+        const std::string &getName() const{
+            return name;
+        }
+
+    private:
+        std::string name;
+        void *addr = nullptr;
+        size_t len = 0;
+        bool owner;
+
+        void map(int fd);
+    };
+}
+
+#endif
@@ -0,0 +1,395 @@
+#ifndef SHM_REPLICAS_HPP_
+#define SHM_REPLICAS_HPP_
+
+#include "checkpoint.hpp"
+#include "shm_region.hpp"
+#include <chrono>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace llrt{
+
+    /**
+       Layout of the region shared by the replicas of a
+       ShmReplicaAverager:
+
+       header (64 bytes): "LLRTSHMW", u32 version, u32 number of
+       replicas, u64 number of values, u64 values per chunk, u64 hash
+       of the layout of the values.
+
+       a 64-byte line for each replica: atomic u64 count of chunks it
+       has written, over all rounds, and atomic u64 count of rounds
+       whose result it has applied.
+
+       atomic u64 for each chunk: the number of rounds reduced.
+
+       a slot of doubles for each replica, holding its values, then
+       the result, each 64-byte aligned.
+     */
+    struct ShmReplicaHeader{
+        char magic[8];
+        uint32_t version;
+        uint32_t numReplicas;
+        uint64_t numValues;
+        uint64_t chunkValues;
+        uint64_t layoutHash;
+    };
+
+    /**
+       The shared-memory region and chunk protocol of a
+       ShmReplicaAverager, which don't depend on the Network's types.
+
+       Each round, every replica writes its values to its slot, chunk
+       by chunk; the reducer of each chunk (replica chunk % number of
+       replicas) sums it over the slots, in replica order, into the
+       result. So every replica gets the same bits, and the work of
+       reducing is split between them.
+     */
+    class ShmReplicaRegion{
+    public:
+        /**
+           Replica 0 creates the region, replacing any existing one
+           with the same name; the others wait for it to appear, and
+           check that it has the same layout. Throws
+           std::runtime_error on a mismatch, or after the timeout.
+         */
+        ShmReplicaRegion(const std::string &name, size_t replica, size_t numReplicas, size_t numValues, size_t chunkValues, uint64_t layoutHash, std::chrono::milliseconds timeout);
+
+        size_t numChunks() const{
+            return chunks;
+        }
+
+        size_t chunkValues() const{
+            return header()->chunkValues;
+        }
+
+        /// the slot of a replica
+        double *slot(size_t r) const;
+
+        double *result() const;
+
+        /**
+           Wait until chunk of slot(this replica) can be written for
+           round, that is until the chunk's result of the round before
+           has been computed (which needed this replica's values).
+         */
+        void waitWritable(uint64_t round, size_t chunk);
+
+        /// chunks of slot(this replica) up to and including chunk are written for round
+        void wrote(uint64_t round, size_t chunk);
+
+        /**
+           Reduce chunk for round: wait until every replica has
+           written it, and has applied the result of the round before,
+           then sum it (or average it) into the result.
+
+           @return false if stop became true while waiting
+         */
+        bool reduce(uint64_t round, size_t chunk, bool average, const std::atomic<bool> &stop);
+
+        /// wait until the result of chunk is reduced for round
+        void waitReduced(uint64_t round, size_t chunk);
+
+        /// this replica has applied the result of round
+        void applied(uint64_t round);
+
+    private:
+        std::unique_ptr<ShmRegion> region;
+        size_t replica, numReplicas, chunks;
+        std::chrono::milliseconds timeout;
+
+        ShmReplicaHeader *header() const{
+            return reinterpret_cast<ShmReplicaHeader *>(region->data());
+        }
+        std::atomic<uint64_t> &written(size_t r) const;
+        std::atomic<uint64_t> &appliedRounds(size_t r) const;
+        std::atomic<uint64_t> &reduced(size_t chunk) const;
+        /// spin, then yield, until done() or the timeout
+        template<typename Done>
+        bool waitFor(Done &&done, const char *what, const std::atomic<bool> *stop = nullptr);
+    };
+
+    /**
+       Keeps the weights of replicas of a Network the same, for
+       data-parallel learning: R processes (or threads) each build the
+       same Network and feed it different inputs, and every so often
+       average the link ends' values through shared memory. The
+       averaging is split into chunks that the replicas reduce in
+       parallel, and runs in the background while the network
+       continues:
+
+       ShmReplicaAverager<TL> avg(net, "/mynet-run1", replica, R);
+       for(size_t t=0; t < steps; t++){
+           ... learn from this replica's inputs ...
+           if (t % 100 == 99)
+               avg.average();
+       }
+
+       After average() every replica has the same values, bit for bit,
+       so they don't drift apart. To overlap the averaging with
+       computation, use beginAverage(), which takes a snapshot of the
+       values, and endAverage(), which adds the average minus the
+       snapshot to the values: changes made in between are kept on top
+       of the average.
+
+       By default the values of every link end of float or double are
+       averaged; Options::select chooses others.
+
+       @tparam TL the Network's types
+     */
+    template<typename TL>
+    class ShmReplicaAverager{
+    public:
+        struct Options{
+            /// values per chunk, the unit of work of the reduction
+            size_t chunkValues = 1 << 16;
+            /// sum the values instead of averaging them
+            bool sum = false;
+            /// whether to average the values of whichEnd of a link
+            std::function<bool(Link<TL> &l, int whichEnd)> select;
+            /// how long to wait for the other replicas
+            std::chrono::milliseconds timeout{60000};
+        };
+
+        /**
+           @param name a shared-memory name of the form "/something",
+           unique to the run, the same in every replica
+           @param replica this replica, from 0
+         */
+        ShmReplicaAverager(Network<TL> &net, const std::string &name, size_t replica, size_t numReplicas);
+        ShmReplicaAverager(Network<TL> &net, const std::string &name, size_t replica, size_t numReplicas, const Options &opts);
+
+        ~ShmReplicaAverager();
+
+        ShmReplicaAverager(const ShmReplicaAverager &) = delete;
+        ShmReplicaAverager &operator=(const ShmReplicaAverager &) = delete;
+
+        /**
+           Finish the operations submitted so far, and share a snapshot
+           of this replica's values. Returns once the snapshot is
+           taken; the reduction continues in the background.
+         */
+        void beginAverage();
+
+        /**
+           Finish the operations submitted so far, wait for the
+           average, and add it, minus the snapshot, to the values.
+           Throws std::runtime_error if another replica doesn't take
+           part within the timeout.
+         */
+        void endAverage();
+
+        /// beginAverage() then endAverage()
+        void average(){
+            beginAverage();
+            endAverage();
+        }
+
+        /**
+           beginAverage(), then submit operations to run while the
+           reduction proceeds, then endAverage().
+
+           @return the batch number interior() returns
+         */
+        template<typename Interior>
+        size_t average(Interior &&interior){
+            beginAverage();
+            size_t batch = interior();
+            endAverage();
+            return batch;
+        }
+
+        /// the number of values averaged
+        size_t numValues() const{
+            return values;
+        }
+
+        /// the number of rounds completed
+        uint64_t rounds() const{
+            return round;
+        }
+
+        size_t getReplica() const{
+            return replica;
+        }
+
+    private:
+        using TType = TLTypes<TL>::TType;
+
+        Network<TL> &net;
+        size_t replica, numReplicas;
+        Options opts;
+        std::vector<Tensor<TType> *> tensors;
+        size_t values = 0;
+        std::unique_ptr<ShmReplicaRegion> region;
+        uint64_t round = 0;
+        bool averaging = false;
+
+        std::thread reducer;
+        std::mutex mtx;
+        std::condition_variable cv;
+        /// rounds begun, and rounds this replica has reduced its chunks of
+        uint64_t begun = 0, reducedRounds = 0;
+        std::atomic<bool> stop{false};
+        std::exception_ptr error;
+
+        void reduceLoop();
+
+        /**
+           Call f(value, index) for each averaged value, in order;
+           before the first value of each chunk, call chunk(chunkIndex).
+         */
+        template<typename F, typename C>
+        void forEachValue(F &&f, C &&chunk);
+    };
+
+    template<typename TL>
+    ShmReplicaAverager<TL>::ShmReplicaAverager(Network<TL> &net, const std::string &name, size_t replica, size_t numReplicas) :
+        ShmReplicaAverager(net, name, replica, numReplicas, Options()){}
+
+    template<typename TL>
+    ShmReplicaAverager<TL>::ShmReplicaAverager(Network<TL> &net, const std::string &name, size_t replica, size_t numReplicas, const Options &opts) :
+        net(net), replica(replica), numReplicas(numReplicas), opts(opts){
+        if (replica >= numReplicas)
+            throw std::runtime_error("ShmReplicaAverager: replica " + std::to_string(replica) + " of only " + std::to_string(numReplicas));
+        if (opts.chunkValues == 0)
+            throw std::runtime_error("ShmReplicaAverager: chunks must hold at least one value");
+        net.finishBatches();
+        uint64_t hash = 14695981039346656037ull;
+        for(Link<TL> *l : checkpointLinks(net))
+            for(int e=0; e < 2; e++){
+                Tensor<TType> &t = l->ends[e].data;
+                bool floating = std::visit([](auto &vec){
+                    return std::is_floating_point_v<typename std::decay_t<decltype(vec)>::value_type>;
+                }, t.values);
+                if (t.noData || !floating || (opts.select && !opts.select(*l, e)))
+                    continue;
+                tensors.push_back(&t);
+                size_t n = t.numValues();
+                values += n;
+                hash = (hash ^ n) * 1099511628211ull;
+            }
+        region = std::make_unique<ShmReplicaRegion>(name, replica, numReplicas, values, opts.chunkValues, hash, opts.timeout);
+        reducer = std::thread([this]{reduceLoop();});
+    }
+
+    template<typename TL>
+    ShmReplicaAverager<TL>::~ShmReplicaAverager(){
+        stop = true;
+        cv.notify_all();
+        reducer.join();
+    }
+
+    template<typename TL>
+    void ShmReplicaAverager<TL>::reduceLoop(){
+        std::unique_lock<std::mutex> lck(mtx);
+        while(true){
+            cv.wait(lck, [this]{return stop || begun > reducedRounds;});
+            if (stop)
+                return;
+            uint64_t r = reducedRounds;
+            lck.unlock();
+            try{
+                for(size_t chunk=replica; chunk < region->numChunks(); chunk += numReplicas)
+                    if (!region->reduce(r, chunk, !opts.sum, stop))
+                        return;
+            }
+            catch(...){
+                lck.lock();
+                error = std::current_exception();
+                reducedRounds++;
+                cv.notify_all();
+                return;
+            }
+            lck.lock();
+            reducedRounds++;
+            cv.notify_all();
+        }
+    }
+
+    template<typename TL>
+    template<typename F, typename C>
+    void ShmReplicaAverager<TL>::forEachValue(F &&f, C &&chunk){
+        size_t chunkValues = region->chunkValues(), i = 0;
+        for(Tensor<TType> *t : tensors){
+            // values never allocated are T(), and stay unallocated unless f changes one
+            bool unallocated = t->unallocated();
+            size_t n = t->numValues();
+            std::visit([&](auto &vec){
+                using T = std::decay_t<decltype(vec)>::value_type;
+                if constexpr(std::is_floating_point_v<T>)
+                    for(size_t j=0; j < n; j++){
+                        if (i % chunkValues == 0)
+                            chunk(i / chunkValues);
+                        if (!unallocated){
+                            f(vec[j], i++);
+                            continue;
+                        }
+                        T v = T();
+                        f(v, i++);
+                        if (v != T()){
+                            t->materialize();
+                            unallocated = false;
+                            vec[j] = v;
+                        }
+                    }
+            }, t->values);
+        }
+    }
+
+    template<typename TL>
+    void ShmReplicaAverager<TL>::beginAverage(){
+        if (averaging)
+            throw std::runtime_error("ShmReplicaAverager: beginAverage() called twice without endAverage()");
+        net.finishBatches();
+        double *slot = region->slot(replica);
+        size_t chunkValues = region->chunkValues();
+        forEachValue([slot, chunkValues, this](auto &v, size_t i){
+            slot[i] = v;
+            if ((i + 1) % chunkValues == 0 || i + 1 == values)
+                region->wrote(round, i / chunkValues);
+        }, [this](size_t chunk){
+            region->waitWritable(round, chunk);
+        });
+        averaging = true;
+        std::unique_lock<std::mutex> lck(mtx);
+        begun++;
+        cv.notify_all();
+    }
+
+    template<typename TL>
+    void ShmReplicaAverager<TL>::endAverage(){
+        if (!averaging)
+            throw std::runtime_error("ShmReplicaAverager: endAverage() called without beginAverage()");
+        averaging = false;
+        net.finishBatches();
+        const double *slot = region->slot(replica), *result = region->result();
+        forEachValue([slot, result](auto &v, size_t i){
+            using T = std::decay_t<decltype(v)>;
+            // when nothing changed since the snapshot, exactly the result
+            if (v == static_cast<T>(slot[i]))
+                v = static_cast<T>(result[i]);
+            else
+                v = static_cast<T>(v + (result[i] - slot[i]));
+        }, [this](size_t chunk){
+            region->waitReduced(round, chunk);
+        });
+        {
+            std::unique_lock<std::mutex> lck(mtx);
+            cv.wait(lck, [this]{return reducedRounds == begun;});
+            if (error)
+                std::rethrow_exception(error);
+        }
+        // so that incremental checkpoints see the averaged values
+        for(Tensor<TType> *t : tensors)
+            t->written = true;
+        region->applied(round);
+        round++;
+    }
+}
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef SPIKE_STREAM_HPP_
+#define SPIKE_STREAM_HPP_
+
+/**
+   Compact recordings of spikes and state traces.
+
+   A spike stream file holds, for each timestep with any activity,
+   the sorted indices of the nodes that spiked, encoded either as
+   varint gaps between successive indices or as a bitset over all the
+   nodes, whichever is smaller. Timesteps with no spikes take no
+   space, so the file grows with activity rather than with the size
+   of the network. It can also hold traces of a fixed number of float
+   values per timestep (membrane potentials, say), each value stored
+   as the varint of its bits XORed with its value at the previous
+   trace, so values that change slowly take a byte or two.
+
+   Layout: "LLRTSPKS", u32 version, u32 unused, u64 number of nodes,
+   u64 trace width, then records, each a tag byte (1 for spikes, 2
+   for a trace) and the varint of the timestep minus the timestep of
+   the previous record, followed by
+   - spikes: varint count, an encoding byte (0 for gaps, 1 for a
+     bitset), then the gaps (the first index, then each index minus
+     the previous one) or the bitset
+   - trace: the trace width varints
+   All fixed-size fields are little-endian.
+ */
+
+#include "incremental_checkpoint.hpp"
+#include "mapped_file.hpp"
+#include <atomic>
+#include <fstream>
+#include <map>
+
+namespace llrt{
+
+    const uint32_t spikeStreamVersion = 1;
+
+    /**
+       Writes a spike stream file. Spikes can be recorded from inside
+       kernels running on any number of worker threads: each thread
+       appends to its own buffer, and endStep() gathers the buffers,
+       encodes the timestep, and passes full blocks to a background
+       thread that writes them to the file.
+
+       Spikes recorded with record() are assigned to the timestep of
+       the next call to endStep(), which must only be called once the
+       operations that recorded them have finished (after
+       finishBatch), and never while an operation that records into
+       this writer is running.
+
+       SpikeStreamWriter spikes("run.spikes", neurons.data.size());
+       for(size_t t=0; t < steps; t++){
+           ProcessCmp_NNi(neurons, [&](IFNeuron &N, const size_t Ni){
+               if (N.v > 1){
+                   N.v = 0;
+                   spikes.record(Ni);
+               }
+           });
+           spikes.endStep(t);
+       }
+     */
+    class SpikeStreamWriter{
+    public:
+        struct Options{
+            /// values per trace record; 0 if trace() isn't used
+            size_t traceWidth = 0;
+            /// encoded bytes to gather before handing them to the writer thread
+            size_t blockBytes = 1 << 20;
+        };
+
+        /**
+           @param numNodes the number of nodes that can spike; indices
+           passed to record() must be smaller
+
+           Throws std::runtime_error if the file can't be opened.
+         */
+        SpikeStreamWriter(const std::string &filename, size_t numNodes);
+        SpikeStreamWriter(const std::string &filename, size_t numNodes, const Options &opts);
+
+        /// closes the file, ignoring any error; call close() to see errors
+        ~SpikeStreamWriter();
+
+        SpikeStreamWriter(const SpikeStreamWriter &) = delete;
+        SpikeStreamWriter &operator=(const SpikeStreamWriter &) = delete;
+
+        /// record a spike of the given node; safe to call from several threads at once
+        void record(size_t node){
+            threadBuffer().push_back(node);
+        }
+
+        /**
+           Encode the spikes recorded since the last call as
+           timestep step, which must be at least the step of the last
+           record. Does nothing if there were no spikes.
+         */
+        void endStep(uint64_t step);
+
+        /// record spikes directly from the client, as for record() then endStep()
+        void spikes(uint64_t step, const std::vector<size_t> &nodes);
+
+        /// record Options::traceWidth values for timestep step
+        void trace(uint64_t step, const float *values);
+
+        /**
+           Hand everything encoded so far to the writer thread, and
+           wait for it to be written. Throws std::runtime_error if a
+           write failed.
+         */
+        void flush();
+
+        /// flush, then close the file
+        void close();
+
+        /// bytes encoded so far, including the header
+        uint64_t bytesEncoded() const{
+            return encoded;
+        }
+
+    private:
+        size_t numNodes;
+        Options opts;
+        std::ofstream out;
+        std::string filename;
+        bool closed = false;
+
+        /// distinguishes this writer from earlier ones at the same address
+        uint64_t serial;
+        std::mutex buffersMtx;
+        std::map<std::thread::id, std::unique_ptr<std::vector<size_t> > > buffers;
+
+        std::string block;
+        std::vector<size_t> stepNodes;
+        std::vector<uint32_t> lastTrace;
+        uint64_t lastStep = 0;
+        uint64_t encoded = 0;
+
+        CheckpointWriterThread writer;
+
+        std::vector<size_t> &threadBuffer();
+        void beginRecord(unsigned char tag, uint64_t step);
+        void encodeSpikes(uint64_t step, std::vector<size_t> &nodes);
+        void submitBlock();
+    };
+
+    /// one timestep of a spike stream file
+    struct SpikeStreamRecord{
+        enum Kind{Spikes = 1, Trace = 2};
+        Kind kind;
+        uint64_t step;
+        /// sorted indices of the nodes that spiked, for Spikes
+        std::vector<size_t> nodes;
+        /// for Trace
+        std::vector<float> values;
+    };
+
+    /**
+       Reads a spike stream file, one record at a time, from a memory
+       mapping of it. Throws std::runtime_error if the file is not a
+       spike stream or is corrupt.
+
+       SpikeStreamReader r("run.spikes");
+       SpikeStreamRecord rec;
+       while(r.next(rec))
+           if (rec.kind == SpikeStreamRecord::Spikes)
+               for(size_t n : rec.nodes)
+                   ...
+     */
+    class SpikeStreamReader{
+    public:
+        SpikeStreamReader(const std::string &filename);
+
+        size_t numNodes() const{
+            return nodes;
+        }
+
+        size_t traceWidth() const{
+            return width;
+        }
+
+        /// read the next record into rec; false at the end of the file
+        bool next(SpikeStreamRecord &rec);
+
+        /// (timestep, node) for every spike in the rest of the file, skipping traces
+        std::vector<std::pair<uint64_t, size_t> > allSpikes();
+
+    private:
+        MappedFile file;
+        std::string filename;
+        size_t nodes, width;
+        size_t pos;
+        uint64_t lastStep = 0;
+        std::vector<uint32_t> lastTrace;
+
+        uint64_t varint();
+    };
+}
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef TOPOLOGY_CACHE_HPP_
+#define TOPOLOGY_CACHE_HPP_
+
+#include "checkpoint.hpp"
+#include <map>
+#include <memory>
+
+namespace llrt{
+
+    /**
+       A file of the index structures of a Network's links (see
+       BaseLinkType::saveTopology), such as the row tables of
+       GeneralLocal2DLinks and the adjacency of AdjListLinks, so that
+       building the same Network again can load them instead of
+       computing them.
+
+       Each link's entry is keyed by its identifier, the dimensions of
+       its ends, and its topologyParams(); links without such params
+       (AdjListLink) are also keyed by their position in the Network.
+       Build the Network's components and links as usual, then:
+
+       TopologyCache cache("net.topo");
+       if (!cache.load(net)){
+           adj.insertEdges(...); // only needed if the cache missed
+           cache.save(net);
+       }
+
+       Layout: "LLRTTOPO", u32 version, u32 unused, u64 number of
+       entries, then for each entry its key (u64 length and bytes),
+       u64 offset and u64 size of its data from the start of the
+       data, which follows the entries. Native byte order.
+     */
+    class TopologyCache{
+    public:
+        /**
+           Map the cache file, if it exists. Throws
+           std::runtime_error if it exists but is not a topology
+           cache.
+         */
+        TopologyCache(const std::string &filename);
+
+        /**
+           Load the index structures of every link of the Network
+           from the cache, if it has an entry for every link. If any
+           is missing, loads nothing (so that code building the links
+           can run as if there were no cache).
+
+           @return true if the links were loaded
+         */
+        template<typename TL>
+        bool load(Network<TL> &net);
+
+        /**
+           Write the index structures of every link of the Network to
+           the cache file, computing them if need be, and keep any
+           entries for other links. The file is replaced only once the
+           new one is complete.
+         */
+        template<typename TL>
+        void save(Network<TL> &net);
+
+        /// the cache key of each link, in checkpoint order
+        template<typename TL>
+        static std::vector<std::string> keys(Network<TL> &net);
+
+        bool contains(const std::string &key) const{
+            return entries.count(key) != 0;
+        }
+
+        size_t size() const{
+            return entries.size();
+        }
+
+    private:
+        std::string filename;
+        std::unique_ptr<MappedFile> file;
+        struct Entry{
+            const char *data;
+            size_t bytes;
+        };
+        std::map<std::string, Entry> entries;
+
+        void write(const std::map<std::string, std::string> &newEntries);
+    };
+
+    template<typename TL>
+    std::vector<std::string> TopologyCache::keys(Network<TL> &net){
+        std::vector<std::string> result;
+        std::vector<Link<TL> *> links = checkpointLinks(net);
+        for(size_t i=0; i < links.size(); i++){
+            Link<TL> &l = *links[i];
+            std::optional<std::string> params = std::visit([](auto &t){return t.topologyParams();}, l.type);
+            std::string key = l.identifier() + " " + listDimensions(l.ends[0].c.data.dimensions) + " " + listDimensions(l.ends[1].c.data.dimensions) + " ";
+            key += params ? *params : "link " + std::to_string(i);
+            result.push_back(key);
+        }
+        return result;
+    }
+
+    template<typename TL>
+    bool TopologyCache::load(Network<TL> &net){
+        net.finishBatches();
+        std::vector<std::string> k = keys(net);
+        for(const std::string &key : k)
+            if (!contains(key))
+                return false;
+        std::vector<Link<TL> *> links = checkpointLinks(net);
+        for(size_t i=0; i < links.size(); i++){
+            const Entry &e = entries.at(k[i]);
+            std::visit([&](auto &t){t.loadTopology(e.data, e.bytes);}, links[i]->type);
+        }
+        return true;
+    }
+
+    template<typename TL>
+    void TopologyCache::save(Network<TL> &net){
+        net.finishBatches();
+        std::map<std::string, std::string> newEntries;
+        for(auto &e : entries)
+            newEntries[e.first].assign(e.second.data, e.second.bytes);
+        std::vector<std::string> k = keys(net);
+        std::vector<Link<TL> *> links = checkpointLinks(net);
+        for(size_t i=0; i < links.size(); i++){
+            std::string &out = newEntries[k[i]];
+            out.clear();
+            std::visit([&](auto &t){t.saveTopology(out);}, links[i]->type);
+        }
+        write(newEntries);
+    }
+}
+
+#endif
@@ -0,0 +1,300 @@
+#include "checkpoint.hpp"
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+namespace llrt{
+
+    namespace{
+        const char checkpointMagic[8] = {'L', 'L', 'R', 'T', 'C', 'K', 'P', 'T'};
+        const char deltaMagic[8] = {'L', 'L', 'R', 'T', 'D', 'L', 'T', 'A'};
+        // magic, version, alignment, header bytes, payload start
+        const size_t preambleBytes = 8 + 4 + 4 + 8 + 8;
+
+        struct HeaderWriter{
+            std::string &out;
+
+            void raw(const void *p, size_t bytes){
+                out.append(static_cast<const char *>(p), bytes);
+            }
+            void u64(uint64_t v){
+                raw(&v, sizeof(v));
+            }
+            void str(const std::string &s){
+                u64(s.size());
+                raw(s.data(), s.size());
+            }
+            void dims(const std::vector<index_t> &d){
+                u64(d.size());
+                for(index_t i : d)
+                    u64(i);
+            }
+            void tensor(const CheckpointTensor &t){
+                u64(static_cast<uint64_t>(t.typeTag));
+                dims(t.dimensions);
+                u64(t.count);
+                u64(t.offset);
+                u64(t.bytes);
+            }
+        };
+
+        struct HeaderReader{
+            const char *p, *end;
+
+            void raw(void *dst, size_t bytes){
+                if (static_cast<size_t>(end - p) < bytes)
+                    throw std::runtime_error("Checkpoint header is truncated");
+                std::memcpy(dst, p, bytes);
+                p += bytes;
+            }
+            uint64_t u64(){
+                uint64_t v;
+                raw(&v, sizeof(v));
+                return v;
+            }
+            /// a count of items of at least minBytes each, checked against the bytes left
+            uint64_t count(size_t minBytes){
+                uint64_t n = u64();
+                if (n > static_cast<size_t>(end - p) / minBytes)
+                    throw std::runtime_error("Checkpoint header is truncated");
+                return n;
+            }
+            std::string str(){
+                std::string s(count(1), '\0');
+                raw(s.data(), s.size());
+                return s;
+            }
+            std::vector<index_t> dims(){
+                std::vector<index_t> d(count(sizeof(uint64_t)));
+                for(index_t &i : d)
+                    i = u64();
+                return d;
+            }
+            CheckpointTensor tensor(){
+                CheckpointTensor t;
+                t.typeTag = static_cast<int64_t>(u64());
+                t.dimensions = dims();
+                t.count = u64();
+                t.offset = u64();
+                t.bytes = u64();
+                return t;
+            }
+        };
+    }
+
+    std::string CheckpointHeader::encode() const{
+        std::string out;
+        HeaderWriter w{out};
+        w.u64(valueTypes.size());
+        for(const ValueType &vt : valueTypes){
+            w.str(vt.name);
+            w.u64(vt.size);
+        }
+        w.str(rngState);
+        w.u64(components.size());
+        for(const CheckpointComponent &c : components){
+            w.str(c.name);
+            w.u64(static_cast<uint64_t>(c.id));
+            w.tensor(c.data);
+        }
+        w.u64(links.size());
+        for(const CheckpointLink &l : links){
+            w.u64(l.id);
+            w.str(l.identifier);
+            w.u64(l.cmp[0]);
+            w.u64(l.cmp[1]);
+            w.u64(l.end0IsAxon);
+            w.tensor(l.ends[0]);
+            w.tensor(l.ends[1]);
+            w.u64(l.stateOffset);
+            w.u64(l.stateBytes);
+        }
+        return out;
+    }
+
+    namespace{
+        CheckpointHeader decodeHeader(HeaderReader &r){
+            CheckpointHeader h;
+            h.valueTypes.resize(r.count(2 * sizeof(uint64_t)));
+            for(CheckpointHeader::ValueType &vt : h.valueTypes){
+                vt.name = r.str();
+                vt.size = r.u64();
+            }
+            h.rngState = r.str();
+            h.components.resize(r.count(sizeof(uint64_t)));
+            for(CheckpointComponent &c : h.components){
+                c.name = r.str();
+                c.id = static_cast<int64_t>(r.u64());
+                c.data = r.tensor();
+            }
+            h.links.resize(r.count(sizeof(uint64_t)));
+            for(size_t i=0; i < h.links.size(); i++){
+                CheckpointLink &l = h.links[i];
+                l.id = r.u64();
+                l.identifier = r.str();
+                l.cmp[0] = r.u64();
+                l.cmp[1] = r.u64();
+                l.end0IsAxon = r.u64() != 0;
+                l.ends[0] = r.tensor();
+                l.ends[1] = r.tensor();
+                l.stateOffset = r.u64();
+                l.stateBytes = r.u64();
+                if (l.cmp[0] >= h.components.size() || l.cmp[1] >= h.components.size())
+                    throw std::runtime_error("Checkpoint header has link " + std::to_string(i) + " to a nonexistent component");
+            }
+            auto checkTag = [&](const CheckpointTensor &t){
+                if (t.typeTag < -1 || t.typeTag >= static_cast<int64_t>(h.valueTypes.size()))
+                    throw std::runtime_error("Checkpoint header has an invalid type tag " + std::to_string(t.typeTag));
+            };
+            for(CheckpointComponent &c : h.components)
+                checkTag(c.data);
+            for(CheckpointLink &l : h.links){
+                checkTag(l.ends[0]);
+                checkTag(l.ends[1]);
+            }
+            return h;
+        }
+    }
+
+    CheckpointHeader CheckpointHeader::decode(const char *data, size_t size){
+        HeaderReader r{data, data + size};
+        return decodeHeader(r);
+    }
+
+    CheckpointTensor &CheckpointHeader::tensor(size_t index){
+        if (index < components.size())
+            return components[index].data;
+        index -= components.size();
+        return links.at(index / 2).ends[index % 2];
+    }
+
+    namespace{
+        void encodeDelta(std::string &out, const CheckpointDelta &delta){
+            HeaderWriter w{out};
+            w.u64(delta.sequence);
+            w.u64(delta.previousSequence);
+            w.u64(delta.chunkBytes);
+            w.u64(delta.chunks.size());
+            for(const std::vector<uint64_t> &c : delta.chunks){
+                w.u64(c.size());
+                for(uint64_t i : c)
+                    w.u64(i);
+            }
+            w.u64(delta.linkStateChanged.size());
+            for(bool b : delta.linkStateChanged)
+                w.u64(b);
+        }
+
+        CheckpointDelta decodeDelta(HeaderReader &r){
+            CheckpointDelta delta;
+            delta.sequence = r.u64();
+            delta.previousSequence = r.u64();
+            delta.chunkBytes = r.u64();
+            if (delta.chunkBytes == 0)
+                throw std::runtime_error("Checkpoint delta has a chunk size of 0");
+            delta.chunks.resize(r.count(sizeof(uint64_t)));
+            for(std::vector<uint64_t> &c : delta.chunks){
+                c.resize(r.count(sizeof(uint64_t)));
+                for(uint64_t &i : c)
+                    i = r.u64();
+            }
+            delta.linkStateChanged.resize(r.count(sizeof(uint64_t)));
+            for(size_t i=0; i < delta.linkStateChanged.size(); i++)
+                delta.linkStateChanged[i] = r.u64() != 0;
+            return delta;
+        }
+    }
+
+    uint64_t checkpointChunksBytes(const std::vector<uint64_t> &chunks, uint64_t chunkBytes, uint64_t totalBytes){
+        uint64_t bytes = 0;
+        uint64_t nChunks = (totalBytes + chunkBytes - 1) / chunkBytes;
+        for(size_t i=0; i < chunks.size(); i++){
+            if (chunks[i] >= nChunks || (i > 0 && chunks[i] <= chunks[i-1]))
+                throw std::runtime_error("Checkpoint is corrupt: a delta has a chunk out of range");
+            bytes += std::min(chunkBytes, totalBytes - chunks[i] * chunkBytes);
+        }
+        return bytes;
+    }
+
+    void patchCheckpointChunks(char *dst, uint64_t bytesSize, const std::vector<uint64_t> &chunks, uint64_t chunkBytes, const char *src){
+        for(uint64_t c : chunks){
+            uint64_t start = c * chunkBytes;
+            uint64_t bytes = std::min(chunkBytes, bytesSize - start);
+            std::memcpy(dst + start, src, bytes);
+            src += bytes;
+        }
+    }
+
+    void writeCheckpointFile(const std::string &filename, const CheckpointHeader &header, const std::vector<CheckpointPayload> &payloads, const CheckpointDelta *delta){
+        std::ofstream f(filename, std::ios::binary | std::ios::trunc);
+        if (!f)
+            throw std::runtime_error("Couldn't open " + filename + " for writing");
+
+        std::string headerBytes = header.encode();
+        if (delta)
+            encodeDelta(headerBytes, *delta);
+        uint64_t payloadStart = checkpointPayloadOffset(preambleBytes, headerBytes.size());
+        std::string preamble;
+        HeaderWriter w{preamble};
+        w.raw(delta ? deltaMagic : checkpointMagic, sizeof(checkpointMagic));
+        uint32_t version = checkpointVersion, alignment = checkpointAlignment;
+        w.raw(&version, sizeof(version));
+        w.raw(&alignment, sizeof(alignment));
+        w.u64(headerBytes.size());
+        w.u64(payloadStart);
+        f.write(preamble.data(), preamble.size());
+        f.write(headerBytes.data(), headerBytes.size());
+
+        const std::string padding(checkpointAlignment, '\0');
+        uint64_t pos = preambleBytes + headerBytes.size();
+        for(const CheckpointPayload &p : payloads){
+            // pad up to the start of the payload
+            uint64_t start = checkpointPayloadOffset(pos, 0);
+            f.write(padding.data(), start - pos);
+            f.write(p.data, p.bytes);
+            pos = start + p.bytes;
+        }
+        f.write(padding.data(), checkpointPayloadOffset(pos, 0) - pos);
+        f.close();
+        if (!f)
+            throw std::runtime_error("Couldn't write " + filename);
+    }
+
+    MappedCheckpoint::MappedCheckpoint(const std::string &filename) : file(filename){
+        HeaderReader r{file.data(), file.data() + file.size()};
+        char magic[sizeof(checkpointMagic)];
+        uint32_t version, alignment;
+        try{
+            r.raw(magic, sizeof(magic));
+            r.raw(&version, sizeof(version));
+            r.raw(&alignment, sizeof(alignment));
+        }
+        catch(std::runtime_error &){
+            throw std::runtime_error(filename + " is not a checkpoint");
+        }
+        bool isDelta = std::memcmp(magic, deltaMagic, sizeof(magic)) == 0;
+        if (!isDelta && std::memcmp(magic, checkpointMagic, sizeof(magic)) != 0)
+            throw std::runtime_error(filename + " is not a checkpoint");
+        if (version != checkpointVersion)
+            throw std::runtime_error(filename + " is a version " + std::to_string(version) + " checkpoint, but only version " + std::to_string(checkpointVersion) + " is supported");
+        if (alignment != checkpointAlignment)
+            throw std::runtime_error(filename + " has payload alignment " + std::to_string(alignment) + ", but only " + std::to_string(checkpointAlignment) + " is supported");
+        uint64_t headerBytes = r.u64();
+        payloadStart = r.u64();
+        if (headerBytes > static_cast<size_t>(r.end - r.p) || payloadStart < preambleBytes + headerBytes || payloadStart > file.size())
+            throw std::runtime_error("Checkpoint header of " + filename + " is truncated");
+        HeaderReader hr{r.p, r.p + headerBytes};
+        header = decodeHeader(hr);
+        if (isDelta)
+            delta = decodeDelta(hr);
+    }
+
+    const char *MappedCheckpoint::payload(uint64_t offset, uint64_t bytes) const{
+        if (bytes == 0)
+            return nullptr;
+        uint64_t available = file.size() - payloadStart;
+        if (offset % checkpointAlignment != 0 || offset > available || bytes > available - offset)
+            throw std::runtime_error("Checkpoint is truncated: a payload is past the end of the file");
+        return file.data() + payloadStart + offset;
+    }
+}
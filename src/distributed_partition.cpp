@@ -0,0 +1,55 @@
+#include "distributed_partition.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+namespace llrt{
+
+    namespace{
+        void putVarint(std::string &out, uint64_t v){
+            while(v >= 0x80){
+                out += static_cast<char>((v & 0x7f) | 0x80);
+                v >>= 7;
+            }
+            out += static_cast<char>(v);
+        }
+
+        uint64_t getVarint(const char *&p, const char *end){
+            uint64_t v = 0;
+            for(int shift=0; shift < 64; shift += 7){
+                if (p >= end)
+                    throw std::runtime_error("Spike indices are truncated");
+                unsigned char c = *p++;
+                v |= uint64_t(c & 0x7f) << shift;
+                if (!(c & 0x80))
+                    return v;
+            }
+            throw std::runtime_error("Spike indices are corrupt: a varint is too long");
+        }
+    }
+
+    void encodeSpikeIndices(const std::vector<bool> &spikes, std::string &out){
+        size_t count = std::count(spikes.begin(), spikes.end(), true);
+        putVarint(out, count);
+        // gaps from one past the previous index, so the first is the index itself
+        size_t next = 0;
+        for(size_t i=0; i < spikes.size(); i++)
+            if (spikes[i]){
+                putVarint(out, i - next);
+                next = i + 1;
+            }
+    }
+
+    const char *decodeSpikeIndices(const char *p, const char *end, std::vector<bool> &spikes){
+        std::fill(spikes.begin(), spikes.end(), false);
+        uint64_t count = getVarint(p, end);
+        size_t next = 0;
+        for(uint64_t i=0; i < count; i++){
+            uint64_t gap = getVarint(p, end);
+            if (next >= spikes.size() || gap >= spikes.size() - next)
+                throw std::runtime_error("Spike indices are corrupt: an index is out of range");
+            spikes[next + gap] = true;
+            next += gap + 1;
+        }
+        return p;
+    }
+}
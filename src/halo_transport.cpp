@@ -0,0 +1,285 @@
+#include "halo_transport.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace llrt{
+
+    namespace{
+        /// how often a receiving thread checks whether to stop, when there's nothing to read
+        const int receivePollMs = 20;
+
+        void splitAddress(const std::string &address, std::string &host, std::string &port){
+            size_t colon = address.rfind(':');
+            if (colon == std::string::npos)
+                throw std::runtime_error("TcpTransport: address " + address + " is not of the form host:port");
+            host = address.substr(0, colon);
+            port = address.substr(colon + 1);
+        }
+
+        struct AddrInfo{
+            addrinfo *info = nullptr;
+            AddrInfo(const std::string &address, bool passive){
+                std::string host, port;
+                splitAddress(address, host, port);
+                addrinfo hints;
+                std::memset(&hints, 0, sizeof(hints));
+                hints.ai_family = AF_INET;
+                hints.ai_socktype = SOCK_STREAM;
+                hints.ai_flags = passive ? AI_PASSIVE : 0;
+                int err = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &info);
+                if (err != 0)
+                    throw std::runtime_error("TcpTransport: can't resolve " + address + ": " + gai_strerror(err));
+            }
+            ~AddrInfo(){
+                freeaddrinfo(info);
+            }
+        };
+
+        /// false on EOF or error
+        bool writeAll(int fd, const char *p, size_t bytes){
+            while(bytes > 0){
+                ssize_t n = ::send(fd, p, bytes, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                p += n;
+                bytes -= n;
+            }
+            return true;
+        }
+
+        bool readAll(int fd, char *p, size_t bytes){
+            while(bytes > 0){
+                ssize_t n = ::recv(fd, p, bytes, 0);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                p += n;
+                bytes -= n;
+            }
+            return true;
+        }
+
+        void setNoDelay(int fd){
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+    }
+
+    TcpTransport::TcpTransport(size_t rank, size_t numRanks, const std::string &listenAddress) :
+        TcpTransport(rank, numRanks, listenAddress, Options()){}
+
+    TcpTransport::TcpTransport(size_t rank, size_t numRanks, const std::string &listenAddress, const Options &opts) : myRank(rank), n(numRanks), opts(opts){
+        if (rank >= numRanks)
+            throw std::runtime_error("TcpTransport: rank " + std::to_string(rank) + " of only " + std::to_string(numRanks));
+        for(size_t r=0; r < numRanks; r++)
+            peers.push_back(std::make_unique<Peer>());
+        AddrInfo addr(listenAddress, true);
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0)
+            throw std::runtime_error(std::string("TcpTransport: can't create a socket: ") + std::strerror(errno));
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(listenFd, addr.info->ai_addr, addr.info->ai_addrlen) != 0 || listen(listenFd, numRanks) != 0){
+            int err = errno;
+            close(listenFd);
+            throw std::runtime_error("TcpTransport: can't listen on " + listenAddress + ": " + std::strerror(err));
+        }
+        sockaddr_in bound;
+        socklen_t len = sizeof(bound);
+        getsockname(listenFd, reinterpret_cast<sockaddr *>(&bound), &len);
+        listenPort = ntohs(bound.sin_port);
+    }
+
+    TcpTransport::~TcpTransport(){
+        for(auto &p : peers){
+            std::unique_lock<std::mutex> lck(p->mtx);
+            p->closing = true;
+            lck.unlock();
+            p->cv.notify_all();
+        }
+        // send what's left, then tell the other rank we're done
+        for(auto &p : peers){
+            if (p->sender.joinable())
+                p->sender.join();
+            if (p->fd >= 0)
+                shutdown(p->fd, SHUT_WR);
+            std::unique_lock<std::mutex> lck(p->mtx);
+            p->stopReceiving = true;
+        }
+        for(auto &p : peers){
+            if (p->receiver.joinable())
+                p->receiver.join();
+            if (p->fd >= 0)
+                close(p->fd);
+        }
+        if (listenFd >= 0)
+            close(listenFd);
+    }
+
+    TcpTransport::Peer &TcpTransport::peer(size_t r){
+        if (r >= n || r == myRank || peers[r]->fd < 0)
+            throw std::runtime_error("TcpTransport: rank " + std::to_string(myRank) + " is not connected to rank " + std::to_string(r));
+        return *peers[r];
+    }
+
+    void TcpTransport::connect(const std::vector<std::string> &addresses, std::chrono::milliseconds timeout){
+        if (addresses.size() != n)
+            throw std::runtime_error("TcpTransport: " + std::to_string(addresses.size()) + " addresses given for " + std::to_string(n) + " ranks");
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        uint64_t me = myRank;
+        // the ranks before this one are already listening, or soon will be
+        for(size_t r=0; r < myRank; r++){
+            AddrInfo addr(addresses[r], false);
+            while(true){
+                int fd = socket(AF_INET, SOCK_STREAM, 0);
+                if (fd < 0)
+                    throw std::runtime_error(std::string("TcpTransport: can't create a socket: ") + std::strerror(errno));
+                if (::connect(fd, addr.info->ai_addr, addr.info->ai_addrlen) == 0){
+                    setNoDelay(fd);
+                    if (!writeAll(fd, reinterpret_cast<const char *>(&me), sizeof(me))){
+                        close(fd);
+                        throw std::runtime_error("TcpTransport: lost the connection to rank " + std::to_string(r) + " at " + addresses[r]);
+                    }
+                    startPeer(r, fd);
+                    break;
+                }
+                close(fd);
+                if (std::chrono::steady_clock::now() > deadline)
+                    throw std::runtime_error("TcpTransport: timed out connecting to rank " + std::to_string(r) + " at " + addresses[r]);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+        // the ranks after this one connect to it, in any order
+        for(size_t accepted=0; accepted < n - 1 - myRank; accepted++){
+            pollfd pfd{listenFd, POLLIN, 0};
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0 || poll(&pfd, 1, left.count()) <= 0)
+                throw std::runtime_error("TcpTransport: timed out waiting for the other ranks to connect to rank " + std::to_string(myRank));
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0)
+                throw std::runtime_error(std::string("TcpTransport: accept failed: ") + std::strerror(errno));
+            setNoDelay(fd);
+            uint64_t r;
+            if (!readAll(fd, reinterpret_cast<char *>(&r), sizeof(r)) || r <= myRank || r >= n || peers[r]->fd >= 0){
+                close(fd);
+                throw std::runtime_error("TcpTransport: rank " + std::to_string(myRank) + " got a connection from an unexpected peer");
+            }
+            startPeer(r, fd);
+        }
+    }
+
+    void TcpTransport::startPeer(size_t r, int fd){
+        Peer &p = *peers[r];
+        p.fd = fd;
+        p.sender = std::thread([this, &p]{sendLoop(p);});
+        p.receiver = std::thread([this, &p]{receiveLoop(p);});
+    }
+
+    void TcpTransport::sendLoop(Peer &p){
+        std::unique_lock<std::mutex> lck(p.mtx);
+        while(true){
+            p.cv.wait(lck, [&p]{return p.closing || !p.outgoing.empty();});
+            if (p.outgoing.empty())
+                return; // closing, and everything has been sent
+            std::string msg = std::move(p.outgoing.front());
+            p.outgoing.pop_front();
+            lck.unlock();
+            uint64_t len = msg.size();
+            bool ok = writeAll(p.fd, reinterpret_cast<const char *>(&len), sizeof(len)) && writeAll(p.fd, msg.data(), msg.size());
+            lck.lock();
+            if (!ok){
+                p.error = std::make_exception_ptr(std::runtime_error("TcpTransport: lost the connection while sending"));
+                p.cv.notify_all();
+                return;
+            }
+        }
+    }
+
+    void TcpTransport::receiveLoop(Peer &p){
+        while(true){
+            // keep reading whatever arrives until the destructor stops
+            // us, so that closing doesn't discard unread data (which
+            // would reset the connection)
+            pollfd pfd{p.fd, POLLIN, 0};
+            int ready = poll(&pfd, 1, receivePollMs);
+            if (ready == 0){
+                std::unique_lock<std::mutex> lck(p.mtx);
+                if (p.stopReceiving)
+                    return;
+                continue;
+            }
+            if (ready < 0 && errno == EINTR)
+                continue;
+            uint64_t len;
+            std::string msg;
+            bool ok = ready > 0 && readAll(p.fd, reinterpret_cast<char *>(&len), sizeof(len));
+            if (ok && len > opts.maxMessageBytes){
+                // a corrupt stream, or a peer that isn't a TcpTransport
+                std::unique_lock<std::mutex> lck(p.mtx);
+                p.error = std::make_exception_ptr(std::runtime_error("TcpTransport: rank " + std::to_string(myRank) + " got a message of " + std::to_string(len) + " bytes, more than the maximum of " + std::to_string(opts.maxMessageBytes)));
+                p.cv.notify_all();
+                return;
+            }
+            if (ok){
+                msg.resize(len);
+                ok = readAll(p.fd, msg.data(), len);
+            }
+            std::unique_lock<std::mutex> lck(p.mtx);
+            if (!ok){
+                p.eof = true;
+                p.cv.notify_all();
+                return;
+            }
+            p.incoming.push_back(std::move(msg));
+            p.cv.notify_all();
+        }
+    }
+
+    void TcpTransport::send(size_t to, std::string msg){
+        Peer &p = peer(to);
+        {
+            std::unique_lock<std::mutex> statsLck(statsMtx);
+            sent += msg.size();
+        }
+        std::unique_lock<std::mutex> lck(p.mtx);
+        if (p.error)
+            std::rethrow_exception(p.error);
+        p.outgoing.push_back(std::move(msg));
+        lck.unlock();
+        p.cv.notify_all();
+    }
+
+    std::string TcpTransport::receive(size_t from){
+        Peer &p = peer(from);
+        std::unique_lock<std::mutex> lck(p.mtx);
+        auto ready = [&p]{return !p.incoming.empty() || p.eof || p.error;};
+        if (opts.receiveTimeout.count() == 0)
+            p.cv.wait(lck, ready);
+        else if (!p.cv.wait_for(lck, opts.receiveTimeout, ready))
+            throw std::runtime_error("TcpTransport: rank " + std::to_string(myRank) + " timed out waiting for a message from rank " + std::to_string(from));
+        // messages that arrived before the connection broke are still whole
+        if (p.incoming.empty()){
+            if (p.error)
+                std::rethrow_exception(p.error);
+            throw std::runtime_error("TcpTransport: rank " + std::to_string(from) + " closed the connection to rank " + std::to_string(myRank));
+        }
+        std::string msg = std::move(p.incoming.front());
+        p.incoming.pop_front();
+        return msg;
+    }
+
+    size_t TcpTransport::bytesSent() const{
+        std::unique_lock<std::mutex> lck(statsMtx);
+        return sent;
+    }
+}
@@ -0,0 +1,143 @@
+#include "incremental_checkpoint.hpp"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+
+namespace llrt{
+
+    void CheckpointChain::save(const std::string &filename) const{
+        std::string tmp = filename + ".tmp";
+        {
+            std::ofstream f(tmp, std::ios::trunc);
+            if (!f)
+                throw std::runtime_error("Couldn't open " + tmp + " for writing");
+            f << "llrt-checkpoint-chain 1\n";
+            for(size_t i=0; i < entries.size(); i++)
+                f << (i == 0 ? "base " : "delta ") << entries[i].sequence << " " << entries[i].filename << "\n";
+            f.close();
+            if (!f)
+                throw std::runtime_error("Couldn't write " + tmp);
+        }
+        if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+            throw std::runtime_error("Couldn't replace " + filename + ": " + std::strerror(errno));
+    }
+
+    CheckpointChain CheckpointChain::load(const std::string &filename){
+        std::ifstream f(filename);
+        if (!f)
+            throw std::runtime_error("Couldn't open " + filename + " for reading");
+        std::string line;
+        if (!std::getline(f, line) || line != "llrt-checkpoint-chain 1")
+            throw std::runtime_error(filename + " is not a checkpoint chain (bad header)");
+        CheckpointChain chain;
+        while(std::getline(f, line)){
+            if (line.empty())
+                continue;
+            std::stringstream st(line);
+            std::string kind;
+            Entry e;
+            st >> kind >> e.sequence >> e.filename;
+            if (st.fail() || kind != (chain.entries.empty() ? "base" : "delta"))
+                throw std::runtime_error(filename + ": malformed line: " + line);
+            chain.entries.push_back(e);
+        }
+        return chain;
+    }
+
+    std::string checkpointChainPath(const std::string &chainFilename, const std::string &filename){
+        return (std::filesystem::path(chainFilename).parent_path() / filename).string();
+    }
+
+    CheckpointWriterThread::CheckpointWriterThread(){
+        thread = std::thread(&CheckpointWriterThread::run, this);
+    }
+
+    CheckpointWriterThread::~CheckpointWriterThread(){
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            waitIdle(lock);
+            stop = true;
+        }
+        cv.notify_all();
+        thread.join();
+    }
+
+    void CheckpointWriterThread::waitIdle(std::unique_lock<std::mutex> &lock){
+        cv.wait(lock, [this]{return !busy;});
+    }
+
+    void CheckpointWriterThread::submit(std::function<void()> write){
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            waitIdle(lock);
+            if (error){
+                std::exception_ptr e = error;
+                error = nullptr;
+                std::rethrow_exception(e);
+            }
+            pending = std::move(write);
+            busy = true;
+        }
+        cv.notify_all();
+    }
+
+    void CheckpointWriterThread::wait(){
+        std::unique_lock<std::mutex> lock(mtx);
+        waitIdle(lock);
+        if (error){
+            std::exception_ptr e = error;
+            error = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+    void CheckpointWriterThread::run(){
+        std::unique_lock<std::mutex> lock(mtx);
+        while(true){
+            cv.wait(lock, [this]{return stop || pending;});
+            if (stop)
+                return;
+            std::function<void()> write = std::move(pending);
+            pending = nullptr;
+            lock.unlock();
+            std::exception_ptr e;
+            try{
+                write();
+            }
+            catch(...){
+                e = std::current_exception();
+            }
+            lock.lock();
+            error = e;
+            busy = false;
+            cv.notify_all();
+        }
+    }
+
+    uint64_t checkpointChunkHash(const char *data, size_t bytes){
+        // four independent lanes of multiply-xorshift mixing, so that
+        // hashing runs at close to memory bandwidth
+        const uint64_t k = 0x9E3779B97F4A7C15ull;
+        uint64_t h[4] = {k ^ bytes, k * 3, k * 5, k * 7};
+        auto mix = [](uint64_t x){
+            x ^= x >> 31;
+            x *= 0xBF58476D1CE4E5B9ull;
+            x ^= x >> 29;
+            return x;
+        };
+        size_t i = 0;
+        for(; i + 32 <= bytes; i += 32){
+            uint64_t w[4];
+            std::memcpy(w, data + i, 32);
+            for(int j=0; j < 4; j++)
+                h[j] = mix(h[j] ^ w[j]);
+        }
+        char tail[32] = {};
+        std::memcpy(tail, data + i, bytes - i);
+        uint64_t w[4];
+        std::memcpy(w, tail, 32);
+        for(int j=0; j < 4; j++)
+            h[j] = mix(h[j] ^ w[j]);
+        return mix(h[0] ^ mix(h[1] ^ mix(h[2] ^ mix(h[3]))));
+    }
+}
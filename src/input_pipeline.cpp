@@ -0,0 +1,257 @@
+#include "input_pipeline.hpp"
+#include "npy.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace llrt{
+
+    namespace{
+        bool hostIsLittleEndian(){
+            uint16_t one = 1;
+            unsigned char first;
+            std::memcpy(&first, &one, 1);
+            return first == 1;
+        }
+
+        /// convert n values of type T, stored with the given byte order, to floats
+        template<typename T>
+        void convertValues(const char *src, float *dst, size_t n, bool littleEndian){
+            bool swap = sizeof(T) > 1 && littleEndian != hostIsLittleEndian();
+            for(size_t i=0; i < n; i++){
+                char bytes[sizeof(T)];
+                std::memcpy(bytes, src + i * sizeof(T), sizeof(T));
+                if (swap)
+                    std::reverse(bytes, bytes + sizeof(T));
+                T v;
+                std::memcpy(&v, bytes, sizeof(T));
+                dst[i] = static_cast<float>(v);
+            }
+        }
+
+        uint32_t readBigEndian32(const char *p){
+            const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+            return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | uint32_t(u[3]);
+        }
+
+        /// throw if the data after the header is too short for the given frames
+        void checkDataSize(const std::string &what, size_t available, size_t frames, size_t size, size_t valueBytes){
+            if (size != 0 && frames > available / size / valueBytes)
+                throw std::runtime_error(what + " is shorter than its header says");
+        }
+    }
+
+    IdxInputSource::IdxInputSource(const std::string &filename) : file(filename){
+        if (file.size() < 4 || file.data()[0] != 0 || file.data()[1] != 0)
+            throw std::runtime_error(filename + " is not an IDX file");
+        typeCode = static_cast<unsigned char>(file.data()[2]);
+        size_t nDims = static_cast<unsigned char>(file.data()[3]);
+        switch(typeCode){
+        case 0x08: case 0x09: valueBytes = 1; break;
+        case 0x0B: valueBytes = 2; break;
+        case 0x0C: case 0x0D: valueBytes = 4; break;
+        case 0x0E: valueBytes = 8; break;
+        default:
+            throw std::runtime_error(filename + " has unknown IDX type code " + std::to_string(typeCode));
+        }
+        if (nDims == 0)
+            throw std::runtime_error(filename + " is an IDX file with no dimensions");
+        headerBytes = 4 + 4 * nDims;
+        if (file.size() < headerBytes)
+            throw std::runtime_error(filename + " is not an IDX file");
+        frames = readBigEndian32(file.data() + 4);
+        for(size_t i=1; i < nDims; i++){
+            dims.push_back(readBigEndian32(file.data() + 4 + 4 * i));
+            size *= dims.back();
+        }
+        checkDataSize(filename, file.size() - headerBytes, frames, size, valueBytes);
+    }
+
+    void IdxInputSource::read(size_t i, float *dst){
+        size_t frameBytes = size * valueBytes;
+        const char *src = file.data() + headerBytes + i * frameBytes;
+        file.willNeed(headerBytes + (i + 1) * frameBytes, frameBytes);
+        switch(typeCode){
+        case 0x08: convertValues<uint8_t>(src, dst, size, false); break;
+        case 0x09: convertValues<int8_t>(src, dst, size, false); break;
+        case 0x0B: convertValues<int16_t>(src, dst, size, false); break;
+        case 0x0C: convertValues<int32_t>(src, dst, size, false); break;
+        case 0x0D: convertValues<float>(src, dst, size, false); break;
+        case 0x0E: convertValues<double>(src, dst, size, false); break;
+        }
+    }
+
+    NpyInputSource::NpyInputSource(const std::string &filename) : file(filename){
+        NpyHeader h = parseNpyHeader(file.data(), file.size(), filename);
+        dataOffset = h.dataOffset;
+        std::string descr = h.scalarDescr();
+        if (descr.size() < 3)
+            throw std::runtime_error(filename + " has unsupported dtype " + h.descr);
+        char order = descr[0];
+        kind = descr[1];
+        valueBytes = descr.find_first_not_of("0123456789", 2) == std::string::npos ? std::stoul(descr.substr(2)) : 0;
+        bool supported = (kind == 'f' && (valueBytes == 4 || valueBytes == 8)) ||
+            ((kind == 'i' || kind == 'u') && (valueBytes == 1 || valueBytes == 2 || valueBytes == 4 || valueBytes == 8));
+        if (!supported || (order == '>' && valueBytes > 1) || (order == '=' && !hostIsLittleEndian()))
+            throw std::runtime_error(filename + " has unsupported dtype " + h.descr);
+        if (h.fortranOrder)
+            throw std::runtime_error(filename + " is in Fortran order; only C order is supported");
+        if (h.shape.empty())
+            throw std::runtime_error(filename + " holds a scalar, not an array of frames");
+        frames = h.shape[0];
+        dims.assign(h.shape.begin() + 1, h.shape.end());
+        for(size_t d : dims)
+            size *= d;
+        checkDataSize(filename, file.size() - dataOffset, frames, size, valueBytes);
+    }
+
+    void NpyInputSource::read(size_t i, float *dst){
+        size_t frameBytes = size * valueBytes;
+        const char *src = file.data() + dataOffset + i * frameBytes;
+        file.willNeed(dataOffset + (i + 1) * frameBytes, frameBytes);
+        if (kind == 'f'){
+            if (valueBytes == 4)
+                convertValues<float>(src, dst, size, true);
+            else
+                convertValues<double>(src, dst, size, true);
+        }
+        else if (kind == 'i'){
+            switch(valueBytes){
+            case 1: convertValues<int8_t>(src, dst, size, true); break;
+            case 2: convertValues<int16_t>(src, dst, size, true); break;
+            case 4: convertValues<int32_t>(src, dst, size, true); break;
+            case 8: convertValues<int64_t>(src, dst, size, true); break;
+            }
+        }
+        else{
+            switch(valueBytes){
+            case 1: convertValues<uint8_t>(src, dst, size, true); break;
+            case 2: convertValues<uint16_t>(src, dst, size, true); break;
+            case 4: convertValues<uint32_t>(src, dst, size, true); break;
+            case 8: convertValues<uint64_t>(src, dst, size, true); break;
+            }
+        }
+    }
+
+    InputPipeline::InputPipeline(std::unique_ptr<InputSource> source) :
+        InputPipeline(std::move(source), Options()){}
+
+    InputPipeline::InputPipeline(std::unique_ptr<InputSource> source, const Options &opts) :
+        source(std::move(source)), opts(opts){
+        if (!this->source)
+            throw std::runtime_error("InputPipeline needs a source");
+        if (opts.ringSize == 0)
+            throw std::runtime_error("InputPipeline needs a ring of at least 1 frame");
+        if (this->source->numFrames() > 0 && opts.start >= this->source->numFrames())
+            throw std::runtime_error("InputPipeline: start frame " + std::to_string(opts.start) + " is past the end of the source");
+        slots.resize(opts.ringSize);
+        for(Slot &s : slots)
+            s.values.resize(this->source->frameSize());
+        sourceDone = this->source->numFrames() == 0;
+        loader = std::thread(&InputPipeline::load, this);
+    }
+
+    InputPipeline::~InputPipeline(){
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        loader.join();
+    }
+
+    void InputPipeline::load(){
+        size_t frame = opts.start;
+        std::unique_lock<std::mutex> lock(mtx);
+        while(true){
+            cv.wait(lock, [&](){return stop || sourceDone || slots[loadSlot].state == Free;});
+            if (stop || sourceDone)
+                return;
+            Slot &slot = slots[loadSlot];
+            slot.state = Loading;
+            lock.unlock();
+            try{
+                float *v = slot.values.data();
+                source->read(frame, v);
+                if (opts.scale != 1 || opts.offset != 0)
+                    for(size_t i=0; i < slot.values.size(); i++)
+                        v[i] = v[i] * opts.scale + opts.offset;
+                if (opts.preprocess)
+                    opts.preprocess(v, slot.values.size(), frame);
+            }
+            catch(...){
+                lock.lock();
+                error = std::current_exception();
+                slot.state = Free;
+                cv.notify_all();
+                return;
+            }
+            lock.lock();
+            slot.state = Ready;
+            slot.frameNumber = frame;
+            loadSlot = (loadSlot + 1) % slots.size();
+            if (++frame == source->numFrames()){
+                frame = 0;
+                sourceDone = !opts.loop;
+            }
+            cv.notify_all();
+        }
+    }
+
+    void InputPipeline::freeFinished(std::function<bool(size_t)> finished){
+        bool freed = false;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            for(Slot &s : slots)
+                if (s.state == InUse && finished(s.batch)){
+                    s.state = Free;
+                    freed = true;
+                }
+        }
+        if (freed)
+            cv.notify_all();
+    }
+
+    bool InputPipeline::slotInUse(size_t i){
+        std::unique_lock<std::mutex> lock(mtx);
+        return slots[i].state == InUse;
+    }
+
+    size_t InputPipeline::slotBatch(size_t i){
+        std::unique_lock<std::mutex> lock(mtx);
+        return slots[i].batch;
+    }
+
+    const float *InputPipeline::takeFrame(){
+        std::unique_lock<std::mutex> lock(mtx);
+        Slot &slot = slots[next];
+        // the loader fills the slots in order, so once the source is
+        // done, a slot that isn't loaded or being loaded never will be
+        cv.wait(lock, [&](){return slot.state == Ready || error || (sourceDone && slot.state == Free);});
+        if (slot.state != Ready){
+            if (error)
+                std::rethrow_exception(error);
+            done = true;
+            return nullptr;
+        }
+        slot.state = InUse;
+        slot.batch = 0;
+        lastFrameNumber = slot.frameNumber;
+        next = (next + 1) % slots.size();
+        return slot.values.data();
+    }
+
+    void InputPipeline::setBatch(size_t batch){
+        std::unique_lock<std::mutex> lock(mtx);
+        slots[(next + slots.size() - 1) % slots.size()].batch = batch;
+    }
+
+    bool InputPipeline::exhausted(){
+        std::unique_lock<std::mutex> lock(mtx);
+        return done;
+    }
+
+    size_t InputPipeline::frameNumber(){
+        std::unique_lock<std::mutex> lock(mtx);
+        return lastFrameNumber;
+    }
+}
@@ -0,0 +1,66 @@
+#include "isa_dispatch.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace llrt{
+
+    namespace{
+        IsaLevel detectIsaLevel(){
+#ifdef LLRT_MULTIVERSION
+            __builtin_cpu_init();
+            bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt");
+            if (!avx2)
+                return IsaLevel::Baseline;
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512cd"))
+                return IsaLevel::AVX512;
+            return IsaLevel::AVX2;
+#else
+            return IsaLevel::Baseline;
+#endif
+        }
+
+        IsaLevel initialIsaLevel(){
+            IsaLevel level = supportedIsaLevel();
+            const char *env = std::getenv("LLRT_ISA");
+            if (env == nullptr)
+                return level;
+            for(IsaLevel l : {IsaLevel::Baseline, IsaLevel::AVX2, IsaLevel::AVX512})
+                if (isaLevelName(l) == env)
+                    return std::min(l, level);
+            return level;
+        }
+
+        std::atomic<IsaLevel> &currentIsaLevel(){
+            static std::atomic<IsaLevel> level(initialIsaLevel());
+            return level;
+        }
+    }
+
+    std::string isaLevelName(IsaLevel level){
+        switch(level){
+        case IsaLevel::AVX2:
+            return "avx2";
+        case IsaLevel::AVX512:
+            return "avx512";
+        default:
+            return "baseline";
+        }
+    }
+
+    IsaLevel supportedIsaLevel(){
+        static const IsaLevel level = detectIsaLevel();
+        return level;
+    }
+
+    IsaLevel isaLevel(){
+        return currentIsaLevel().load(std::memory_order_relaxed);
+    }
+
+    void setIsaLevel(IsaLevel level){
+        if (level > supportedIsaLevel())
+            throw std::runtime_error("Can't run link operations at " + isaLevelName(level) + ": this build or CPU only supports " + isaLevelName(supportedIsaLevel()));
+        currentIsaLevel().store(level, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,51 @@
+#include "mapped_file.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace llrt{
+
+    MappedFile::MappedFile(const std::string &filename){
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Couldn't open " + filename + " for reading: " + std::strerror(errno));
+        struct stat st;
+        if (fstat(fd, &st) != 0){
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("Couldn't stat " + filename + ": " + std::strerror(err));
+        }
+        len = st.st_size;
+        if (len > 0){
+            addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED){
+                int err = errno;
+                close(fd);
+                addr = nullptr;
+                throw std::runtime_error("Couldn't map " + filename + ": " + std::strerror(err));
+            }
+        }
+        // the mapping keeps its own reference to the file
+        close(fd);
+    }
+
+    MappedFile::~MappedFile(){
+        if (addr != nullptr)
+            munmap(addr, len);
+    }
+
+    void MappedFile::willNeed(size_t offset, size_t bytes) const{
+        if (addr == nullptr || offset >= len)
+            return;
+        // madvise needs a page-aligned start
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t start = offset - offset % page;
+        bytes = std::min(bytes + (offset - start), len - start);
+        madvise(static_cast<char *>(addr) + start, bytes, MADV_WILLNEED);
+    }
+}
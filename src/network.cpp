@@ -10,6 +10,18 @@ namespace llrt{
         return JobOptions<NOpT3>{false, true, true, name};
     }
 
+    const JobOptions<NOpT3> DeterministicCombine(size_t blockProgress){
+        if (blockProgress == 0)
+            throw std::runtime_error("DeterministicCombine: blocks must have some progress");
+        return JobOptions<NOpT3>{false, true, true, "", false, false, NullOption, NullOption, NullOption, blockProgress};
+    }
+
+    const JobOptions<NOpT3> AlignProgress(size_t multiple){
+        if (multiple == 0)
+            throw std::runtime_error("AlignProgress: the multiple must be positive");
+        return JobOptions<NOpT3>{false, true, true, "", false, false, NullOption, NullOption, NullOption, 0, multiple};
+    }
+
     std::string listDimensions(std::vector<index_t> dims){
         std::string s = "(";
         for (size_t i=0; i < dims.size(); i++){
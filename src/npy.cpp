@@ -0,0 +1,233 @@
+#include "npy.hpp"
+#include <cstring>
+#include <map>
+#include <algorithm>
+
+namespace llrt{
+
+    namespace{
+        const char npyMagic[6] = {'\x93', 'N', 'U', 'M', 'P', 'Y'};
+
+        std::string trim(const std::string &s){
+            size_t start = s.find_first_not_of(" \t\n");
+            if (start == std::string::npos)
+                return "";
+            return s.substr(start, s.find_last_not_of(" \t\n") + 1 - start);
+        }
+
+        /**
+           The entries of the Python dict literal in an npy header, as
+           key -> value literal
+         */
+        std::map<std::string, std::string> parseDict(const std::string &header, const std::string &filename){
+            std::map<std::string, std::string> entries;
+            std::string h = trim(header);
+            if (h.size() < 2 || h.front() != '{' || h.back() != '}')
+                throw std::runtime_error(filename + " has a malformed npy header");
+            size_t pos = 1;
+            while(true){
+                pos = h.find_first_not_of(" \t\n", pos);
+                if (pos == std::string::npos || h[pos] == '}')
+                    break;
+                char quote = h[pos];
+                size_t keyEnd = h.find(quote, pos + 1);
+                size_t colon = keyEnd == std::string::npos ? keyEnd : h.find(':', keyEnd);
+                if ((quote != '\'' && quote != '"') || colon == std::string::npos)
+                    throw std::runtime_error(filename + " has a malformed npy header");
+                std::string key = h.substr(pos + 1, keyEnd - pos - 1);
+                // the value runs to the next comma outside brackets and quotes
+                size_t end = colon + 1;
+                int depth = 0;
+                char inQuote = 0;
+                for(; end < h.size() - 1; end++){
+                    char c = h[end];
+                    if (inQuote){
+                        if (c == inQuote)
+                            inQuote = 0;
+                    }
+                    else if (c == '\'' || c == '"')
+                        inQuote = c;
+                    else if (c == '(' || c == '[' || c == '{')
+                        depth++;
+                    else if (c == ')' || c == ']' || c == '}')
+                        depth--;
+                    else if (c == ',' && depth == 0)
+                        break;
+                }
+                entries[key] = trim(h.substr(colon + 1, end - colon - 1));
+                pos = end + 1;
+                if (end >= h.size() - 1)
+                    break;
+            }
+            return entries;
+        }
+
+        std::string dictEntry(const std::map<std::string, std::string> &entries, const std::string &key, const std::string &filename){
+            auto it = entries.find(key);
+            if (it == entries.end())
+                throw std::runtime_error(filename + " has no " + key + " in its npy header");
+            return it->second;
+        }
+
+        /// the header length field's size, from the major version
+        size_t npyLengthBytes(unsigned char major, const std::string &filename){
+            if (major == 1)
+                return 2;
+            if (major == 2 || major == 3)
+                return 4;
+            throw std::runtime_error(filename + " is an npy file of unsupported version " + std::to_string(major));
+        }
+
+        /// parse the dict of a header, knowing it starts at offset headerStart
+        NpyHeader parseNpyDict(const std::string &dict, size_t headerStart, const std::string &filename){
+            NpyHeader h;
+            h.dataOffset = headerStart + dict.size();
+            auto entries = parseDict(dict, filename);
+            h.descr = dictEntry(entries, "descr", filename);
+            std::string fortran = dictEntry(entries, "fortran_order", filename);
+            if (fortran != "False" && fortran != "True")
+                throw std::runtime_error(filename + " has a malformed fortran_order " + fortran);
+            h.fortranOrder = fortran == "True";
+
+            std::string shape = dictEntry(entries, "shape", filename);
+            if (shape.size() < 2 || shape.front() != '(' || shape.back() != ')')
+                throw std::runtime_error(filename + " has a malformed shape " + shape);
+            std::string rest = shape.substr(1, shape.size() - 2);
+            size_t pos = 0;
+            while(pos < rest.size()){
+                size_t comma = rest.find(',', pos);
+                std::string item = trim(rest.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos));
+                if (!item.empty()){
+                    if (item.find_first_not_of("0123456789") != std::string::npos)
+                        throw std::runtime_error(filename + " has a malformed shape " + shape);
+                    h.shape.push_back(std::stoull(item));
+                }
+                if (comma == std::string::npos)
+                    break;
+                pos = comma + 1;
+            }
+            return h;
+        }
+    }
+
+    size_t NpyHeader::count() const{
+        size_t n = 1;
+        for(size_t d : shape)
+            n *= d;
+        return n;
+    }
+
+    std::string NpyHeader::scalarDescr() const{
+        if (descr.size() < 2 || (descr.front() != '\'' && descr.front() != '"') || descr.back() != descr.front())
+            return "";
+        return descr.substr(1, descr.size() - 2);
+    }
+
+    NpyHeader parseNpyHeader(const char *data, size_t size, const std::string &filename){
+        if (size < 10 || std::memcmp(data, npyMagic, sizeof(npyMagic)) != 0)
+            throw std::runtime_error(filename + " is not an npy file");
+        size_t lengthBytes = npyLengthBytes(static_cast<unsigned char>(data[6]), filename);
+        size_t headerStart = 8 + lengthBytes;
+        if (size < headerStart)
+            throw std::runtime_error(filename + " is not an npy file");
+        size_t headerLen = 0;
+        for(size_t i=lengthBytes; i > 0; i--)
+            headerLen = (headerLen << 8) | static_cast<unsigned char>(data[8 + i - 1]);
+        if (size - headerStart < headerLen)
+            throw std::runtime_error(filename + " has a truncated npy header");
+        return parseNpyDict(std::string(data + headerStart, headerLen), headerStart, filename);
+    }
+
+    NpyHeader readNpyHeader(std::istream &f, const std::string &filename){
+        char preamble[12];
+        f.read(preamble, 10);
+        if (!f || std::memcmp(preamble, npyMagic, sizeof(npyMagic)) != 0)
+            throw std::runtime_error(filename + " is not an npy file");
+        size_t lengthBytes = npyLengthBytes(static_cast<unsigned char>(preamble[6]), filename);
+        if (lengthBytes == 4)
+            f.read(preamble + 10, 2);
+        size_t headerLen = 0;
+        for(size_t i=lengthBytes; i > 0; i--)
+            headerLen = (headerLen << 8) | static_cast<unsigned char>(preamble[8 + i - 1]);
+        std::string dict(headerLen, '\0');
+        f.read(dict.data(), dict.size());
+        if (!f)
+            throw std::runtime_error(filename + " has a truncated npy header");
+        return parseNpyDict(dict, 8 + lengthBytes, filename);
+    }
+
+    std::string encodeNpyHeader(const std::string &descr, const std::vector<size_t> &shape){
+        std::string dict = "{'descr': " + descr + ", 'fortran_order': False, 'shape': (";
+        for(size_t d : shape)
+            dict += std::to_string(d) + (shape.size() == 1 ? "," : ", ");
+        if (shape.size() > 1)
+            dict.resize(dict.size() - 2);
+        dict += "), }";
+        // version 1 has a 2-byte header length; version 2 a 4-byte one
+        bool v1 = 10 + dict.size() + 64 <= 0xffff;
+        size_t start = v1 ? 10 : 12;
+        size_t total = (start + dict.size() + 1 + 63) / 64 * 64;
+        dict.append(total - start - dict.size() - 1, ' ');
+        dict += '\n';
+
+        std::string out(npyMagic, sizeof(npyMagic));
+        out += static_cast<char>(v1 ? 1 : 2);
+        out += '\0';
+        for(size_t i=0; i < start - 8; i++)
+            out += static_cast<char>((dict.size() >> (8 * i)) & 0xff);
+        return out + dict;
+    }
+
+    char npyByteOrder(){
+        uint16_t one = 1;
+        unsigned char first;
+        std::memcpy(&first, &one, 1);
+        return first == 1 ? '<' : '>';
+    }
+
+    std::string npyStructDescr(std::vector<NpyField> fields, size_t itemSize){
+        std::sort(fields.begin(), fields.end(), [](const NpyField &a, const NpyField &b){
+            return a.offset < b.offset;
+        });
+        // numpy's list form, with unnamed void fields for padding
+        std::string descr = "[";
+        size_t offset = 0;
+        auto pad = [&](size_t to){
+            if (to > offset)
+                descr += "('', '|V" + std::to_string(to - offset) + "'), ";
+        };
+        for(const NpyField &f : fields){
+            if (f.offset < offset || f.offset + f.size > itemSize)
+                throw std::runtime_error("NpyFields: field " + f.name + " overlaps another field or the end of the struct");
+            pad(f.offset);
+            descr += "('" + f.name + "', " + f.descr + "), ";
+            offset = f.offset + f.size;
+        }
+        pad(itemSize);
+        if (descr.size() > 1)
+            descr.resize(descr.size() - 2);
+        return descr + "]";
+    }
+
+    void checkNpyType(const NpyHeader &h, size_t dataBytes, const std::string &descr, size_t size, size_t count, const std::string &filename){
+        if (h.fortranOrder)
+            throw std::runtime_error(filename + " is in Fortran order; only C order is supported");
+        if (h.count() != count)
+            throw std::runtime_error(filename + " holds " + std::to_string(h.count()) + " values, but " + std::to_string(count) + " are needed");
+        bool plain = descr.front() == '\'' && descr.compare(0, 3, "'|V") != 0;
+        if (h.descr != descr && (plain || (!h.scalarDescr().empty() && h.descr.compare(0, 3, "'|V") != 0)))
+            throw std::runtime_error(filename + " has dtype " + h.descr + ", but the values are of dtype " + descr);
+        if (dataBytes < count * size || (!plain && h.descr != descr && dataBytes != count * size))
+            throw std::runtime_error(filename + " doesn't hold " + std::to_string(count) + " values of " + std::to_string(size) + " bytes each");
+    }
+
+    NpyArray::NpyArray(const std::string &filename) : file(filename), filename(filename){
+        hdr = parseNpyHeader(file.data(), file.size(), filename);
+    }
+
+    void NpyArray::checkType(const std::string &descr, size_t size, size_t align) const{
+        checkNpyType(hdr, bytes(), descr, size, hdr.count(), filename);
+        if (reinterpret_cast<uintptr_t>(data()) % align != 0)
+            throw std::runtime_error(filename + ": the values aren't aligned for their type");
+    }
+}
@@ -0,0 +1,217 @@
+#include "partition_planner.hpp"
+#include <sstream>
+#include <iomanip>
+
+namespace llrt{
+
+    namespace{
+        const double eps = 1e-9;
+
+        /// the number of ranks, other than its owner's, that read a halo datum
+        size_t remoteReaders(const PartitionGraph::HaloData &d, const std::vector<size_t> &owners){
+            std::vector<size_t> ranks;
+            for(size_t r : d.readers)
+                if (owners[r] != owners[d.owner] && std::find(ranks.begin(), ranks.end(), owners[r]) == ranks.end())
+                    ranks.push_back(owners[r]);
+            return ranks.size();
+        }
+
+        /// the indices of the halo data each component owns or reads
+        std::vector<std::vector<size_t> > touching(const PartitionGraph &g){
+            std::vector<std::vector<size_t> > t(g.work.size());
+            for(size_t i=0; i < g.data.size(); i++){
+                t[g.data[i].owner].push_back(i);
+                for(size_t r : g.data[i].readers)
+                    t[r].push_back(i);
+            }
+            return t;
+        }
+
+        double overload(double load, double capacity){
+            return std::max(0.0, load - capacity);
+        }
+
+        /// grow each rank's part in turn; the last rank gets the rest
+        std::vector<size_t> growParts(const PartitionGraph &g, size_t numRanks, const PartitionOptions &opts, const std::vector<std::vector<size_t> > &touch){
+            size_t n = g.work.size();
+            const size_t unplaced = numRanks;
+            std::vector<size_t> owners(n, unplaced);
+            double remaining = 0;
+            for(double w : g.work)
+                remaining += w;
+            size_t numUnplaced = n;
+            for(size_t rank=0; rank + 1 < numRanks; rank++){
+                double target = remaining / (numRanks - rank), limit = target * (1 + opts.imbalance), load = 0;
+                // bytes exchanged between each unplaced component and this part
+                std::vector<double> conn(n, 0);
+                auto place = [&](size_t c){
+                    owners[c] = rank;
+                    load += g.work[c];
+                    remaining -= g.work[c];
+                    numUnplaced--;
+                    for(size_t i : touch[c]){
+                        const PartitionGraph::HaloData &d = g.data[i];
+                        if (d.owner == c){
+                            for(size_t r : d.readers)
+                                if (owners[r] == unplaced)
+                                    conn[r] += d.bytes;
+                        }
+                        else if (owners[d.owner] == unplaced)
+                            conn[d.owner] += d.bytes;
+                    }
+                };
+                auto heaviest = [&](bool mustFit){
+                    size_t best = n;
+                    for(size_t c=0; c < n; c++)
+                        if (owners[c] == unplaced && (!mustFit || load + g.work[c] <= limit) && (best == n || g.work[c] > g.work[best]))
+                            best = c;
+                    return best;
+                };
+                place(heaviest(false));
+                // leave at least one component for each of the other ranks
+                while(load < target && numUnplaced > numRanks - rank - 1){
+                    size_t best = n;
+                    for(size_t c=0; c < n; c++){
+                        if (owners[c] != unplaced || conn[c] <= 0 || load + g.work[c] > limit)
+                            continue;
+                        if (best == n || conn[c] > conn[best] || (conn[c] == conn[best] && g.work[c] > g.work[best]))
+                            best = c;
+                    }
+                    if (best == n)
+                        best = heaviest(true);
+                    if (best == n)
+                        break;
+                    place(best);
+                }
+            }
+            for(size_t &o : owners)
+                if (o == unplaced)
+                    o = numRanks - 1;
+            return owners;
+        }
+
+        /// move single components while that reduces the overload, or the traffic without adding overload
+        void refine(const PartitionGraph &g, size_t numRanks, const PartitionOptions &opts, const std::vector<std::vector<size_t> > &touch, std::vector<size_t> &owners){
+            size_t n = g.work.size();
+            std::vector<double> load(numRanks, 0);
+            std::vector<size_t> count(numRanks, 0);
+            double total = 0;
+            for(size_t c=0; c < n; c++){
+                load[owners[c]] += g.work[c];
+                count[owners[c]]++;
+                total += g.work[c];
+            }
+            double capacity = total / numRanks * (1 + opts.imbalance);
+            auto traffic = [&](size_t c){
+                double bytes = 0;
+                for(size_t i : touch[c])
+                    bytes += g.data[i].bytes * remoteReaders(g.data[i], owners);
+                return bytes;
+            };
+            for(size_t pass=0; pass < opts.passes; pass++){
+                bool moved = false;
+                for(size_t c=0; c < n; c++){
+                    size_t from = owners[c];
+                    if (count[from] == 1)
+                        continue;
+                    double before = traffic(c), w = g.work[c];
+                    size_t bestRank = from;
+                    double bestOver = 0, bestBytes = 0;
+                    for(size_t to=0; to < numRanks; to++){
+                        if (to == from)
+                            continue;
+                        double dOver = overload(load[from] - w, capacity) + overload(load[to] + w, capacity)
+                            - overload(load[from], capacity) - overload(load[to], capacity);
+                        owners[c] = to;
+                        double dBytes = traffic(c) - before;
+                        owners[c] = from;
+                        bool better = dOver < -eps || (dOver <= eps && dBytes < -eps);
+                        bool best = bestRank == from || dOver < bestOver - eps || (dOver <= bestOver + eps && dBytes < bestBytes - eps);
+                        if (better && best){
+                            bestRank = to;
+                            bestOver = dOver;
+                            bestBytes = dBytes;
+                        }
+                    }
+                    if (bestRank != from){
+                        owners[c] = bestRank;
+                        load[from] -= w;
+                        load[bestRank] += w;
+                        count[from]--;
+                        count[bestRank]++;
+                        moved = true;
+                    }
+                }
+                if (!moved)
+                    break;
+            }
+        }
+    }
+
+    double PartitionPlan::imbalance() const{
+        double total = 0, most = 0;
+        for(double l : load){
+            total += l;
+            most = std::max(most, l);
+        }
+        return total > 0 ? most * load.size() / total : 1;
+    }
+
+    std::string PartitionPlan::report() const{
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(0);
+        for(size_t r=0; r < load.size(); r++){
+            out << "rank " << r << ": load " << load[r] << ",";
+            for(size_t c=0; c < owners.size(); c++)
+                if (owners[c] == r)
+                    out << " " << (c < names.size() && !names[c].empty() ? names[c] : "#" + std::to_string(c));
+            out << "\n";
+        }
+        for(size_t from=0; from < bytes.size(); from++)
+            for(size_t to=0; to < bytes[from].size(); to++)
+                if (bytes[from][to] > 0)
+                    out << "rank " << from << " -> rank " << to << ": " << bytes[from][to] << " bytes\n";
+        out << "total " << totalBytes << " bytes per exchange, " << cutLinks << " links cut, imbalance "
+            << std::setprecision(3) << imbalance() << "\n";
+        return out.str();
+    }
+
+    PartitionPlan evaluatePartition(const PartitionGraph &g, const std::vector<size_t> &owners){
+        if (owners.size() != g.work.size())
+            throw std::runtime_error("Partition of " + std::to_string(g.work.size()) + " components has " + std::to_string(owners.size()) + " owners");
+        PartitionPlan plan;
+        plan.owners = owners;
+        plan.names = g.names;
+        size_t numRanks = numRanksOf(owners);
+        plan.load.assign(numRanks, 0);
+        plan.bytes.assign(numRanks, std::vector<double>(numRanks, 0));
+        for(size_t c=0; c < owners.size(); c++)
+            plan.load[owners[c]] += g.work[c];
+        for(const PartitionGraph::HaloData &d : g.data){
+            size_t from = owners[d.owner];
+            std::vector<size_t> ranks;
+            for(size_t r : d.readers)
+                if (owners[r] != from)
+                    ranks.push_back(owners[r]);
+            std::sort(ranks.begin(), ranks.end());
+            ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+            for(size_t to : ranks){
+                plan.bytes[from][to] += d.bytes;
+                plan.totalBytes += d.bytes;
+            }
+        }
+        for(auto &l : g.links)
+            if (owners[l.first] != owners[l.second])
+                plan.cutLinks++;
+        return plan;
+    }
+
+    PartitionPlan planPartition(const PartitionGraph &g, size_t numRanks, const PartitionOptions &opts){
+        if (numRanks == 0 || numRanks > g.work.size())
+            throw std::runtime_error("Can't place " + std::to_string(g.work.size()) + " components on " + std::to_string(numRanks) + " ranks, each owning at least one");
+        auto touch = touching(g);
+        std::vector<size_t> owners = growParts(g, numRanks, opts, touch);
+        refine(g, numRanks, opts, touch, owners);
+        return evaluatePartition(g, owners);
+    }
+}
@@ -97,6 +97,7 @@ namespace llrt{
                 copyJobs.push_back(&j);
             }
 
+            traceBatch(copyJobs);
             planAllStages(copyJobs);
 
             for(Job *job: copyJobs){
@@ -122,11 +123,49 @@ namespace llrt{
         finalCleanup();
     }
 
+    template<typename F>
+    void Scheduler::forEachChunkJob(JobChunk &chunk, F f){
+        if (chunk.packed.empty()){
+            f(chunk.job, chunk.end - chunk.start, chunk.startTime, chunk.endTime);
+            return;
+        }
+        std::vector<std::pair<Job *, size_t> > parts{{chunk.job, chunk.end - chunk.start}};
+        for(JobChunk::PackedJob &p : chunk.packed)
+            parts.emplace_back(p.job, p.job->maxProgress);
+        std::vector<double> weights;
+        double totWeight = 0;
+        for(auto &[job, progress] : parts){
+            weights.push_back(microseconds(estimateTimeOp(job->opTypeIndex, progress)));
+            totWeight += weights.back();
+        }
+        dur_t total = chunk.endTime - chunk.startTime;
+        time_t t = chunk.startTime;
+        for(size_t i=0; i < parts.size(); i++){
+            double share = totWeight > 0 ? weights[i] / totWeight : 1.0 / parts.size();
+            time_t end = i + 1 == parts.size() ? chunk.endTime : t + std::chrono::duration_cast<dur_t>(total * share);
+            f(parts[i].first, parts[i].second, t, end);
+            t = end;
+        }
+    }
+
     void Scheduler::collectStats(JobChunkBatch &batch, size_t worker){
         for(JobChunk &chunk : batch.chunks){
-            trackOp(chunk.job->opTypeIndex, chunk.endTime - chunk.startTime, chunk.end-chunk.start);
+            // A chunk with packed jobs is only timed as a whole. Its
+            // time is one measurement of an operation type if all its
+            // jobs are of that type; otherwise splitting it would only
+            // feed the estimates back to themselves, so it isn't used.
+            size_t progress = chunk.end - chunk.start;
+            bool oneType = true;
+            for(JobChunk::PackedJob &p : chunk.packed){
+                progress += p.job->maxProgress;
+                oneType = oneType && p.job->opTypeIndex == chunk.job->opTypeIndex;
+            }
+            if (oneType)
+                trackOp(chunk.job->opTypeIndex, chunk.endTime - chunk.startTime, progress);
 #ifdef PROFILER
-            npl_op.logChunk(chunk.job->opPerfLogId, chunk.end - chunk.start, chunk.startTime, chunk.endTime, worker + 2);
+            forEachChunkJob(chunk, [&](Job *job, size_t jobProgress, time_t start, time_t end){
+                npl_op.logChunk(job->opPerfLogId, jobProgress, start, end, worker + 2);
+            });
 #endif
         }
     }
@@ -196,11 +235,28 @@ namespace llrt{
         // records some profiler info
         std::unique_lock<std::mutex> schedLck(schedChan.mtx);
 #endif
+        std::unique_lock<std::mutex> statsLck(statsMtx);
+        dur_t busiest = dur_t::zero();
         for(size_t worker=0; worker < nWorkers; worker++){
             JobChunkBatch &batch = schedBarrier->workerBatches[worker];
             collectStats(batch, worker);
             batch.statsRecorded = true;
+            dur_t busy = dur_t::zero();
+            for(JobChunk &chunk : batch.chunks){
+                busy += chunk.endTime - chunk.startTime;
+                stats.packedJobs += chunk.packed.size();
+            }
+            stats.busyByWorker[worker] += busy;
+            stats.chunks += batch.chunks.size();
+            busiest = std::max(busiest, busy);
         }
+        stats.criticalPath += busiest;
+        if (!schedBarrier->jobs.empty()){ // not the empty barrier the Scheduler starts with
+            stats.barriers++;
+            if (schedBarrier->singleThreaded)
+                stats.singleThreadedBarriers++;
+        }
+        statsLck.unlock();
 #ifdef PROFILER
         schedLck.unlock();
 #endif
@@ -285,23 +341,41 @@ namespace llrt{
 
 
             JobChunkBatch *batch = &barrier.workerBatches[i];
+            // the chunk this worker's tiny jobs are packed into
+            JobChunk *pack = nullptr;
 
             dur_t waterColumn = dur_t::zero();
             for(;waterIt != buckets.end();){
                 Job *bucket = *waterIt;
                 dur_t est = estimateTimeOp(bucket->opTypeIndex, bucket->maxProgress - bucket->progress);
                 dur_t newHeight = waterColumn + est;
-                if(newHeight < waterLevel || i == nWorkers-1){
+                bool tiny = est < packJobThreshold && bucket->progress == 0;
+                // last worker gets all remaining jobs
+                bool overflows = newHeight >= waterLevel && i != nWorkers-1;
+                if(!overflows || (tiny && pack != nullptr)){
                     // pour the whole bucket
-                    // last worker gets all remaining jobs
+                    // a tiny one that overflows goes in this worker's pack, rather than a chunk of its own
                     waterColumn = newHeight;
-                    assignJob(bucket, batch, dur_t::zero()
+                    if (tiny && pack != nullptr){
+                        pack->packed.push_back({bucket, bucket->copier(*bucket)});
+                        bucket->progress = bucket->maxProgress;
 #ifdef DEBUG_OP_LEVEL
-                              ,i
+                        std::cout << "Packed " << bucket->kernelName << " with " << pack->job->kernelName << " for worker thread " << i << std::endl;
 #endif
-                        );
+                    }
+                    else{
+                        assignJob(bucket, batch, dur_t::zero()
+#ifdef DEBUG_OP_LEVEL
+                                  ,i
+#endif
+                            );
+                        if (tiny)
+                            pack = &batch->chunks.back();
+                    }
                     barrier.jobs.push_back(bucket);
                     waterIt = buckets.erase(waterIt);
+                    if (overflows)
+                        break;
                 }
                 else{
                     // pour as much of the bucket as we can
@@ -433,7 +507,7 @@ namespace llrt{
                 JobChunkBatch &batch = barrier->workerBatches[workerIndex];
                 for (JobChunk &chunk : batch.chunks){
                     chunk.startTime = std::chrono::steady_clock::now();
-                    chunk.task(chunk.start, chunk.end);
+                    chunk.run();
                     chunk.endTime = std::chrono::steady_clock::now();
                 }
                 std::unique_lock<std::mutex> schedLck(schedChan.mtx);
@@ -481,6 +555,11 @@ namespace llrt{
             completedClientBatchCv.wait(completedClientBatchLck);
     }
 
+    bool Scheduler::batchFinished(size_t batchNumber){
+        std::unique_lock<std::mutex> completedClientBatchLck(completedClientBatchMtx);
+        return completedClientBatchNum >= batchNumber;
+    }
+
     void Scheduler::finishBatches(){
         // 1. find the latest clientBatchNumber
         // 2. call finishBatch on that number
@@ -504,6 +583,71 @@ namespace llrt{
     }
 
 
+    void Scheduler::traceBatch(std::list<Job *> &jobs){
+        std::unique_lock<std::mutex> traceLck(traceMtx);
+        if (!tracing || trace.batches.size() >= traceMaxBatches)
+            return;
+        trace.batches.emplace_back();
+        SchedulerTrace::TraceBatch &batch = trace.batches.back();
+        for(Job *job : jobs){
+            batch.jobs.push_back({job->opTypeIndex, job->cmpId, job->maxProgress, job->indivisible});
+            if (!trace.opTypes.contains(job->opTypeIndex))
+                trace.opTypes[job->opTypeIndex].kernelName = job->kernelName;
+
+            std::pair<type_index_t, size_t> key(job->opTypeIndex, job->maxProgress);
+            if (trace.progressPoints.contains(key))
+                continue;
+            // record where chunks of this job may end. Most jobs can
+            // end anywhere, which we check for first, since
+            // enumerating every point would take too long.
+            std::vector<size_t> &points = trace.progressPoints[key];
+            size_t mp = job->maxProgress;
+            auto endsAnywhere = [&](size_t p){
+                return p >= mp || static_cast<size_t>(job->nextProgressPoint(p)) == p;
+            };
+            if (endsAnywhere(1) && endsAnywhere(mp/2 + 1) && endsAnywhere(mp - 1))
+                continue;
+            const size_t maxPoints = 1000000;
+            for(size_t p = 0; p < mp && points.size() < maxPoints;){
+                p = std::min<size_t>(job->nextProgressPoint(p + 1), mp);
+                points.push_back(p);
+            }
+            if (points.size() >= maxPoints)
+                points.clear(); // too fine-grained to matter
+        }
+    }
+
+    void Scheduler::startTrace(size_t maxBatches){
+        std::unique_lock<std::mutex> traceLck(traceMtx);
+        trace = SchedulerTrace();
+        traceMaxBatches = maxBatches;
+        tracing = true;
+    }
+
+    SchedulerTrace Scheduler::stopTrace(){
+        finishBatches();
+        std::unique_lock<std::mutex> traceLck(traceMtx);
+        tracing = false;
+        // the scheduler thread is idle now, so it's safe to read timeByKernel
+        for(auto &[id, op] : trace.opTypes)
+            if (timeByKernel.contains(id))
+                op.usPerOp = timeByKernel[id].T_op;
+        SchedulerTrace result = std::move(trace);
+        trace = SchedulerTrace();
+        return result;
+    }
+
+    Scheduler::Stats Scheduler::getStats(){
+        std::unique_lock<std::mutex> statsLck(statsMtx);
+        return stats;
+    }
+
+    void Scheduler::resetStats(){
+        std::unique_lock<std::mutex> statsLck(statsMtx);
+        stats = Stats();
+        stats.busyByWorker.resize(nWorkers, dur_t::zero());
+    }
+
     void Scheduler::mergeLoggers(NetworkPerfLogger &npl_client){
         finishBatches();
         std::unique_lock<std::mutex> schedLck(schedChan.mtx);
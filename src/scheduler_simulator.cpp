@@ -0,0 +1,116 @@
+#include "scheduler_simulator.hpp"
+
+namespace llrt{
+
+    dur_t SchedulerSimulator::chunkTime(const SchedulerTrace::TraceJob &job, size_t progress) const{
+        double usPerOp = 1;
+        auto it = trace.opTypes.find(job.opTypeIndex);
+        if (it != trace.opTypes.end())
+            usPerOp = it->second.usPerOp;
+        return std::chrono::duration_cast<dur_t>(std::chrono::duration<double, std::micro>(usPerOp * progress)) + opts.chunkOverhead;
+    }
+
+    SchedulerSimulator::Result SchedulerSimulator::run(){
+        using Job = Scheduler::Job;
+        using JobChunkBatch = Scheduler::JobChunkBatch;
+        using Barrier = Scheduler::Barrier;
+
+        Scheduler sched(opts.nWorkers, Scheduler::NoThreads());
+        sched.singleThreadThreshold = opts.singleThreadThreshold;
+        sched.packJobThreshold = opts.packJobThreshold;
+        if (opts.warmEstimates){
+            // weight the initial estimate heavily, as if it came from a long run
+            const size_t weight = 1000000;
+            for(auto &[id, op] : trace.opTypes){
+                Scheduler::PerfTracker &pt = sched.timeByKernel[id];
+                pt.totOps = weight;
+                pt.totTime = std::chrono::duration_cast<dur_t>(std::chrono::duration<double, std::micro>(op.usPerOp * weight));
+                pt.T_op = op.usPerOp;
+            }
+        }
+
+        Result result;
+        time_t now = time_t();
+        for(const SchedulerTrace::TraceBatch &traceBatch : trace.batches){
+            // the Jobs must stay in place until their barriers are recorded
+            std::list<Job> jobs;
+            std::list<Job *> jobPtrs;
+            std::map<Job *, const SchedulerTrace::TraceJob *> traceJobs;
+            for(const SchedulerTrace::TraceJob &tj : traceBatch.jobs){
+                jobs.emplace_back();
+                Job &job = jobs.back();
+                job.copier = [](Job &){
+                    return std::function<void(int64_t, int64_t)>([](int64_t, int64_t){});
+                };
+                const SchedulerTrace &tr = trace;
+                job.nextProgressPoint = [&tr, tj](int64_t p){
+                    return static_cast<int64_t>(tr.nextProgressPoint(tj, p));
+                };
+                job.combineAll = [](Job &){};
+                auto op = trace.opTypes.find(tj.opTypeIndex);
+                if (op != trace.opTypes.end())
+                    job.kernelName = op->second.kernelName;
+                job.opTypeIndex = tj.opTypeIndex;
+                job.opPerfLogId = 0;
+                job.maxProgress = tj.maxProgress;
+                job.indivisible = tj.indivisible;
+                job.cmpId = tj.cmpId;
+                jobPtrs.push_back(&job);
+                traceJobs[&job] = &tj;
+            }
+
+            Barrier *before = sched.lastBarrier;
+            sched.planAllStages(jobPtrs);
+
+            for(Barrier *b = before->next; b != nullptr; b = b->next){
+                dur_t barrierTime = dur_t::zero();
+                if (b->singleThreaded){
+                    // the jobs all run on whichever worker gets there first
+                    JobChunkBatch &batch = b->workerBatches[0];
+                    time_t t = now;
+                    for(Job *j : b->jobs){
+                        batch.chunks.emplace_back(j->copier(*j), 0, j->maxProgress, j);
+                        batch.chunks.back().startTime = t;
+                        t += chunkTime(*traceJobs[j], j->maxProgress);
+                        batch.chunks.back().endTime = t;
+                    }
+                    result.busy += t - now;
+                    barrierTime = (t - now) + opts.singleThreadedOverhead;
+                    result.singleThreadedBarriers++;
+                    result.chunks += batch.chunks.size();
+                }
+                else{
+                    dur_t busiest = dur_t::zero();
+                    for(JobChunkBatch &batch : b->workerBatches){
+                        time_t t = now;
+                        for(auto &chunk : batch.chunks){
+                            chunk.startTime = t;
+                            t += chunkTime(*traceJobs[chunk.job], chunk.end - chunk.start);
+                            for(auto &p : chunk.packed)
+                                t += chunkTime(*traceJobs[p.job], p.job->maxProgress) - opts.chunkOverhead;
+                            chunk.endTime = t;
+                        }
+                        result.busy += t - now;
+                        busiest = std::max(busiest, t - now);
+                        result.chunks += batch.chunks.size();
+                    }
+                    barrierTime = busiest + opts.barrierOverhead;
+                }
+                result.barriers++;
+                now += barrierTime;
+                result.makespan += barrierTime;
+
+                // let the Scheduler learn from the simulated times, and
+                // free the barrier
+                b->doneWorkers = opts.nWorkers;
+                for(JobChunkBatch &batch : b->workerBatches)
+                    batch.neededByWorker = false;
+                sched.schedBarrier = b;
+                sched.recordFinishedJobs();
+                b->finalized = true;
+            }
+        }
+        result.idle = result.makespan * opts.nWorkers - result.busy;
+        return result;
+    }
+}
@@ -0,0 +1,118 @@
+#include "scheduler_trace.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+namespace llrt{
+
+    // The text format is one record per line:
+    //
+    //   llrt-sched-trace 1
+    //   op <opTypeIndex> <usPerOp> <kernelName>
+    //   points <opTypeIndex> <maxProgress> <count> <point> <point> ...
+    //   batch <number of jobs>
+    //   job <opTypeIndex> <cmpId> <maxProgress> <indivisible>
+    //
+    // job lines belong to the batch line before them.
+
+    size_t SchedulerTrace::nextProgressPoint(const TraceJob &job, size_t p) const{
+        auto it = progressPoints.find({job.opTypeIndex, job.maxProgress});
+        if (it == progressPoints.end() || it->second.empty())
+            return std::min(p, job.maxProgress);
+        const std::vector<size_t> &points = it->second;
+        auto pt = std::lower_bound(points.begin(), points.end(), p);
+        if (pt == points.end())
+            return job.maxProgress;
+        return *pt;
+    }
+
+    void SchedulerTrace::save(std::ostream &out) const{
+        out << "llrt-sched-trace 1\n";
+        out << std::setprecision(9);
+        for(auto &[id, op] : opTypes)
+            out << "op " << id << " " << op.usPerOp << " " << op.kernelName << "\n";
+        for(auto &[key, points] : progressPoints){
+            out << "points " << key.first << " " << key.second << " " << points.size();
+            for(size_t p : points)
+                out << " " << p;
+            out << "\n";
+        }
+        for(const TraceBatch &batch : batches){
+            out << "batch " << batch.jobs.size() << "\n";
+            for(const TraceJob &job : batch.jobs)
+                out << "job " << job.opTypeIndex << " " << job.cmpId << " " << job.maxProgress << " " << job.indivisible << "\n";
+        }
+    }
+
+    void SchedulerTrace::save(const std::string &filename) const{
+        std::ofstream f(filename);
+        if (!f)
+            throw std::runtime_error("Couldn't open " + filename + " for writing");
+        save(f);
+    }
+
+    SchedulerTrace SchedulerTrace::load(std::istream &in){
+        SchedulerTrace trace;
+        std::string line;
+        if (!std::getline(in, line) || line != "llrt-sched-trace 1")
+            throw std::runtime_error("Not a scheduler trace (bad header)");
+        size_t lineNum = 1;
+        while(std::getline(in, line)){
+            lineNum++;
+            if (line.empty())
+                continue;
+            std::stringstream st(line);
+            std::string kind;
+            st >> kind;
+            if (kind == "op"){
+                type_index_t id;
+                OpType op;
+                st >> id >> op.usPerOp;
+                if (!st.fail()){
+                    // the name is the rest of the line, and may be empty
+                    std::getline(st, op.kernelName);
+                    st.clear();
+                    if (!op.kernelName.empty())
+                        op.kernelName.erase(0, 1); // the separating space
+                }
+                trace.opTypes[id] = op;
+            }
+            else if (kind == "points"){
+                type_index_t id;
+                size_t maxProgress, count;
+                st >> id >> maxProgress >> count;
+                std::vector<size_t> &points = trace.progressPoints[{id, maxProgress}];
+                points.resize(count);
+                for(size_t &p : points)
+                    st >> p;
+            }
+            else if (kind == "batch"){
+                size_t count;
+                st >> count;
+                trace.batches.emplace_back();
+                trace.batches.back().jobs.reserve(count);
+            }
+            else if (kind == "job"){
+                if (trace.batches.empty())
+                    throw std::runtime_error("Scheduler trace line " + std::to_string(lineNum) + ": job before any batch");
+                TraceJob job;
+                st >> job.opTypeIndex >> job.cmpId >> job.maxProgress >> job.indivisible;
+                trace.batches.back().jobs.push_back(job);
+            }
+            else
+                throw std::runtime_error("Scheduler trace line " + std::to_string(lineNum) + ": unknown record " + kind);
+            if (st.fail())
+                throw std::runtime_error("Scheduler trace line " + std::to_string(lineNum) + ": malformed " + kind + " record");
+        }
+        return trace;
+    }
+
+    SchedulerTrace SchedulerTrace::load(const std::string &filename){
+        std::ifstream f(filename);
+        if (!f)
+            throw std::runtime_error("Couldn't open " + filename + " for reading");
+        return load(f);
+    }
+}
@@ -0,0 +1,131 @@
+#include "shm_input.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <thread>
+#include <new>
+
+namespace llrt{
+
+    namespace{
+        const char shmInputMagic[8] = {'L', 'L', 'R', 'T', 'S', 'H', 'M', 'I'};
+        const uint32_t shmInputVersion = 1;
+        /// offset of the first slot, and of the frame within a slot
+        const size_t shmSlotAlign = 64;
+
+        static_assert(sizeof(ShmFrameRingHeader) <= shmSlotAlign, "the ring header must fit before the first slot");
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "the ring needs lock-free atomics to be shared between processes");
+
+        size_t slotBytes(size_t frameSize){
+            return shmSlotAlign + (frameSize * sizeof(float) + shmSlotAlign - 1) / shmSlotAlign * shmSlotAlign;
+        }
+
+        std::atomic<uint64_t> &slotState(char *base, const ShmFrameRingHeader *h, size_t slot){
+            return *reinterpret_cast<std::atomic<uint64_t> *>(base + shmSlotAlign + slot * h->slotBytes);
+        }
+    }
+
+    ShmFrameProducer::ShmFrameProducer(const std::string &name, size_t frameSize, size_t slots) :
+        region(name, shmSlotAlign + slots * slotBytes(frameSize)){
+        if (frameSize == 0)
+            throw std::runtime_error("ShmFrameProducer needs a frame size of at least 1");
+        if (slots < 3 || slots > 0xffff)
+            throw std::runtime_error("ShmFrameProducer needs between 3 and 65535 slots");
+        // the region is zero-filled, so every slot starts out Ready
+        ShmFrameRingHeader *h = new(region.data()) ShmFrameRingHeader;
+        h->version = shmInputVersion;
+        h->slots = slots;
+        h->frameSize = frameSize;
+        h->slotBytes = slotBytes(frameSize);
+        for(size_t i=0; i < slots; i++)
+            new(&slotState(region.data(), h, i)) std::atomic<uint64_t>(ShmSlotReady);
+        h->latest.store(0, std::memory_order_relaxed);
+        // written last, so a consumer never sees a half initialized header
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(h->magic, shmInputMagic, sizeof(shmInputMagic));
+    }
+
+    uint64_t ShmFrameProducer::publish(const float *frame){
+        ShmFrameRingHeader *h = header();
+        uint64_t latest = h->latest.load(std::memory_order_relaxed);
+        for(size_t tries=0; tries < h->slots; tries++){
+            size_t slot = nextSlot;
+            nextSlot = (nextSlot + 1) % h->slots;
+            if (latest != 0 && (latest & 0xffff) == slot)
+                continue;
+            std::atomic<uint64_t> &state = slotState(region.data(), h, slot);
+            uint64_t cur = state.load(std::memory_order_acquire);
+            if ((cur & 3) != ShmSlotReady || !state.compare_exchange_strong(cur, (cur & ~uint64_t(3)) | ShmSlotWriting, std::memory_order_acquire))
+                continue;
+            uint64_t seq = nextSeq++;
+            std::memcpy(region.data() + shmSlotAlign + slot * h->slotBytes + shmSlotAlign, frame, h->frameSize * sizeof(float));
+            state.store(seq << 2 | ShmSlotReady, std::memory_order_release);
+            h->latest.store(seq << 16 | slot, std::memory_order_release);
+            return seq;
+        }
+        return 0;
+    }
+
+    ShmInputChannel::ShmInputChannel(const std::string &name) : ShmInputChannel(name, Options()){}
+
+    ShmInputChannel::ShmInputChannel(const std::string &name, const Options &opts) : region(name), opts(opts){
+        const ShmFrameRingHeader *h = header();
+        if (region.size() < shmSlotAlign || std::memcmp(h->magic, shmInputMagic, sizeof(shmInputMagic)) != 0)
+            throw std::runtime_error("Shared memory region " + name + " is not an input frame ring");
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (h->version != shmInputVersion)
+            throw std::runtime_error("Shared memory region " + name + " is a version " + std::to_string(h->version) + " input frame ring, but only version " + std::to_string(shmInputVersion) + " is supported");
+        if (h->slots < 3 || h->slotBytes != slotBytes(h->frameSize) || region.size() < shmSlotAlign + h->slots * h->slotBytes)
+            throw std::runtime_error("Shared memory region " + name + " is a malformed input frame ring");
+        maxHeld = h->slots - 2;
+    }
+
+    ShmInputChannel::~ShmInputChannel(){
+        while(!held.empty()){
+            release(held.front());
+            held.pop_front();
+        }
+    }
+
+    const float *ShmInputChannel::frame(size_t slot) const{
+        return reinterpret_cast<const float *>(region.data() + shmSlotAlign + slot * header()->slotBytes + shmSlotAlign);
+    }
+
+    ShmInputChannel::Held ShmInputChannel::acquire(){
+        ShmFrameRingHeader *h = header();
+        auto deadline = std::chrono::steady_clock::now() + opts.timeout;
+        while(true){
+            uint64_t latest = h->latest.load(std::memory_order_acquire);
+            uint64_t seq = latest >> 16;
+            size_t slot = latest & 0xffff;
+            bool fresh = seq > lastSeq || (!opts.waitForNew && seq != 0);
+            if (fresh){
+                for(const Held &o : held)
+                    if (o.seq == seq){
+                        // already reserved by an earlier step
+                        lastSeq = seq;
+                        return {slot, seq, 0};
+                    }
+                std::atomic<uint64_t> &state = slotState(region.data(), h, slot);
+                uint64_t expected = seq << 2 | ShmSlotReady;
+                // fails if the producer has moved on and reused the slot
+                if (state.compare_exchange_strong(expected, seq << 2 | ShmSlotReading, std::memory_order_acquire)){
+                    lastSeq = seq;
+                    return {slot, seq, 0};
+                }
+                continue;
+            }
+            if (std::chrono::steady_clock::now() > deadline)
+                throw std::runtime_error("Timed out waiting for a frame in shared memory region " + region.getName());
+            std::this_thread::sleep_for(opts.pollInterval);
+        }
+    }
+
+    void ShmInputChannel::release(const Held &h){
+        // the first entry is the one being released; keep the slot if
+        // a later step still reads the same frame
+        for(size_t i=1; i < held.size(); i++)
+            if (held[i].seq == h.seq)
+                return;
+        slotState(region.data(), header(), h.slot).store(h.seq << 2 | ShmSlotReady, std::memory_order_release);
+    }
+}
@@ -0,0 +1,148 @@
+#include "shm_mirror.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <new>
+
+namespace llrt{
+
+    namespace{
+        const char shmMirrorMagic[8] = {'L', 'L', 'R', 'T', 'S', 'H', 'M', 'M'};
+        const uint32_t shmMirrorVersion = 1;
+        const size_t shmMirrorAlign = 64;
+
+        static_assert(sizeof(ShmMirrorHeader) <= shmMirrorAlign, "the mirror header must fit in 64 bytes");
+        static_assert(sizeof(ShmMirrorFieldEntry) == shmMirrorAlign, "field table entries must be 64 bytes");
+
+        size_t align64(size_t n){
+            return (n + shmMirrorAlign - 1) / shmMirrorAlign * shmMirrorAlign;
+        }
+
+        size_t fieldBytes(uint32_t type, size_t count){
+            return type == ShmBits ? (count + 63) / 64 * sizeof(uint64_t) : count * sizeof(float);
+        }
+
+        /// offset of the first buffer
+        size_t buffersStart(size_t numFields){
+            return shmMirrorAlign + numFields * sizeof(ShmMirrorFieldEntry);
+        }
+
+        size_t regionBytes(const std::vector<ShmMirrorField> &fields){
+            size_t bufferBytes = 0;
+            for(const ShmMirrorField &f : fields)
+                bufferBytes += align64(fieldBytes(f.type, f.count));
+            return buffersStart(fields.size()) + 2 * std::max<size_t>(bufferBytes, shmMirrorAlign);
+        }
+    }
+
+    ShmStateMirror::ShmStateMirror(const std::string &name, const std::vector<ShmMirrorField> &fields) :
+        region(name, regionBytes(fields)), fields(fields){
+        ShmMirrorHeader *h = new(region.data()) ShmMirrorHeader;
+        ShmMirrorFieldEntry *table = reinterpret_cast<ShmMirrorFieldEntry *>(region.data() + shmMirrorAlign);
+        size_t offset = 0;
+        for(size_t i=0; i < fields.size(); i++){
+            const ShmMirrorField &f = fields[i];
+            if (f.name.size() >= sizeof(table[i].name))
+                throw std::runtime_error("ShmStateMirror: field name " + f.name + " is too long");
+            if (f.type != ShmFloat && f.type != ShmBits)
+                throw std::runtime_error("ShmStateMirror: field " + f.name + " has an unknown type");
+            std::memcpy(table[i].name, f.name.data(), f.name.size());
+            table[i].type = f.type;
+            table[i].count = f.count;
+            table[i].offset = offset;
+            fieldOffsets.push_back(offset);
+            offset += align64(fieldBytes(f.type, f.count));
+        }
+        h->version = shmMirrorVersion;
+        h->numFields = fields.size();
+        h->bufferBytes = (region.size() - buffersStart(fields.size())) / 2;
+        h->latest.store(0, std::memory_order_relaxed);
+        h->seq[0].store(0, std::memory_order_relaxed);
+        h->seq[1].store(0, std::memory_order_relaxed);
+        // written last, so a viewer never sees a half initialized header
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(h->magic, shmMirrorMagic, sizeof(shmMirrorMagic));
+    }
+
+    char *ShmStateMirror::back() const{
+        return region.data() + buffersStart(fields.size()) + backBuffer * header()->bufferBytes;
+    }
+
+    float *ShmStateMirror::floats(size_t field){
+        if (fields.at(field).type != ShmFloat)
+            throw std::runtime_error("ShmStateMirror: field " + fields[field].name + " is not a ShmFloat field");
+        return reinterpret_cast<float *>(back() + fieldOffsets[field]);
+    }
+
+    void ShmStateMirror::beginFrame(){
+        ShmMirrorHeader *h = header();
+        // odd until publish(), so that viewers reading this buffer retry
+        h->seq[backBuffer].store((published + 1) << 1 | 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for(size_t i=0; i < fields.size(); i++)
+            if (fields[i].type == ShmBits)
+                std::memset(back() + fieldOffsets[i], 0, fieldBytes(ShmBits, fields[i].count));
+    }
+
+    void ShmStateMirror::publish(){
+        ShmMirrorHeader *h = header();
+        published++;
+        h->seq[backBuffer].store(published << 1, std::memory_order_release);
+        h->latest.store(published << 1 | backBuffer, std::memory_order_release);
+        backBuffer ^= 1;
+    }
+
+    ShmStateViewer::ShmStateViewer(const std::string &name) : region(name){
+        const ShmMirrorHeader *h = header();
+        if (region.size() < shmMirrorAlign || std::memcmp(h->magic, shmMirrorMagic, sizeof(shmMirrorMagic)) != 0)
+            throw std::runtime_error("Shared memory region " + name + " is not a state mirror");
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (h->version != shmMirrorVersion)
+            throw std::runtime_error("Shared memory region " + name + " is a version " + std::to_string(h->version) + " state mirror, but only version " + std::to_string(shmMirrorVersion) + " is supported");
+        size_t start = buffersStart(h->numFields);
+        if (region.size() < start || region.size() - start < 2 * h->bufferBytes)
+            throw std::runtime_error("Shared memory region " + name + " is a malformed state mirror");
+        const ShmMirrorFieldEntry *table = reinterpret_cast<const ShmMirrorFieldEntry *>(region.data() + shmMirrorAlign);
+        for(size_t i=0; i < h->numFields; i++){
+            const ShmMirrorFieldEntry &e = table[i];
+            std::string fieldName(e.name, strnlen(e.name, sizeof(e.name)));
+            if ((e.type != ShmFloat && e.type != ShmBits) || e.offset > h->bufferBytes || fieldBytes(e.type, e.count) > h->bufferBytes - e.offset)
+                throw std::runtime_error("Shared memory region " + name + " is a malformed state mirror");
+            fields.push_back({fieldName, static_cast<ShmFieldType>(e.type), e.count});
+            fieldOffsets.push_back(e.offset);
+        }
+        snapshot.resize(h->bufferBytes / sizeof(uint64_t));
+    }
+
+    size_t ShmStateViewer::fieldIndex(const std::string &name) const{
+        for(size_t i=0; i < fields.size(); i++)
+            if (fields[i].name == name)
+                return i;
+        throw std::runtime_error("Shared memory region " + region.getName() + " has no field " + name);
+    }
+
+    uint64_t ShmStateViewer::read(){
+        const ShmMirrorHeader *h = header();
+        const char *buffers = region.data() + buffersStart(fields.size());
+        while(true){
+            uint64_t latest = h->latest.load(std::memory_order_acquire);
+            if (latest == 0 || latest >> 1 == lastFrame)
+                return lastFrame;
+            size_t b = latest & 1;
+            uint64_t before = h->seq[b].load(std::memory_order_acquire);
+            if (before & 1)
+                continue; // the mirror has started on the next frame in this buffer
+            std::memcpy(snapshot.data(), buffers + b * h->bufferBytes, h->bufferBytes);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (h->seq[b].load(std::memory_order_relaxed) == before){
+                lastFrame = before >> 1;
+                return lastFrame;
+            }
+        }
+    }
+
+    const float *ShmStateViewer::floats(size_t field) const{
+        if (fields.at(field).type != ShmFloat)
+            throw std::runtime_error("ShmStateViewer: field " + fields[field].name + " is not a ShmFloat field");
+        return reinterpret_cast<const float *>(reinterpret_cast<const char *>(snapshot.data()) + fieldOffsets[field]);
+    }
+}
@@ -0,0 +1,110 @@
+#include "shm_partition.hpp"
+#include <fstream>
+#include <thread>
+#include <new>
+#include <sched.h>
+
+namespace llrt{
+
+    namespace{
+        const char shmPartitionMagic[8] = {'L', 'L', 'R', 'T', 'S', 'H', 'M', 'P'};
+        const uint32_t shmPartitionVersion = 1;
+        const size_t shmPartitionAlign = 64;
+
+        static_assert(sizeof(ShmPartitionHeader) <= shmPartitionAlign, "the partition header must fit in 64 bytes");
+    }
+
+    bool pinToNumaNode(int node){
+        std::ifstream f("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        if (!std::getline(f, list))
+            return false;
+        // a list of ranges such as "0-3,8-11"
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        size_t pos = 0;
+        bool any = false;
+        while(pos < list.size()){
+            size_t comma = list.find(',', pos);
+            std::string range = list.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+            size_t dash = range.find('-');
+            try{
+                int first = std::stoi(range.substr(0, dash));
+                int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for(int cpu=first; cpu <= last && cpu < CPU_SETSIZE; cpu++){
+                    CPU_SET(cpu, &set);
+                    any = true;
+                }
+            }
+            catch(std::logic_error &){
+                return false;
+            }
+            if (comma == std::string::npos)
+                break;
+            pos = comma + 1;
+        }
+        return any && sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+
+    ShmHaloRegion::ShmHaloRegion(const std::string &name, size_t rank, size_t numRanks, size_t bufferBytes, uint64_t layoutHash, std::chrono::milliseconds timeout) :
+        rank(rank), numRanks(numRanks), timeout(timeout){
+        size_t bytes = shmPartitionAlign + 2 * std::max<size_t>(bufferBytes, shmPartitionAlign);
+        if (rank == 0){
+            region = std::make_unique<ShmRegion>(name, bytes);
+            ShmPartitionHeader *h = new(region->data()) ShmPartitionHeader;
+            h->version = shmPartitionVersion;
+            h->numRanks = numRanks;
+            h->bufferBytes = bufferBytes;
+            h->layoutHash = layoutHash;
+            h->arrived.store(0, std::memory_order_relaxed);
+            h->generation.store(0, std::memory_order_relaxed);
+            // written last, so the other ranks never see a half initialized header
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(h->magic, shmPartitionMagic, sizeof(shmPartitionMagic));
+        }
+        else{
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            while(true){
+                try{
+                    region = std::make_unique<ShmRegion>(name);
+                    if (region->size() >= bytes && std::memcmp(header()->magic, shmPartitionMagic, sizeof(shmPartitionMagic)) == 0)
+                        break;
+                    region.reset();
+                }
+                catch(std::runtime_error &){
+                    // rank 0 hasn't created it yet
+                }
+                if (std::chrono::steady_clock::now() > deadline)
+                    throw std::runtime_error("Timed out waiting for rank 0 to create shared memory region " + name);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const ShmPartitionHeader *h = header();
+            if (h->version != shmPartitionVersion || h->numRanks != numRanks || h->bufferBytes != bufferBytes || h->layoutHash != layoutHash)
+                throw std::runtime_error("Shared memory region " + name + " was created for a different network or number of processes");
+        }
+        barrier();
+    }
+
+    char *ShmHaloRegion::buffer(size_t i) const{
+        return region->data() + shmPartitionAlign + i * std::max<size_t>(header()->bufferBytes, shmPartitionAlign);
+    }
+
+    void ShmHaloRegion::barrier(){
+        ShmPartitionHeader *h = header();
+        uint64_t gen = h->generation.load(std::memory_order_acquire);
+        if (h->arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == numRanks){
+            h->arrived.store(0, std::memory_order_relaxed);
+            h->generation.store(gen + 1, std::memory_order_release);
+            return;
+        }
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        for(size_t spins=0; h->generation.load(std::memory_order_acquire) == gen; spins++){
+            if (spins < 1000)
+                continue;
+            if (std::chrono::steady_clock::now() > deadline)
+                throw std::runtime_error("Timed out waiting for the other processes at a barrier in shared memory region " + region->getName());
+            std::this_thread::yield();
+        }
+    }
+}
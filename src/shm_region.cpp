@@ -0,0 +1,69 @@
+#include "shm_region.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace llrt{
+
+    ShmRegion::ShmRegion(const std::string &name, size_t bytes) : name(name), len(bytes), owner(true){
+        if (bytes == 0)
+            throw std::runtime_error("Shared memory region " + name + " must not be empty");
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0)
+            throw std::runtime_error("Couldn't create shared memory region " + name + ": " + std::strerror(errno));
+        if (ftruncate(fd, bytes) != 0){
+            int err = errno;
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::runtime_error("Couldn't size shared memory region " + name + ": " + std::strerror(err));
+        }
+        try{
+            map(fd);
+        }
+        catch(...){
+            shm_unlink(name.c_str());
+            throw;
+        }
+    }
+
+    ShmRegion::ShmRegion(const std::string &name) : name(name), owner(false){
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0)
+            throw std::runtime_error("Couldn't open shared memory region " + name + ": " + std::strerror(errno));
+        struct stat st;
+        if (fstat(fd, &st) != 0){
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("Couldn't stat shared memory region " + name + ": " + std::strerror(err));
+        }
+        len = st.st_size;
+        if (len == 0){
+            close(fd);
+            throw std::runtime_error("Shared memory region " + name + " is empty");
+        }
+        map(fd);
+    }
+
+    void ShmRegion::map(int fd){
+        addr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        int err = errno;
+        // the mapping keeps its own reference to the object
+        close(fd);
+        if (addr == MAP_FAILED){
+            addr = nullptr;
+            throw std::runtime_error("Couldn't map shared memory region " + name + ": " + std::strerror(err));
+        }
+    }
+
+    ShmRegion::~ShmRegion(){
+        if (addr != nullptr)
+            munmap(addr, len);
+        if (owner)
+            shm_unlink(name.c_str());
+    }
+}
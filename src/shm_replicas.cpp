@@ -0,0 +1,159 @@
+#include "shm_replicas.hpp"
+#include <cstring>
+#include <new>
+
+namespace llrt{
+
+    namespace{
+        const char shmReplicaMagic[8] = {'L', 'L', 'R', 'T', 'S', 'H', 'M', 'W'};
+        const uint32_t shmReplicaVersion = 1;
+        const size_t shmReplicaAlign = 64;
+
+        static_assert(sizeof(ShmReplicaHeader) <= shmReplicaAlign, "the replica header must fit in 64 bytes");
+
+        size_t align64(size_t n){
+            return (n + shmReplicaAlign - 1) / shmReplicaAlign * shmReplicaAlign;
+        }
+
+        size_t countersStart(){
+            return shmReplicaAlign;
+        }
+
+        size_t reducedStart(size_t numReplicas){
+            return countersStart() + numReplicas * shmReplicaAlign;
+        }
+
+        size_t slotsStart(size_t numReplicas, size_t numChunks){
+            return reducedStart(numReplicas) + align64(numChunks * sizeof(uint64_t));
+        }
+
+        size_t slotBytes(size_t numValues){
+            return align64(numValues * sizeof(double));
+        }
+    }
+
+    ShmReplicaRegion::ShmReplicaRegion(const std::string &name, size_t replica, size_t numReplicas, size_t numValues, size_t chunkValues, uint64_t layoutHash, std::chrono::milliseconds timeout) :
+        replica(replica), numReplicas(numReplicas), chunks((numValues + chunkValues - 1) / chunkValues), timeout(timeout){
+        size_t bytes = slotsStart(numReplicas, chunks) + (numReplicas + 1) * slotBytes(numValues);
+        if (replica == 0){
+            region = std::make_unique<ShmRegion>(name, bytes);
+            ShmReplicaHeader *h = new(region->data()) ShmReplicaHeader;
+            h->version = shmReplicaVersion;
+            h->numReplicas = numReplicas;
+            h->numValues = numValues;
+            h->chunkValues = chunkValues;
+            h->layoutHash = layoutHash;
+            for(size_t r=0; r < numReplicas; r++){
+                new(&written(r)) std::atomic<uint64_t>(0);
+                new(&appliedRounds(r)) std::atomic<uint64_t>(0);
+            }
+            for(size_t c=0; c < chunks; c++)
+                new(&reduced(c)) std::atomic<uint64_t>(0);
+            // written last, so the other replicas never see a half initialized header
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(h->magic, shmReplicaMagic, sizeof(shmReplicaMagic));
+        }
+        else{
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            while(true){
+                try{
+                    region = std::make_unique<ShmRegion>(name);
+                    if (region->size() >= bytes && std::memcmp(header()->magic, shmReplicaMagic, sizeof(shmReplicaMagic)) == 0)
+                        break;
+                    region.reset();
+                }
+                catch(std::runtime_error &){
+                    // replica 0 hasn't created it yet
+                }
+                if (std::chrono::steady_clock::now() > deadline)
+                    throw std::runtime_error("Timed out waiting for replica 0 to create shared memory region " + name);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const ShmReplicaHeader *h = header();
+            if (h->version != shmReplicaVersion || h->numReplicas != numReplicas || h->numValues != numValues || h->chunkValues != chunkValues || h->layoutHash != layoutHash)
+                throw std::runtime_error("Shared memory region " + name + " was created for a different network or number of replicas");
+        }
+    }
+
+    std::atomic<uint64_t> &ShmReplicaRegion::written(size_t r) const{
+        return *reinterpret_cast<std::atomic<uint64_t> *>(region->data() + countersStart() + r * shmReplicaAlign);
+    }
+
+    std::atomic<uint64_t> &ShmReplicaRegion::appliedRounds(size_t r) const{
+        return *reinterpret_cast<std::atomic<uint64_t> *>(region->data() + countersStart() + r * shmReplicaAlign + sizeof(uint64_t));
+    }
+
+    std::atomic<uint64_t> &ShmReplicaRegion::reduced(size_t chunk) const{
+        return reinterpret_cast<std::atomic<uint64_t> *>(region->data() + reducedStart(numReplicas))[chunk];
+    }
+
+    double *ShmReplicaRegion::slot(size_t r) const{
+        return reinterpret_cast<double *>(region->data() + slotsStart(numReplicas, chunks) + r * slotBytes(header()->numValues));
+    }
+
+    double *ShmReplicaRegion::result() const{
+        return slot(numReplicas);
+    }
+
+    template<typename Done>
+    bool ShmReplicaRegion::waitFor(Done &&done, const char *what, const std::atomic<bool> *stop){
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        for(size_t spins=0; !done(); spins++){
+            if (spins < 1000)
+                continue;
+            if (stop != nullptr && stop->load())
+                return false;
+            if (std::chrono::steady_clock::now() > deadline)
+                throw std::runtime_error(std::string("Timed out waiting for the other replicas ") + what + " in shared memory region " + region->getName());
+            // the reducer may wait in the background for a whole step of the others
+            if (spins < 2000)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        return true;
+    }
+
+    void ShmReplicaRegion::waitWritable(uint64_t round, size_t chunk){
+        waitFor([&]{return reduced(chunk).load(std::memory_order_acquire) >= round;}, "to reduce the previous round");
+    }
+
+    void ShmReplicaRegion::wrote(uint64_t round, size_t chunk){
+        written(replica).store(round * chunks + chunk + 1, std::memory_order_release);
+    }
+
+    bool ShmReplicaRegion::reduce(uint64_t round, size_t chunk, bool average, const std::atomic<bool> &stop){
+        uint64_t needed = round * chunks + chunk + 1;
+        bool ready = waitFor([&]{
+            for(size_t r=0; r < numReplicas; r++)
+                if (written(r).load(std::memory_order_acquire) < needed || appliedRounds(r).load(std::memory_order_acquire) < round)
+                    return false;
+            return true;
+        }, "to write their values", &stop);
+        if (!ready)
+            return false;
+        size_t chunkValues = header()->chunkValues, begin = chunk * chunkValues;
+        size_t end = std::min<size_t>(begin + chunkValues, header()->numValues);
+        double *sum = result();
+        std::memcpy(sum + begin, slot(0) + begin, (end - begin) * sizeof(double));
+        for(size_t r=1; r < numReplicas; r++){
+            const double *s = slot(r);
+            for(size_t i=begin; i < end; i++)
+                sum[i] += s[i];
+        }
+        if (average)
+            for(size_t i=begin; i < end; i++)
+                sum[i] /= numReplicas;
+        reduced(chunk).store(round + 1, std::memory_order_release);
+        return true;
+    }
+
+    void ShmReplicaRegion::waitReduced(uint64_t round, size_t chunk){
+        waitFor([&]{return reduced(chunk).load(std::memory_order_acquire) > round;}, "to reduce their chunks");
+    }
+
+    void ShmReplicaRegion::applied(uint64_t round){
+        appliedRounds(replica).store(round + 1, std::memory_order_release);
+    }
+}
@@ -0,0 +1,291 @@
+#include "spike_stream.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace llrt{
+
+    namespace{
+        const char spikeStreamMagic[8] = {'L', 'L', 'R', 'T', 'S', 'P', 'K', 'S'};
+        const size_t spikeStreamHeaderBytes = 8 + 4 + 4 + 8 + 8;
+
+        std::atomic<uint64_t> nextWriterSerial{1};
+
+        /// the buffer of the last writer this thread recorded into
+        struct ThreadBufferCache{
+            uint64_t serial = 0;
+            std::vector<size_t> *buffer = nullptr;
+        };
+        thread_local ThreadBufferCache threadBufferCache;
+
+        void putVarint(std::string &out, uint64_t v){
+            while(v >= 0x80){
+                out += static_cast<char>((v & 0x7f) | 0x80);
+                v >>= 7;
+            }
+            out += static_cast<char>(v);
+        }
+
+        size_t varintBytes(uint64_t v){
+            size_t n = 1;
+            while(v >= 0x80){
+                v >>= 7;
+                n++;
+            }
+            return n;
+        }
+
+        void putLE(std::string &out, uint64_t v, size_t bytes){
+            for(size_t i=0; i < bytes; i++)
+                out += static_cast<char>((v >> (8 * i)) & 0xff);
+        }
+
+        uint64_t getLE(const char *p, size_t bytes){
+            uint64_t v = 0;
+            for(size_t i=0; i < bytes; i++)
+                v |= uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+            return v;
+        }
+    }
+
+    SpikeStreamWriter::SpikeStreamWriter(const std::string &filename, size_t numNodes) :
+        SpikeStreamWriter(filename, numNodes, Options()){}
+
+    SpikeStreamWriter::SpikeStreamWriter(const std::string &filename, size_t numNodes, const Options &opts) :
+        numNodes(numNodes), opts(opts), out(filename, std::ios::binary | std::ios::trunc), filename(filename),
+        serial(nextWriterSerial++), lastTrace(opts.traceWidth){
+        if (!out)
+            throw std::runtime_error("Couldn't open " + filename + " for writing");
+        block.append(spikeStreamMagic, sizeof(spikeStreamMagic));
+        putLE(block, spikeStreamVersion, 4);
+        putLE(block, 0, 4);
+        putLE(block, numNodes, 8);
+        putLE(block, opts.traceWidth, 8);
+        encoded = block.size();
+    }
+
+    SpikeStreamWriter::~SpikeStreamWriter(){
+        try{
+            close();
+        }
+        catch(std::runtime_error &){
+        }
+    }
+
+    std::vector<size_t> &SpikeStreamWriter::threadBuffer(){
+        if (threadBufferCache.serial == serial)
+            return *threadBufferCache.buffer;
+        std::unique_lock<std::mutex> lock(buffersMtx);
+        auto &buf = buffers[std::this_thread::get_id()];
+        if (!buf)
+            buf = std::make_unique<std::vector<size_t> >();
+        threadBufferCache.serial = serial;
+        threadBufferCache.buffer = buf.get();
+        return *buf;
+    }
+
+    void SpikeStreamWriter::beginRecord(unsigned char tag, uint64_t step){
+        if (closed)
+            throw std::runtime_error("SpikeStreamWriter: " + filename + " is closed");
+        if (step < lastStep)
+            throw std::runtime_error("SpikeStreamWriter: timestep " + std::to_string(step) + " is before the previous record's timestep " + std::to_string(lastStep));
+        block += static_cast<char>(tag);
+        putVarint(block, step - lastStep);
+        lastStep = step;
+    }
+
+    void SpikeStreamWriter::encodeSpikes(uint64_t step, std::vector<size_t> &nodes){
+        if (nodes.empty())
+            return;
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+        if (nodes.back() >= numNodes)
+            throw std::runtime_error("SpikeStreamWriter: node " + std::to_string(nodes.back()) + " is out of range for " + std::to_string(numNodes) + " nodes");
+        size_t start = block.size();
+        beginRecord(SpikeStreamRecord::Spikes, step);
+        putVarint(block, nodes.size());
+
+        size_t gapBytes = 0, prev = 0;
+        for(size_t n : nodes){
+            gapBytes += varintBytes(n - prev);
+            prev = n;
+        }
+        size_t bitsetBytes = (numNodes + 7) / 8;
+        if (gapBytes <= bitsetBytes){
+            block += '\0';
+            prev = 0;
+            for(size_t n : nodes){
+                putVarint(block, n - prev);
+                prev = n;
+            }
+        }
+        else{
+            block += '\1';
+            size_t bits = block.size();
+            block.append(bitsetBytes, '\0');
+            for(size_t n : nodes)
+                block[bits + n / 8] |= static_cast<char>(1 << (n % 8));
+        }
+        encoded += block.size() - start;
+        if (block.size() >= opts.blockBytes)
+            submitBlock();
+    }
+
+    void SpikeStreamWriter::endStep(uint64_t step){
+        stepNodes.clear();
+        {
+            std::unique_lock<std::mutex> lock(buffersMtx);
+            for(auto &b : buffers){
+                stepNodes.insert(stepNodes.end(), b.second->begin(), b.second->end());
+                b.second->clear();
+            }
+        }
+        encodeSpikes(step, stepNodes);
+    }
+
+    void SpikeStreamWriter::spikes(uint64_t step, const std::vector<size_t> &nodes){
+        stepNodes = nodes;
+        encodeSpikes(step, stepNodes);
+    }
+
+    void SpikeStreamWriter::trace(uint64_t step, const float *values){
+        if (opts.traceWidth == 0)
+            throw std::runtime_error("SpikeStreamWriter: " + filename + " was opened with a trace width of 0");
+        size_t start = block.size();
+        beginRecord(SpikeStreamRecord::Trace, step);
+        for(size_t i=0; i < opts.traceWidth; i++){
+            uint32_t bits;
+            std::memcpy(&bits, values + i, sizeof(bits));
+            putVarint(block, bits ^ lastTrace[i]);
+            lastTrace[i] = bits;
+        }
+        encoded += block.size() - start;
+        if (block.size() >= opts.blockBytes)
+            submitBlock();
+    }
+
+    void SpikeStreamWriter::submitBlock(){
+        if (block.empty())
+            return;
+        auto b = std::make_shared<std::string>(std::move(block));
+        block.clear();
+        writer.submit([this, b](){
+            out.write(b->data(), b->size());
+            if (!out)
+                throw std::runtime_error("Couldn't write " + filename);
+        });
+    }
+
+    void SpikeStreamWriter::flush(){
+        if (closed)
+            return;
+        submitBlock();
+        writer.submit([this](){
+            out.flush();
+            if (!out)
+                throw std::runtime_error("Couldn't write " + filename);
+        });
+        writer.wait();
+    }
+
+    void SpikeStreamWriter::close(){
+        if (closed)
+            return;
+        flush();
+        closed = true;
+        out.close();
+        if (!out)
+            throw std::runtime_error("Couldn't write " + filename);
+    }
+
+    SpikeStreamReader::SpikeStreamReader(const std::string &filename) : file(filename), filename(filename){
+        const char *d = file.data();
+        if (file.size() < spikeStreamHeaderBytes || std::memcmp(d, spikeStreamMagic, sizeof(spikeStreamMagic)) != 0)
+            throw std::runtime_error(filename + " is not a spike stream");
+        uint32_t version = getLE(d + 8, 4);
+        if (version != spikeStreamVersion)
+            throw std::runtime_error(filename + " is a version " + std::to_string(version) + " spike stream, but only version " + std::to_string(spikeStreamVersion) + " is supported");
+        nodes = getLE(d + 16, 8);
+        width = getLE(d + 24, 8);
+        if (width > file.size())
+            throw std::runtime_error(filename + " has a corrupt header");
+        lastTrace.resize(width);
+        pos = spikeStreamHeaderBytes;
+    }
+
+    uint64_t SpikeStreamReader::varint(){
+        uint64_t v = 0;
+        for(int shift=0; shift < 64; shift += 7){
+            if (pos >= file.size())
+                throw std::runtime_error(filename + " is truncated");
+            unsigned char c = file.data()[pos++];
+            v |= uint64_t(c & 0x7f) << shift;
+            if (!(c & 0x80))
+                return v;
+        }
+        throw std::runtime_error(filename + " is corrupt: a varint is too long");
+    }
+
+    bool SpikeStreamReader::next(SpikeStreamRecord &rec){
+        if (pos >= file.size())
+            return false;
+        unsigned char tag = file.data()[pos++];
+        lastStep += varint();
+        rec.step = lastStep;
+        rec.nodes.clear();
+        rec.values.clear();
+        if (tag == SpikeStreamRecord::Spikes){
+            rec.kind = SpikeStreamRecord::Spikes;
+            uint64_t count = varint();
+            if (count > nodes)
+                throw std::runtime_error(filename + " is corrupt: too many spikes at timestep " + std::to_string(rec.step));
+            if (pos >= file.size())
+                throw std::runtime_error(filename + " is truncated");
+            char encoding = file.data()[pos++];
+            if (encoding == 0){
+                size_t n = 0;
+                for(uint64_t i=0; i < count; i++){
+                    n += varint();
+                    if (n >= nodes || (i > 0 && n == rec.nodes.back()))
+                        throw std::runtime_error(filename + " is corrupt: bad node index at timestep " + std::to_string(rec.step));
+                    rec.nodes.push_back(n);
+                }
+            }
+            else if (encoding == 1){
+                size_t bytes = (nodes + 7) / 8;
+                if (file.size() - pos < bytes)
+                    throw std::runtime_error(filename + " is truncated");
+                const unsigned char *bits = reinterpret_cast<const unsigned char *>(file.data() + pos);
+                for(size_t i=0; i < bytes; i++)
+                    for(unsigned b=0; bits[i] >> b; b++)
+                        if (bits[i] & (1 << b))
+                            rec.nodes.push_back(8 * i + b);
+                pos += bytes;
+                if (rec.nodes.size() != count || (!rec.nodes.empty() && rec.nodes.back() >= nodes))
+                    throw std::runtime_error(filename + " is corrupt: bad bitset at timestep " + std::to_string(rec.step));
+            }
+            else
+                throw std::runtime_error(filename + " is corrupt: unknown spike encoding " + std::to_string(encoding));
+        }
+        else if (tag == SpikeStreamRecord::Trace){
+            rec.kind = SpikeStreamRecord::Trace;
+            rec.values.resize(width);
+            for(size_t i=0; i < width; i++){
+                lastTrace[i] ^= static_cast<uint32_t>(varint());
+                std::memcpy(&rec.values[i], &lastTrace[i], sizeof(float));
+            }
+        }
+        else
+            throw std::runtime_error(filename + " is corrupt: unknown record tag " + std::to_string(tag));
+        return true;
+    }
+
+    std::vector<std::pair<uint64_t, size_t> > SpikeStreamReader::allSpikes(){
+        std::vector<std::pair<uint64_t, size_t> > result;
+        SpikeStreamRecord rec;
+        while(next(rec))
+            if (rec.kind == SpikeStreamRecord::Spikes)
+                for(size_t n : rec.nodes)
+                    result.push_back({rec.step, n});
+        return result;
+    }
+}
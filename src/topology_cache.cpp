@@ -0,0 +1,111 @@
+#include "topology_cache.hpp"
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+
+namespace llrt{
+
+    namespace{
+        const char topologyMagic[8] = {'L', 'L', 'R', 'T', 'T', 'O', 'P', 'O'};
+        const uint32_t topologyVersion = 1;
+
+        void putU64(std::string &out, uint64_t v){
+            out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+        }
+
+        /// round up to a multiple of 8, so entries' data is aligned for size_t
+        uint64_t align8(uint64_t n){
+            return (n + 7) / 8 * 8;
+        }
+    }
+
+    TopologyCache::TopologyCache(const std::string &filename) : filename(filename){
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0)
+            return; // no cache yet
+        file = std::make_unique<MappedFile>(filename);
+        const char *p = file->data(), *end = p + file->size();
+        auto get = [&](void *dst, size_t bytes){
+            if (static_cast<size_t>(end - p) < bytes)
+                throw std::runtime_error(filename + " is truncated");
+            std::memcpy(dst, p, bytes);
+            p += bytes;
+        };
+        char magic[sizeof(topologyMagic)];
+        uint32_t version, unused;
+        get(magic, sizeof(magic));
+        if (std::memcmp(magic, topologyMagic, sizeof(magic)) != 0)
+            throw std::runtime_error(filename + " is not a topology cache");
+        get(&version, sizeof(version));
+        get(&unused, sizeof(unused));
+        if (version != topologyVersion)
+            throw std::runtime_error(filename + " is a version " + std::to_string(version) + " topology cache, but only version " + std::to_string(topologyVersion) + " is supported");
+        uint64_t n;
+        get(&n, sizeof(n));
+        struct Pending{
+            std::string key;
+            uint64_t offset, bytes;
+        };
+        std::vector<Pending> pending;
+        for(uint64_t i=0; i < n; i++){
+            Pending e;
+            uint64_t keyBytes;
+            get(&keyBytes, sizeof(keyBytes));
+            if (keyBytes > static_cast<size_t>(end - p))
+                throw std::runtime_error(filename + " is truncated");
+            e.key.assign(p, keyBytes);
+            p += keyBytes;
+            get(&e.offset, sizeof(e.offset));
+            get(&e.bytes, sizeof(e.bytes));
+            pending.push_back(e);
+        }
+        const char *dataStart = file->data() + align8(p - file->data());
+        for(const Pending &e : pending){
+            uint64_t available = dataStart <= end ? end - dataStart : 0;
+            if (e.offset > available || e.bytes > available - e.offset)
+                throw std::runtime_error(filename + " is truncated");
+            entries[e.key] = {dataStart + e.offset, e.bytes};
+        }
+    }
+
+    void TopologyCache::write(const std::map<std::string, std::string> &newEntries){
+        std::string index;
+        index.append(topologyMagic, sizeof(topologyMagic));
+        uint32_t version = topologyVersion, unused = 0;
+        index.append(reinterpret_cast<const char *>(&version), sizeof(version));
+        index.append(reinterpret_cast<const char *>(&unused), sizeof(unused));
+        putU64(index, newEntries.size());
+        uint64_t offset = 0;
+        for(auto &e : newEntries){
+            putU64(index, e.first.size());
+            index += e.first;
+            putU64(index, offset);
+            putU64(index, e.second.size());
+            offset = align8(offset + e.second.size());
+        }
+        index.resize(align8(index.size()), '\0');
+
+        std::string tmp = filename + ".tmp";
+        {
+            std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+            if (!f)
+                throw std::runtime_error("Couldn't open " + tmp + " for writing");
+            f.write(index.data(), index.size());
+            const char padding[8] = {};
+            for(auto &e : newEntries){
+                f.write(e.second.data(), e.second.size());
+                f.write(padding, align8(e.second.size()) - e.second.size());
+            }
+            f.close();
+            if (!f)
+                throw std::runtime_error("Couldn't write " + tmp);
+        }
+        // drop the old mapping before replacing the file it maps
+        entries.clear();
+        file.reset();
+        if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+            throw std::runtime_error("Couldn't replace " + filename + ": " + std::strerror(errno));
+        *this = TopologyCache(filename);
+    }
+}
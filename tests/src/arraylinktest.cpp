@@ -0,0 +1,154 @@
+#include "arraylinktest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+
+using namespace llrt;
+
+namespace{
+    using TL = std::pair<std::tuple<float>, std::tuple<DenseLink, ArrayLink<DenseLink>, ArrayLink<AdjListLink>, ArrayLink<Local2DLink<3,2,1> > > >;
+
+    const size_t members = 50, n = 20, k = 8;
+
+    float node(size_t m, size_t i){
+        return 0.01f * (m * n + i);
+    }
+
+    float weight(size_t m, size_t i, size_t j){
+        return 0.001f * ((m * 7 + i * 3 + j) % 11);
+    }
+}
+
+void arrayLinkTest(){
+    GIVEN("An array of small populations, and the same populations built separately"){
+        Network<TL> arrayNet(2);
+        Component<TL> &A = arrayNet.template componentArray<float>(members, {n});
+        Component<TL> &B = A.template connect<ArrayLink<DenseLink>, float, NoData, float>({members, k});
+        Link<TL> &al = *B.links[1][0];
+
+        Network<TL> sepNet(2);
+        std::vector<Link<TL> *> sl;
+        for(size_t m=0; m < members; m++){
+            Component<TL> &a = sepNet.template component<float>({n});
+            Component<TL> &b = a.template connect<DenseLink, float, NoData, float>({k});
+            sl.push_back(b.links[1][0].get());
+        }
+
+        std::vector<float> &aw = al.linkData<float>(0);
+        REQUIRE(A.dataSize() == members * n);
+        REQUIRE(aw.size() == members * n * k);
+        for(size_t m=0; m < members; m++)
+            for(size_t i=0; i < n; i++){
+                std::get<std::vector<float> >(A.data.values)[m * n + i] = node(m, i);
+                std::get<std::vector<float> >(sl[m]->ends[0].c.data.values)[i] = node(m, i);
+                for(size_t j=0; j < k; j++){
+                    aw[m * n * k + i * k + j] = weight(m, i, j);
+                    sl[m]->linkData<float>(0)[i * k + j] = weight(m, i, j);
+                }
+            }
+
+        auto kernel = [](float &N, const float &e, const float &n){
+            N += e * n;
+        };
+
+        WHEN("The weighted sums are computed in parallel"){
+            arrayNet.sched->startTrace();
+            ProcessLink_Nen(al, 1, kernel, Parallel);
+            SchedulerTrace trace = arrayNet.sched->stopTrace();
+            for(Link<TL> *l : sl)
+                ProcessLink_Nen(*l, 1, kernel, Parallel);
+
+            THEN("Each member gets the sums of its own population"){
+                std::vector<float> &result = std::get<std::vector<float> >(B.data.values);
+                for(size_t m=0; m < members; m++)
+                    for(size_t j=0; j < k; j++)
+                        REQUIRE(result[m * k + j] == std::get<std::vector<float> >(sl[m]->ends[1].c.data.values)[j]);
+            }
+
+            THEN("The whole array is a single job"){
+                REQUIRE(trace.batches.size() == 1);
+                REQUIRE(trace.batches[0].jobs.size() == 1);
+                REQUIRE(trace.batches[0].jobs[0].maxProgress == members * std::get<ArrayLink<DenseLink> >(al.type).inner.maxProgress(1));
+            }
+        }
+
+        THEN("Partial progress stops within one member's progress points"){
+            ArrayLink<DenseLink> &t = std::get<ArrayLink<DenseLink> >(al.type);
+            size_t p = t.inner.maxProgress(0);
+            REQUIRE(t.maxProgress(0) == members * p);
+            REQUIRE(t.requestPartialProgress(0, 3 * p) == 3 * p);
+            REQUIRE(t.requestPartialProgress(0, 3 * p + 5) == 3 * p + t.inner.requestPartialProgress(0, 5));
+            REQUIRE(t.requestPartialProgress(0, members * p + 5) == members * p);
+        }
+    }
+
+    GIVEN("An array of populations connected by an AdjListLink"){
+        Network<TL> net(2);
+        Component<TL> &A = net.template componentArray<float>(4, {10});
+        Component<TL> &B = net.template componentArray<float>(4, {6});
+        A.template connect<ArrayLink<AdjListLink>, float, float>(B);
+        Link<TL> &l = *B.links[1][0];
+        ArrayLink<AdjListLink> &t = net.template prevLinkType<ArrayLink<AdjListLink> >();
+        t.inner.insertEdges({{0, 1}, {9, 1}, {3, 5}});
+
+        ProcessCmp_N(A, [](float &N){
+            N = 1;
+        });
+        for(size_t i=0; i < 12; i++)
+            l.linkData<float>(0)[i] = float(i + 1);
+
+        THEN("Every member has the edges, with values of its own"){
+            REQUIRE(l.linkData<float>(0).size() == 12);
+            REQUIRE(l.linkData<float>(1).size() == 12);
+            ProcessLink_Nen(l, 1, [](float &N, const float &e, const float &n){
+                N += e * n;
+            });
+            std::vector<float> &b = std::get<std::vector<float> >(B.data.values);
+            for(size_t m=0; m < 4; m++){
+                REQUIRE(b[m * 6 + 1] == float(m * 3 + 1) + float(m * 3 + 2));
+                REQUIRE(b[m * 6 + 5] == float(m * 3 + 3));
+                REQUIRE(b[m * 6 + 0] == 0);
+            }
+        }
+
+        WHEN("More edges are inserted"){
+            t.inner.insertEdges({{2, 2}});
+
+            THEN("Each member's values stay with its own edges"){
+                std::vector<float> &e = l.linkData<float>(0);
+                REQUIRE(e.size() == 16);
+                for(size_t m=0; m < 4; m++){
+                    for(size_t i=0; i < 3; i++)
+                        REQUIRE(e[m * 4 + i] == float(m * 3 + i + 1));
+                    REQUIRE(e[m * 4 + 3] == 0);
+                }
+            }
+        }
+    }
+
+    GIVEN("An array of populations connected by a Local2DLink"){
+        Network<TL> net(2);
+        Component<TL> &A = net.template componentArray<float>(3, {9, 9});
+        Component<TL> &B = A.template connect<ArrayLink<Local2DLink<3,2,1> >, NoData, NoData, float>();
+
+        THEN("The far component is an array of the deduced member dimensions"){
+            REQUIRE(B.data.dimensions.size() == 3);
+            REQUIRE(B.data.dimensions[0] == 3);
+        }
+
+        THEN("The members don't see each other"){
+            std::vector<float> &a = std::get<std::vector<float> >(A.data.values);
+            for(size_t i=0; i < a.size(); i++)
+                a[i] = float(i / 81 + 1);
+            ProcessLink_Nn(*B.links[1][0], 1, [](float &N, const float &n){
+                N += n;
+            }, Parallel);
+            std::vector<float> &b = std::get<std::vector<float> >(B.data.values);
+            size_t memberSize = b.size() / 3;
+            for(size_t i=0; i < memberSize; i++){
+                REQUIRE(b[i] > 0);
+                REQUIRE(b[memberSize + i] == 2 * b[i]);
+                REQUIRE(b[2 * memberSize + i] == 3 * b[i]);
+            }
+        }
+    }
+}
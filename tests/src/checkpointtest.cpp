@@ -0,0 +1,212 @@
+#include "checkpointtest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include "incremental_checkpoint.hpp"
+#include <cstdio>
+
+using namespace llrt;
+
+struct CkptNode{
+    float v;
+    int spikes;
+};
+
+using TTypes = std::tuple<CkptNode, float, bool>;
+using LTypes = std::tuple<DenseLink, AdjListLink>;
+using TL = std::pair<TTypes, LTypes>;
+
+// A Network with a Dense link, an AdjList link and a bool component
+struct CkptNet{
+    Network<TL> net;
+    Component<TL> &A, &B, &C;
+    CkptNet() : net(0),
+                A(net.template component<CkptNode>({4, 3})),
+                B(A.template connect<DenseLink, float, float, CkptNode>({5})),
+                C(net.template component<bool>({7})){
+        B.template connect<AdjListLink, float, NoData>(C);
+    }
+    AdjListLink &adj(){
+        return std::get<AdjListLink>(B.links[0][0]->type);
+    }
+};
+
+void checkpointTest(){
+    std::string filename = "checkpointtest.ckpt";
+    GIVEN("A network with data in every tensor"){
+        CkptNet a;
+        a.net.seed(3);
+        a.adj().insertEdges({{0, 1}, {0, 6}, {2, 3}, {4, 1}, {4, 0}});
+        a.adj().removeEdges({{2, 3}});
+        ProcessCmp_Nr(a.A, [](CkptNode &N, ThreadsafeRNG &r){
+            N.v = r() % 1000;
+            N.spikes = r() % 7;
+        });
+        ProcessLink_Er(*a.B.links[1][0], 1, [](float &E, ThreadsafeRNG &r){
+            E = r() % 100;
+        });
+        ProcessLink_Er(*a.B.links[0][0], 0, [](float &E, ThreadsafeRNG &r){
+            E = r() % 100;
+        });
+        auto &spikes = std::get<std::vector<bool> >(a.C.data.values);
+        for(size_t i=0; i < spikes.size(); i++)
+            spikes[i] = a.net.rng() % 2;
+        saveCheckpoint(a.net, filename);
+
+        WHEN("The checkpoint is loaded into a network with the same structure"){
+            CkptNet b;
+            loadCheckpoint(b.net, filename);
+            THEN("All the data and the adjacency are restored"){
+                auto &av = std::get<std::vector<CkptNode> >(a.A.data.values);
+                auto &bv = std::get<std::vector<CkptNode> >(b.A.data.values);
+                REQUIRE(av.size() == bv.size());
+                for(size_t i=0; i < av.size(); i++){
+                    REQUIRE(av[i].v == bv[i].v);
+                    REQUIRE(av[i].spikes == bv[i].spikes);
+                }
+                REQUIRE(a.B.links[1][0]->linkData<float>(1) == b.B.links[1][0]->linkData<float>(1));
+                REQUIRE(a.B.links[0][0]->linkData<float>(0) == b.B.links[0][0]->linkData<float>(0));
+                REQUIRE(a.B.links[0][0]->linkData<float>(0).size() == 5);
+                REQUIRE(std::get<std::vector<bool> >(a.C.data.values) == std::get<std::vector<bool> >(b.C.data.values));
+                REQUIRE(b.adj().edgeIxBound == 5);
+                REQUIRE(b.adj().destructedStatus == a.adj().destructedStatus);
+                REQUIRE(b.B.links[0][0]->getMaxProgress(0) == 4);
+
+                std::vector<std::pair<size_t, size_t> > aEdges, bEdges;
+                ProcessLink_Nini(*a.B.links[0][0], 0, [&](const size_t Ni, const size_t ni){
+                    aEdges.push_back({Ni, ni});
+                });
+                ProcessLink_Nini(*b.B.links[0][0], 0, [&](const size_t Ni, const size_t ni){
+                    bEdges.push_back({Ni, ni});
+                });
+                REQUIRE(aEdges == bEdges);
+            }
+            THEN("The random number generator continues where it was"){
+                REQUIRE(a.net.rng() == b.net.rng());
+            }
+        }
+
+        WHEN("The checkpoint is loaded into a network with a different structure"){
+            Network<TL> other(0);
+            auto &A = other.template component<CkptNode>({4, 3});
+            A.template connect<DenseLink, float, float, CkptNode>({6});
+            other.template component<bool>({7});
+            THEN("It throws"){
+                REQUIRE_THROWS_AS(loadCheckpoint(other, filename), std::runtime_error);
+            }
+        }
+    }
+    std::remove(filename.c_str());
+
+    GIVEN("An incremental checkpointer with small chunks"){
+        CkptNet a;
+        a.adj().insertEdges({{0, 1}, {0, 6}, {2, 3}});
+        ProcessCmp_NiN(a.A, [](const size_t Ni, CkptNode &N){
+            N.v = Ni;
+        });
+        IncrementalCheckpointer<TL>::Options opts;
+        opts.chunkBytes = 16;
+        opts.fullEvery = 10;
+        IncrementalCheckpointer<TL> ckpt(a.net, "checkpointtest", opts);
+        REQUIRE(ckpt.checkpoint() == "checkpointtest.0.ckpt");
+
+        WHEN("One node and the adjacency change between checkpoints"){
+            ProcessCmp_NiN(a.A, [](const size_t Ni, CkptNode &N){
+                if (Ni == 5)
+                    N.spikes = 1;
+            });
+            a.adj().insertEdges({{4, 4}});
+            REQUIRE(ckpt.checkpoint() == "checkpointtest.1.delta");
+            ProcessLink_E(*a.B.links[1][0], 1, [](float &E){
+                E += 1;
+            });
+            REQUIRE(ckpt.checkpoint() == "checkpointtest.2.delta");
+            ckpt.wait();
+
+            THEN("The first delta holds only the changed chunk and the new edge"){
+                MappedCheckpoint delta("checkpointtest.1.delta");
+                REQUIRE(delta.delta);
+                REQUIRE(delta.delta->chunks[0] == std::vector<uint64_t>{2}); // node 5 is in bytes 40-47
+                REQUIRE(delta.delta->chunks[1].empty());
+                REQUIRE(delta.delta->chunks[3].empty());
+                REQUIRE(delta.delta->linkStateChanged == std::vector<bool>{false, true});
+            }
+            THEN("The chain restores the latest values"){
+                CkptNet b;
+                loadCheckpointChain(b.net, ckpt.chainFilename());
+                auto &av = std::get<std::vector<CkptNode> >(a.A.data.values);
+                auto &bv = std::get<std::vector<CkptNode> >(b.A.data.values);
+                for(size_t i=0; i < av.size(); i++){
+                    REQUIRE(av[i].v == bv[i].v);
+                    REQUIRE(av[i].spikes == bv[i].spikes);
+                }
+                REQUIRE(a.B.links[1][0]->linkData<float>(1) == b.B.links[1][0]->linkData<float>(1));
+                REQUIRE(b.adj().edgeIxBound == 4);
+                REQUIRE(b.B.links[0][0]->linkData<float>(0).size() == 4);
+            }
+        }
+        ckpt.wait();
+        for(const char *f : {"checkpointtest.0.ckpt", "checkpointtest.1.delta", "checkpointtest.2.delta", "checkpointtest.chain"})
+            std::remove(f);
+    }
+
+    GIVEN("An incremental checkpoint of edges that are then removed"){
+        CkptNet a;
+        std::vector<std::pair<size_t, size_t> > edges;
+        for(size_t i=0; i < 100; i++)
+            edges.push_back({i % 5, i % 7});
+        a.adj().insertEdges(edges);
+        ProcessLink_EEi(*a.B.links[0][0], 0, [](float &E, const size_t Ei){
+            E = Ei + 1;
+        });
+        // one chunk for all the edges, as for any link smaller than a chunk
+        IncrementalCheckpointer<TL> ckpt(a.net, "checkpointtest_edges");
+        ckpt.checkpoint();
+        a.adj().removeEdges(std::vector<std::pair<size_t, size_t> >(edges.begin(), edges.begin() + 10));
+        auto restoresEachEdge = [&](size_t numEdges){
+            REQUIRE(ckpt.checkpoint() == "checkpointtest_edges.1.delta");
+            ckpt.wait();
+            CkptNet b;
+            loadCheckpointChain(b.net, ckpt.chainFilename());
+            std::vector<float> &av = a.B.links[0][0]->linkData<float>(0), &bv = b.B.links[0][0]->linkData<float>(0);
+            REQUIRE(bv == av);
+            REQUIRE(bv.size() == numEdges);
+            for(size_t n=0; n < 5; n++){
+                auto &an = a.adj().end0Adjacency[n], &bn = b.adj().end0Adjacency[n];
+                REQUIRE(an.size() == bn.size());
+                for(size_t k=0; k < an.size(); k++){
+                    REQUIRE(an[k].farNode == bn[k].farNode);
+                    REQUIRE(bv[bn[k].edgeIx] == av[an[k].edgeIx]);
+                }
+            }
+        };
+
+        WHEN("The removed edges' values are cleared in place"){
+            THEN("A delta restores each edge with its own value"){
+                REQUIRE(a.B.links[0][0]->linkData<float>(0)[0] == 0);
+                restoresEachEdge(100);
+            }
+        }
+        WHEN("The edges are defragmented"){
+            a.adj().defragmentEdges();
+            THEN("A delta restores each edge with its own value"){
+                REQUIRE(a.B.links[0][0]->linkData<float>(0)[0] == 11);
+                restoresEachEdge(90);
+            }
+        }
+        ckpt.wait();
+        for(const char *f : {"checkpointtest_edges.0.ckpt", "checkpointtest_edges.1.delta", "checkpointtest_edges.chain"})
+            std::remove(f);
+    }
+
+    GIVEN("A file that isn't a checkpoint"){
+        {
+            std::ofstream f(filename);
+            f << "not a checkpoint\n";
+        }
+        CkptNet b;
+        THEN("Loading it throws"){
+            REQUIRE_THROWS_AS(loadCheckpoint(b.net, filename), std::runtime_error);
+        }
+        std::remove(filename.c_str());
+    }
+}
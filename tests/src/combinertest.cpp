@@ -0,0 +1,100 @@
+#include "combinertest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include <cmath>
+
+using namespace llrt;
+
+namespace{
+    using TL = std::pair<std::tuple<float>, std::tuple<DenseLink> >;
+
+    struct CNet{
+        Network<TL> net;
+        Component<TL> &A, &B, &C;
+        CNet(int workers) : net(workers),
+                            A(net.template component<float>({1000})),
+                            B(A.template connect<DenseLink, NoData, float, float>({100})),
+                            C(net.template component<float>({100000})){
+            // values of very different sizes, so the order of addition matters
+            std::mt19937 rng(3);
+            for(float &x : values(C))
+                x = std::normal_distribution<float>(0, 1)(rng) * std::exp(std::uniform_real_distribution<float>(-8, 8)(rng));
+            for(float &x : edges())
+                x = std::normal_distribution<float>(0, 1)(rng) * std::exp(std::uniform_real_distribution<float>(-8, 8)(rng));
+        }
+
+        std::vector<float> &values(Component<TL> &c){
+            return std::get<std::vector<float> >(c.data.values);
+        }
+        std::vector<float> &edges(){
+            return std::get<std::vector<float> >(B.links[1][0]->ends[1].data.values);
+        }
+    };
+
+    struct Sum{
+        float total = 0;
+        void operator()(const float &N){
+            total += N;
+        }
+    };
+
+    struct EdgeSum{
+        float total = 0;
+        void operator()(const float &E){
+            total += E;
+        }
+    };
+
+    auto add = [](auto &k, auto &copy){
+        k.total += copy.total;
+    };
+
+    float nodeSum(CNet &c, size_t block){
+        Sum s;
+        ProcessCmp_N(c.C, s, Parallel | Combiner(add) | DeterministicCombine(block));
+        return s.total;
+    }
+
+    float edgeSum(CNet &c, size_t block){
+        EdgeSum s;
+        ProcessLink_E(*c.B.links[1][0], 1, s, Parallel | Combiner(add) | DeterministicCombine(block));
+        return s.total;
+    }
+}
+
+void combinerTest(){
+    GIVEN("Float sums with a deterministic Combiner on one thread and on several"){
+        CNet single(0), adaptive(4), three(3);
+        float nodes = nodeSum(single, 1000), edges = edgeSum(single, 1000);
+        double exactNodes = 0, exactEdges = 0;
+        for(float x : single.values(single.C))
+            exactNodes += x;
+        for(float x : single.edges())
+            exactEdges += x;
+
+        THEN("The sums are close to the exact sums"){
+            REQUIRE(std::abs(nodes - exactNodes) <= 1e-3 * std::abs(exactNodes) + 1e-3);
+            REQUIRE(std::abs(edges - exactEdges) <= 1e-3 * std::abs(exactEdges) + 1e-3);
+        }
+
+        THEN("Every run gives the same bits, whatever the workers and chunks"){
+            for(CNet *c : {&adaptive, &three})
+                for(int run=0; run < 5; run++){
+                    REQUIRE(nodeSum(*c, 1000) == nodes);
+                    REQUIRE(edgeSum(*c, 1000) == edges);
+                }
+        }
+
+        THEN("A block that doesn't divide the progress evenly is also deterministic"){
+            float oddNodes = nodeSum(single, 777), oddEdges = edgeSum(single, 1500);
+            for(int run=0; run < 5; run++){
+                REQUIRE(nodeSum(adaptive, 777) == oddNodes);
+                REQUIRE(edgeSum(adaptive, 1500) == oddEdges);
+            }
+        }
+
+        THEN("Blocks must have some progress"){
+            REQUIRE_THROWS(DeterministicCombine(0));
+        }
+    }
+}
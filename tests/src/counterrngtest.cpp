@@ -0,0 +1,159 @@
+#include "counterrngtest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include <array>
+#include <set>
+
+using namespace llrt;
+
+namespace{
+    using TL = std::pair<std::tuple<float>, std::tuple<DenseLink> >;
+
+    struct RNet{
+        Network<TL> net;
+        Component<TL> &A, &B;
+        RNet(int workers) : net(workers),
+                            A(net.template component<float>({300})),
+                            B(A.template connect<DenseLink, float, float, float>({40})){
+            net.seed(11);
+        }
+
+        /// draw random values everywhere, twice on A
+        void draw(){
+            for(int i=0; i < 2; i++)
+                ProcessCmp_Nr(A, [](float &N, CounterRNG &r){
+                    N += std::normal_distribution<float>(0, 1)(r);
+                }, ParallelNonBlocking);
+            ProcessNetLinks_Er(net, [](float &E, CounterRNG &r){
+                E = r.uniform();
+            }, ParallelNonBlocking);
+            net.finishBatches();
+        }
+
+        std::vector<float> &values(Component<TL> &c){
+            return std::get<std::vector<float> >(c.data.values);
+        }
+        std::vector<float> &edges(int whichEnd){
+            return std::get<std::vector<float> >(B.links[1][0]->ends[whichEnd].data.values);
+        }
+    };
+}
+
+void counterRNGTest(){
+    GIVEN("The Philox4x32-10 known-answer tests"){
+        THEN("The blocks match"){
+            auto block = [](std::array<uint32_t, 4> ctr, std::array<uint32_t, 2> key){
+                std::array<uint32_t, 4> out;
+                CounterRNG::philox(ctr.data(), key.data(), out.data());
+                return out;
+            };
+            REQUIRE(block({0, 0, 0, 0}, {0, 0}) == std::array<uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+            REQUIRE(block({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}) == std::array<uint32_t, 4>{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+            REQUIRE(block({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}) == std::array<uint32_t, 4>{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+        }
+    }
+
+    GIVEN("A stream"){
+        CounterRNG a(42), b(42);
+        a.restart(7, 9);
+        b.restart(7, 9);
+        THEN("Bulk generation gives the same numbers as single draws"){
+            std::vector<uint32_t> single, bulk(37);
+            for(size_t i=0; i < 38; i++)
+                single.push_back(a());
+            bulk[0] = b();
+            b.generate(bulk.data() + 1, 36);
+            bulk.push_back(b());
+            REQUIRE(bulk == single);
+            std::vector<float> u(600);
+            a.restart(1, 2);
+            a.uniform(u.data(), u.size());
+            b.restart(1, 2);
+            for(float x : u){
+                REQUIRE(x == b.uniform());
+                REQUIRE(x >= 0);
+                REQUIRE(x < 1);
+            }
+        }
+
+        THEN("Nodes that differ only in their high bits get different streams"){
+            uint64_t k = 5;
+            a.restart(3, 9);
+            b.restart(3 ^ (k << 32 | k), 9);
+            REQUIRE(a() != b());
+            a.restart(3, 9);
+            b.restart(3 | uint64_t(1) << 40, 9);
+            REQUIRE(a() != b());
+            a.restart(3, 9);
+            b.restart(3, 9 | uint64_t(1) << 40);
+            REQUIRE(a() != b());
+        }
+    }
+
+    GIVEN("Kernels that draw from a CounterRNG"){
+        RNet single(0), parallel(4), adaptive(3);
+        parallel.net.setDeterminism();
+        for(RNet *n : {&single, &parallel, &adaptive})
+            n->draw();
+
+        THEN("The numbers don't depend on the workers or the scheduling"){
+            for(RNet *n : {&parallel, &adaptive}){
+                REQUIRE(n->values(n->A) == single.values(single.A));
+                REQUIRE(n->values(n->B) == single.values(single.B));
+                REQUIRE(n->edges(0) == single.edges(0));
+                REQUIRE(n->edges(1) == single.edges(1));
+            }
+        }
+        THEN("Each node, edge and operation gets its own numbers"){
+            std::vector<float> &a = single.values(single.A);
+            std::set<float> distinct(a.begin(), a.end());
+            REQUIRE(distinct.size() == a.size());
+            std::set<float> edges(single.edges(0).begin(), single.edges(0).end());
+            REQUIRE(edges.size() > single.edges(0).size() * 99 / 100);
+            REQUIRE(single.edges(0) != single.edges(1));
+            // the second draw on A is not the first one again
+            RNet once(0);
+            ProcessCmp_Nr(once.A, [](float &N, CounterRNG &r){
+                N += std::normal_distribution<float>(0, 1)(r);
+            });
+            for(size_t i=0; i < a.size(); i++)
+                REQUIRE(a[i] != 2 * once.values(once.A)[i]);
+        }
+        THEN("Another seed gives other numbers"){
+            RNet other(0);
+            other.net.seed(12);
+            other.draw();
+            REQUIRE(other.values(other.A) != single.values(single.A));
+        }
+    }
+
+    GIVEN("A component that another process runs"){
+        RNet all(0), part(0);
+        part.A.local = false;
+        all.draw();
+        part.draw();
+        THEN("Its operations are skipped, but still advance its streams"){
+            REQUIRE(part.values(part.A) == std::vector<float>(300, 0));
+            REQUIRE(part.values(part.B) == all.values(all.B));
+            REQUIRE(part.A.selfLink->rngSteps[0] == all.A.selfLink->rngSteps[0]);
+            part.A.local = true;
+            for(RNet *n : {&all, &part})
+                ProcessCmp_Nr(n->A, [](float &N, CounterRNG &r){
+                    N = r.uniform();
+                });
+            REQUIRE(part.values(part.A) == all.values(all.A));
+        }
+    }
+
+    GIVEN("A kernel that draws from a ThreadsafeRNG"){
+        RNet run(0), drawn(0);
+        ProcessCmp_Nr(run.A, [](float &N, ThreadsafeRNG &r){
+            N = r();
+        });
+        THEN("The network's generator seeds the kernel and its reference copy"){
+            drawn.net.rng();
+            drawn.net.rng();
+            REQUIRE(run.net.rng() == drawn.net.rng());
+        }
+    }
+}
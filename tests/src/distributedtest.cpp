@@ -0,0 +1,186 @@
+#include "distributedtest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include "distributed_partition.hpp"
+
+using namespace llrt;
+
+namespace{
+    struct DNode{
+        float v;
+        float in;
+    };
+
+    using TL = std::pair<std::tuple<DNode, float, bool>, std::tuple<DenseLink> >;
+
+    const size_t steps = 20, numSpikes = 1000;
+
+    // A -> B -> C, densely linked, and a component D of spikes linked to A
+    struct DNet{
+        Network<TL> net;
+        Component<TL> &A, &B, &C, &D;
+        DNet() : net(2),
+                 A(net.template component<DNode>({4})),
+                 B(A.template connect<DenseLink, float, float, DNode>({3})),
+                 C(B.template connect<DenseLink, float, float, DNode>({2})),
+                 D(A.template connect<DenseLink, NoData, NoData, bool>({numSpikes})){}
+
+        void initialize(){
+            ProcessNetCmps_NNi(net, [](DNode &N, const size_t Ni){
+                N.v = Ni + 1;
+                N.in = 0;
+            }, Parallel | NearCmpFilter([](Component<TL> &c){return c.data.values.index() == 0;}));
+            ProcessLink_EEi(*B.links[1][0], 1, [](float &E, const size_t Ei){
+                E = 0.1f * (Ei % 5 + 1);
+            }, Parallel);
+            ProcessLink_EEi(*B.links[1][0], 0, [](float &E, const size_t Ei){
+                E = 0.2f * (Ei % 3 + 1);
+            }, Parallel);
+            ProcessLink_EEi(*C.links[1][0], 1, [](float &E, const size_t Ei){
+                E = 0.1f * (Ei % 2 + 1);
+            }, Parallel);
+            ProcessLink_EEi(*C.links[1][0], 0, [](float &E, const size_t Ei){
+                E = 0.3f;
+            }, Parallel);
+        }
+
+        void step(){
+            ProcessLink_NEn(*B.links[1][0], 0, [](DNode &N, const float &E, const DNode &n){
+                N.in += E * n.v;
+            }, ParallelPart);
+            ProcessLink_NEn(*B.links[1][0], 1, [](DNode &N, const float &E, const DNode &n){
+                N.in += E * n.v;
+            }, ParallelPart);
+            ProcessLink_NEn(*C.links[1][0], 1, [](DNode &N, const float &E, const DNode &n){
+                N.in += E * n.v;
+            }, Parallel);
+            ProcessNetCmps_N(net, [](DNode &N){
+                N.v = 0.5f * N.v + 0.1f * N.in + 0.01f;
+                N.in = 0;
+            }, Parallel | NearCmpFilter([](Component<TL> &c){return c.data.values.index() == 0;}));
+        }
+
+        // a few spikes, only computed where D is local
+        void spike(size_t t){
+            if (!D.local)
+                return;
+            auto &spikes = std::get<std::vector<bool> >(D.data.values);
+            for(size_t i=0; i < spikes.size(); i++)
+                spikes[i] = (i + t) % 97 == 0;
+        }
+    };
+
+    std::vector<float> values(Component<TL> &c){
+        std::vector<float> v;
+        for(const DNode &n : std::get<std::vector<DNode> >(c.data.values))
+            v.push_back(n.v);
+        return v;
+    }
+}
+
+void distributedTest(){
+    GIVEN("Spike indices"){
+        std::vector<bool> spikes(300, false);
+        for(size_t i : {0, 1, 128, 299})
+            spikes[i] = true;
+        std::string encoded;
+        encodeSpikeIndices(spikes, encoded);
+        std::vector<bool> decoded(300, true);
+        THEN("They round-trip, and take a few bytes each"){
+            REQUIRE(decodeSpikeIndices(encoded.data(), encoded.data() + encoded.size(), decoded) == encoded.data() + encoded.size());
+            REQUIRE(decoded == spikes);
+            REQUIRE(encoded.size() == 1 + 1 + 1 + 1 + 2);
+            std::vector<bool> tooShort(200);
+            REQUIRE_THROWS_AS(decodeSpikeIndices(encoded.data(), encoded.data() + encoded.size(), tooShort), std::runtime_error);
+        }
+    }
+
+    GIVEN("A network run in one process"){
+        DNet ref;
+        ref.initialize();
+        for(size_t t=0; t < steps; t++)
+            ref.step();
+        std::vector<float> refA = values(ref.A), refB = values(ref.B), refC = values(ref.C);
+
+        WHEN("The same network is split between two ranks over TCP on loopback"){
+            std::vector<size_t> owners{0, 1, 1, 1};
+            TcpTransport t0(0, 2, "127.0.0.1:0"), t1(1, 2, "127.0.0.1:0");
+            std::vector<std::string> addresses{"127.0.0.1:" + std::to_string(t0.port()), "127.0.0.1:" + std::to_string(t1.port())};
+            DNet n0, n1;
+            size_t interiorCalls = 0;
+            size_t sent0 = 0, sent1 = 0;
+            auto run = [&](DNet &n, TcpTransport &transport, size_t &sent, size_t *calls){
+                transport.connect(addresses, std::chrono::milliseconds(10000));
+                DistributedPartition<TL> part(n.net, transport, owners);
+                n.initialize();
+                part.exchange();
+                for(size_t t=0; t < steps; t++){
+                    n.step();
+                    n.spike(t);
+                    part.exchange([&]{
+                        if (calls != nullptr)
+                            (*calls)++;
+                        return size_t(0);
+                    });
+                }
+                sent = part.bytesSent();
+            };
+            std::exception_ptr error;
+            std::thread other([&]{
+                try{
+                    run(n1, t1, sent1, nullptr);
+                }
+                catch(...){
+                    error = std::current_exception();
+                }
+            });
+            run(n0, t0, sent0, &interiorCalls);
+            other.join();
+            if (error)
+                std::rethrow_exception(error);
+
+            THEN("Rank 0 sees the same values as one process, and the spikes of rank 1 as indices"){
+                REQUIRE(interiorCalls == steps);
+                std::vector<float> a = values(n0.A), b = values(n0.B), c = values(n1.C);
+                for(size_t i=0; i < refA.size(); i++)
+                    REQUIRE(a[i] == Approx(refA[i]));
+                for(size_t i=0; i < refB.size(); i++)
+                    REQUIRE(b[i] == Approx(refB[i]));
+                for(size_t i=0; i < refC.size(); i++)
+                    REQUIRE(c[i] == Approx(refC[i]));
+                auto &spikes = std::get<std::vector<bool> >(n0.D.data.values);
+                for(size_t i=0; i < spikes.size(); i++)
+                    REQUIRE(spikes[i] == ((i + steps - 1) % 97 == 0));
+                // rank 0 never computes C
+                REQUIRE(values(n0.C) == std::vector<float>(2, 0));
+                // about 11 spikes of 1000 take far fewer bytes than the bools
+                REQUIRE(sent1 < (steps + 1) * numSpikes / 2);
+                REQUIRE(sent0 > 0);
+            }
+        }
+    }
+
+    GIVEN("Two ranks connected over TCP with a receive timeout and a maximum message size"){
+        TcpTransport::Options opts;
+        opts.receiveTimeout = std::chrono::milliseconds(100);
+        opts.maxMessageBytes = 10;
+        TcpTransport t0(0, 2, "127.0.0.1:0", opts), t1(1, 2, "127.0.0.1:0", opts);
+        std::vector<std::string> addresses{"127.0.0.1:" + std::to_string(t0.port()), "127.0.0.1:" + std::to_string(t1.port())};
+        std::thread other([&]{
+            t1.connect(addresses, std::chrono::milliseconds(10000));
+        });
+        t0.connect(addresses, std::chrono::milliseconds(10000));
+        other.join();
+
+        THEN("Receiving throws when nothing arrives in time"){
+            REQUIRE_THROWS(t0.receive(1));
+        }
+
+        THEN("Messages up to the maximum arrive, and a longer one breaks the connection"){
+            t0.send(1, "short");
+            t0.send(1, std::string(11, 'x'));
+            REQUIRE(t1.receive(0) == "short");
+            REQUIRE_THROWS_WITH(t1.receive(0), Catch::Contains("more than the maximum"));
+        }
+    }
+}
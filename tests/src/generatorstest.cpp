@@ -0,0 +1,135 @@
+#include "generatorstest.hpp"
+#include "catch.hpp"
+#include "generators.hpp"
+#include "process_link.hpp"
+
+using namespace llrt;
+
+namespace{
+    struct GNode{
+        float v = 5;
+        float noise = 0;
+        bool spike = false;
+    };
+
+    using TL = std::pair<std::tuple<bool, float, GNode>, std::tuple<DenseLink> >;
+
+    const index_t numNodes = 100000;
+
+    struct GNet{
+        Network<TL> net;
+        Component<TL> &spikes, &currents, &neurons;
+        GNet(int workers) : net(workers),
+                            spikes(net.template component<bool>({numNodes})),
+                            currents(net.template component<float>({numNodes})),
+                            neurons(net.template component<GNode>({numNodes})){
+            net.seed(5);
+        }
+
+        std::vector<bool> &spikeValues(){
+            return std::get<std::vector<bool> >(spikes.data.values);
+        }
+        std::vector<float> &currentValues(){
+            return std::get<std::vector<float> >(currents.data.values);
+        }
+        std::vector<GNode> &neuronValues(){
+            return std::get<std::vector<GNode> >(neurons.data.values);
+        }
+    };
+
+    /// the first node of each job chunk an operation ran in
+    struct ChunkStarts{
+        size_t first = SIZE_MAX;
+        std::vector<size_t> starts;
+        void operator()(float &, const size_t Ni){
+            first = std::min(first, Ni);
+        }
+    };
+
+    double mean(const std::vector<float> &v){
+        double sum = 0;
+        for(float x : v)
+            sum += x;
+        return sum / v.size();
+    }
+
+    double stddev(const std::vector<float> &v){
+        double m = mean(v), sum = 0;
+        for(float x : v)
+            sum += (x - m) * (x - m);
+        return std::sqrt(sum / v.size());
+    }
+}
+
+void generatorsTest(){
+    GIVEN("Spikes and noise generated on one thread and on several"){
+        GNet single(0), parallel(4);
+        std::vector<float> rates(numNodes);
+        for(index_t i=0; i < numNodes; i++)
+            rates[i] = i % 2 == 0 ? 0.0f : 1.0f;
+        for(GNet *g : {&single, &parallel}){
+            GeneratePoisson(g->spikes, 0.1f, ParallelNonBlocking);
+            GenerateNoise(g->currents, 2.0f, 3.0f, ParallelNonBlocking);
+            GeneratePoisson(g->neurons, &GNode::spike, rates, ParallelNonBlocking);
+            GenerateNoise(g->neurons, &GNode::noise, 0.0f, 1.0f, ParallelNonBlocking);
+            g->net.finishBatches();
+        }
+
+        THEN("They have the given rates and distributions"){
+            std::vector<bool> &s = single.spikeValues();
+            double rate = std::count(s.begin(), s.end(), true) / double(numNodes);
+            REQUIRE(rate == Approx(0.1).margin(0.005));
+            REQUIRE(mean(single.currentValues()) == Approx(2).margin(0.05));
+            REQUIRE(stddev(single.currentValues()) == Approx(3).margin(0.05));
+            std::vector<float> noise;
+            for(index_t i=0; i < numNodes; i++){
+                const GNode &n = single.neuronValues()[i];
+                REQUIRE(n.spike == (i % 2 == 1));
+                REQUIRE(n.v == 5);
+                noise.push_back(n.noise);
+            }
+            REQUIRE(mean(noise) == Approx(0).margin(0.02));
+            REQUIRE(stddev(noise) == Approx(1).margin(0.02));
+        }
+        THEN("They don't depend on the scheduling"){
+            REQUIRE(parallel.spikeValues() == single.spikeValues());
+            REQUIRE(parallel.currentValues() == single.currentValues());
+            for(index_t i=0; i < numNodes; i++)
+                REQUIRE(parallel.neuronValues()[i].noise == single.neuronValues()[i].noise);
+        }
+        THEN("The next step gets other numbers"){
+            std::vector<bool> before = single.spikeValues();
+            GeneratePoisson(single.spikes, 0.1f);
+            REQUIRE(single.spikeValues() != before);
+        }
+    }
+
+    GIVEN("Spikes generated in parallel on a component whose size isn't a multiple of 64"){
+        const index_t n = 100003;
+        Network<TL> single(0), parallel(4);
+        Component<TL> &s1 = single.template component<bool>({n}), &s2 = parallel.template component<bool>({n});
+        Component<TL> &c2 = parallel.template component<float>({n});
+        single.seed(5);
+        parallel.seed(5);
+        bool same = true;
+        for(int step=0; step < 20; step++){
+            GeneratePoisson(s1, 0.5f);
+            GeneratePoisson(s2, 0.5f, Parallel);
+            same = same && std::get<std::vector<bool> >(s1.data.values) == std::get<std::vector<bool> >(s2.data.values);
+        }
+        ChunkStarts cs;
+        for(int step=0; step < 20; step++)
+            ProcessCmp_NNi(c2, cs, Parallel | AlignProgress(64) | Combiner([](ChunkStarts &k, ChunkStarts &copy){
+                k.starts.push_back(copy.first);
+            }));
+
+        THEN("No two workers write the same word of the bools"){
+            REQUIRE(same);
+        }
+        THEN("AlignProgress divides operations at its multiples"){
+            REQUIRE(cs.starts.size() > 20);
+            for(size_t start : cs.starts)
+                REQUIRE(start % 64 == 0);
+        }
+    }
+}
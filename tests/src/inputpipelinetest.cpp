@@ -0,0 +1,107 @@
+#include "inputpipelinetest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include "input_pipeline.hpp"
+#include <fstream>
+#include <cstdio>
+
+using namespace llrt;
+
+using TL = std::pair<std::tuple<float>, std::tuple<DenseLink> >;
+
+namespace{
+    // 3 frames of 2x2 values; value j of frame i is 10 * i + j
+    const size_t nFrames = 3, frameSize = 4;
+
+    void writeBigEndian32(std::ofstream &f, uint32_t v){
+        unsigned char b[4] = {uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v)};
+        f.write(reinterpret_cast<char *>(b), 4);
+    }
+
+    void writeFiles(){
+        std::ofstream raw("inputpipelinetest.raw", std::ios::binary);
+        std::ofstream idx("inputpipelinetest.idx", std::ios::binary);
+        std::ofstream npy("inputpipelinetest.npy", std::ios::binary);
+        const char idxMagic[4] = {0, 0, 0x08, 3};
+        idx.write(idxMagic, 4);
+        writeBigEndian32(idx, nFrames);
+        writeBigEndian32(idx, 2);
+        writeBigEndian32(idx, 2);
+        std::string header = "{'descr': '<i2', 'fortran_order': False, 'shape': (3, 2, 2), }";
+        header.append(128 - 10 - header.size() - 1, ' ');
+        header += '\n';
+        npy.write("\x93NUMPY\x01\x00", 8);
+        uint16_t len = header.size();
+        npy.write(reinterpret_cast<char *>(&len), 2);
+        npy << header;
+        for(size_t i=0; i < nFrames; i++)
+            for(size_t j=0; j < frameSize; j++){
+                float f = 10 * i + j;
+                uint8_t u = 10 * i + j;
+                int16_t s = 10 * i + j;
+                raw.write(reinterpret_cast<char *>(&f), sizeof(f));
+                idx.write(reinterpret_cast<char *>(&u), sizeof(u));
+                npy.write(reinterpret_cast<char *>(&s), sizeof(s));
+            }
+    }
+
+    void removeFiles(){
+        std::remove("inputpipelinetest.raw");
+        std::remove("inputpipelinetest.idx");
+        std::remove("inputpipelinetest.npy");
+    }
+}
+
+void inputPipelineTest(){
+    GIVEN("The same frames in raw, IDX and npy files"){
+        writeFiles();
+        std::vector<std::unique_ptr<InputSource> > sources;
+        sources.push_back(std::make_unique<RawInputSource<float> >("inputpipelinetest.raw", frameSize));
+        sources.push_back(std::make_unique<IdxInputSource>("inputpipelinetest.idx"));
+        sources.push_back(std::make_unique<NpyInputSource>("inputpipelinetest.npy"));
+
+        THEN("Every source reads the same frames"){
+            REQUIRE(dynamic_cast<NpyInputSource &>(*sources[2]).frameDimensions() == std::vector<size_t>{2, 2});
+            for(auto &s : sources){
+                REQUIRE(s->numFrames() == nFrames);
+                REQUIRE(s->frameSize() == frameSize);
+                std::vector<float> frame(frameSize);
+                s->read(2, frame.data());
+                REQUIRE(frame == std::vector<float>{20, 21, 22, 23});
+            }
+        }
+
+        WHEN("A pipeline feeds the frames to a component with nonblocking operations"){
+            Network<TL> net(2);
+            auto &A = net.template component<float>({frameSize});
+            InputPipeline::Options opts;
+            opts.ringSize = 2;
+            opts.loop = false;
+            opts.scale = 2;
+            opts.preprocess = [](float *v, size_t n, size_t frame){
+                v[0] = -1;
+            };
+            InputPipeline inputs(std::move(sources[1]), opts);
+            size_t steps = 0;
+            while(true){
+                inputs.step(net, [&](const float *frame){
+                    return ProcessCmp_NNi(A, [=](float &N, const size_t Ni){
+                        N += frame[Ni];
+                    }, ParallelNonBlocking);
+                });
+                if (inputs.exhausted())
+                    break;
+                steps++;
+            }
+            net.finishBatches();
+
+            THEN("Each frame is added once, scaled and preprocessed"){
+                REQUIRE(steps == nFrames);
+                REQUIRE(inputs.exhausted());
+                REQUIRE(inputs.frameNumber() == nFrames - 1);
+                REQUIRE(std::get<std::vector<float> >(A.data.values) == std::vector<float>{-3, 2 * 33, 2 * 36, 2 * 39});
+            }
+        }
+        removeFiles();
+    }
+}
@@ -0,0 +1,84 @@
+#include "isadispatchtest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+
+using namespace llrt;
+
+namespace{
+    using TL = std::pair<std::tuple<float>, std::tuple<DenseLink, Local2DLink<3,2,1>, AdjListLink> >;
+
+    struct INet{
+        Network<TL> net;
+        Component<TL> &A, &B, &C;
+        INet() : net(2),
+                 A(net.template component<float>({40, 40})),
+                 B(A.template connect<DenseLink, float, float, float>({300})),
+                 C(A.template connect<Local2DLink<3,2,1>, float, float, float>()){
+            A.template connect<AdjListLink, float, float>(C);
+            std::vector<std::pair<size_t, size_t> > edges;
+            std::mt19937 rng(7);
+            for(size_t i=0; i < 20000; i++)
+                edges.emplace_back(rng() % 1600, rng() % C.dataSize());
+            net.template prevLinkType<AdjListLink>().insertEdges(edges);
+            ProcessCmp_N(A, [&rng](float &N){
+                N = std::uniform_real_distribution<float>(-1, 1)(rng);
+            });
+            for(auto &l : A.links[0])
+                ProcessLink_Ee(*l, 0, [&rng](float &E, float &e){
+                    E = std::uniform_real_distribution<float>(-1, 1)(rng);
+                    e = std::uniform_real_distribution<float>(-1, 1)(rng);
+                });
+        }
+
+        /// weighted sums and updates over every link, at the current level
+        std::vector<float> run(){
+            std::vector<float> out;
+            for(auto &l : A.links[0]){
+                Component<TL> &far = l->ends[1].c;
+                ProcessCmp_N(far, [](float &N){
+                    N = 0;
+                });
+                ProcessLink_NEn(*l, 1, [](float &N, const float &E, const float &n){
+                    N += E * n + 0.5f * E;
+                }, Parallel);
+                ProcessLink_Een(*l, 0, [](const float &E, float &e, const float &n){
+                    e = 0.9f * e + E * n * 0.01f;
+                }, Parallel);
+                ProcessCmp_N(far, [&out](const float &N){
+                    out.push_back(N);
+                });
+                ProcessLink_E(*l, 0, [&out](const float &e){
+                    out.push_back(e);
+                });
+            }
+            return out;
+        }
+    };
+}
+
+void isaDispatchTest(){
+    GIVEN("Link operations run at every instruction set level this CPU supports"){
+        IsaLevel original = isaLevel();
+        std::vector<std::vector<float> > results;
+        for(IsaLevel level : {IsaLevel::Baseline, IsaLevel::AVX2, IsaLevel::AVX512}){
+            if (level > supportedIsaLevel())
+                break;
+            setIsaLevel(level);
+            INet n;
+            results.push_back(n.run());
+        }
+        setIsaLevel(original);
+
+        THEN("Every level gives the same bits"){
+            REQUIRE(results[0].size() > 100000);
+            for(size_t i=1; i < results.size(); i++)
+                REQUIRE((results[i] == results[0]));
+        }
+
+        THEN("The level can't be set above what the CPU supports"){
+            if (supportedIsaLevel() < IsaLevel::AVX512)
+                REQUIRE_THROWS(setIsaLevel(IsaLevel::AVX512));
+            REQUIRE(isaLevelName(IsaLevel::AVX2) == "avx2");
+        }
+    }
+}
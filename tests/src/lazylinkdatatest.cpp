@@ -0,0 +1,164 @@
+#include "lazylinkdatatest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include "checkpoint.hpp"
+#include "halo.hpp"
+#include "npy.hpp"
+#include "shm_replicas.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <unistd.h>
+
+using namespace llrt;
+
+namespace{
+    using TL = std::pair<std::tuple<float>, std::tuple<DenseLink> >;
+
+    std::vector<float> &values(Tensor<std::tuple<float> > &t){
+        return std::get<std::vector<float> >(t.values);
+    }
+}
+
+void lazyLinkDataTest(){
+    GIVEN("A large DenseLink with edge data on both ends, allocated lazily"){
+        Network<TL> net(2);
+        net.lazyLinkData = true;
+        Component<TL> &A = net.template component<float>({2000});
+        Component<TL> &B = A.template connect<DenseLink, float, float, float>({1000});
+        Link<TL> &l = *B.links[1][0];
+
+        THEN("Neither end is allocated until it is used"){
+            for(int e=0; e < 2; e++){
+                REQUIRE(!l.ends[e].data.materialized);
+                REQUIRE(values(l.ends[e].data).empty());
+                REQUIRE(l.ends[e].data.numValues() == 2000000);
+            }
+        }
+
+        WHEN("An operation writes to one end"){
+            ProcessLink_E(l, 1, [](float &E){
+                E += 1;
+            }, Parallel);
+
+            THEN("Only that end is allocated, from zero"){
+                REQUIRE(l.ends[1].data.materialized);
+                REQUIRE(values(l.ends[1].data) == std::vector<float>(2000000, 1));
+                REQUIRE(!l.ends[0].data.materialized);
+                REQUIRE(values(l.ends[0].data).empty());
+            }
+
+            THEN("Asking for the other end's values allocates them"){
+                REQUIRE(l.linkData<float>(0) == std::vector<float>(2000000, 0));
+                REQUIRE(l.ends[0].data.numValues() == 2000000);
+            }
+        }
+
+        WHEN("Values are assigned directly before they are used"){
+            l.ends[0].data.values = std::vector<float>(2000000, 3);
+            ProcessLink_E(l, 0, [](float &E){
+                E *= 2;
+            });
+
+            THEN("They are kept"){
+                REQUIRE(l.linkData<float>(0) == std::vector<float>(2000000, 6));
+            }
+        }
+    }
+
+    GIVEN("Lazy link ends that nothing has used"){
+        Network<TL> net(0);
+        net.lazyLinkData = true;
+        Component<TL> &A = net.template component<float>({30});
+        Component<TL> &B = A.template connect<DenseLink, float, float, float>({20});
+        Tensor<std::tuple<float> > &end = B.links[1][0]->ends[0].data;
+
+        WHEN("The network is saved and loaded"){
+            std::string filename = "lazylinkdatatest_" + std::to_string(getpid()) + ".ckpt";
+            saveCheckpoint(net, filename);
+
+            Network<TL> lazy(0);
+            lazy.lazyLinkData = true;
+            lazy.template component<float>({30}).template connect<DenseLink, float, float, float>({20});
+            loadCheckpoint(lazy, filename);
+
+            Network<TL> eager(0);
+            Component<TL> &eagerB = eager.template component<float>({30}).template connect<DenseLink, float, float, float>({20});
+            values(eagerB.links[1][0]->ends[0].data).assign(600, 7);
+            loadCheckpoint(eager, filename);
+            std::remove(filename.c_str());
+
+            THEN("Unused ends are neither allocated to save them nor to load them"){
+                REQUIRE(!end.materialized);
+                REQUIRE(!lazy.components[1]->links[1][0]->ends[0].data.materialized);
+                REQUIRE(lazy.components[1]->links[1][0]->ends[0].data.numValues() == 600);
+            }
+
+            THEN("Values that were allocated are reset to zero"){
+                REQUIRE(values(eagerB.links[1][0]->ends[0].data) == std::vector<float>(600, 0));
+            }
+        }
+
+        WHEN("They are copied to and from a halo buffer"){
+            std::vector<char> buf(haloTensorBytes(end), 1);
+            writeHaloTensor(end, buf.data());
+            bool zeros = std::all_of(buf.begin(), buf.end(), [](char c){return c == 0;});
+            readHaloTensor(end, buf.data());
+            bool stillUnallocated = !end.materialized;
+            float f = 2;
+            std::memcpy(buf.data() + 5 * sizeof(float), &f, sizeof(float));
+            readHaloTensor(end, buf.data());
+
+            THEN("Zeros are sent and received without allocating, and other values allocate them"){
+                REQUIRE(buf.size() == 600 * sizeof(float));
+                REQUIRE(zeros);
+                REQUIRE(stillUnallocated);
+                REQUIRE(end.materialized);
+                REQUIRE(values(end)[5] == 2);
+                REQUIRE(values(end)[4] == 0);
+            }
+        }
+
+        WHEN("They are saved to an npy file"){
+            std::string filename = "lazylinkdatatest_" + std::to_string(getpid()) + ".npy";
+            saveNpy(end, filename);
+            std::vector<float> saved;
+            {
+                NpyArray a(filename);
+                size_t n = std::accumulate(a.shape().begin(), a.shape().end(), size_t(1), std::multiplies<>());
+                saved.assign(a.values<float>(), a.values<float>() + n);
+            }
+            std::remove(filename.c_str());
+
+            THEN("Zeros are written without allocating them"){
+                REQUIRE(!end.materialized);
+                REQUIRE(saved == std::vector<float>(600, 0));
+            }
+        }
+
+        WHEN("A single replica averages them"){
+            std::string name = "/llrt-lazylinkdatatest-" + std::to_string(getpid());
+            {
+                ShmReplicaAverager<TL> avg(net, name, 0, 1);
+                avg.average();
+            }
+
+            THEN("They stay unallocated"){
+                REQUIRE(!end.materialized);
+            }
+        }
+    }
+
+    GIVEN("A Network with the default settings"){
+        Network<TL> net(0);
+        Component<TL> &A = net.template component<float>({20});
+        Component<TL> &B = A.template connect<DenseLink, float, NoData, float>({10});
+
+        THEN("Link ends are allocated when they are connected"){
+            REQUIRE(B.links[1][0]->ends[0].data.materialized);
+            REQUIRE(values(B.links[1][0]->ends[0].data).size() == 200);
+            REQUIRE(B.links[1][0]->ends[1].data.noData);
+        }
+    }
+}
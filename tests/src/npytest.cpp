@@ -0,0 +1,85 @@
+#include "npytest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include "npy.hpp"
+#include <cstdio>
+
+using namespace llrt;
+
+struct NpyNode{
+    float v;
+    char flag;
+    int count;
+    float hist[2];
+};
+
+template<>
+struct llrt::NpyFields<NpyNode>{
+    static std::vector<NpyField> fields(){
+        return {npyField("v", &NpyNode::v), npyField("count", &NpyNode::count), npyField("hist", &NpyNode::hist)};
+    }
+};
+
+using TL = std::pair<std::tuple<NpyNode, float, bool>, std::tuple<DenseLink> >;
+
+void npyTest(){
+    GIVEN("A network with struct, float and bool values"){
+        Network<TL> net(0);
+        auto &A = net.template component<NpyNode>({2, 3});
+        auto &B = A.template connect<DenseLink, float, NoData, bool>({4});
+        auto &av = std::get<std::vector<NpyNode> >(A.data.values);
+        for(size_t i=0; i < av.size(); i++)
+            av[i] = {i * 0.5f, 0, int(i), {float(i), -float(i)}};
+        auto &weights = std::get<std::vector<float> >(B.links[1][0]->ends[0].data.values);
+        for(size_t i=0; i < weights.size(); i++)
+            weights[i] = i;
+        auto &bv = std::get<std::vector<bool> >(B.data.values);
+        bv = {true, false, false, true};
+
+        saveNpy(A.data, "npytest_a.npy");
+        saveNpy(B.links[1][0]->ends[0].data, "npytest_w.npy");
+        saveNpy(B.data, "npytest_b.npy");
+
+        THEN("The headers describe the values as numpy would"){
+            NpyArray a("npytest_a.npy");
+            REQUIRE(a.shape() == std::vector<size_t>{2, 3});
+            REQUIRE(a.header().descr == "[('v', '<f4'), ('', '|V4'), ('count', '<i4'), ('hist', '<f4', (2,))]");
+            REQUIRE(a.header().dataOffset % 64 == 0);
+            REQUIRE(a.values<NpyNode>()[5].count == 5);
+            NpyArray w("npytest_w.npy");
+            REQUIRE(w.shape() == std::vector<size_t>{2, 3, 4});
+            REQUIRE(w.values<float>()[23] == 23);
+            REQUIRE_THROWS(w.values<int>());
+            REQUIRE(NpyArray("npytest_b.npy").header().descr == "'|b1'");
+        }
+
+        WHEN("The files are loaded into another network"){
+            Network<TL> net2(0);
+            auto &A2 = net2.template component<NpyNode>({2, 3});
+            auto &B2 = A2.template connect<DenseLink, float, NoData, bool>({4});
+            A2.data.written = false;
+            B2.links[1][0]->ends[0].data.written = false;
+            loadNpy(A2.data, "npytest_a.npy");
+            loadNpy(B2.links[1][0]->ends[0].data, "npytest_w.npy", true);
+            loadNpy(B2.data, "npytest_b.npy", true);
+
+            THEN("The values are the same"){
+                auto &av2 = std::get<std::vector<NpyNode> >(A2.data.values);
+                for(size_t i=0; i < av.size(); i++){
+                    REQUIRE(av2[i].v == av[i].v);
+                    REQUIRE(av2[i].count == av[i].count);
+                    REQUIRE(av2[i].hist[1] == av[i].hist[1]);
+                }
+                REQUIRE(std::get<std::vector<float> >(B2.links[1][0]->ends[0].data.values) == weights);
+                REQUIRE(std::get<std::vector<bool> >(B2.data.values) == bv);
+                REQUIRE(A2.data.written);
+                REQUIRE(B2.links[1][0]->ends[0].data.written);
+                REQUIRE_THROWS(loadNpy(B2.data, "npytest_w.npy"));
+                REQUIRE_THROWS(loadNpy(A2.data, "npytest_b.npy", true));
+            }
+        }
+        std::remove("npytest_a.npy");
+        std::remove("npytest_w.npy");
+        std::remove("npytest_b.npy");
+    }
+}
@@ -0,0 +1,74 @@
+#include "partitionplannertest.hpp"
+#include "catch.hpp"
+#include "partition_planner.hpp"
+
+using namespace llrt;
+
+namespace{
+    using TL = std::pair<std::tuple<float>, std::tuple<DenseLink, AdjListLink> >;
+
+    // two densely linked pairs, A-B and C-D, joined by a few edges from B to C
+    struct PNet{
+        Network<TL> net;
+        Component<TL> &A, &B, &C, &D;
+        PNet() : net(0),
+                 A(net.template component<float>({50})),
+                 B(A.template connect<DenseLink, float, float, float>({50})),
+                 C(B.template connect<AdjListLink, float, float, float>({50})),
+                 D(C.template connect<DenseLink, float, float, float>({50})){
+            std::get<AdjListLink>(B.links[0][0]->type).insertEdges({{0, 1}, {2, 3}, {4, 5}});
+        }
+    };
+
+    /// the bytes a partition would exchange, from the halo it computes
+    double haloBytes(Network<TL> &net, const std::vector<size_t> &owners){
+        double bytes = 0;
+        for(auto &h : haloTensors(net, owners))
+            bytes += haloTensorBytes(*h.t) * h.readers.size();
+        return bytes;
+    }
+}
+
+void partitionPlannerTest(){
+    GIVEN("A network of two densely linked pairs"){
+        PNet p;
+        PartitionPlan plan = planPartition(p.net, 2);
+
+        THEN("Each pair is placed on its own rank, cutting only the sparse link"){
+            REQUIRE(plan.owners.size() == 4);
+            REQUIRE(plan.owners[0] == plan.owners[1]);
+            REQUIRE(plan.owners[2] == plan.owners[3]);
+            REQUIRE(plan.owners[0] != plan.owners[2]);
+            REQUIRE(plan.cutLinks == 1);
+            REQUIRE(plan.imbalance() == Approx(1));
+            REQUIRE(plan.report().find("links cut") != std::string::npos);
+        }
+        THEN("The predicted traffic is what the partition exchanges"){
+            REQUIRE(plan.totalBytes == Approx(haloBytes(p.net, plan.owners)));
+            // the components B and C, and 3 edges at each end of their link
+            REQUIRE(plan.totalBytes == Approx(2 * 50 * 4 + 2 * 3 * 4));
+            REQUIRE(plan.bytes[0][1] == Approx(plan.totalBytes / 2));
+        }
+        THEN("It beats a placement that splits the pairs"){
+            PartitionPlan split = evaluatePartition(partitionGraph(p.net), {0, 1, 0, 1});
+            REQUIRE(split.totalBytes == Approx(haloBytes(p.net, {0, 1, 0, 1})));
+            REQUIRE(split.totalBytes > plan.totalBytes);
+            REQUIRE(split.cutLinks == 3);
+        }
+        THEN("There can't be more ranks than components"){
+            REQUIRE_THROWS_AS(planPartition(p.net, 5), std::runtime_error);
+        }
+    }
+
+    GIVEN("Unlinked components of different sizes"){
+        Network<TL> net(0);
+        for(index_t size : {10, 10, 10, 10, 20})
+            net.template component<float>({size});
+        PartitionPlan plan = planPartition(net, 2);
+
+        THEN("Their work is balanced"){
+            REQUIRE(plan.load == std::vector<double>{30, 30});
+            REQUIRE(plan.totalBytes == 0);
+        }
+    }
+}
@@ -0,0 +1,167 @@
+#include "schedsimtest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include "scheduler_simulator.hpp"
+#include <sstream>
+
+using namespace llrt;
+
+using TL = std::pair<std::tuple<float>, std::tuple<DenseLink> >;
+
+SchedulerTrace handMadeTrace(){
+    SchedulerTrace trace;
+    trace.opTypes[1] = {"A", 1.0};
+    trace.opTypes[2] = {"B", 2.0};
+    trace.batches.push_back({{{1, 1, 1000, false}, {2, 2, 500, false}, {1, 3, 1000, true}}});
+    return trace;
+}
+
+SchedulerSimulator::Options exactOptions(size_t nWorkers){
+    SchedulerSimulator::Options opts;
+    opts.nWorkers = nWorkers;
+    opts.chunkOverhead = dur_t::zero();
+    opts.barrierOverhead = dur_t::zero();
+    opts.singleThreadedOverhead = dur_t::zero();
+    return opts;
+}
+
+void schedSimTest(){
+    GIVEN("A hand-made trace with jobs of known cost"){
+        SchedulerTrace trace = handMadeTrace();
+        WHEN("It is simulated with one worker"){
+            SchedulerSimulator::Result r = SchedulerSimulator(trace, exactOptions(1)).run();
+            THEN("The makespan is the total cost, with no idle time"){
+                REQUIRE(r.makespan == std::chrono::microseconds(3000));
+                REQUIRE(r.busy == std::chrono::microseconds(3000));
+                REQUIRE(r.idle == dur_t::zero());
+                REQUIRE(r.barriers == 1);
+            }
+        }
+        WHEN("It is simulated with two workers"){
+            SchedulerSimulator::Result r = SchedulerSimulator(trace, exactOptions(2)).run();
+            SchedulerSimulator::Result r2 = SchedulerSimulator(trace, exactOptions(2)).run();
+            THEN("The work is shared, and the result is deterministic"){
+                REQUIRE(r.makespan < std::chrono::microseconds(3000));
+                REQUIRE(r.makespan >= std::chrono::microseconds(1500));
+                REQUIRE(r.busy == std::chrono::microseconds(3000));
+                REQUIRE(r.idle == r.makespan * 2 - r.busy);
+                REQUIRE(r.makespan == r2.makespan);
+                REQUIRE(r.chunks == r2.chunks);
+            }
+        }
+        WHEN("Two jobs share a cmpId"){
+            trace.batches[0].jobs[1].cmpId = 1;
+            SchedulerSimulator::Result r = SchedulerSimulator(trace, exactOptions(2)).run();
+            THEN("They go in separate barriers"){
+                REQUIRE(r.barriers == 2);
+            }
+        }
+        WHEN("Chunks may only end at recorded progress points"){
+            SchedulerTrace pointTrace;
+            pointTrace.opTypes[1] = {"A", 1.0};
+            pointTrace.batches.push_back({{{1, 1, 1000, false}}});
+            pointTrace.progressPoints[{1, 1000}] = {250, 500, 750, 1000};
+            SchedulerSimulator::Result r = SchedulerSimulator(pointTrace, exactOptions(3)).run();
+            THEN("Chunk sizes are rounded up to the points"){
+                // 1000us over 3 workers rounds up to two chunks of 500
+                REQUIRE(r.makespan == std::chrono::microseconds(500));
+                REQUIRE(r.chunks == 2);
+            }
+        }
+        WHEN("It is saved and loaded"){
+            trace.progressPoints[{1, 1000}] = {10, 1000};
+            std::stringstream st;
+            trace.save(st);
+            SchedulerTrace loaded = SchedulerTrace::load(st);
+            THEN("The same trace comes back"){
+                REQUIRE(loaded.opTypes.size() == 2);
+                REQUIRE(loaded.opTypes[2].kernelName == "B");
+                REQUIRE(loaded.opTypes[2].usPerOp == 2.0);
+                REQUIRE(loaded.progressPoints[{1, 1000}] == std::vector<size_t>{10, 1000});
+                REQUIRE(loaded.batches.size() == 1);
+                REQUIRE(loaded.batches[0].jobs.size() == 3);
+                REQUIRE(loaded.batches[0].jobs[2].indivisible);
+                REQUIRE(loaded.batches[0].jobs[1].maxProgress == 500);
+            }
+        }
+    }
+
+    GIVEN("A trace recorded from a running network"){
+        Network<TL> net(2);
+        Component<TL> &a = net.component<float>({100});
+        a.connect<DenseLink, NoData, float, float>({100});
+        net.sched->startTrace();
+        for(int i=0; i < 5; i++){
+            ProcessNetLinks_NEn(net, [](float &N, const float &E, const float &n){
+                N += E * n;
+            }, Dendrites | Parallel);
+            ProcessNetCmps_N(net, [](float &N){
+                N = 0;
+            }, Parallel);
+        }
+        SchedulerTrace trace = net.sched->stopTrace();
+        THEN("It has every batch, and can be simulated"){
+            REQUIRE(trace.batches.size() == 10);
+            REQUIRE(trace.opTypes.size() == 2);
+            REQUIRE(trace.batches[0].jobs[0].maxProgress == 10000);
+            SchedulerSimulator::Result r = SchedulerSimulator(trace, SchedulerSimulator::Options()).run();
+            REQUIRE(r.barriers >= 10);
+            REQUIRE(r.makespan > dur_t::zero());
+        }
+    }
+
+    GIVEN("A network that hasn't submitted a batch yet"){
+        Network<TL> net(2);
+        Component<TL> &a = net.component<float>({100});
+        THEN("Waiting for its batches returns at once, and later ones still finish"){
+            REQUIRE(net.sched->batchFinished(0));
+            net.finishBatches();
+            ProcessNetCmps_N(net, [](float &N){
+                N = 1;
+            }, ParallelNonBlocking);
+            net.finishBatches();
+            REQUIRE(std::get<std::vector<float> >(a.data.values) == std::vector<float>(100, 1));
+        }
+    }
+
+    GIVEN("A trace of hundreds of tiny jobs"){
+        SchedulerTrace trace;
+        trace.opTypes[1] = {"A", 1.0};
+        trace.batches.emplace_back();
+        for(int i=0; i < 400; i++)
+            trace.batches[0].jobs.push_back({1, i, 1, false});
+        SchedulerSimulator::Options opts;
+        SchedulerSimulator::Result packed = SchedulerSimulator(trace, opts).run();
+        opts.packJobThreshold = dur_t::zero();
+        SchedulerSimulator::Result unpacked = SchedulerSimulator(trace, opts).run();
+
+        THEN("They are packed into one chunk per worker"){
+            REQUIRE(unpacked.chunks == 400);
+            REQUIRE(packed.chunks == 4);
+            REQUIRE(packed.barriers == unpacked.barriers);
+            REQUIRE(packed.makespan < unpacked.makespan);
+        }
+    }
+
+    GIVEN("A network of many tiny components"){
+        Network<TL> net(2);
+        net.sched->singleThreadThreshold = dur_t::zero();
+        std::vector<Component<TL> *> cmps;
+        for(int i=0; i < 200; i++)
+            cmps.push_back(&net.component<float>({4}));
+        for(int step=0; step < 5; step++)
+            ProcessNetCmps_N(net, [](float &N){
+                N += 1;
+            }, Parallel);
+
+        THEN("Every job runs once per step, and tiny ones share chunks"){
+            for(Component<TL> *c : cmps)
+                REQUIRE(std::get<std::vector<float> >(c->data.values) == std::vector<float>(4, 5));
+            Scheduler::Stats stats = net.sched->getStats();
+            REQUIRE(stats.packedJobs > 0);
+            REQUIRE(stats.barriers == 5);
+            REQUIRE(stats.singleThreadedBarriers <= stats.barriers);
+            REQUIRE(stats.chunks + stats.packedJobs >= 5 * 200);
+        }
+    }
+}
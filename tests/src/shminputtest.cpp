@@ -0,0 +1,111 @@
+#include "shminputtest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include "shm_input.hpp"
+#include <thread>
+#include <atomic>
+#include <unistd.h>
+
+using namespace llrt;
+
+using TL = std::pair<std::tuple<float>, std::tuple<DenseLink> >;
+
+void shmInputTest(){
+    GIVEN("A shared-memory frame ring with 3 slots"){
+        std::string name = "/llrt_shminputtest_" + std::to_string(getpid());
+        const size_t frameSize = 4;
+        ShmFrameProducer producer(name, frameSize, 3);
+        ShmInputChannel::Options opts;
+        opts.timeout = std::chrono::milliseconds(20);
+
+        THEN("Attaching to a missing ring, or waiting for a frame that never comes, throws"){
+            REQUIRE_THROWS_AS(ShmInputChannel("/llrt_shminputtest_missing"), std::runtime_error);
+            ShmInputChannel inputs(name, opts);
+            Network<TL> net(0);
+            REQUIRE_THROWS_AS(inputs.step(net, [](const float *){return size_t(0);}), std::runtime_error);
+        }
+
+        WHEN("Frames are fed to a component with nonblocking operations"){
+            Network<TL> net(2);
+            auto &A = net.template component<float>({frameSize});
+            ShmInputChannel inputs(name, opts);
+            auto submit = [&](const float *frame){
+                return ProcessCmp_NNi(A, [=](float &N, const size_t Ni){
+                    N += frame[Ni];
+                }, ParallelNonBlocking);
+            };
+            std::vector<float> f1{1, 2, 3, 4}, f2{10, 20, 30, 40}, f3{100, 200, 300, 400};
+            REQUIRE(producer.publish(f1.data()) == 1);
+            inputs.step(net, submit);
+            // the consumer holds one slot and the producer keeps the latest
+            // frame, so it always has a slot to write
+            REQUIRE(producer.publish(f2.data()) == 2);
+            REQUIRE(producer.publish(f3.data()) == 3);
+            inputs.step(net, submit);
+            net.finishBatches();
+
+            THEN("Each step reads the newest frame, skipping the others"){
+                REQUIRE(inputs.sequence() == 3);
+                REQUIRE(std::get<std::vector<float> >(A.data.values) == std::vector<float>{101, 202, 303, 404});
+            }
+        }
+
+        WHEN("Without waiting for new frames, steps read the newest frame again"){
+            Network<TL> net(0);
+            auto &A = net.template component<float>({frameSize});
+            opts.waitForNew = false;
+            ShmInputChannel inputs(name, opts);
+            std::vector<float> f1{1, 2, 3, 4};
+            producer.publish(f1.data());
+            for(int i=0; i < 3; i++)
+                inputs.step(net, [&](const float *frame){
+                    return ProcessCmp_NNi(A, [=](float &N, const size_t Ni){
+                        N += frame[Ni];
+                    });
+                });
+
+            THEN("The frame is added each time"){
+                REQUIRE(inputs.sequence() == 1);
+                REQUIRE(std::get<std::vector<float> >(A.data.values) == std::vector<float>{3, 6, 9, 12});
+            }
+        }
+    }
+
+    GIVEN("A producer thread publishing large frames as fast as it can"){
+        std::string name = "/llrt_shminputtest_big_" + std::to_string(getpid());
+        const size_t frameSize = 1 << 14;
+        ShmFrameProducer producer(name, frameSize, 4);
+        ShmInputChannel inputs(name);
+        std::atomic<bool> stop{false};
+        std::thread t([&]{
+            std::vector<float> frame(frameSize);
+            for(uint64_t i=1; !stop; i++){
+                std::fill(frame.begin(), frame.end(), float(i % 1000));
+                producer.publish(frame.data());
+            }
+        });
+        Network<TL> net(2);
+        auto &A = net.template component<float>({frameSize});
+        std::atomic<size_t> torn{0};
+        uint64_t prevSeq = 0;
+        bool increasing = true;
+        for(int i=0; i < 50; i++){
+            inputs.step(net, [&](const float *frame){
+                return ProcessCmp_NNi(A, [=, &torn](float &N, const size_t Ni){
+                    if (frame[Ni] != frame[0])
+                        torn++;
+                }, ParallelNonBlocking);
+            });
+            increasing = increasing && inputs.sequence() > prevSeq;
+            prevSeq = inputs.sequence();
+        }
+        net.finishBatches();
+        stop = true;
+        t.join();
+
+        THEN("Every frame read is whole, and newer than the last"){
+            REQUIRE(torn == 0);
+            REQUIRE(increasing);
+        }
+    }
+}
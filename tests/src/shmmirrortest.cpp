@@ -0,0 +1,91 @@
+#include "shmmirrortest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include "shm_mirror.hpp"
+#include <thread>
+#include <atomic>
+#include <unistd.h>
+
+using namespace llrt;
+
+using TL = std::pair<std::tuple<float>, std::tuple<DenseLink> >;
+
+void shmMirrorTest(){
+    GIVEN("A state mirror of a component's values and of which of them are odd"){
+        std::string name = "/llrt_shmmirrortest_" + std::to_string(getpid());
+        const size_t n = 100;
+        Network<TL> net(2);
+        auto &A = net.template component<float>({n});
+        ShmStateMirror mirror(name, {{"v", ShmFloat, n}, {"odd", ShmBits, n}});
+        ShmStateViewer viewer(name);
+        auto step = [&]{
+            return mirror.capture(net, [&]{
+                float *v = mirror.floats(0);
+                return ProcessCmp_NNi(A, [&, v](float &N, const size_t Ni){
+                    N += 1;
+                    v[Ni] = N;
+                    if (size_t(N) % 2 == 1)
+                        mirror.setBit(1, Ni);
+                }, ParallelNonBlocking);
+            });
+        };
+
+        THEN("The viewer sees the fields, and no frame before the first is published"){
+            REQUIRE(viewer.getFields().size() == 2);
+            REQUIRE(viewer.fieldIndex("odd") == 1);
+            REQUIRE(viewer.getFields()[0].count == n);
+            REQUIRE_THROWS_AS(viewer.fieldIndex("w"), std::runtime_error);
+            REQUIRE(viewer.read() == 0);
+        }
+
+        WHEN("Steps are captured"){
+            step();
+            step();
+            step();
+            mirror.finish(net);
+
+            THEN("The viewer reads the newest frame"){
+                REQUIRE(mirror.frame() == 3);
+                REQUIRE(viewer.read() == 3);
+                for(size_t i=0; i < n; i++){
+                    REQUIRE(viewer.floats(0)[i] == 3);
+                    REQUIRE(viewer.bit(1, i));
+                }
+                step();
+                mirror.finish(net);
+                REQUIRE(viewer.read() == 4);
+                REQUIRE(viewer.floats(0)[n - 1] == 4);
+                REQUIRE(!viewer.bit(1, n - 1));
+            }
+        }
+
+        WHEN("A viewer thread reads frames while the network runs"){
+            std::atomic<bool> stop{false};
+            std::atomic<size_t> inconsistent{0}, framesRead{0};
+            std::thread t([&]{
+                ShmStateViewer v(name);
+                uint64_t last = 0;
+                while(!stop){
+                    uint64_t frame = v.read();
+                    if (frame == last)
+                        continue;
+                    last = frame;
+                    framesRead++;
+                    for(size_t i=0; i < n; i++)
+                        if (v.floats(0)[i] != frame || v.bit(1, i) != (frame % 2 == 1))
+                            inconsistent++;
+                }
+            });
+            for(int i=0; i < 2000; i++)
+                step();
+            mirror.finish(net);
+            stop = true;
+            t.join();
+
+            THEN("Every frame it reads is whole"){
+                REQUIRE(inconsistent == 0);
+                REQUIRE(framesRead > 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#include "shmpartitiontest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include "shm_partition.hpp"
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace llrt;
+
+namespace{
+    struct PNode{
+        float v;
+        float in;
+    };
+
+    using TL = std::pair<std::tuple<PNode, float>, std::tuple<DenseLink> >;
+
+    const size_t steps = 20;
+
+    // A -> B -> C, all densely linked in both directions
+    struct PNet{
+        Network<TL> net;
+        Component<TL> &A, &B, &C;
+        PNet() : net(2),
+                 A(net.template component<PNode>({4})),
+                 B(A.template connect<DenseLink, float, float, PNode>({3})),
+                 C(B.template connect<DenseLink, float, float, PNode>({2})){}
+
+        void initialize(){
+            ProcessNetCmps_NNi(net, [](PNode &N, const size_t Ni){
+                N.v = Ni + 1;
+                N.in = 0;
+            }, Parallel);
+            ProcessNetLinks_EEi(net, [](float &E, const size_t Ei){
+                E = 0.1f * (Ei % 5 + 1);
+            }, Parallel);
+        }
+
+        void step(){
+            ProcessNetLinks_NEn(net, [](PNode &N, const float &E, const PNode &n){
+                N.in += E * n.v;
+            }, Parallel);
+            ProcessNetCmps_N(net, [](PNode &N){
+                N.v = 0.5f * N.v + 0.1f * N.in + 0.01f;
+                N.in = 0;
+            }, Parallel);
+        }
+    };
+
+    std::vector<float> values(Component<TL> &c){
+        std::vector<float> v;
+        for(const PNode &n : std::get<std::vector<PNode> >(c.data.values))
+            v.push_back(n.v);
+        return v;
+    }
+}
+
+void shmPartitionTest(){
+    GIVEN("A network run in one process"){
+        PNet ref;
+        ref.initialize();
+        for(size_t t=0; t < steps; t++)
+            ref.step();
+        std::vector<float> refA = values(ref.A), refB = values(ref.B);
+
+        WHEN("The same network is split between two processes, with A on rank 0 and B and C on rank 1"){
+            std::string name = "/llrt_shmpartitiontest_" + std::to_string(getpid());
+            ShmPartition<TL>::Options opts;
+            opts.timeout = std::chrono::milliseconds(20000);
+            pid_t child = fork();
+            if (child == 0){
+                int status = 0;
+                try{
+                    PNet p;
+                    ShmPartition<TL> part(p.net, name, 1, {0, 1, 1}, opts);
+                    p.initialize();
+                    part.exchange();
+                    for(size_t t=0; t < steps; t++){
+                        p.step();
+                        part.exchange();
+                    }
+                }
+                catch(...){
+                    status = 1;
+                }
+                _exit(status);
+            }
+            REQUIRE(child > 0);
+            PNet p;
+            std::vector<float> initialB;
+            size_t outgoing, incoming;
+            {
+                ShmPartition<TL> part(p.net, name, 0, {0, 1, 1}, opts);
+                outgoing = part.outgoingTensors();
+                incoming = part.incomingTensors();
+                p.initialize();
+                initialB = values(p.B);
+                part.exchange();
+                for(size_t t=0; t < steps; t++){
+                    p.step();
+                    part.exchange();
+                }
+            }
+            int status = -1;
+            waitpid(child, &status, 0);
+
+            THEN("Rank 0 sees the same values as the single process, with B's values from rank 1"){
+                REQUIRE(WIFEXITED(status));
+                REQUIRE(WEXITSTATUS(status) == 0);
+                // A's data and A's end of the A-B link go out; B's data and end come in
+                REQUIRE(outgoing == 2);
+                REQUIRE(incoming == 2);
+                // rank 0 didn't initialize B itself
+                REQUIRE(initialB == std::vector<float>(3, 0));
+                std::vector<float> a = values(p.A), b = values(p.B);
+                for(size_t i=0; i < refA.size(); i++)
+                    REQUIRE(a[i] == Approx(refA[i]));
+                for(size_t i=0; i < refB.size(); i++)
+                    REQUIRE(b[i] == Approx(refB[i]));
+                // C isn't in rank 0's halo
+                REQUIRE(values(p.C) == std::vector<float>(2, 0));
+                REQUIRE(p.C.local);
+            }
+        }
+    }
+}
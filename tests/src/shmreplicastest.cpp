@@ -0,0 +1,156 @@
+#include "shmreplicastest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include "shm_replicas.hpp"
+#include "incremental_checkpoint.hpp"
+#include <cstdio>
+#include <unistd.h>
+
+using namespace llrt;
+
+namespace{
+    using TL = std::pair<std::tuple<float, double, int>, std::tuple<DenseLink> >;
+
+    const size_t numReplicas = 3;
+
+    // A -> B densely linked with float and double ends, and an int link to C that isn't averaged
+    struct RNet{
+        Network<TL> net;
+        Component<TL> &A, &B, &C;
+        RNet() : net(1),
+                 A(net.template component<float>({5})),
+                 B(A.template connect<DenseLink, float, double, float>({4})),
+                 C(B.template connect<DenseLink, int, int, float>({2})){}
+
+        std::vector<float> &weights(){
+            return std::get<std::vector<float> >(B.links[1][0]->ends[0].data.values);
+        }
+        std::vector<double> &backWeights(){
+            return std::get<std::vector<double> >(B.links[1][0]->ends[1].data.values);
+        }
+        std::vector<int> &counts(){
+            return std::get<std::vector<int> >(C.links[1][0]->ends[0].data.values);
+        }
+
+        /// values that differ between replicas
+        void learn(size_t replica, size_t round){
+            ProcessLink_EEi(*B.links[1][0], 0, [=](float &E, const size_t Ei){
+                E = 0.1f * (Ei % 7) + 0.37f * replica + round;
+            }, Parallel);
+            ProcessLink_EEi(*B.links[1][0], 1, [=](double &E, const size_t Ei){
+                E = 0.3 * Ei - replica;
+            }, Parallel);
+            for(int &c : counts())
+                c = replica;
+        }
+    };
+
+    /// run f(replica, net) for each replica in its own thread
+    template<typename F>
+    void runReplicas(std::vector<RNet> &nets, F &&f){
+        std::vector<std::thread> threads;
+        std::vector<std::exception_ptr> errors(numReplicas);
+        for(size_t r=0; r < numReplicas; r++)
+            threads.emplace_back([&, r]{
+                try{
+                    f(r, nets[r]);
+                }
+                catch(...){
+                    errors[r] = std::current_exception();
+                }
+            });
+        for(auto &t : threads)
+            t.join();
+        for(auto &e : errors)
+            if (e)
+                std::rethrow_exception(e);
+    }
+}
+
+void shmReplicasTest(){
+    std::string name = "/llrt-shmreplicastest-" + std::to_string(getpid());
+    std::vector<RNet> nets(numReplicas);
+
+    GIVEN("Replicas that learn different weights"){
+        const size_t rounds = 3;
+        // small chunks, so that each replica reduces several of them
+        ShmReplicaAverager<TL>::Options opts;
+        opts.chunkValues = 3;
+        size_t numValues = 0;
+        std::vector<uint64_t> completed(numReplicas);
+        runReplicas(nets, [&](size_t r, RNet &n){
+            ShmReplicaAverager<TL> avg(n.net, name, r, numReplicas, opts);
+            if (r == 0)
+                numValues = avg.numValues();
+            for(size_t round=0; round < rounds; round++){
+                n.learn(r, round);
+                avg.average();
+            }
+            completed[r] = avg.rounds();
+        });
+
+        THEN("They all get the same average, bit for bit, and other types are left alone"){
+            REQUIRE(numValues == 2 * 5 * 4);
+            REQUIRE(completed == std::vector<uint64_t>(numReplicas, rounds));
+            for(size_t i=0; i < nets[0].weights().size(); i++){
+                double sum = 0;
+                for(size_t r=0; r < numReplicas; r++)
+                    sum += double(0.1f * (i % 7) + 0.37f * r + (rounds - 1));
+                REQUIRE(nets[0].weights()[i] == Approx(sum / numReplicas));
+            }
+            for(size_t i=0; i < nets[0].backWeights().size(); i++)
+                REQUIRE(nets[0].backWeights()[i] == Approx(0.3 * i - 1));
+            for(size_t r=1; r < numReplicas; r++){
+                REQUIRE(nets[r].weights() == nets[0].weights());
+                REQUIRE(nets[r].backWeights() == nets[0].backWeights());
+                REQUIRE(nets[r].counts() == std::vector<int>(8, r));
+            }
+        }
+    }
+
+    GIVEN("Replicas that keep learning while averaging"){
+        runReplicas(nets, [&](size_t r, RNet &n){
+            ShmReplicaAverager<TL> avg(n.net, name, r, numReplicas);
+            n.learn(r, 0);
+            avg.average([&]{
+                // changes made during the averaging are kept on top of it
+                return ProcessLink_E(*n.B.links[1][0], 0, [r](float &E){
+                    E += r;
+                }, ParallelNonBlocking);
+            });
+        });
+
+        THEN("Their own changes are added to the average"){
+            for(size_t r=0; r < numReplicas; r++)
+                for(size_t i=0; i < nets[r].weights().size(); i++)
+                    REQUIRE(nets[r].weights()[i] == Approx(0.1f * (i % 7) + 0.37f + r));
+        }
+    }
+
+    GIVEN("Replicas that checkpoint incrementally before and after averaging"){
+        std::vector<std::vector<float> > restored(numReplicas);
+        runReplicas(nets, [&](size_t r, RNet &n){
+            std::string prefix = "shmreplicastest_" + std::to_string(getpid()) + "_" + std::to_string(r);
+            IncrementalCheckpointer<TL> ckpt(n.net, prefix);
+            ShmReplicaAverager<TL> avg(n.net, name, r, numReplicas);
+            n.learn(r, 0);
+            ckpt.checkpoint();
+            avg.average();
+            ckpt.checkpoint();
+            ckpt.wait();
+
+            RNet loaded;
+            loadCheckpointChain(loaded.net, ckpt.chainFilename());
+            restored[r] = loaded.weights();
+            for(const std::string &f : {prefix + ".0.ckpt", prefix + ".1.delta", prefix + ".chain"})
+                std::remove(f.c_str());
+        });
+
+        THEN("The delta holds the averaged weights, which were the same for all"){
+            for(size_t r=0; r < numReplicas; r++){
+                REQUIRE(restored[r] == nets[r].weights());
+                REQUIRE(restored[r] == restored[0]);
+            }
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#include "spikestreamtest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include "spike_stream.hpp"
+#include <cstdio>
+
+using namespace llrt;
+
+using TL = std::pair<std::tuple<float>, std::tuple<DenseLink> >;
+
+void spikeStreamTest(){
+    std::string filename = "spikestreamtest.spikes";
+    GIVEN("A writer recording spikes from kernels on several threads"){
+        Network<TL> net(3);
+        const size_t n = 1000;
+        auto &A = net.template component<float>({n});
+        std::vector<std::pair<uint64_t, size_t> > expected;
+        std::vector<std::vector<float> > traces;
+        {
+            SpikeStreamWriter::Options opts;
+            opts.traceWidth = 3;
+            opts.blockBytes = 64;
+            SpikeStreamWriter w(filename, n, opts);
+            for(uint64_t t=0; t < 20; t++){
+                // sparse on most steps, dense on every fifth, none on every seventh
+                size_t every = t % 7 == 6 ? n + 1 : (t % 5 == 0 ? 2 : 97);
+                ProcessCmp_NNi(A, [&w, every, t](float &N, const size_t Ni){
+                    N = t;
+                    if ((Ni + t) % every == 0)
+                        w.record(Ni);
+                });
+                for(size_t i=0; i < n; i++)
+                    if ((i + t) % every == 0)
+                        expected.push_back({t, i});
+                w.endStep(t);
+                std::vector<float> v{float(t), 0.5f, -float(t) / 3};
+                w.trace(t, v.data());
+                traces.push_back(v);
+            }
+            w.spikes(25, {7, 3});
+            expected.push_back({25, 3});
+            expected.push_back({25, 7});
+            w.close();
+            REQUIRE(w.bytesEncoded() < expected.size() * 2 + 20 * 16 + 200);
+        }
+
+        THEN("The reader returns the same spikes and traces"){
+            SpikeStreamReader r(filename);
+            REQUIRE(r.numNodes() == n);
+            REQUIRE(r.traceWidth() == 3);
+            std::vector<std::pair<uint64_t, size_t> > spikes;
+            std::vector<std::vector<float> > readTraces;
+            SpikeStreamRecord rec;
+            while(r.next(rec)){
+                if (rec.kind == SpikeStreamRecord::Trace)
+                    readTraces.push_back(rec.values);
+                else
+                    for(size_t i : rec.nodes)
+                        spikes.push_back({rec.step, i});
+            }
+            REQUIRE(spikes == expected);
+            REQUIRE(readTraces == traces);
+        }
+        std::remove(filename.c_str());
+    }
+}
@@ -4,6 +4,24 @@
 #include "local2dtester.hpp"
 #include "sigmoidtest.hpp"
 #include "adjlisttest.hpp"
+#include "schedsimtest.hpp"
+#include "checkpointtest.hpp"
+#include "inputpipelinetest.hpp"
+#include "spikestreamtest.hpp"
+#include "npytest.hpp"
+#include "topologycachetest.hpp"
+#include "shminputtest.hpp"
+#include "shmmirrortest.hpp"
+#include "shmpartitiontest.hpp"
+#include "distributedtest.hpp"
+#include "partitionplannertest.hpp"
+#include "shmreplicastest.hpp"
+#include "counterrngtest.hpp"
+#include "generatorstest.hpp"
+#include "combinertest.hpp"
+#include "lazylinkdatatest.hpp"
+#include "isadispatchtest.hpp"
+#include "arraylinktest.hpp"
 
 using namespace llrt;
 
@@ -100,3 +118,75 @@ SCENARIO("Sigmoid tests", "[sigmoid]"){
 SCENARIO("AdjListLink tests", "[adjlist]"){
     adjListTest();
 }
+
+SCENARIO("Scheduler simulator tests", "[scheduler]"){
+    schedSimTest();
+}
+
+SCENARIO("Checkpoint tests", "[checkpoint]"){
+    checkpointTest();
+}
+
+SCENARIO("Input pipeline tests", "[input]"){
+    inputPipelineTest();
+}
+
+SCENARIO("Spike stream tests", "[spikes]"){
+    spikeStreamTest();
+}
+
+SCENARIO("Npy tests", "[npy]"){
+    npyTest();
+}
+
+SCENARIO("Topology cache tests", "[topology]"){
+    topologyCacheTest();
+}
+
+SCENARIO("Shared-memory input tests", "[shm]"){
+    shmInputTest();
+}
+
+SCENARIO("Shared-memory state mirror tests", "[shm]"){
+    shmMirrorTest();
+}
+
+SCENARIO("Shared-memory partition tests", "[shm]"){
+    shmPartitionTest();
+}
+
+SCENARIO("Distributed partition tests", "[distributed]"){
+    distributedTest();
+}
+
+SCENARIO("Partition planner tests", "[partition]"){
+    partitionPlannerTest();
+}
+
+SCENARIO("Shared-memory replica averaging tests", "[shm]"){
+    shmReplicasTest();
+}
+
+SCENARIO("Counter-based RNG tests", "[rng]"){
+    counterRNGTest();
+}
+
+SCENARIO("Generator tests", "[generators]"){
+    generatorsTest();
+}
+
+SCENARIO("Combiner tests", "[combiner]"){
+    combinerTest();
+}
+
+SCENARIO("Lazy link data tests", "[lazy]"){
+    lazyLinkDataTest();
+}
+
+SCENARIO("Instruction set dispatch tests", "[isa]"){
+    isaDispatchTest();
+}
+
+SCENARIO("Array link tests", "[array]"){
+    arrayLinkTest();
+}
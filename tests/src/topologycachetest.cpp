@@ -0,0 +1,86 @@
+#include "topologycachetest.hpp"
+#include "catch.hpp"
+#include "process_link.hpp"
+#include "topology_cache.hpp"
+#include <cstdio>
+
+using namespace llrt;
+
+using TTypes = std::tuple<float>;
+using LTypes = std::tuple<GeneralLocal2DLink, AdjListLink, DenseLink>;
+using TL = std::pair<TTypes, LTypes>;
+
+// A Network with a GeneralLocal2D link, an AdjList link and a Dense link
+struct TopoNet{
+    Network<TL> net;
+    Component<TL> &A, &B, &C;
+    TopoNet(size_t filterRows) : net(2),
+                                 A(net.template component<float>({9, 8})),
+                                 B(A.template connect<GeneralLocal2DLink, float, float, float>({5, 4})),
+                                 C(B.template connect<AdjListLink, float, float, float>({6})){
+        local2d().setParams(-1, -1, filterRows, 3, 2, 2, 1, 1);
+        C.template connect<DenseLink, float, float>(A);
+    }
+    GeneralLocal2DLink &local2d(){
+        return std::get<GeneralLocal2DLink>(A.links[0][0]->type);
+    }
+    AdjListLink &adj(){
+        return std::get<AdjListLink>(B.links[0][0]->type);
+    }
+    /// the sum over edges of the near and far node indices, for each end of each link
+    std::vector<size_t> edgeSums(){
+        std::vector<size_t> sums;
+        for(Link<TL> *l : {A.links[0][0].get(), B.links[0][0].get()})
+            for(int e=0; e < 2; e++){
+                size_t s = 0;
+                ProcessLink_Nini(*l, e, [&s](const size_t Ni, const size_t ni){
+                    s += Ni * 100 + ni;
+                });
+                sums.push_back(s);
+            }
+        return sums;
+    }
+};
+
+void topologyCacheTest(){
+    std::string filename = "topologycachetest.topo";
+    std::remove(filename.c_str());
+    GIVEN("A cache saved from a network"){
+        TopoNet a(3);
+        {
+            TopologyCache cache(filename);
+            REQUIRE(cache.size() == 0);
+            REQUIRE(!cache.load(a.net));
+            a.adj().insertEdges({{0, 1}, {3, 5}, {19, 0}, {7, 2}});
+            cache.save(a.net);
+            REQUIRE(cache.size() == 3);
+        }
+
+        WHEN("The same network is built again"){
+            TopoNet b(3);
+            TopologyCache cache(filename);
+            THEN("Its links' indexes are loaded, not computed, and iterate the same edges"){
+                REQUIRE(cache.load(b.net));
+                REQUIRE(!b.local2d().dirty);
+                REQUIRE(b.local2d().cumulativeEnd0RowSizes == a.local2d().cumulativeEnd0RowSizes);
+                REQUIRE(b.adj().edgeIxBound == 4);
+                REQUIRE(b.B.links[0][0]->linkData<float>(0).size() == 4);
+                REQUIRE(b.edgeSums() == a.edgeSums());
+            }
+        }
+
+        WHEN("A network with different link parameters is built"){
+            TopoNet c(5);
+            TopologyCache cache(filename);
+            THEN("Nothing is loaded, and saving adds its entries"){
+                REQUIRE(!cache.load(c.net));
+                REQUIRE(c.adj().edgeIxBound == 0);
+                REQUIRE(c.local2d().dirty);
+                cache.save(c.net);
+                REQUIRE(cache.size() == 4);
+                REQUIRE(TopologyCache(filename).load(c.net));
+            }
+        }
+        std::remove(filename.c_str());
+    }
+}